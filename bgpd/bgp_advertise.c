@@ -40,6 +40,49 @@
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_updgrp.h"
 
+/* Per-prefix, per-peer state; there are millions of these in a big
+   table, so they come from slabs. */
+DEFINE_MTYPE_SLAB(BGPD, BGP_ADJ_IN,	"BGP adj in",
+		  sizeof (struct bgp_adj_in))
+DEFINE_MTYPE_SLAB(BGPD, BGP_ADJ_OUT,	"BGP adj out",
+		  sizeof (struct bgp_adj_out))
+
+static __inline int bgp_adj_out_compare (const struct bgp_adj_out *,
+                                         const struct bgp_adj_out *);
+
+RB_GENERATE (bgp_adj_out_rb, bgp_adj_out, adj_entry, bgp_adj_out_compare)
+
+static __inline int
+bgp_adj_out_compare (const struct bgp_adj_out *o1,
+                     const struct bgp_adj_out *o2)
+{
+  if (o1->subgroup->id != o2->subgroup->id)
+    return o1->subgroup->id < o2->subgroup->id ? -1 : 1;
+  if (o1->addpath_tx_id != o2->addpath_tx_id)
+    return o1->addpath_tx_id < o2->addpath_tx_id ? -1 : 1;
+  return 0;
+}
+
+/* The adj-out of subgrp on rn for addpath_tx_id.  With any_id, the
+   subgroup's first one whatever its id, which is the only one there is
+   for subgroups that don't do addpath. */
+struct bgp_adj_out *
+bgp_adj_out_find (struct bgp_node *rn, struct update_subgroup *subgrp,
+                  u_int32_t addpath_tx_id, int any_id)
+{
+  struct bgp_adj_out lookup;
+  struct bgp_adj_out *adj;
+
+  lookup.subgroup = subgrp;
+  lookup.addpath_tx_id = any_id ? 0 : addpath_tx_id;
+  adj = RB_NFIND (bgp_adj_out_rb, &rn->adj_out, &lookup);
+  if (!adj || adj->subgroup != subgrp)
+    return NULL;
+  if (!any_id && adj->addpath_tx_id != addpath_tx_id)
+    return NULL;
+  return adj;
+}
+
 /* BGP advertise attribute is used for pack same attribute update into
    one packet.  To do that we maintain attribute hash in struct
    peer.  */
@@ -160,31 +203,28 @@ int
 bgp_adj_out_lookup (struct peer *peer, struct bgp_node *rn,
                     u_int32_t addpath_tx_id)
 {
+  struct bgp_table *table = bgp_node_table (rn);
   struct bgp_adj_out *adj;
   struct peer_af *paf;
-  afi_t afi;
-  safi_t safi;
   int addpath_capable;
 
-  for (adj = rn->adj_out; adj; adj = adj->next)
-    SUBGRP_FOREACH_PEER(adj->subgroup, paf)
-      if (paf->peer == peer)
-	{
-          afi = SUBGRP_AFI (adj->subgroup);
-          safi = SUBGRP_SAFI (adj->subgroup);
-          addpath_capable = bgp_addpath_encode_tx (peer, afi, safi);
-
-          /* Match on a specific addpath_tx_id if we are using addpath for this
-           * peer and if an addpath_tx_id was specified */
-          if (addpath_capable && addpath_tx_id && adj->addpath_tx_id != addpath_tx_id)
-            continue;
-
-	  return (adj->adv
-		  ? (adj->adv->baa ? 1 : 0)
-		  : (adj->attr ? 1 : 0));
-	}
+  /* The peer is in one subgroup for the table's afi/safi, so there is
+     no need to look through them all. */
+  paf = peer_af_find (peer, table->afi, table->safi);
+  if (!paf || !paf->subgroup)
+    return 0;
 
-  return 0;
+  /* Match on a specific addpath_tx_id if we are using addpath for this
+   * peer and if an addpath_tx_id was specified */
+  addpath_capable = bgp_addpath_encode_tx (peer, table->afi, table->safi);
+  adj = bgp_adj_out_find (rn, paf->subgroup, addpath_tx_id,
+                          !(addpath_capable && addpath_tx_id));
+  if (!adj)
+    return 0;
+
+  return (adj->adv
+          ? (adj->adv->baa ? 1 : 0)
+          : (adj->attr ? 1 : 0));
 }
 
 
@@ -192,6 +232,7 @@ void
 bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr,
                 u_int32_t addpath_id)
 {
+  struct bgp_table *table = bgp_node_table (rn);
   struct bgp_adj_in *adj;
 
   for (adj = rn->adj_in; adj; adj = adj->next)
@@ -210,7 +251,9 @@ bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr,
   adj->peer = peer_lock (peer); /* adj_in peer reference */
   adj->attr = bgp_attr_intern (attr);
   adj->addpath_rx_id = addpath_id;
+  adj->rn = rn;
   BGP_ADJ_IN_ADD (rn, adj);
+  LIST_INSERT_HEAD (&peer->adj_in[table->afi][table->safi], adj, peer_thread);
   bgp_lock_node (rn);
 }
 
@@ -219,6 +262,7 @@ bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
 {
   bgp_attr_unintern (&bai->attr);
   BGP_ADJ_IN_DEL (rn, bai);
+  LIST_REMOVE (bai, peer_thread);
   peer_unlock (bai->peer); /* adj_in peer reference */
   XFREE (MTYPE_BGP_ADJ_IN, bai);
 }
@@ -22,6 +22,8 @@
 #define _QUAGGA_BGP_ADVERTISE_H
 
 #include <lib/fifo.h>
+#include "queue.h"
+#include "openbsd-tree.h"
 
 struct update_subgroup;
 
@@ -71,9 +73,8 @@ struct bgp_advertise
 /* BGP adjacency out.  */
 struct bgp_adj_out
 {
-  /* Lined list pointer.  */
-  struct bgp_adj_out *next;
-  struct bgp_adj_out *prev;
+  /* The node's tree, ordered by subgroup id, then addpath_tx_id.  */
+  RB_ENTRY(bgp_adj_out) adj_entry;
 
   /* Advertised subgroup.  */
   struct update_subgroup *subgroup;
@@ -93,6 +94,9 @@ struct bgp_adj_out
   struct bgp_advertise *adv;
 };
 
+RB_HEAD (bgp_adj_out_rb, bgp_adj_out);
+RB_PROTOTYPE (bgp_adj_out_rb, bgp_adj_out, adj_entry, bgp_adj_out_compare)
+
 /* BGP adjacency in. */
 struct bgp_adj_in
 {
@@ -100,6 +104,10 @@ struct bgp_adj_in
   struct bgp_adj_in *next;
   struct bgp_adj_in *prev;
 
+  /* For the peer's list of adj-ins, and the node this one is on. */
+  LIST_ENTRY(bgp_adj_in) peer_thread;
+  struct bgp_node *rn;
+
   /* Received peer.  */
   struct peer *peer;
 
@@ -140,8 +148,6 @@ struct bgp_synchronize
 
 #define BGP_ADJ_IN_ADD(N,A)    BGP_INFO_ADD(N,A,adj_in)
 #define BGP_ADJ_IN_DEL(N,A)    BGP_INFO_DEL(N,A,adj_in)
-#define BGP_ADJ_OUT_ADD(N,A)   BGP_INFO_ADD(N,A,adj_out)
-#define BGP_ADJ_OUT_DEL(N,A)   BGP_INFO_DEL(N,A,adj_out)
 
 #define BGP_ADV_FIFO_ADD(F, N)			\
   do {						\
@@ -173,6 +179,9 @@ struct bgp_synchronize
 
 /* Prototypes.  */
 extern int bgp_adj_out_lookup (struct peer *, struct bgp_node *, u_int32_t);
+extern struct bgp_adj_out *bgp_adj_out_find (struct bgp_node *,
+                                             struct update_subgroup *,
+                                             u_int32_t, int);
 extern void bgp_adj_in_set (struct bgp_node *, struct peer *, struct attr *, u_int32_t);
 extern int bgp_adj_in_unset (struct bgp_node *, struct peer *, u_int32_t);
 extern void bgp_adj_in_remove (struct bgp_node *, struct bgp_adj_in *);
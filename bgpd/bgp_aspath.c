@@ -2134,7 +2134,8 @@ aspath_cmp (const void *arg1, const void *arg2)
 void
 aspath_init (void)
 {
-  ashash = hash_create_size (32768, aspath_key_make, aspath_cmp);
+  /* can grow to millions of paths, don't stall while it does */
+  ashash = hash_create_open_size (32768, aspath_key_make, aspath_cmp);
 }
 
 void
@@ -52,6 +52,8 @@
 #include "bgp_encap_types.h"
 #include "bgp_evpn.h"
 
+DEFINE_MTYPE_STATIC(BGPD, BGP_ATTR_CACHE, "BGP attribute cache")
+
 /* Attribute strings for logging. */
 static const struct message attr_str [] = 
 {
@@ -764,7 +766,8 @@ attrhash_cmp (const void *p1, const void *p2)
 static void
 attrhash_init (void)
 {
-  attrhash = hash_create (attrhash_key_make, attrhash_cmp);
+  /* can grow to millions of attributes, don't stall while it does */
+  attrhash = hash_create_open (attrhash_key_make, attrhash_cmp);
 }
 
 /*
@@ -906,6 +909,15 @@ bgp_attr_intern (struct attr *attr)
   return find;
 }
 
+/* Find the interned attribute that is the same as attr, if there is one.
+   Unlike bgp_attr_intern(), neither attr nor anything it points to is
+   touched, and no reference is taken. */
+struct attr *
+bgp_attr_lookup (struct attr *attr)
+{
+  return hash_lookup (attrhash, attr);
+}
+
 /**
  * Increment the refcount on various structures that attr holds.
  * Note on usage: call _only_ when the 'attr' object has already
@@ -931,6 +943,9 @@ bgp_attr_refcount (struct attr *attr)
       if (attre->ecommunity)
 	attre->ecommunity->refcnt++;
 
+      if (attre->lcommunity)
+	attre->lcommunity->refcnt++;
+
       if (attre->cluster)
 	attre->cluster->refcnt++;
 
@@ -2470,6 +2485,347 @@ bgp_attr_check (struct peer *peer, struct attr *attr)
   return BGP_ATTR_PARSE_PROCEED;
 }
 
+/* Attribute sections seen from a peer, keyed by their raw bytes.  Most
+ * UPDATEs from a peer repeat an attribute section it has sent before,
+ * only with different NLRI, so the interned result of parsing it can be
+ * reused as is.  MP_REACH_NLRI and MP_UNREACH_NLRI carry NLRI, so they
+ * are left out of the key and parsed every time.
+ *
+ * The cache is direct-mapped: an attribute section goes in the slot its
+ * hash picks, pushing out whatever was there. */
+#define BGP_ATTR_CACHE_SLOTS 1024
+
+/* Attribute sections longer than this are not worth keeping. */
+#define BGP_ATTR_CACHE_MAXLEN 512
+
+#define BGP_ATTR_CACHE_MP_REACH   (1 << 0)
+#define BGP_ATTR_CACHE_MP_UNREACH (1 << 1)
+
+struct bgp_attr_cache_entry
+{
+  u_int32_t hash;
+  u_char mp;
+  bgp_size_t len;
+  u_char *data;
+  struct attr *attr;
+};
+
+struct bgp_attr_cache
+{
+  struct bgp_attr_cache_entry slots[BGP_ATTR_CACHE_SLOTS];
+};
+
+/* Where an attribute section's MP attributes are, so that the rest of it
+ * can be hashed, compared and copied around them. */
+struct bgp_attr_cache_key
+{
+  u_int32_t hash;
+  u_char mp;
+  bgp_size_t len;
+  u_char *startp, *endp;
+  int mp_count;
+  struct
+  {
+    u_char *startp;
+    bgp_size_t total;
+  } mps[2];
+};
+
+/* Find the MP attributes in an attribute section, returning 0 if the
+ * section is not cacheable.  Nothing is read off the stream; anything odd
+ * is left for bgp_attr_parse() to complain about.  Only Established peers
+ * cache, as leaving that state is what flushes the cache. */
+static int
+bgp_attr_cache_key_make (struct peer *peer, bgp_size_t size,
+                         struct bgp_attr_cache_key *key)
+{
+  u_char seen[BGP_ATTR_BITMAP_SIZE];
+  u_char *p, *seg;
+  u_char flag, type;
+  bgp_size_t length, hdr;
+  int i;
+
+  if (peer->status != Established || !peer->ibuf
+      || BGP_DEBUG (allow_martians, ALLOW_MARTIANS))
+    return 0;
+
+  memset (seen, 0, BGP_ATTR_BITMAP_SIZE);
+  memset (key, 0, sizeof (struct bgp_attr_cache_key));
+  key->startp = BGP_INPUT_PNT (peer);
+  key->endp = key->startp + size;
+
+  for (p = key->startp; p < key->endp; p += hdr + length)
+    {
+      if (key->endp - p < BGP_ATTR_MIN_LEN)
+        return 0;
+      flag = p[0] & 0xF0;
+      type = p[1];
+      if (CHECK_FLAG (flag, BGP_ATTR_FLAG_EXTLEN))
+        {
+          if (key->endp - p < BGP_ATTR_MIN_LEN + 1)
+            return 0;
+          length = (p[2] << 8) | p[3];
+          hdr = 4;
+        }
+      else
+        {
+          length = p[2];
+          hdr = 3;
+        }
+      if (p + hdr + length > key->endp || CHECK_BITMAP (seen, type))
+        return 0;
+      SET_BITMAP (seen, type);
+
+      switch (type)
+        {
+        case BGP_ATTR_MP_REACH_NLRI:
+        case BGP_ATTR_MP_UNREACH_NLRI:
+          key->mp |= (type == BGP_ATTR_MP_REACH_NLRI
+                      ? BGP_ATTR_CACHE_MP_REACH : BGP_ATTR_CACHE_MP_UNREACH);
+          key->mps[key->mp_count].startp = p;
+          key->mps[key->mp_count].total = hdr + length;
+          key->mp_count++;
+          break;
+        case BGP_ATTR_PREFIX_SID:
+          /* Parsed against MP_REACH_NLRI's AFI. */
+          return 0;
+        default:
+          key->len += hdr + length;
+          break;
+        }
+    }
+
+  if (key->len > BGP_ATTR_CACHE_MAXLEN)
+    return 0;
+
+  key->hash = key->mp;
+  for (seg = key->startp, i = 0; i <= key->mp_count; i++)
+    {
+      p = i < key->mp_count ? key->mps[i].startp : key->endp;
+      key->hash = jhash (seg, p - seg, key->hash);
+      if (i < key->mp_count)
+        seg = p + key->mps[i].total;
+    }
+  return 1;
+}
+
+/* Does entry hold the attribute section key describes? */
+static int
+bgp_attr_cache_match (struct bgp_attr_cache_entry *entry,
+                      struct bgp_attr_cache_key *key)
+{
+  u_char *p, *seg, *data;
+  int i;
+
+  if (!entry->attr || entry->hash != key->hash || entry->mp != key->mp
+      || entry->len != key->len)
+    return 0;
+
+  data = entry->data;
+  for (seg = key->startp, i = 0; i <= key->mp_count; i++)
+    {
+      p = i < key->mp_count ? key->mps[i].startp : key->endp;
+      if (memcmp (data, seg, p - seg))
+        return 0;
+      data += p - seg;
+      if (i < key->mp_count)
+        seg = p + key->mps[i].total;
+    }
+  return 1;
+}
+
+static void
+bgp_attr_cache_entry_free (struct bgp_attr_cache_entry *entry)
+{
+  if (entry->attr)
+    bgp_attr_unintern (&entry->attr);
+  if (entry->data)
+    XFREE (MTYPE_BGP_ATTR_CACHE, entry->data);
+  memset (entry, 0, sizeof (struct bgp_attr_cache_entry));
+}
+
+/* Take the references on attr's parts that bgp_attr_parse() would have
+ * taken, for a copy of an interned attr. */
+static void
+bgp_attr_lock_sub (struct attr *attr)
+{
+  if (attr->aspath)
+    attr->aspath->refcnt++;
+  if (attr->community)
+    attr->community->refcnt++;
+  if (attr->extra)
+    {
+      struct attr_extra *attre = attr->extra;
+
+      if (attre->ecommunity)
+        attre->ecommunity->refcnt++;
+      if (attre->lcommunity)
+        attre->lcommunity->refcnt++;
+      if (attre->cluster)
+        attre->cluster->refcnt++;
+      if (attre->transit)
+        attre->transit->refcnt++;
+      if (attre->encap_subtlvs)
+        attre->encap_subtlvs->refcnt++;
+#if ENABLE_BGP_VNC
+      if (attre->vnc_subtlvs)
+        attre->vnc_subtlvs->refcnt++;
+#endif
+    }
+}
+
+/* Forget what the MP attributes put in attr. */
+static void
+bgp_attr_cache_mp_clear (struct attr *attr)
+{
+  UNSET_FLAG (attr->flag, ATTR_FLAG_BIT (BGP_ATTR_MP_REACH_NLRI));
+  UNSET_FLAG (attr->flag, ATTR_FLAG_BIT (BGP_ATTR_MP_UNREACH_NLRI));
+  /* MP_REACH_NLRI with an IPv4 nexthop fills in a missing NEXT_HOP. */
+  if (!CHECK_FLAG (attr->flag, ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP)))
+    attr->nexthop.s_addr = 0;
+  if (attr->extra)
+    {
+      attr->extra->mp_nexthop_len = 0;
+      memset (&attr->extra->mp_nexthop_global_in, 0,
+              sizeof (attr->extra->mp_nexthop_global_in));
+      memset (&attr->extra->mp_nexthop_global, 0,
+              sizeof (attr->extra->mp_nexthop_global));
+      memset (&attr->extra->mp_nexthop_local, 0,
+              sizeof (attr->extra->mp_nexthop_local));
+    }
+}
+
+/* Fill in attr from the cache, parsing only the MP attributes.  Returns 0,
+ * with attr and the stream as they were, if the section isn't cached or
+ * its MP attributes need the full parse to deal with them. */
+static int
+bgp_attr_cache_get (struct peer *peer, struct bgp_attr_cache_key *key,
+                    struct attr *attr, struct bgp_nlri *mp_update,
+                    struct bgp_nlri *mp_withdraw)
+{
+  struct bgp_attr_cache_entry *entry;
+  struct stream *s = BGP_INPUT (peer);
+  struct attr orig;
+  struct attr_extra orig_extra;
+  size_t getp = stream_get_getp (s);
+  u_char *p;
+  int i, ret;
+
+  /* The copy goes into the caller's attr_extra. */
+  if (!peer->attr_cache || !attr->extra)
+    return 0;
+
+  entry = &peer->attr_cache->slots[key->hash % BGP_ATTR_CACHE_SLOTS];
+  if (!bgp_attr_cache_match (entry, key))
+    return 0;
+
+  orig = *attr;
+  orig_extra = *attr->extra;
+
+  bgp_attr_dup (attr, entry->attr);
+  attr->refcnt = 0;
+  bgp_attr_lock_sub (attr);
+
+  for (i = 0; i < key->mp_count; i++)
+    {
+      p = key->mps[i].startp;
+      struct bgp_attr_parser_args attr_args = {
+        .peer = peer,
+        .attr = attr,
+        .flags = p[0] & 0xF0,
+        .type = p[1],
+        .startp = p,
+        .total = key->mps[i].total,
+      };
+
+      if (CHECK_FLAG (attr_args.flags, BGP_ATTR_FLAG_EXTLEN))
+        p += 4;
+      else
+        p += 3;
+      attr_args.length = attr_args.total - (p - attr_args.startp);
+      stream_set_getp (s, p - STREAM_DATA (s));
+
+      if (bgp_attr_flag_invalid (&attr_args))
+        break;
+      if (attr_args.type == BGP_ATTR_MP_REACH_NLRI)
+        ret = bgp_mp_reach_parse (&attr_args, mp_update);
+      else
+        ret = bgp_mp_unreach_parse (&attr_args, mp_withdraw);
+      if (ret != BGP_ATTR_PARSE_PROCEED
+          || BGP_INPUT_PNT (peer) != attr_args.startp + attr_args.total)
+        break;
+    }
+
+  if (i < key->mp_count)
+    {
+      bgp_attr_unintern_sub (attr);
+      *attr->extra = orig_extra;
+      orig.extra = attr->extra;
+      *attr = orig;
+      stream_set_getp (s, getp);
+      return 0;
+    }
+
+  stream_set_getp (s, getp + (key->endp - key->startp));
+  return 1;
+}
+
+/* Remember what bgp_attr_parse() made of an attribute section. */
+static void
+bgp_attr_cache_put (struct peer *peer, struct bgp_attr_cache_key *key,
+                    struct attr *attr)
+{
+  struct bgp_attr_cache_entry *entry;
+  struct attr tmp;
+  struct attr_extra tmp_extra;
+  u_char *p, *seg, *data;
+  int i;
+
+  if (!peer->attr_cache)
+    peer->attr_cache = XCALLOC (MTYPE_BGP_ATTR_CACHE,
+                                sizeof (struct bgp_attr_cache));
+
+  entry = &peer->attr_cache->slots[key->hash % BGP_ATTR_CACHE_SLOTS];
+  bgp_attr_cache_entry_free (entry);
+
+  tmp = *attr;
+  if (attr->extra)
+    {
+      tmp_extra = *attr->extra;
+      tmp.extra = &tmp_extra;
+    }
+  bgp_attr_cache_mp_clear (&tmp);
+
+  entry->hash = key->hash;
+  entry->mp = key->mp;
+  entry->len = key->len;
+  entry->data = data = XMALLOC (MTYPE_BGP_ATTR_CACHE, key->len ? key->len : 1);
+  for (seg = key->startp, i = 0; i <= key->mp_count; i++)
+    {
+      p = i < key->mp_count ? key->mps[i].startp : key->endp;
+      memcpy (data, seg, p - seg);
+      data += p - seg;
+      if (i < key->mp_count)
+        seg = p + key->mps[i].total;
+    }
+  entry->attr = bgp_attr_intern (&tmp);
+}
+
+/* Forget the attribute sections peer has sent, for when it goes down or
+ * the way they are parsed changes. */
+void
+bgp_attr_cache_flush (struct peer *peer)
+{
+  int i;
+
+  if (!peer->attr_cache)
+    return;
+
+  for (i = 0; i < BGP_ATTR_CACHE_SLOTS; i++)
+    bgp_attr_cache_entry_free (&peer->attr_cache->slots[i]);
+  XFREE (MTYPE_BGP_ATTR_CACHE, peer->attr_cache);
+}
+
 /* Read attribute of update packet.  This function is called from
    bgp_update_receive() in bgp_packet.c.  */
 bgp_attr_parse_ret_t
@@ -2488,6 +2844,17 @@ bgp_attr_parse (struct peer *peer, struct attr *attr, bgp_size_t size,
   struct aspath *as4_path = NULL;
   as_t as4_aggregator = 0;
   struct in_addr as4_aggregator_addr = { .s_addr = 0 };
+  struct bgp_attr_cache_key key;
+  int cacheable;
+
+  /* Seen this one before? */
+  cacheable = bgp_attr_cache_key_make (peer, size, &key);
+  if (cacheable && bgp_attr_cache_get (peer, &key, attr, mp_update, mp_withdraw))
+    {
+      peer->attr_cache_hit++;
+      return BGP_ATTR_PARSE_PROCEED;
+    }
+  peer->attr_cache_miss++;
 
   /* Initialize bitmap. */
   memset (seen, 0, BGP_ATTR_BITMAP_SIZE);
@@ -2802,6 +3169,9 @@ bgp_attr_parse (struct peer *peer, struct attr *attr, bgp_size_t size,
 #endif
     }
 
+  if (cacheable)
+    bgp_attr_cache_put (peer, &key, attr);
+
   return BGP_ATTR_PARSE_PROCEED;
 }
 
@@ -0,0 +1,221 @@
+/* BGP best path selection workers
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "jhash.h"
+#include "log.h"
+#include "memory.h"
+#include "prefix.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_bestpath.h"
+
+DEFINE_MTYPE_STATIC(BGPD, BGP_BESTPATH_WORKERS, "BGP bestpath workers")
+
+static struct
+{
+  pthread_mutex_t mtx;
+  pthread_cond_t work;
+  pthread_cond_t done;
+
+  /* Shards, the main pthread's included, and the pthreads for the rest. */
+  unsigned int workers;
+  pthread_t *threads;
+
+  /* The batch being worked on, and how many workers aren't done with it
+   * yet.  A new batch bumps the generation; started is where it was at
+   * when the workers were started. */
+  struct bgp_bestpath_job *jobs;
+  unsigned char *shards;
+  unsigned int count;
+  unsigned int generation;
+  unsigned int started;
+  unsigned int pending;
+
+  bool stop;
+} bp = {
+  .mtx = PTHREAD_MUTEX_INITIALIZER,
+  .work = PTHREAD_COND_INITIALIZER,
+  .done = PTHREAD_COND_INITIALIZER,
+  .workers = BGP_BESTPATH_WORKERS_DEFAULT,
+};
+
+static void
+bgp_bestpath_shard (unsigned int shard)
+{
+  struct bgp_bestpath_job *job;
+  unsigned int i;
+
+  for (i = 0; i < bp.count; i++)
+    if (bp.shards[i] == shard)
+      {
+        job = &bp.jobs[i];
+        job->new_select = bgp_best_path (job->bgp, job->rn, job->mpath_cfg,
+                                         0, NULL);
+      }
+}
+
+static void *
+bgp_bestpath_worker (void *arg)
+{
+  unsigned int shard = (uintptr_t) arg;
+  unsigned int generation;
+
+  pthread_mutex_lock (&bp.mtx);
+  generation = bp.started;
+  while (1)
+    {
+      while (!bp.stop && bp.generation == generation)
+        pthread_cond_wait (&bp.work, &bp.mtx);
+      if (bp.stop)
+        break;
+      generation = bp.generation;
+
+      pthread_mutex_unlock (&bp.mtx);
+      bgp_bestpath_shard (shard);
+      pthread_mutex_lock (&bp.mtx);
+
+      if (--bp.pending == 0)
+        pthread_cond_signal (&bp.done);
+    }
+  pthread_mutex_unlock (&bp.mtx);
+  return NULL;
+}
+
+void
+bgp_bestpath_run (struct bgp_bestpath_job *jobs, unsigned int count)
+{
+  unsigned char shards[count ? count : 1];
+  struct prefix *p;
+  unsigned int i;
+
+  if (bp.workers <= 1 || count < BGP_BESTPATH_PARALLEL_MIN)
+    {
+      for (i = 0; i < count; i++)
+        jobs[i].new_select = bgp_best_path (jobs[i].bgp, jobs[i].rn,
+                                            jobs[i].mpath_cfg, 0, NULL);
+      return;
+    }
+
+  /* The same prefix always goes to the same pthread. */
+  for (i = 0; i < count; i++)
+    {
+      p = &jobs[i].rn->p;
+      shards[i] = jhash (&p->u.prefix, PSIZE (p->prefixlen), p->prefixlen)
+                  % bp.workers;
+    }
+
+  pthread_mutex_lock (&bp.mtx);
+  bp.jobs = jobs;
+  bp.shards = shards;
+  bp.count = count;
+  bp.pending = bp.workers - 1;
+  bp.generation++;
+  pthread_cond_broadcast (&bp.work);
+  pthread_mutex_unlock (&bp.mtx);
+
+  bgp_bestpath_shard (0);
+
+  pthread_mutex_lock (&bp.mtx);
+  while (bp.pending)
+    pthread_cond_wait (&bp.done, &bp.mtx);
+  bp.jobs = NULL;
+  bp.shards = NULL;
+  bp.count = 0;
+  pthread_mutex_unlock (&bp.mtx);
+}
+
+static void
+bgp_bestpath_stop (void)
+{
+  unsigned int i;
+
+  if (!bp.threads)
+    return;
+
+  pthread_mutex_lock (&bp.mtx);
+  bp.stop = true;
+  pthread_cond_broadcast (&bp.work);
+  pthread_mutex_unlock (&bp.mtx);
+
+  for (i = 1; i < bp.workers; i++)
+    pthread_join (bp.threads[i], NULL);
+
+  XFREE (MTYPE_BGP_BESTPATH_WORKERS, bp.threads);
+  bp.stop = false;
+  bp.workers = BGP_BESTPATH_WORKERS_DEFAULT;
+}
+
+void
+bgp_bestpath_workers_set (unsigned int workers)
+{
+  sigset_t blocked, oldmask;
+  unsigned int i;
+  int ret;
+
+  if (workers < 1)
+    workers = 1;
+  if (workers > BGP_BESTPATH_WORKERS_MAX)
+    workers = BGP_BESTPATH_WORKERS_MAX;
+  if (workers == bp.workers)
+    return;
+
+  bgp_bestpath_stop ();
+  if (workers == 1)
+    return;
+
+  /* Signals are for the main pthread. */
+  sigfillset (&blocked);
+  pthread_sigmask (SIG_BLOCK, &blocked, &oldmask);
+
+  bp.threads = XCALLOC (MTYPE_BGP_BESTPATH_WORKERS,
+                        workers * sizeof (pthread_t));
+  bp.started = bp.generation;
+  for (i = 1; i < workers; i++)
+    if ((ret = pthread_create (&bp.threads[i], NULL, bgp_bestpath_worker,
+                               (void *) (uintptr_t) i)) != 0)
+      {
+        zlog_err ("%s: could not start bestpath worker %u: %s", __func__, i,
+                  safe_strerror (ret));
+        break;
+      }
+  bp.workers = i;
+
+  pthread_sigmask (SIG_SETMASK, &oldmask, NULL);
+
+  if (bp.workers == 1)
+    XFREE (MTYPE_BGP_BESTPATH_WORKERS, bp.threads);
+}
+
+unsigned int
+bgp_bestpath_workers (void)
+{
+  return bp.workers;
+}
+
+void
+bgp_bestpath_finish (void)
+{
+  bgp_bestpath_stop ();
+}
@@ -0,0 +1,67 @@
+/* BGP best path selection workers
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _BGP_BESTPATH_H
+#define _BGP_BESTPATH_H
+
+/* bgp_process_main() takes the nodes queued for processing a batch at a
+ * time, and has the best path selected for all of them before it does
+ * anything else.  Picking the best path out of a node's paths only looks
+ * at that node, so with "bgp bestpath workers N" the batch is split by
+ * prefix hash into N shards: one for the main pthread and one each for
+ * N - 1 worker pthreads.  The main pthread waits for all of them to be
+ * done, and then goes on to update zebra and the update-groups, reap
+ * paths and so on, as before.
+ *
+ * Nothing else runs on the main pthread while the workers are at it, so
+ * they can look at peers, attributes and configuration freely.
+ */
+
+/* Default, and most, pthreads selecting best paths, the main one
+ * included. */
+#define BGP_BESTPATH_WORKERS_DEFAULT 1
+#define BGP_BESTPATH_WORKERS_MAX     64
+
+/* Batches smaller than this are done on the main pthread alone. */
+#define BGP_BESTPATH_PARALLEL_MIN    32
+
+struct bgp_bestpath_job
+{
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  struct bgp_maxpaths_cfg *mpath_cfg;
+
+  /* The result of bgp_best_path() for rn. */
+  struct bgp_info *new_select;
+};
+
+/* Start or stop worker pthreads, so that that many pthreads in all select
+ * best paths from now on. */
+extern void bgp_bestpath_workers_set (unsigned int workers);
+extern unsigned int bgp_bestpath_workers (void);
+
+/* Run bgp_best_path() for each of the jobs. */
+extern void bgp_bestpath_run (struct bgp_bestpath_job *jobs,
+                              unsigned int count);
+
+/* Stop the worker pthreads. */
+extern void bgp_bestpath_finish (void);
+
+#endif /* _BGP_BESTPATH_H */
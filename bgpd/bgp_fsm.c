@@ -27,6 +27,7 @@
 #include "thread.h"
 #include "log.h"
 #include "stream.h"
+#include "ringbuf.h"
 #include "memory.h"
 #include "plist.h"
 #include "workqueue.h"
@@ -40,6 +41,8 @@
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_fsm.h"
 #include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_keepalives.h"
 #include "bgpd/bgp_network.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_dump.h"
@@ -87,7 +90,6 @@ int bgp_event (struct thread *);
 static int bgp_start_timer (struct thread *);
 static int bgp_connect_timer (struct thread *);
 static int bgp_holdtime_timer (struct thread *);
-static int bgp_keepalive_timer (struct thread *);
 
 /* BGP FSM functions. */
 static int bgp_start (struct peer *);
@@ -104,6 +106,23 @@ peer_xfer_stats (struct peer *peer_dst, struct peer *peer_src)
   peer_dst->notify_out += peer_src->notify_out;
   peer_dst->dynamic_cap_in += peer_src->dynamic_cap_in;
   peer_dst->dynamic_cap_out += peer_src->dynamic_cap_out;
+
+  atomic_fetch_add_explicit (&peer_dst->read_calls,
+                             atomic_load_explicit (&peer_src->read_calls,
+                                                   memory_order_relaxed),
+                             memory_order_relaxed);
+  atomic_fetch_add_explicit (&peer_dst->read_bytes,
+                             atomic_load_explicit (&peer_src->read_bytes,
+                                                   memory_order_relaxed),
+                             memory_order_relaxed);
+  atomic_fetch_add_explicit (&peer_dst->write_calls,
+                             atomic_load_explicit (&peer_src->write_calls,
+                                                   memory_order_relaxed),
+                             memory_order_relaxed);
+  atomic_fetch_add_explicit (&peer_dst->write_bytes,
+                             atomic_load_explicit (&peer_src->write_bytes,
+                                                   memory_order_relaxed),
+                             memory_order_relaxed);
 }
 
 static struct peer *
@@ -115,6 +134,8 @@ peer_xfer_conn(struct peer *from_peer)
   int fd;
   int status, pstatus;
   unsigned char last_evt, last_maj_evt;
+  struct stream *s;
+  bool pending;
 
   assert(from_peer != NULL);
 
@@ -127,10 +148,12 @@ peer_xfer_conn(struct peer *from_peer)
     zlog_debug ("%s: peer transfer %p fd %d -> %p fd %d)", from_peer->host,
                 from_peer, from_peer->fd, peer, peer->fd);
 
-  BGP_WRITE_OFF(peer->t_write);
-  BGP_READ_OFF(peer->t_read);
-  BGP_WRITE_OFF(from_peer->t_write);
-  BGP_READ_OFF(from_peer->t_read);
+  bgp_keepalives_off(peer);
+  bgp_keepalives_off(from_peer);
+  bgp_writes_off(peer);
+  bgp_reads_off(peer);
+  bgp_writes_off(from_peer);
+  bgp_reads_off(from_peer);
 
   BGP_TIMER_OFF(peer->t_routeadv);
   BGP_TIMER_OFF(from_peer->t_routeadv);
@@ -139,8 +162,26 @@ peer_xfer_conn(struct peer *from_peer)
   peer->fd = from_peer->fd;
   from_peer->fd = fd;
   stream_reset(peer->ibuf);
-  stream_fifo_clean(peer->obuf);
-  stream_fifo_clean(from_peer->obuf);
+
+  /* Whatever the I/O pthread has already read off the connection goes
+   * along with it. */
+  pthread_mutex_lock(&peer->io_mtx);
+  pthread_mutex_lock(&from_peer->io_mtx);
+  {
+    stream_fifo_clean(peer->inq);
+    stream_fifo_clean(peer->obuf);
+    stream_fifo_clean(from_peer->obuf);
+
+    while ((s = stream_fifo_pop(from_peer->inq)) != NULL)
+      stream_fifo_push(peer->inq, s);
+    pending = (peer->inq->count > 0);
+
+    ringbuf_reset(peer->ibuf_work);
+    ringbuf_copy(peer->ibuf_work, from_peer->ibuf_work,
+                 ringbuf_remain(from_peer->ibuf_work));
+  }
+  pthread_mutex_unlock(&from_peer->io_mtx);
+  pthread_mutex_unlock(&peer->io_mtx);
 
   peer->as = from_peer->as;
   peer->v_holdtime = from_peer->v_holdtime;
@@ -220,8 +261,11 @@ peer_xfer_conn(struct peer *from_peer)
         }
     }
 
-  BGP_READ_ON(peer->t_read, bgp_read, peer->fd);
-  BGP_WRITE_ON(peer->t_write, bgp_write, peer->fd);
+  bgp_reads_on(peer);
+  bgp_writes_on(peer);
+  if (pending)
+    thread_add_event(bm->master, bgp_process_packet, peer, 0,
+                     &peer->t_process_packet);
 
   if (from_peer)
     peer_xfer_stats(peer, from_peer);
@@ -252,7 +296,7 @@ bgp_timer_set (struct peer *peer)
 	}
       BGP_TIMER_OFF (peer->t_connect);
       BGP_TIMER_OFF (peer->t_holdtime);
-      BGP_TIMER_OFF (peer->t_keepalive);
+      bgp_keepalives_off (peer);
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
 
@@ -263,7 +307,7 @@ bgp_timer_set (struct peer *peer)
       BGP_TIMER_OFF (peer->t_start);
       BGP_TIMER_ON (peer->t_connect, bgp_connect_timer, peer->v_connect);
       BGP_TIMER_OFF (peer->t_holdtime);
-      BGP_TIMER_OFF (peer->t_keepalive);
+      bgp_keepalives_off (peer);
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
 
@@ -282,7 +326,7 @@ bgp_timer_set (struct peer *peer)
 	  BGP_TIMER_ON (peer->t_connect, bgp_connect_timer, peer->v_connect);
 	}
       BGP_TIMER_OFF (peer->t_holdtime);
-      BGP_TIMER_OFF (peer->t_keepalive);
+      bgp_keepalives_off (peer);
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
 
@@ -299,7 +343,7 @@ bgp_timer_set (struct peer *peer)
 	{
 	  BGP_TIMER_OFF (peer->t_holdtime);
 	}
-      BGP_TIMER_OFF (peer->t_keepalive);
+      bgp_keepalives_off (peer);
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
 
@@ -313,14 +357,14 @@ bgp_timer_set (struct peer *peer)
       if (peer->v_holdtime == 0)
 	{
 	  BGP_TIMER_OFF (peer->t_holdtime);
-	  BGP_TIMER_OFF (peer->t_keepalive);
+	  bgp_keepalives_off (peer);
 	}
       else
 	{
 	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
 			peer->v_holdtime);
-	  BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer, 
-			peer->v_keepalive);
+	  /* the FSM ignores the keepalive timer in OpenConfirm */
+	  bgp_keepalives_off (peer);
 	}
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
@@ -336,14 +380,13 @@ bgp_timer_set (struct peer *peer)
       if (peer->v_holdtime == 0)
 	{
 	  BGP_TIMER_OFF (peer->t_holdtime);
-	  BGP_TIMER_OFF (peer->t_keepalive);
+	  bgp_keepalives_off (peer);
 	}
       else
 	{
 	  BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
 			peer->v_holdtime);
-	  BGP_TIMER_ON (peer->t_keepalive, bgp_keepalive_timer,
-			peer->v_keepalive);
+	  bgp_keepalives_on (peer);
 	}
       break;
     case Deleted:
@@ -354,7 +397,7 @@ bgp_timer_set (struct peer *peer)
       BGP_TIMER_OFF (peer->t_start);
       BGP_TIMER_OFF (peer->t_connect);
       BGP_TIMER_OFF (peer->t_holdtime);
-      BGP_TIMER_OFF (peer->t_keepalive);
+      bgp_keepalives_off (peer);
       BGP_TIMER_OFF (peer->t_routeadv);
       break;
     }
@@ -412,32 +455,29 @@ static int
 bgp_holdtime_timer (struct thread *thread)
 {
   struct peer *peer;
+  size_t inq_count;
 
   peer = THREAD_ARG (thread);
   peer->t_holdtime = NULL;
 
-  if (bgp_debug_neighbor_events(peer))
-    zlog_debug ("%s [FSM] Timer (holdtime timer expire)", peer->host);
-
-  THREAD_VAL (thread) = Hold_Timer_expired;
-  bgp_event (thread); /* bgp_event unlocks peer */
-
-  return 0;
-}
-
-/* BGP keepalive fire ! */
-static int
-bgp_keepalive_timer (struct thread *thread)
-{
-  struct peer *peer;
+  /* The I/O pthread has read packets we haven't gotten around to yet,
+   * so the peer is alive; give ourselves a chance to catch up. */
+  pthread_mutex_lock (&peer->io_mtx);
+  {
+    inq_count = peer->inq->count;
+  }
+  pthread_mutex_unlock (&peer->io_mtx);
 
-  peer = THREAD_ARG (thread);
-  peer->t_keepalive = NULL;
+  if (inq_count)
+    {
+      BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer, peer->v_holdtime);
+      return 0;
+    }
 
   if (bgp_debug_neighbor_events(peer))
-    zlog_debug ("%s [FSM] Timer (keepalive timer expire)", peer->host);
+    zlog_debug ("%s [FSM] Timer (holdtime timer expire)", peer->host);
 
-  THREAD_VAL (thread) = KeepAlive_timer_expired;
+  THREAD_VAL (thread) = Hold_Timer_expired;
   bgp_event (thread); /* bgp_event unlocks peer */
 
   return 0;
@@ -456,7 +496,7 @@ bgp_routeadv_timer (struct thread *thread)
 
   peer->synctime = bgp_clock ();
 
-  BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+  BGP_UPDGRP_PACKETS_ON (peer);
 
   /* MRAI timer will be started again when FIFO is built, no need to
    * do it here.
@@ -665,7 +705,7 @@ bgp_adjust_routeadv (struct peer *peer)
         BGP_TIMER_OFF(peer->t_routeadv);
 
       peer->synctime = bgp_clock ();
-      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+      BGP_UPDGRP_PACKETS_ON (peer);
       return;
     }
 
@@ -1074,27 +1114,40 @@ bgp_stop (struct peer *peer)
       bgp_bfd_deregister_peer(peer);
     }
 
-  /* Stop read and write threads when exists. */
-  BGP_READ_OFF (peer->t_read);
-  BGP_WRITE_OFF (peer->t_write);
+  /* Stop read and write threads when exists.  Keepalives first, they
+   * would turn writes back on. */
+  THREAD_OFF (peer->t_connect_check);
+  bgp_keepalives_off (peer);
+  bgp_reads_off (peer);
+  bgp_writes_off (peer);
 
   /* Stop all timers. */
   BGP_TIMER_OFF (peer->t_start);
   BGP_TIMER_OFF (peer->t_connect);
   BGP_TIMER_OFF (peer->t_holdtime);
-  BGP_TIMER_OFF (peer->t_keepalive);
   BGP_TIMER_OFF (peer->t_routeadv);
 
-  /* Stream reset. */
-  peer->packet_size = 0;
-
   /* Clear input and output buffer.  */
   if (peer->ibuf)
     stream_reset (peer->ibuf);
   if (peer->work)
     stream_reset (peer->work);
-  if (peer->obuf)
-    stream_fifo_clean (peer->obuf);
+
+  /* The session may come back with other capabilities, so the attributes
+   * it sent are parsed afresh. */
+  bgp_attr_cache_flush (peer);
+
+  pthread_mutex_lock (&peer->io_mtx);
+  {
+    /* Stream reset. */
+    if (peer->ibuf_work)
+      ringbuf_reset (peer->ibuf_work);
+    if (peer->inq)
+      stream_fifo_clean (peer->inq);
+    if (peer->obuf)
+      stream_fifo_clean (peer->obuf);
+  }
+  pthread_mutex_unlock (&peer->io_mtx);
 
   /* Close of file descriptor. */
   if (peer->fd >= 0)
@@ -1234,7 +1287,7 @@ bgp_connect_success (struct peer *peer)
       return -1;
     }
 
-  BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+  bgp_reads_on (peer);
 
   if (bgp_debug_neighbor_events(peer))
     {
@@ -1369,8 +1422,8 @@ bgp_start (struct peer *peer)
 		    peer->fd);
 	  return -1;
 	}
-      BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
-      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+      thread_add_write (bm->master, bgp_connect_check_thread, peer, peer->fd,
+                        &peer->t_connect_check);
       break;
     }
   return 0;
@@ -22,35 +22,13 @@
 #ifndef _QUAGGA_BGP_FSM_H
 #define _QUAGGA_BGP_FSM_H
 
-/* Macro for BGP read, write and timer thread.  */
-#define BGP_READ_ON(T,F,V) \
-  do { \
-    if ((peer->status != Deleted)) \
-      thread_add_read (bm->master,(F),peer,(V),&(T)); \
-  } while (0)
-
-#define BGP_READ_OFF(T) \
-  do { \
-    if (T) \
-      THREAD_READ_OFF(T); \
-  } while (0)
-
-#define BGP_WRITE_ON(T,F,V) \
+/* Macro for BGP timer thread.  Socket reads and writes are done by the I/O
+ * pthread, see bgp_io.h.  */
+#define BGP_UPDGRP_PACKETS_ON(peer) \
   do { \
     if ((peer)->status != Deleted) \
-      thread_add_write (bm->master,(F),(peer),(V),&(T)); \
-  } while (0)
-
-#define BGP_PEER_WRITE_ON(T,F,V, peer) \
-  do { \
-    if ((peer)->status != Deleted) \
-      thread_add_write (bm->master,(F),(peer),(V),&(T)); \
-  } while (0)
-
-#define BGP_WRITE_OFF(T) \
-  do { \
-    if (T) \
-      THREAD_WRITE_OFF(T); \
+      thread_add_event (bm->master, bgp_generate_updgrp_packets, (peer), 0, \
+                        &(peer)->t_generate_updgrp_packets); \
   } while (0)
 
 #define BGP_TIMER_ON(T,F,V) \
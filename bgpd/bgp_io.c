@@ -0,0 +1,426 @@
+/* BGP socket I/O pthread
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "thread.h"
+#include "frr_pthread.h"
+#include "frratomic.h"
+#include "stream.h"
+#include "ringbuf.h"
+#include "network.h"
+#include "sockopt.h"
+#include "log.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_packet.h"
+
+static struct frr_pthread *bgp_pth_io;
+
+/* ------------------------------------------------------------------------
+ * Main thread side
+ * ------------------------------------------------------------------------ */
+
+/* The I/O pthread lost the connection.  Runs on the main thread, since the
+ * bookkeeping below races with the FSM otherwise. */
+static int
+bgp_io_closed (struct thread *thread)
+{
+  struct peer *peer = THREAD_ARG (thread);
+
+  if (peer->status == Established)
+    {
+      if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_MODE))
+        {
+          peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
+          SET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
+        }
+      else
+        peer->last_reset = PEER_DOWN_CLOSE_SESSION;
+    }
+
+  return bgp_event (thread);
+}
+
+/* A NOTIFY went out, so the session is over.  Runs on the main thread, as
+ * v_start is FSM state. */
+static int
+bgp_io_notify_sent (struct thread *thread)
+{
+  struct peer *peer = THREAD_ARG (thread);
+
+  if (peer->status == Deleted)
+    return 0;
+
+  /* Double start timer. */
+  peer->v_start *= 2;
+
+  /* Overflow check. */
+  if (peer->v_start >= (60 * 2))
+    peer->v_start = (60 * 2);
+
+  /* Flush any existing events */
+  return bgp_event (thread);
+}
+
+/* ------------------------------------------------------------------------
+ * I/O pthread side
+ * ------------------------------------------------------------------------ */
+
+/* Take up to budget whole packets off the front of peer->ibuf_work and
+ * queue them onto peer->inq.  Returns how many were queued.
+ *
+ * A header with a length we can't frame by is queued as a packet by itself
+ * and *unframed set; validating it is up to the main thread. */
+static unsigned int
+bgp_io_frame (struct peer *peer, unsigned int budget, bool *unframed)
+{
+  struct ringbuf *ibw = peer->ibuf_work;
+  u_char hdr[BGP_HEADER_SIZE];
+  struct stream *pkt;
+  unsigned int count = 0;
+  u_int16_t size;
+
+  while (count < budget && ringbuf_remain (ibw) >= BGP_HEADER_SIZE)
+    {
+      ringbuf_peek (ibw, 0, hdr, BGP_HEADER_SIZE);
+      size = (hdr[BGP_MARKER_SIZE] << 8) | hdr[BGP_MARKER_SIZE + 1];
+
+      if (size < BGP_HEADER_SIZE || size > BGP_MAX_PACKET_SIZE)
+        {
+          *unframed = true;
+          size = BGP_HEADER_SIZE;
+        }
+      else if (ringbuf_remain (ibw) < size)
+        break;
+
+      pkt = stream_new (size);
+      ringbuf_get (ibw, STREAM_DATA (pkt), size);
+      stream_set_endp (pkt, size);
+
+      pthread_mutex_lock (&peer->io_mtx);
+      {
+        stream_fifo_push (peer->inq, pkt);
+      }
+      pthread_mutex_unlock (&peer->io_mtx);
+
+      count++;
+
+      /* if we couldn't make sense of the length, neither can we find where
+       * the next packet starts; the main thread will tear down the session
+       * once it sees this one */
+      if (*unframed)
+        break;
+    }
+
+  return count;
+}
+
+/* Read as much as the socket has and peer->ibuf_work takes with a single
+ * syscall, then frame up to the instance's read quanta of packets out of
+ * it.  Anything beyond that stays buffered for the next run, so one busy
+ * peer doesn't hold up the others. */
+static int
+bgp_io_read (struct thread *thread)
+{
+  struct peer *peer = THREAD_ARG (thread);
+  unsigned int budget = peer->bgp->rpkt_quanta;
+  unsigned int count;
+  bool unframed = false;
+  ssize_t nbytes = -2;
+
+  /* with no room left, there's a whole packet buffered to frame first */
+  if (ringbuf_space (peer->ibuf_work) > 0)
+    {
+      nbytes = ringbuf_read_try (peer->ibuf_work, peer->fd);
+
+      atomic_fetch_add_explicit (&peer->read_calls, 1, memory_order_relaxed);
+      if (nbytes > 0)
+        atomic_fetch_add_explicit (&peer->read_bytes, nbytes,
+                                   memory_order_relaxed);
+    }
+
+  /* frame even if the connection is gone, the peer may have sent a
+   * NOTIFICATION right before closing it */
+  count = bgp_io_frame (peer, budget, &unframed);
+  if (count)
+    thread_add_event (bm->master, bgp_process_packet, peer, 0,
+                      &peer->t_process_packet);
+
+  if (unframed)
+    return 0;
+
+  if (nbytes == -1)
+    {
+      zlog_err ("%s [Error] bgp_read_packet error: %s",
+                peer->host, safe_strerror (errno));
+      thread_add_event (bm->master, bgp_io_closed, peer,
+                        TCP_fatal_error, NULL);
+      return 0;
+    }
+
+  if (nbytes == 0)
+    {
+      if (bgp_debug_neighbor_events (peer))
+        zlog_debug ("%s [Event] BGP connection closed fd %d",
+                    peer->host, peer->fd);
+      thread_add_event (bm->master, bgp_io_closed, peer,
+                        TCP_connection_closed, NULL);
+      return 0;
+    }
+
+  /* Used up the budget, there may be whole packets left in ibuf_work that
+   * the socket won't wake us up for. */
+  if (count == budget)
+    thread_add_event (bgp_pth_io->master, bgp_io_read, peer, 0,
+                      &peer->t_read);
+  else
+    thread_add_read (bgp_pth_io->master, bgp_io_read, peer, peer->fd,
+                     &peer->t_read);
+
+  return 0;
+}
+
+/* Account for a packet that made it onto the wire in full. */
+static void
+bgp_io_packet_sent (struct peer *peer, struct stream *s)
+{
+  switch (stream_getc_from (s, BGP_MARKER_SIZE + 2))
+    {
+    case BGP_MSG_OPEN:
+      atomic_fetch_add_explicit (&peer->open_out, 1, memory_order_relaxed);
+      break;
+    case BGP_MSG_UPDATE:
+      atomic_fetch_add_explicit (&peer->update_out, 1, memory_order_relaxed);
+      break;
+    case BGP_MSG_NOTIFY:
+      atomic_fetch_add_explicit (&peer->notify_out, 1, memory_order_relaxed);
+      thread_add_event (bm->master, bgp_io_notify_sent, peer, BGP_Stop, NULL);
+      break;
+    case BGP_MSG_KEEPALIVE:
+      atomic_fetch_add_explicit (&peer->keepalive_out, 1,
+                                 memory_order_relaxed);
+      break;
+    case BGP_MSG_ROUTE_REFRESH_NEW:
+    case BGP_MSG_ROUTE_REFRESH_OLD:
+      atomic_fetch_add_explicit (&peer->refresh_out, 1, memory_order_relaxed);
+      break;
+    case BGP_MSG_CAPABILITY:
+      atomic_fetch_add_explicit (&peer->dynamic_cap_out, 1,
+                                 memory_order_relaxed);
+      break;
+    }
+}
+
+/* Write out as much of peer->obuf as the socket takes, up to the instance's
+ * write quanta.  Queued packets are gathered into one writev() call, up to
+ * BGP_WRITEV_MAX of them at a time.  Called with peer->io_mtx held.  Returns
+ * -1 if nothing more should be written on this connection. */
+static int
+bgp_io_write_packets (struct peer *peer)
+{
+  struct iovec iov[BGP_WRITEV_MAX];
+  struct stream *s;
+  unsigned int count = 0;
+  u_int32_t oc = peer->update_out;
+  size_t total, left;
+  ssize_t num;
+  bool notify;
+  int iovcnt;
+  int ret = 0;
+
+  sockopt_cork (peer->fd, 1);
+
+  while (count < peer->bgp->wpkt_quanta && stream_fifo_head (peer->obuf))
+    {
+      /* Gather; nothing goes out after a NOTIFY. */
+      iovcnt = 0;
+      total = 0;
+      notify = false;
+      for (s = stream_fifo_head (peer->obuf);
+           s && iovcnt < BGP_WRITEV_MAX
+             && count + iovcnt < peer->bgp->wpkt_quanta && !notify;
+           s = s->next)
+        {
+          iov[iovcnt].iov_base = STREAM_PNT (s);
+          iov[iovcnt].iov_len = stream_get_endp (s) - stream_get_getp (s);
+          total += iov[iovcnt].iov_len;
+          iovcnt++;
+          notify = (stream_getc_from (s, BGP_MARKER_SIZE + 2)
+                    == BGP_MSG_NOTIFY);
+        }
+
+      num = writev (peer->fd, iov, iovcnt);
+      if (num < 0)
+        {
+          /* write failed either retry needed or error; the FSM is the
+           * main thread's, and ignores events for Deleted peers there */
+          if (!ERRNO_IO_RETRY (errno))
+            {
+              thread_add_event (bm->master, bgp_event, peer,
+                                TCP_fatal_error, NULL);
+              ret = -1;
+            }
+          break;
+        }
+
+      atomic_fetch_add_explicit (&peer->write_calls, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit (&peer->write_bytes, num,
+                                 memory_order_relaxed);
+
+      /* Scatter: drop what made it out, keep the rest of a partial write */
+      for (left = num; left > 0; )
+        {
+          s = stream_fifo_head (peer->obuf);
+          if (left < stream_get_endp (s) - stream_get_getp (s))
+            {
+              stream_forward_getp (s, left);
+              break;
+            }
+          left -= stream_get_endp (s) - stream_get_getp (s);
+
+          bgp_io_packet_sent (peer, s);
+          stream_free (stream_fifo_pop (peer->obuf));
+          count++;
+        }
+
+      if ((size_t) num != total)
+        /* socket is full */
+        break;
+
+      if (notify)
+        {
+          ret = -1;
+          break;
+        }
+    }
+
+  /* Update last_update if UPDATEs were written. */
+  if (peer->update_out > oc)
+    peer->last_update = bgp_clock ();
+
+  /* If we TXed any flavor of packet update last_write */
+  if (count)
+    peer->last_write = bgp_clock ();
+
+  sockopt_cork (peer->fd, 0);
+  return ret;
+}
+
+static int
+bgp_io_write (struct thread *thread)
+{
+  struct peer *peer = THREAD_ARG (thread);
+  bool pending;
+  int ret;
+
+  pthread_mutex_lock (&peer->io_mtx);
+  {
+    ret = bgp_io_write_packets (peer);
+    pending = (stream_fifo_head (peer->obuf) != NULL);
+  }
+  pthread_mutex_unlock (&peer->io_mtx);
+
+  if (ret < 0)
+    return 0;
+
+  if (pending)
+    thread_add_write (bgp_pth_io->master, bgp_io_write, peer, peer->fd,
+                      &peer->t_write);
+  else
+    /* ran dry, have the main thread build the next batch of updates if
+     * the session is still up */
+    thread_add_event (bm->master, bgp_generate_updgrp_packets, peer, 0,
+                      &peer->t_generate_updgrp_packets);
+
+  return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+
+void
+bgp_io_init (void)
+{
+  bgp_pth_io = frr_pthread_new ("BGP I/O", frr_pthread_get_id (),
+                                frr_pthread_loop, frr_pthread_loop_stop);
+  bgp_pth_io->master->handle_signals = false;
+}
+
+void
+bgp_io_run (void)
+{
+  if (frr_pthread_run (bgp_pth_io->id, NULL, bgp_pth_io) != 0)
+    {
+      zlog_err ("%s: could not start the BGP I/O pthread", __func__);
+      exit (1);
+    }
+}
+
+void
+bgp_io_finish (void)
+{
+  if (!bgp_pth_io)
+    return;
+
+  if (atomic_load_explicit (&bgp_pth_io->running, memory_order_relaxed))
+    frr_pthread_stop (bgp_pth_io->id, NULL);
+
+  bgp_pth_io = NULL;
+}
+
+void
+bgp_reads_on (struct peer *peer)
+{
+  if (peer->status == Deleted || peer->fd < 0 || !bgp_pth_io)
+    return;
+
+  thread_add_read (bgp_pth_io->master, bgp_io_read, peer, peer->fd,
+                   &peer->t_read);
+}
+
+void
+bgp_reads_off (struct peer *peer)
+{
+  if (bgp_pth_io)
+    thread_cancel_async (bgp_pth_io->master, &peer->t_read);
+  THREAD_OFF (peer->t_process_packet);
+}
+
+void
+bgp_writes_on (struct peer *peer)
+{
+  if (peer->status == Deleted || peer->fd < 0 || !bgp_pth_io)
+    return;
+
+  thread_add_write (bgp_pth_io->master, bgp_io_write, peer, peer->fd,
+                    &peer->t_write);
+}
+
+void
+bgp_writes_off (struct peer *peer)
+{
+  if (bgp_pth_io)
+    thread_cancel_async (bgp_pth_io->master, &peer->t_write);
+  THREAD_OFF (peer->t_generate_updgrp_packets);
+}
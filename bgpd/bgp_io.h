@@ -0,0 +1,68 @@
+/* BGP socket I/O pthread
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _BGP_IO_H
+#define _BGP_IO_H
+
+/* Raw socket reads and writes for established and establishing sessions are
+ * done on a dedicated pthread, so that a busy main thread (best path runs,
+ * update generation) doesn't keep us from draining the sockets.
+ *
+ * The I/O pthread reads and frames packets into peer->inq and tells the main
+ * thread about them with bgp_process_packet(); header and message validation
+ * stay on the main thread.  Packets the main thread puts onto peer->obuf are
+ * written out by the I/O pthread, which asks the main thread for more
+ * updates with bgp_generate_updgrp_packets() once the queue has run dry.
+ * peer->io_mtx protects inq and obuf.
+ *
+ * Reads go into peer->ibuf_work, a ring buffer with room for a good many
+ * packets, so that a full table can be taken in a few large syscalls
+ * rather than two per packet.  Writes likewise gather whatever is queued on
+ * peer->obuf into one writev().  peer->{read,write}_{calls,bytes} count the
+ * syscalls and what they moved.
+ */
+
+#define BGP_IBUF_WORK_SIZE (BGP_MAX_PACKET_SIZE * 16)
+
+/* Most packets handed to a single writev(); well below any IOV_MAX. */
+#define BGP_WRITEV_MAX 64
+
+/* Create the I/O pthread's thread_master.  Must be called before any peer
+ * is started. */
+extern void bgp_io_init (void);
+
+/* Start the I/O pthread.  Called after the daemon has forked. */
+extern void bgp_io_run (void);
+
+/* Stop the I/O pthread.  Its thread_master goes with frr_pthread_finish(). */
+extern void bgp_io_finish (void);
+
+/* Start/stop reading packets from peer->fd.  bgp_reads_off() waits for the
+ * I/O pthread to let go of the peer; afterwards, no more packets will be
+ * queued onto peer->inq. */
+extern void bgp_reads_on (struct peer *);
+extern void bgp_reads_off (struct peer *);
+
+/* Start/stop writing out peer->obuf.  bgp_writes_off() waits for the I/O
+ * pthread to let go of the peer. */
+extern void bgp_writes_on (struct peer *);
+extern void bgp_writes_off (struct peer *);
+
+#endif /* _BGP_IO_H */
@@ -0,0 +1,118 @@
+/* BGP keepalives pthread
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "thread.h"
+#include "frr_pthread.h"
+#include "frratomic.h"
+#include "monotime.h"
+#include "log.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_keepalives.h"
+#include "bgpd/bgp_packet.h"
+
+static struct frr_pthread *bgp_pth_ka;
+
+/* Runs on the keepalives pthread. */
+static int
+bgp_keepalives_timer (struct thread *thread)
+{
+  struct peer *peer = THREAD_ARG (thread);
+  int64_t late;
+  u_int32_t jitter;
+
+  /* thread->u.sands is when we were due */
+  late = monotime_since (&thread->u.sands, NULL);
+  jitter = (late > 0) ? (late > UINT32_MAX ? UINT32_MAX : late) : 0;
+
+  bgp_keepalive_send (peer);
+
+  if (jitter > atomic_load_explicit (&peer->ka_jitter_max,
+                                     memory_order_relaxed))
+    atomic_store_explicit (&peer->ka_jitter_max, jitter,
+                           memory_order_relaxed);
+  atomic_fetch_add_explicit (&peer->ka_jitter_total, jitter,
+                             memory_order_relaxed);
+  atomic_fetch_add_explicit (&peer->ka_jitter_count, 1,
+                             memory_order_relaxed);
+
+  thread_add_timer (bgp_pth_ka->master, bgp_keepalives_timer, peer,
+                    peer->v_keepalive, &peer->t_keepalive);
+  return 0;
+}
+
+void
+bgp_keepalives_init (void)
+{
+  bgp_pth_ka = frr_pthread_new ("BGP keepalives", frr_pthread_get_id (),
+                                frr_pthread_loop, frr_pthread_loop_stop);
+  bgp_pth_ka->master->handle_signals = false;
+}
+
+void
+bgp_keepalives_run (void)
+{
+  if (frr_pthread_run (bgp_pth_ka->id, NULL, bgp_pth_ka) != 0)
+    {
+      zlog_err ("%s: could not start the BGP keepalives pthread", __func__);
+      exit (1);
+    }
+}
+
+void
+bgp_keepalives_finish (void)
+{
+  if (!bgp_pth_ka)
+    return;
+
+  if (atomic_load_explicit (&bgp_pth_ka->running, memory_order_relaxed))
+    frr_pthread_stop (bgp_pth_ka->id, NULL);
+
+  bgp_pth_ka = NULL;
+}
+
+void
+bgp_keepalives_on (struct peer *peer)
+{
+  if (peer->ka_on || !bgp_pth_ka)
+    return;
+
+  peer->ka_on = true;
+  atomic_store_explicit (&peer->ka_jitter_max, 0, memory_order_relaxed);
+  atomic_store_explicit (&peer->ka_jitter_total, 0, memory_order_relaxed);
+  atomic_store_explicit (&peer->ka_jitter_count, 0, memory_order_relaxed);
+
+  thread_add_timer (bgp_pth_ka->master, bgp_keepalives_timer, peer,
+                    peer->v_keepalive, &peer->t_keepalive);
+}
+
+void
+bgp_keepalives_off (struct peer *peer)
+{
+  if (!peer->ka_on)
+    return;
+
+  peer->ka_on = false;
+  thread_cancel_async (bgp_pth_ka->master, &peer->t_keepalive);
+}
@@ -0,0 +1,48 @@
+/* BGP keepalives pthread
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _BGP_KEEPALIVES_H
+#define _BGP_KEEPALIVES_H
+
+/* KEEPALIVEs for Established sessions are generated on a pthread of their
+ * own.  A main thread that is busy with best path runs or update generation
+ * could otherwise hold them back long enough for the remote end's hold
+ * timer to expire.  The keepalives pthread owns peer->t_keepalive, queues
+ * each KEEPALIVE onto peer->obuf and hands it straight to the I/O pthread.
+ *
+ * How late each KEEPALIVE went out is tallied in peer->ka_jitter_*.
+ */
+
+/* Create the keepalives pthread's thread_master. */
+extern void bgp_keepalives_init (void);
+
+/* Start the keepalives pthread.  Called after the daemon has forked. */
+extern void bgp_keepalives_run (void);
+
+/* Stop the keepalives pthread. */
+extern void bgp_keepalives_finish (void);
+
+/* Start/stop sending KEEPALIVEs every peer->v_keepalive seconds.  Both are
+ * no-ops if the peer is already in that state; bgp_keepalives_off() waits
+ * for the keepalives pthread to let go of the peer. */
+extern void bgp_keepalives_on (struct peer *);
+extern void bgp_keepalives_off (struct peer *);
+
+#endif /* _BGP_KEEPALIVES_H */
@@ -40,6 +40,7 @@
 #include "vrf.h"
 #include "bfd.h"
 #include "libfrr.h"
+#include "frr_pthread.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_attr.h"
@@ -54,6 +55,9 @@
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_filter.h"
 #include "bgpd/bgp_zebra.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_keepalives.h"
+#include "bgpd/bgp_bestpath.h"
 
 #ifdef ENABLE_BGP_VNC
 #include "bgpd/rfapi/rfapi_backend.h"
@@ -195,6 +199,13 @@ bgp_exit (int status)
   for (ALL_LIST_ELEMENTS (bm->bgp, node, nnode, bgp))
     bgp_delete (bgp);
 
+  /* reverse bgp_io_init and bgp_keepalives_init, once no peer is left for
+   * them to look after */
+  bgp_keepalives_finish ();
+  bgp_io_finish ();
+  bgp_bestpath_finish ();
+  frr_pthread_finish ();
+
   /* reverse bgp_dump_init */
   bgp_dump_finish ();
 
@@ -437,6 +448,8 @@ main (int argc, char **argv)
             bm->port);
 
   frr_config_fork ();
+  bgp_io_run ();
+  bgp_keepalives_run ();
   frr_run (bm->master);
 
   /* Not reached. */
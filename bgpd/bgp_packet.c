@@ -40,6 +40,8 @@
 #include "bgpd/bgp_attr.h"
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_keepalives.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_open.h"
@@ -89,19 +91,17 @@ bgp_packet_set_size (struct stream *s)
   return cp;
 }
 
-/* Add new packet to the peer. */
+/* Add new packet to the peer.  It is written out by the I/O pthread once
+ * bgp_writes_on() has been called. */
 void
 bgp_packet_add (struct peer *peer, struct stream *s)
 {
   /* Add packet to the end of list. */
-  stream_fifo_push (peer->obuf, s);
-}
-
-/* Free first packet. */
-static void
-bgp_packet_delete (struct peer *peer)
-{
-  stream_free (stream_fifo_pop (peer->obuf));
+  pthread_mutex_lock (&peer->io_mtx);
+  {
+    stream_fifo_push (peer->obuf, s);
+  }
+  pthread_mutex_unlock (&peer->io_mtx);
 }
 
 /* Check file descriptor whether connect is established. */
@@ -112,9 +112,8 @@ bgp_connect_check (struct peer *peer, int change_state)
   socklen_t slen;
   int ret;
 
-  /* Anyway I have to reset read and write thread. */
-  BGP_READ_OFF (peer->t_read);
-  BGP_WRITE_OFF (peer->t_write);
+  /* Anyway I have to reset the connect check thread. */
+  THREAD_OFF (peer->t_connect_check);
 
   /* Check file descriptor. */
   slen = sizeof (status);
@@ -190,7 +189,8 @@ bgp_update_packet_eor (struct peer *peer, afi_t afi, safi_t safi)
   return s;
 }
 
-/* Get next packet to be written.  */
+/* Generate the next update packet for the peer and queue it onto
+ * peer->obuf.  */
 static struct stream *
 bgp_write_packet (struct peer *peer)
 {
@@ -200,10 +200,6 @@ bgp_write_packet (struct peer *peer)
   afi_t afi;
   safi_t safi;
 
-  s = stream_fifo_head (peer->obuf);
-  if (s)
-    return s;
-
   /*
    * The code beyond this part deals with update packets, proceed only
    * if peer is Established and updates are not on hold (as part of
@@ -282,12 +278,6 @@ bgp_write_proceed_actions (struct peer *peer)
   int fullq_found = 0;
   struct update_subgroup *subgrp;
 
-  if (stream_fifo_head (peer->obuf))
-    {
-      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
-      return;
-    }
-
    for (afi = AFI_IP; afi < AFI_MAX; afi++)
      for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
       {
@@ -301,7 +291,7 @@ bgp_write_proceed_actions (struct peer *peer)
         next_pkt = paf->next_pkt_to_send;
         if (next_pkt && next_pkt->buffer)
           {
-            BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+            BGP_UPDGRP_PACKETS_ON (peer);
             return;
           }
 
@@ -312,7 +302,7 @@ bgp_write_proceed_actions (struct peer *peer)
           fullq_found = 1;
         else if (subgroup_packets_to_build (subgrp))
           {
-            BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+            BGP_UPDGRP_PACKETS_ON (peer);
             return;
           }
 
@@ -326,7 +316,7 @@ bgp_write_proceed_actions (struct peer *peer)
                             PEER_STATUS_EOR_SEND) &&
                 safi != SAFI_MPLS_VPN)
               {
-                BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+                BGP_UPDGRP_PACKETS_ON (peer);
                 return;
               }
 
@@ -334,128 +324,64 @@ bgp_write_proceed_actions (struct peer *peer)
       }
   if (fullq_found)
     {
-      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+      BGP_UPDGRP_PACKETS_ON (peer);
       return;
     }
 }
 
-/* Write packet to the peer. */
+/* Non-blocking connect() has completed or failed. */
 int
-bgp_write (struct thread *thread)
+bgp_connect_check_thread (struct thread *thread)
 {
   struct peer *peer;
-  u_char type;
-  struct stream *s;
-  int num;
-  int update_last_write = 0;
-  unsigned int count = 0;
-  unsigned int oc = 0;
 
-  /* Yes first of all get peer pointer. */
   peer = THREAD_ARG (thread);
-  peer->t_write = NULL;
-
-  /* For non-blocking IO check. */
-  if (peer->status == Connect)
-    {
-      bgp_connect_check (peer, 1);
-      return 0;
-    }
-
-  s = bgp_write_packet (peer);
-  if (!s)
-    {
-      bgp_write_proceed_actions (peer);
-      return 0;
-    }
+  peer->t_connect_check = NULL;
 
-  sockopt_cork (peer->fd, 1);
-
-  oc = peer->update_out;
-
-  /* Nonblocking write until TCP output buffer is full.  */
-  do
-    {
-      int writenum;
-
-      /* Number of bytes to be sent.  */
-      writenum = stream_get_endp (s) - stream_get_getp (s);
-
-      /* Call write() system call.  */
-      num = write (peer->fd, STREAM_PNT (s), writenum);
-      if (num < 0)
-	{
-	  /* write failed either retry needed or error */
-	  if (ERRNO_IO_RETRY(errno))
-		break;
+  bgp_connect_check (peer, 1);
+  return 0;
+}
 
-          BGP_EVENT_ADD (peer, TCP_fatal_error);
-	  return 0;
-	}
+/* Build the next batch of update packets for the peer and hand them to the
+ * I/O pthread.  Scheduled whenever there may be something new to send, and
+ * by the I/O pthread once it has written out everything queued. */
+int
+bgp_generate_updgrp_packets (struct thread *thread)
+{
+  struct peer *peer;
+  struct stream *s;
+  unsigned int count = 0;
+  size_t queued;
 
-      if (num != writenum)
-	{
-	  /* Partial write */
-	  stream_forward_getp (s, num);
-	  break;
-	}
+  peer = THREAD_ARG (thread);
+  peer->t_generate_updgrp_packets = NULL;
 
-      /* Retrieve BGP packet type. */
-      stream_set_getp (s, BGP_MARKER_SIZE + 2);
-      type = stream_getc (s);
+  if (peer->status != Established)
+    return 0;
 
-      switch (type)
-	{
-	case BGP_MSG_OPEN:
-	  peer->open_out++;
-	  break;
-	case BGP_MSG_UPDATE:
-	  peer->update_out++;
-	  break;
-	case BGP_MSG_NOTIFY:
-	  peer->notify_out++;
-	  /* Double start timer. */
-	  peer->v_start *= 2;
-
-	  /* Overflow check. */
-	  if (peer->v_start >= (60 * 2))
-	    peer->v_start = (60 * 2);
-
-	  /* Flush any existing events */
-	  BGP_EVENT_ADD (peer, BGP_Stop);
-	  goto done;
-
-	case BGP_MSG_KEEPALIVE:
-	  peer->keepalive_out++;
-	  break;
-	case BGP_MSG_ROUTE_REFRESH_NEW:
-	case BGP_MSG_ROUTE_REFRESH_OLD:
-	  peer->refresh_out++;
-	  break;
-	case BGP_MSG_CAPABILITY:
-	  peer->dynamic_cap_out++;
-	  break;
-	}
+  /* Don't run ahead of the socket; the I/O pthread asks for more once it
+   * has written out what is queued. */
+  pthread_mutex_lock (&peer->io_mtx);
+  {
+    queued = peer->obuf->count;
+  }
+  pthread_mutex_unlock (&peer->io_mtx);
 
-      /* OK we send packet so delete it. */
-      bgp_packet_delete (peer);
-      update_last_write = 1;
+  if (queued >= peer->bgp->wpkt_quanta)
+    {
+      bgp_writes_on (peer);
+      return 0;
     }
-  while (++count < peer->bgp->wpkt_quanta &&
-	 (s = bgp_write_packet (peer)) != NULL);
-
-  bgp_write_proceed_actions (peer);
 
- done:
-  /* Update last_update if UPDATEs were written. */
-  if (peer->update_out > oc)
-    peer->last_update = bgp_clock ();
+  while (count < peer->bgp->wpkt_quanta - queued
+         && (s = bgp_write_packet (peer)) != NULL)
+    count++;
 
-  /* If we TXed any flavor of packet update last_write */
-  if (update_last_write)
-    peer->last_write = bgp_clock ();
+  if (count || queued)
+    bgp_writes_on (peer);
+  else
+    bgp_write_proceed_actions (peer);
 
-  sockopt_cork (peer->fd, 0);
   return 0;
 }
 
@@ -468,7 +394,11 @@ bgp_write_notify (struct peer *peer)
   struct stream *s;
 
   /* There should be at least one packet. */
-  s = stream_fifo_head (peer->obuf);
+  pthread_mutex_lock (&peer->io_mtx);
+  {
+    s = stream_fifo_head (peer->obuf);
+  }
+  pthread_mutex_unlock (&peer->io_mtx);
   if (!s)
     return 0;
   assert (stream_get_endp (s) >= BGP_HEADER_SIZE);
@@ -539,7 +469,7 @@ bgp_keepalive_send (struct peer *peer)
   /* Add packet to the peer. */
   bgp_packet_add (peer, s);
 
-  BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+  bgp_writes_on (peer);
 }
 
 /* Make open packet and send it to the peer. */
@@ -590,7 +520,7 @@ bgp_open_send (struct peer *peer)
   /* Add packet to the peer. */
   bgp_packet_add (peer, s);
 
-  BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+  bgp_writes_on (peer);
 }
 
 /* Send BGP notify packet with data potion. */
@@ -618,8 +548,17 @@ bgp_notify_send_with_data (struct peer *peer, u_char code, u_char sub_code,
   /* Set BGP packet length. */
   length = bgp_packet_set_size (s);
   
+  /* Take the keepalives and I/O pthreads off the socket, the NOTIFY goes
+   * out right away in place of anything still queued. */
+  bgp_keepalives_off (peer);
+  bgp_writes_off (peer);
+
   /* Add packet to the peer. */
-  stream_fifo_clean (peer->obuf);
+  pthread_mutex_lock (&peer->io_mtx);
+  {
+    stream_fifo_clean (peer->obuf);
+  }
+  pthread_mutex_unlock (&peer->io_mtx);
   bgp_packet_add (peer, s);
 
   /* For debug */
@@ -678,8 +617,6 @@ bgp_notify_send_with_data (struct peer *peer, u_char code, u_char sub_code,
     peer->last_reset = PEER_DOWN_NOTIFY_SEND;
 
   /* Call immediately. */
-  BGP_WRITE_OFF (peer->t_write);
-
   bgp_write_notify (peer);
 }
 
@@ -776,7 +713,7 @@ bgp_route_refresh_send (struct peer *peer, afi_t afi, safi_t safi,
   /* Add packet to the peer. */
   bgp_packet_add (peer, s);
 
-  BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+  bgp_writes_on (peer);
 }
 
 /* Send capability message to the peer. */
@@ -818,7 +755,7 @@ bgp_capability_send (struct peer *peer, afi_t afi, safi_t safi,
   /* Add packet to the peer. */
   bgp_packet_add (peer, s);
 
-  BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+  bgp_writes_on (peer);
 }
 
 /* RFC1771 6.8 Connection collision detection. */
@@ -1216,7 +1153,6 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
       return (ret);
     }
 
-  peer->packet_size = 0;
   if (peer->ibuf)
     stream_reset (peer->ibuf);
 
@@ -2087,76 +2023,6 @@ bgp_capability_receive (struct peer *peer, bgp_size_t size)
   return bgp_capability_msg_parse (peer, pnt, size);
 }
 
-/* BGP read utility function. */
-static int
-bgp_read_packet (struct peer *peer)
-{
-  int nbytes;
-  int readsize;
-
-  readsize = peer->packet_size - stream_get_endp (peer->ibuf);
-
-  /* If size is zero then return. */
-  if (! readsize)
-    return 0;
-
-  /* Read packet from fd. */
-  nbytes = stream_read_try (peer->ibuf, peer->fd, readsize);
-
-  /* If read byte is smaller than zero then error occured. */
-  if (nbytes < 0) 
-    {
-      /* Transient error should retry */
-      if (nbytes == -2)
-	return -1;
-
-      zlog_err ("%s [Error] bgp_read_packet error: %s",
-		peer->host, safe_strerror (errno));
-
-      if (peer->status == Established) 
-	{
-	  if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_MODE))
-	    {
-	      peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
-	      SET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
-	    }
-	  else
-	    peer->last_reset = PEER_DOWN_CLOSE_SESSION;
-	}
-
-      BGP_EVENT_ADD (peer, TCP_fatal_error);
-      return -1;
-    }  
-
-  /* When read byte is zero : clear bgp peer and return */
-  if (nbytes == 0) 
-    {
-      if (bgp_debug_neighbor_events(peer))
-	zlog_debug ("%s [Event] BGP connection closed fd %d",
-		    peer->host, peer->fd);
-
-      if (peer->status == Established) 
-	{
-	  if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_MODE))
-	    {
-	      peer->last_reset = PEER_DOWN_NSF_CLOSE_SESSION;
-	      SET_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT);
-	    }
-	  else
-	    peer->last_reset = PEER_DOWN_CLOSE_SESSION;
-	}
-
-      BGP_EVENT_ADD (peer, TCP_connection_closed);
-      return -1;
-    }
-
-  /* We read partial packet. */
-  if (stream_get_endp (peer->ibuf) != peer->packet_size)
-    return -1;
-
-  return 0;
-}
-
 /* Marker check. */
 static int
 bgp_marker_all_one (struct stream *s, int length)
@@ -2170,123 +2036,75 @@ bgp_marker_all_one (struct stream *s, int length)
   return 1;
 }
 
-/* Starting point of packet process function. */
-int
-bgp_read (struct thread *thread)
+/* Validate the header of the packet in peer->ibuf and hand it to the
+ * handler for its type. */
+static void
+bgp_process_one (struct peer *peer)
 {
-  int ret;
   u_char type = 0;
-  struct peer *peer;
   bgp_size_t size;
   char notify_data_length[2];
-  u_int32_t notify_out;
 
-  /* Yes first of all get peer pointer. */
-  peer = THREAD_ARG (thread);
-  peer->t_read = NULL;
-
-  /* Note notify_out so we can check later to see if we sent another one */
-  notify_out = peer->notify_out;
+  /* Get size and type. */
+  stream_forward_getp (peer->ibuf, BGP_MARKER_SIZE);
+  memcpy (notify_data_length, stream_pnt (peer->ibuf), 2);
+  size = stream_getw (peer->ibuf);
+  type = stream_getc (peer->ibuf);
 
-  /* For non-blocking IO check. */
-  if (peer->status == Connect)
+  /* Marker check */
+  if (((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE))
+      && ! bgp_marker_all_one (peer->ibuf, BGP_MARKER_SIZE))
     {
-      bgp_connect_check (peer, 1);
-      goto done;
+      bgp_notify_send (peer,
+		       BGP_NOTIFY_HEADER_ERR, 
+		       BGP_NOTIFY_HEADER_NOT_SYNC);
+      return;
     }
-  else
+
+  /* BGP type check. */
+  if (type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE 
+      && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE 
+      && type != BGP_MSG_ROUTE_REFRESH_NEW
+      && type != BGP_MSG_ROUTE_REFRESH_OLD
+      && type != BGP_MSG_CAPABILITY)
     {
-      if (peer->fd < 0)
-	{
-	  zlog_err ("bgp_read peer's fd is negative value %d", peer->fd);
-	  return -1;
-	}
-      BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+      if (bgp_debug_neighbor_events(peer))
+	zlog_debug ("%s unknown message type 0x%02x",
+		    peer->host, type);
+      bgp_notify_send_with_data (peer,
+				 BGP_NOTIFY_HEADER_ERR,
+				 BGP_NOTIFY_HEADER_BAD_MESTYPE,
+				 &type, 1);
+      return;
     }
-
-  /* Read packet header to determine type of the packet */
-  if (peer->packet_size == 0)
-    peer->packet_size = BGP_HEADER_SIZE;
-
-  if (stream_get_endp (peer->ibuf) < BGP_HEADER_SIZE)
+  /* Mimimum packet length check. */
+  if ((size < BGP_HEADER_SIZE)
+      || (size > BGP_MAX_PACKET_SIZE)
+      || (size != stream_get_endp (peer->ibuf))
+      || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE)
+      || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
+      || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE)
+      || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE)
+      || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
+      || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
+      || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE))
     {
-      ret = bgp_read_packet (peer);
-
-      /* Header read error or partial read packet. */
-      if (ret < 0) 
-	goto done;
-
-      /* Get size and type. */
-      stream_forward_getp (peer->ibuf, BGP_MARKER_SIZE);
-      memcpy (notify_data_length, stream_pnt (peer->ibuf), 2);
-      size = stream_getw (peer->ibuf);
-      type = stream_getc (peer->ibuf);
-
-      /* Marker check */
-      if (((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE))
-	  && ! bgp_marker_all_one (peer->ibuf, BGP_MARKER_SIZE))
-	{
-	  bgp_notify_send (peer,
-			   BGP_NOTIFY_HEADER_ERR, 
-			   BGP_NOTIFY_HEADER_NOT_SYNC);
-	  goto done;
-	}
-
-      /* BGP type check. */
-      if (type != BGP_MSG_OPEN && type != BGP_MSG_UPDATE 
-	  && type != BGP_MSG_NOTIFY && type != BGP_MSG_KEEPALIVE 
-	  && type != BGP_MSG_ROUTE_REFRESH_NEW
-	  && type != BGP_MSG_ROUTE_REFRESH_OLD
-	  && type != BGP_MSG_CAPABILITY)
-	{
-          if (bgp_debug_neighbor_events(peer))
-	    zlog_debug ("%s unknown message type 0x%02x",
-		        peer->host, type);
-	  bgp_notify_send_with_data (peer,
-				     BGP_NOTIFY_HEADER_ERR,
-			 	     BGP_NOTIFY_HEADER_BAD_MESTYPE,
-				     &type, 1);
-	  goto done;
-	}
-      /* Mimimum packet length check. */
-      if ((size < BGP_HEADER_SIZE)
-	  || (size > BGP_MAX_PACKET_SIZE)
-	  || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE)
-	  || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
-	  || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE)
-	  || (type == BGP_MSG_KEEPALIVE && size != BGP_MSG_KEEPALIVE_MIN_SIZE)
-	  || (type == BGP_MSG_ROUTE_REFRESH_NEW && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
-	  || (type == BGP_MSG_ROUTE_REFRESH_OLD && size < BGP_MSG_ROUTE_REFRESH_MIN_SIZE)
-	  || (type == BGP_MSG_CAPABILITY && size < BGP_MSG_CAPABILITY_MIN_SIZE))
-	{
-          if (bgp_debug_neighbor_events(peer))
-	    zlog_debug ("%s bad message length - %d for %s",
-		        peer->host, size,
-		        type == 128 ? "ROUTE-REFRESH" :
-		        bgp_type_str[(int) type]);
-	  bgp_notify_send_with_data (peer,
-				     BGP_NOTIFY_HEADER_ERR,
-			  	     BGP_NOTIFY_HEADER_BAD_MESLEN,
-				     (u_char *) notify_data_length, 2);
-	  goto done;
-	}
-
-      /* Adjust size to message length. */
-      peer->packet_size = size;
+      if (bgp_debug_neighbor_events(peer))
+	zlog_debug ("%s bad message length - %d for %s",
+		    peer->host, size,
+		    type == 128 ? "ROUTE-REFRESH" :
+		    bgp_type_str[(int) type]);
+      bgp_notify_send_with_data (peer,
+				 BGP_NOTIFY_HEADER_ERR,
+				 BGP_NOTIFY_HEADER_BAD_MESLEN,
+				 (u_char *) notify_data_length, 2);
+      return;
     }
 
-  ret = bgp_read_packet (peer);
-  if (ret < 0) 
-    goto done;
-
-  /* Get size and type again. */
-  (void)stream_getw_from (peer->ibuf, BGP_MARKER_SIZE);
-  type = stream_getc_from (peer->ibuf, BGP_MARKER_SIZE + 2);
-
   /* BGP packet dump function. */
   bgp_dump_packet (peer, type, peer->ibuf);
   
-  size = (peer->packet_size - BGP_HEADER_SIZE);
+  size -= BGP_HEADER_SIZE;
 
   /* Read rest of the packet and call each sort of packet routine */
   switch (type) 
@@ -2316,31 +2134,74 @@ bgp_read (struct thread *thread)
       bgp_capability_receive (peer, size);
       break;
     }
+}
 
-  /* If reading this packet caused us to send a NOTIFICATION then store a copy
-   * of the packet for troubleshooting purposes
-   */
-  if (notify_out < peer->notify_out)
+/* Starting point of packet process function.  Works through the packets
+ * the I/O pthread has queued onto peer->inq, a few at a time so that other
+ * peers get their turn. */
+int
+bgp_process_packet (struct thread *thread)
+{
+  struct peer *peer;
+  struct stream *s;
+  unsigned int processed = 0;
+  u_int32_t notify_out;
+  bool more = false;
+
+  /* Yes first of all get peer pointer. */
+  peer = THREAD_ARG (thread);
+  peer->t_process_packet = NULL;
+
+  peer_lock (peer);
+
+  while (processed < peer->bgp->rpkt_quanta && peer->status != Deleted)
     {
-      memcpy(peer->last_reset_cause, peer->ibuf->data, peer->packet_size);
-      peer->last_reset_cause_size = peer->packet_size;
+      pthread_mutex_lock (&peer->io_mtx);
+      {
+        s = stream_fifo_pop (peer->inq);
+      }
+      pthread_mutex_unlock (&peer->io_mtx);
+
+      if (!s)
+        break;
+
+      stream_free (peer->ibuf);
+      peer->ibuf = s;
+
+      /* Note notify_out so we can check later to see if we sent another one */
       notify_out = peer->notify_out;
-    }
 
-  /* Clear input buffer. */
-  peer->packet_size = 0;
-  if (peer->ibuf)
-    stream_reset (peer->ibuf);
+      bgp_process_one (peer);
+      processed++;
 
- done:
-  /* If reading this packet caused us to send a NOTIFICATION then store a copy
-   * of the packet for troubleshooting purposes
-   */
-  if (notify_out < peer->notify_out)
+      if (notify_out < peer->notify_out)
+        {
+          /* If reading this packet caused us to send a NOTIFICATION then
+           * store a copy of the packet for troubleshooting purposes; the
+           * rest of the input is of no interest anymore. */
+          if (peer->status != Deleted)
+            {
+              memcpy (peer->last_reset_cause, s->data, stream_get_endp (s));
+              peer->last_reset_cause_size = stream_get_endp (s);
+            }
+          goto done;
+        }
+    }
+
+  if (peer->status != Deleted)
     {
-      memcpy(peer->last_reset_cause, peer->ibuf->data, peer->packet_size);
-      peer->last_reset_cause_size = peer->packet_size;
+      pthread_mutex_lock (&peer->io_mtx);
+      {
+        more = (stream_fifo_head (peer->inq) != NULL);
+      }
+      pthread_mutex_unlock (&peer->io_mtx);
     }
 
+  if (more)
+    thread_add_event (bm->master, bgp_process_packet, peer, 0,
+                      &peer->t_process_packet);
+
+ done:
+  peer_unlock (peer);
   return 0;
 }
@@ -25,6 +25,7 @@
 #define BGP_TOTAL_ATTR_LEN    2U
 #define BGP_UNFEASIBLE_LEN    2U
 #define BGP_WRITE_PACKET_MAX 10U
+#define BGP_READ_PACKET_MAX  10U
 
 /* When to refresh */
 #define REFRESH_IMMEDIATE 1
@@ -38,9 +39,10 @@
 #define ORF_COMMON_PART_DENY       0x20 
 
 /* Packet send and receive function prototypes. */
-extern int bgp_read (struct thread *);
-extern int bgp_write (struct thread *);
+extern int bgp_process_packet (struct thread *);
+extern int bgp_generate_updgrp_packets (struct thread *);
 extern int bgp_connect_check (struct peer *, int change_state);
+extern int bgp_connect_check_thread (struct thread *);
 
 extern void bgp_keepalive_send (struct peer *);
 extern void bgp_open_send (struct peer *);
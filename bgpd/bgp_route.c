@@ -73,7 +73,9 @@
 #include "bgpd/bgp_encap_tlv.h"
 #include "bgpd/bgp_evpn.h"
 #include "bgpd/bgp_evpn_vty.h"
+#include "bgpd/bgp_bestpath.h"
 
+DEFINE_MTYPE_SLAB(BGPD, BGP_ROUTE, "BGP route", sizeof (struct bgp_info))
 
 /* Extern from bgp_dump.c */
 extern const char *bgp_origin_str[];
@@ -207,6 +209,7 @@ bgp_info_unlock (struct bgp_info *binfo)
 void
 bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
 {
+  struct bgp_table *table = bgp_node_table (rn);
   struct bgp_info *top;
 
   top = rn->info;
@@ -216,6 +219,9 @@ bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
   if (top)
     top->prev = ri;
   rn->info = ri;
+  ri->net = rn;
+  LIST_INSERT_HEAD (&ri->peer->routes[table->afi][table->safi], ri,
+                    peer_thread);
   
   bgp_info_lock (ri);
   bgp_lock_node (rn);
@@ -233,6 +239,7 @@ bgp_info_reap (struct bgp_node *rn, struct bgp_info *ri)
     ri->prev->next = ri->next;
   else
     rn->info = ri->next;
+  LIST_REMOVE (ri, peer_thread);
   
   bgp_info_mpath_dequeue (ri);
   bgp_info_unlock (ri);
@@ -644,8 +651,8 @@ bgp_info_cmp (struct bgp *bgp, struct bgp_info *new, struct bgp_info *exist,
      path with smaller cluster list length.                       */
   if (newm == existm)
     {
-      if (peer_sort (new->peer) == BGP_PEER_IBGP
-	  && peer_sort (exist->peer) == BGP_PEER_IBGP
+      if (new_sort == BGP_PEER_IBGP
+	  && exist_sort == BGP_PEER_IBGP
 	  && (mpath_cfg == NULL ||
               CHECK_FLAG (mpath_cfg->ibgp_flags,
                           BGP_FLAG_IBGP_MULTIPATH_SAME_CLUSTERLEN)))
@@ -899,20 +906,109 @@ bgp_info_cmp_compatible (struct bgp *bgp, struct bgp_info *new, struct bgp_info
   return ret;
 }
 
-static enum filter_type
-bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
-		  afi_t afi, safi_t safi)
+/* The batch of prefix-list results for the table walk under way. */
+static struct bgp_plist_batch *plist_batch;
+
+/* Start a walk that filters with up to two prefix-lists, either of which
+ * may be NULL. */
+void
+bgp_plist_batch_start (struct bgp_plist_batch *batch,
+                       struct prefix_list *plist1, struct prefix_list *plist2,
+                       int (*want) (struct bgp_node *, void *), void *arg)
 {
-  struct bgp_filter *filter;
+  batch->plist[0] = plist1;
+  batch->plist[1] = plist2;
+  batch->want = want;
+  batch->arg = arg;
+  batch->count = batch->pos = 0;
 
-  filter = &peer->filter[afi][safi];
+  batch->prev = plist_batch;
+  plist_batch = batch;
+}
+
+void
+bgp_plist_batch_end (struct bgp_plist_batch *batch)
+{
+  assert (plist_batch == batch);
+  plist_batch = batch->prev;
+}
+
+/* The walk has got to rn.  Work out the next batch from there if rn is
+ * wanted but isn't in this one. */
+void
+bgp_plist_batch_node (struct bgp_plist_batch *batch, struct bgp_node *rn)
+{
+  struct prefix *prefixes[BGP_PLIST_BATCH];
+  struct bgp_node *next;
+  unsigned int i;
+
+  /* Nodes the walk passes over were left out of the batch; it still
+   * holds the wanted ones after them. */
+  if (! batch->want (rn, batch->arg))
+    return;
+
+  /* Usually the next one along, unless nodes went away. */
+  for (i = batch->pos; i < batch->count; i++)
+    if (prefix_same (&batch->prefix[i], &rn->p))
+      {
+        batch->pos = i;
+        return;
+      }
+
+  batch->count = batch->pos = 0;
+
+  /* Looking ahead leaves the locks as they were. */
+  bgp_lock_node (rn);
+  for (next = rn; next; next = bgp_route_next (next))
+    {
+      if (next != rn && ! batch->want (next, batch->arg))
+        continue;
+
+      prefix_copy (&batch->prefix[batch->count], &next->p);
+      prefixes[batch->count] = &batch->prefix[batch->count];
+      if (++batch->count == BGP_PLIST_BATCH)
+        break;
+    }
+  if (next)
+    bgp_unlock_node (next);
+
+  for (i = 0; i < BGP_PLIST_BATCH_LISTS; i++)
+    if (batch->plist[i])
+      prefix_list_apply_bulk (batch->plist[i], prefixes, batch->count,
+                              batch->result[i]);
+}
+
+/* prefix_list_apply(), or what it came to for the node the walk is at. */
+static enum prefix_list_type
+bgp_prefix_list_apply (struct prefix_list *plist, struct prefix *p)
+{
+  struct bgp_plist_batch *batch = plist_batch;
+  unsigned int i;
+
+  if (plist && batch && batch->pos < batch->count
+      && prefix_same (&batch->prefix[batch->pos], p))
+    for (i = 0; i < BGP_PLIST_BATCH_LISTS; i++)
+      if (batch->plist[i] == plist)
+        return batch->result[i][batch->pos];
+
+  return prefix_list_apply (plist, p);
+}
 
 #define FILTER_EXIST_WARN(F,f,filter) \
   if (BGP_DEBUG (update, UPDATE_IN) \
       && !(F ## _IN (filter))) \
     zlog_warn ("%s: Could not find configured input %s-list %s!", \
                peer->host, #f, F ## _IN_NAME(filter));
-  
+
+/* The input filters that look at the prefix. */
+static enum filter_type
+bgp_input_filter_prefix (struct peer *peer, struct prefix *p, afi_t afi,
+                         safi_t safi)
+{
+  struct bgp_filter *filter;
+
+  filter = &peer->filter[afi][safi];
+
   if (DISTRIBUTE_IN_NAME (filter)) {
     FILTER_EXIST_WARN(DISTRIBUTE, distribute, filter);
       
@@ -923,10 +1019,22 @@ bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
   if (PREFIX_LIST_IN_NAME (filter)) {
     FILTER_EXIST_WARN(PREFIX_LIST, prefix, filter);
     
-    if (prefix_list_apply (PREFIX_LIST_IN (filter), p) == PREFIX_DENY)
+    if (bgp_prefix_list_apply (PREFIX_LIST_IN (filter), p) == PREFIX_DENY)
       return FILTER_DENY;
   }
-  
+
+  return FILTER_PERMIT;
+}
+
+/* The input filters that look at the attributes only. */
+static enum filter_type
+bgp_input_filter_attr (struct peer *peer, struct attr *attr, afi_t afi,
+                       safi_t safi)
+{
+  struct bgp_filter *filter;
+
+  filter = &peer->filter[afi][safi];
+
   if (FILTER_LIST_IN_NAME (filter)) {
     FILTER_EXIST_WARN(FILTER_LIST, as, filter);
     
@@ -935,7 +1043,16 @@ bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
   }
   
   return FILTER_PERMIT;
+}
 #undef FILTER_EXIST_WARN
+
+static enum filter_type
+bgp_input_filter (struct peer *peer, struct prefix *p, struct attr *attr,
+		  afi_t afi, safi_t safi)
+{
+  if (bgp_input_filter_prefix (peer, p, afi, safi) == FILTER_DENY)
+    return FILTER_DENY;
+  return bgp_input_filter_attr (peer, attr, afi, safi);
 }
 
 static enum filter_type
@@ -962,7 +1079,7 @@ bgp_output_filter (struct peer *peer, struct prefix *p, struct attr *attr,
   if (PREFIX_LIST_OUT_NAME (filter)) {
     FILTER_EXIST_WARN(PREFIX_LIST, prefix, filter);
     
-    if (prefix_list_apply (PREFIX_LIST_OUT (filter), p) == PREFIX_DENY)
+    if (bgp_prefix_list_apply (PREFIX_LIST_OUT (filter), p) == PREFIX_DENY)
       return FILTER_DENY;
   }
 
@@ -1063,7 +1180,7 @@ bgp_input_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_IN); 
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (rmap, p, RMAP_BGP, &info);
+      ret = bgp_route_map_apply (rmap, p, &info);
 
       peer->rmap_type = 0;
 
@@ -1120,7 +1237,7 @@ bgp_output_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_OUT);
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (rmap, p, RMAP_BGP, &info);
+      ret = bgp_route_map_apply (rmap, p, &info);
 
       peer->rmap_type = 0;
 
@@ -1334,7 +1451,7 @@ subgroup_announce_check (struct bgp_node *rn, struct bgp_info *ri,
 			 PEER_CAP_ORF_PREFIX_SM_OLD_RCV)))
     if (peer->orf_plist[afi][safi])
       {
-	if (prefix_list_apply (peer->orf_plist[afi][safi], p) == PREFIX_DENY)
+	if (bgp_prefix_list_apply (peer->orf_plist[afi][safi], p) == PREFIX_DENY)
 	  {
             if (bgp_debug_update(NULL, p, subgrp->update_group, 0))
               zlog_debug ("%s [Update:SEND] %s is filtered via ORF",
@@ -1519,7 +1636,7 @@ subgroup_announce_check (struct bgp_node *rn, struct bgp_info *ri,
       if (ri->extra && ri->extra->suppress)
 	ret = route_map_apply (UNSUPPRESS_MAP (filter), p, RMAP_BGP, &info);
       else
-	ret = route_map_apply (ROUTE_MAP_OUT (filter), p, RMAP_BGP, &info);
+	ret = bgp_route_map_apply (ROUTE_MAP_OUT (filter), p, &info);
 
       peer->rmap_type = 0;
 
@@ -1595,30 +1712,21 @@ struct bgp_info_pair
   struct bgp_info *new;
 };
 
-static void
-bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
-		    struct bgp_maxpaths_cfg *mpath_cfg,
-		    struct bgp_info_pair *result)
+/* Which of the paths of rn is best.  This only looks at, and marks, the
+ * paths of rn itself, so the bestpath workers run it for nodes nothing
+ * else is looking at meanwhile, with debug off. */
+struct bgp_info *
+bgp_best_path (struct bgp *bgp, struct bgp_node *rn,
+               struct bgp_maxpaths_cfg *mpath_cfg, int debug,
+               const char *pfx_buf)
 {
   struct bgp_info *new_select;
-  struct bgp_info *old_select;
   struct bgp_info *ri;
   struct bgp_info *ri1;
   struct bgp_info *ri2;
-  struct bgp_info *nextri = NULL;
-  int paths_eq, do_mpath, debug;
-  struct list mp_list;
-  char pfx_buf[PREFIX2STR_BUFFER];
+  int paths_eq;
   char path_buf[PATH_ADDPATH_STR_BUFFER];
 
-  bgp_mp_list_init (&mp_list);
-  do_mpath = (mpath_cfg->maxpaths_ebgp > 1 || mpath_cfg->maxpaths_ibgp > 1);
-
-  debug = bgp_debug_bestpath(&rn->p);
-
-  if (debug)
-    prefix2str (&rn->p, pfx_buf, sizeof (pfx_buf));
-
   /* bgp deterministic-med */
   new_select = NULL;
   if (bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED))
@@ -1680,25 +1788,11 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
         }
     }
 
-  /* Check old selected route and new selected route. */
-  old_select = NULL;
   new_select = NULL;
-  for (ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri)
+  for (ri = rn->info; ri; ri = ri->next)
     {
-      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
-	old_select = ri;
-
       if (BGP_INFO_HOLDDOWN (ri))
-        {
-          /* reap REMOVED routes, if needs be 
-           * selected route must stay for a while longer though
-           */
-          if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
-              && (ri != old_select))
-              bgp_info_reap (rn, ri);
-          
-          continue;
-        }
+        continue;
 
       if (ri->peer &&
           ri->peer != bgp->peer_self &&
@@ -1720,6 +1814,48 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
 	  new_select = ri;
 	}
     }
+
+  return new_select;
+}
+
+/* The rest of best path selection, once bgp_best_path() has been run for
+ * rn, with its result in new_select. */
+static void
+bgp_best_selection (struct bgp *bgp, struct bgp_node *rn,
+		    struct bgp_maxpaths_cfg *mpath_cfg,
+		    struct bgp_info *new_select,
+		    struct bgp_info_pair *result)
+{
+  struct bgp_info *old_select;
+  struct bgp_info *ri;
+  struct bgp_info *nextri = NULL;
+  int paths_eq, do_mpath, debug;
+  struct list mp_list;
+  char pfx_buf[PREFIX2STR_BUFFER];
+  char path_buf[PATH_ADDPATH_STR_BUFFER];
+
+  bgp_mp_list_init (&mp_list);
+  do_mpath = (mpath_cfg->maxpaths_ebgp > 1 || mpath_cfg->maxpaths_ibgp > 1);
+
+  debug = bgp_debug_bestpath(&rn->p);
+
+  if (debug)
+    prefix2str (&rn->p, pfx_buf, sizeof (pfx_buf));
+
+  /* Check old selected route. */
+  old_select = NULL;
+  for (ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri)
+    {
+      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+	old_select = ri;
+
+      /* reap REMOVED routes, if needs be 
+       * selected route must stay for a while longer though
+       */
+      if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
+          && (ri != old_select))
+        bgp_info_reap (rn, ri);
+    }
     
   /* Now that we know which path is the bestpath see if any of the other paths
    * qualify as multipaths
@@ -1892,47 +2028,38 @@ bgp_zebra_has_route_changed (struct bgp_node *rn, struct bgp_info *selected)
   return 0;
 }
 
+/* Nodes queued for processing, a batch at a time, so that best path
+ * selection for them can be spread over the bestpath workers.  A batch
+ * without nodes marks the end of the initial update. */
+#define BGP_PROCESS_BATCH 256
+
 struct bgp_process_queue
 {
   struct bgp *bgp;
-  struct bgp_node *rn;
   afi_t afi;
   safi_t safi;
+
+  /* Nothing is added to a batch any more once it is being processed. */
+  int running;
+
+  unsigned int count;
+  struct bgp_node *rn[BGP_PROCESS_BATCH];
 };
 
-static wq_item_status
-bgp_process_main (struct work_queue *wq, void *data)
+/* Everything that comes of the new best path for rn, which was selected
+ * for it by bgp_best_path(). */
+static void
+bgp_process_main_one (struct bgp *bgp, struct bgp_node *rn, afi_t afi,
+                      safi_t safi, struct bgp_info *new_best)
 {
-  struct bgp_process_queue *pq = data;
-  struct bgp *bgp = pq->bgp;
-  struct bgp_node *rn = pq->rn;
-  afi_t afi = pq->afi;
-  safi_t safi = pq->safi;
   struct prefix *p = &rn->p;
   struct bgp_info *new_select;
   struct bgp_info *old_select;
   struct bgp_info_pair old_and_new;
 
-  /* Is it end of initial update? (after startup) */
-  if (!rn)
-    {
-      quagga_timestamp(3, bgp->update_delay_zebra_resume_time,
-                       sizeof(bgp->update_delay_zebra_resume_time));
-
-      bgp->main_zebra_update_hold = 0;
-      for (afi = AFI_IP; afi < AFI_MAX; afi++)
-        for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
-          {
-            bgp_zebra_announce_table(bgp, afi, safi);
-          }
-      bgp->main_peers_update_hold = 0;
-
-      bgp_start_routeadv(bgp);
-      return WQ_SUCCESS;
-    }
-
   /* Best path selection. */
-  bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], &old_and_new);
+  bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], new_best,
+                      &old_and_new);
   old_select = old_and_new.old;
   new_select = old_and_new.new;
 
@@ -2002,7 +2129,7 @@ bgp_process_main (struct work_queue *wq, void *data)
          }
 
       UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
-      return WQ_SUCCESS;
+      return;
     }
 
   /* If the user did "clear ip bgp prefix x.x.x.x" this flag will be set */
@@ -2078,6 +2205,73 @@ bgp_process_main (struct work_queue *wq, void *data)
     bgp_info_reap (rn, old_select);
   
   UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
+}
+
+static wq_item_status
+bgp_process_main (struct work_queue *wq, void *data)
+{
+  struct bgp_process_queue *pq = data;
+  struct bgp *bgp = pq->bgp;
+  afi_t afi = pq->afi;
+  safi_t safi = pq->safi;
+  struct bgp_bestpath_job jobs[BGP_PROCESS_BATCH];
+  struct bgp_node *rn;
+  unsigned int i, j, njobs = 0;
+  char pfx_buf[PREFIX2STR_BUFFER];
+
+  /* Is it end of initial update? (after startup) */
+  if (!pq->count)
+    {
+      quagga_timestamp(3, bgp->update_delay_zebra_resume_time,
+                       sizeof(bgp->update_delay_zebra_resume_time));
+
+      bgp->main_zebra_update_hold = 0;
+      for (afi = AFI_IP; afi < AFI_MAX; afi++)
+        for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+          {
+            bgp_zebra_announce_table(bgp, afi, safi);
+          }
+      bgp->main_peers_update_hold = 0;
+
+      bgp_start_routeadv(bgp);
+      return WQ_SUCCESS;
+    }
+
+  pq->running = 1;
+
+  /* Select the best paths first, all of them at once.  Nodes being
+   * debugged are left for later, to log from here. */
+  for (i = 0; i < pq->count; i++)
+    {
+      rn = pq->rn[i];
+      if (bgp_debug_bestpath (&rn->p))
+        continue;
+
+      jobs[njobs].bgp = bgp;
+      jobs[njobs].rn = rn;
+      jobs[njobs].mpath_cfg = &bgp->maxpaths[afi][safi];
+      jobs[njobs].new_select = NULL;
+      njobs++;
+    }
+  bgp_bestpath_run (jobs, njobs);
+
+  /* Then do whatever comes of them, one node after the other. */
+  for (i = 0, j = 0; i < pq->count; i++)
+    {
+      struct bgp_info *new_best;
+
+      rn = pq->rn[i];
+      if (j < njobs && jobs[j].rn == rn)
+        new_best = jobs[j++].new_select;
+      else
+        {
+          prefix2str (&rn->p, pfx_buf, sizeof (pfx_buf));
+          new_best = bgp_best_path (bgp, rn, &bgp->maxpaths[afi][safi], 1,
+                                    pfx_buf);
+        }
+      bgp_process_main_one (bgp, rn, afi, safi, new_best);
+    }
+
   return WQ_SUCCESS;
 }
 
@@ -2086,12 +2280,13 @@ bgp_processq_del (struct work_queue *wq, void *data)
 {
   struct bgp_process_queue *pq = data;
   struct bgp_table *table;
+  unsigned int i;
 
   bgp_unlock (pq->bgp);
-  if (pq->rn)
+  for (i = 0; i < pq->count; i++)
     {
-      table = bgp_node_table (pq->rn);
-      bgp_unlock_node (pq->rn);
+      table = bgp_node_table (pq->rn[i]);
+      bgp_unlock_node (pq->rn[i]);
       bgp_table_unlock (table);
     }
   XFREE (MTYPE_BGP_PROCESS_QUEUE, pq);
@@ -2118,33 +2313,49 @@ bgp_process_queue_init (void)
   bm->process_main_queue->spec.hold = 50;
   /* Use a higher yield value of 50ms for main queue processing */
   bm->process_main_queue->spec.yield = 50 * 1000L;
+  /* Routes being cleared end up on this queue too, so it gets a bigger
+   * share than the clear-node queues feeding it */
+  bm->process_main_queue->spec.weight = 4 * WORK_QUEUE_DEFAULT_WEIGHT;
 }
 
 void
 bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
 {
-  struct bgp_process_queue *pqnode;
+  struct work_queue *wq = bm->process_main_queue;
+  struct bgp_process_queue *pqnode = NULL;
+  struct listnode *tail;
   
   /* already scheduled for processing? */
   if (CHECK_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED))
     return;
 
-  if (bm->process_main_queue == NULL)
+  if (wq == NULL)
     return;
 
-  pqnode = XCALLOC (MTYPE_BGP_PROCESS_QUEUE, 
-                    sizeof (struct bgp_process_queue));
+  /* Into the batch at the end of the queue, if there is room in it. */
+  if ((tail = listtail (wq->items)) != NULL)
+    {
+      pqnode = ((struct work_queue_item *) listgetdata (tail))->data;
+      if (pqnode->running || pqnode->bgp != bgp || pqnode->afi != afi
+          || pqnode->safi != safi || pqnode->count == 0
+          || pqnode->count == BGP_PROCESS_BATCH)
+        pqnode = NULL;
+    }
+
   if (!pqnode)
-    return;
+    {
+      pqnode = XCALLOC (MTYPE_BGP_PROCESS_QUEUE,
+                        sizeof (struct bgp_process_queue));
+      pqnode->bgp = bgp;
+      bgp_lock (bgp);
+      pqnode->afi = afi;
+      pqnode->safi = safi;
+      work_queue_add (wq, pqnode);
+    }
 
   /* all unlocked in bgp_processq_del */
   bgp_table_lock (bgp_node_table (rn));
-  pqnode->rn = bgp_lock_node (rn);
-  pqnode->bgp = bgp;
-  bgp_lock (bgp);
-  pqnode->afi = afi;
-  pqnode->safi = safi;
-  work_queue_add (bm->process_main_queue, pqnode);
+  pqnode->rn[pqnode->count++] = bgp_lock_node (rn);
   SET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
   return;
 }
@@ -2162,7 +2373,6 @@ bgp_add_eoiu_mark (struct bgp *bgp)
   if (!pqnode)
     return;
 
-  pqnode->rn = NULL;
   pqnode->bgp = bgp;
   bgp_lock (bgp);
   work_queue_add (bm->process_main_queue, pqnode);
@@ -2461,50 +2671,15 @@ bgp_update_martian_nexthop (struct bgp *bgp, afi_t afi, safi_t safi, struct attr
   return ret;
 }
 
-int
-bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
-            struct attr *attr, afi_t afi, safi_t safi, int type,
-            int sub_type, struct prefix_rd *prd, u_char *tag,
-            int soft_reconfig, struct bgp_route_evpn* evpn)
+/* The checks on an UPDATE's attributes that are the same for every prefix
+   it carries.  Returns why its routes are filtered, or NULL. */
+static const char *
+bgp_update_attr_filter (struct peer *peer, struct attr *attr, afi_t afi,
+                        safi_t safi)
 {
-  int ret;
+  struct bgp *bgp = peer->bgp;
   int aspath_loop_count = 0;
-  struct bgp_node *rn;
-  struct bgp *bgp;
-  struct attr new_attr;
-  struct attr_extra new_extra;
-  struct attr *attr_new;
-  struct bgp_info *ri;
-  struct bgp_info *new;
-  const char *reason;
-  char pfx_buf[BGP_PRD_PATH_STRLEN];
-  char label_buf[20];
-  int connected = 0;
   int do_loop_check = 1;
-#if ENABLE_BGP_VNC
-  int vnc_implicit_withdraw = 0;
-#endif
-
-  memset (&new_attr, 0, sizeof(struct attr));
-  memset (&new_extra, 0, sizeof(struct attr_extra));
-
-  bgp = peer->bgp;
-  rn = bgp_afi_node_get (bgp->rib[afi][safi], afi, safi, p, prd);
-  label_buf[0] = '\0';
-  if (bgp_labeled_safi(safi))
-    sprintf (label_buf, "label %u", label_pton(tag));
-  
-  /* When peer's soft reconfiguration enabled.  Record input packet in
-     Adj-RIBs-In.  */
-  if (! soft_reconfig && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
-      && peer != bgp->peer_self)
-    bgp_adj_in_set (rn, peer, attr, addpath_id);
-
-  /* Check previously received route. */
-  for (ri = rn->info; ri; ri = ri->next)
-    if (ri->peer == peer && ri->type == type && ri->sub_type == sub_type &&
-        ri->addpath_rx_id == addpath_id)
-      break;
 
   /* AS path local-as loop check. */
   if (peer->change_local_as)
@@ -2513,10 +2688,7 @@ bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
 	aspath_loop_count = 1;
 
       if (aspath_loop_check (attr->aspath, peer->change_local_as) > aspath_loop_count) 
-	{
-	  reason = "as-path contains our own AS;";
-	  goto filtered;
-	}
+	return "as-path contains our own AS;";
     }
 
   /* If the peer is configured for "allowas-in origin" and the last ASN in the
@@ -2532,33 +2704,33 @@ bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
       if (aspath_loop_check (attr->aspath, bgp->as) > peer->allowas_in[afi][safi]
           || (CHECK_FLAG(bgp->config, BGP_CONFIG_CONFEDERATION)
               && aspath_loop_check(attr->aspath, bgp->confed_id) > peer->allowas_in[afi][safi]))
-        {
-          reason = "as-path contains our own AS;";
-          goto filtered;
-        }
+	return "as-path contains our own AS;";
     }
 
   /* Route reflector originator ID check.  */
   if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)
       && IPV4_ADDR_SAME (&bgp->router_id, &attr->extra->originator_id))
-    {
-      reason = "originator is us;";
-      goto filtered;
-    }
+    return "originator is us;";
 
   /* Route reflector cluster ID check.  */
   if (bgp_cluster_filter (peer, attr))
-    {
-      reason = "reflected from the same cluster;";
-      goto  filtered;
-    }
+    return "reflected from the same cluster;";
 
-  /* Apply incoming filter.  */
-  if (bgp_input_filter (peer, p, attr, afi, safi) == FILTER_DENY)
-    {
-      reason = "filter;";
-      goto filtered;
-    }
+  return NULL;
+}
+
+/* Apply the inbound route-map and next hop check to a copy of attr for p,
+   and intern what comes out.  Returns why the route is filtered instead,
+   or NULL. */
+static const char *
+bgp_update_modify (struct peer *peer, struct prefix *p, struct attr *attr,
+                   afi_t afi, safi_t safi, struct attr **attr_new)
+{
+  struct attr new_attr;
+  struct attr_extra new_extra;
+
+  memset (&new_attr, 0, sizeof(struct attr));
+  memset (&new_extra, 0, sizeof(struct attr_extra));
 
   new_attr.extra = &new_extra;
   bgp_attr_dup (&new_attr, attr);
@@ -2569,20 +2741,44 @@ bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
    * the attr (which takes over the memory references) */
   if (bgp_input_modifier (peer, p, &new_attr, afi, safi, NULL) == RMAP_DENY)
     {
-      reason = "route-map;";
       bgp_attr_flush (&new_attr);
-      goto filtered;
+      return "route-map;";
     }
 
   /* next hop check.  */
-  if (bgp_update_martian_nexthop (bgp, afi, safi, &new_attr))
+  if (bgp_update_martian_nexthop (peer->bgp, afi, safi, &new_attr))
     {
-       reason = "martian or self next-hop;";
-       bgp_attr_flush (&new_attr);
-       goto filtered;
+      bgp_attr_flush (&new_attr);
+      return "martian or self next-hop;";
     }
 
-  attr_new = bgp_attr_intern (&new_attr);
+  *attr_new = bgp_attr_intern (&new_attr);
+  return NULL;
+}
+
+/* Put an accepted route in the table as peer's path ri on rn, or as a new
+   path if ri is NULL.  Takes over the node lock and the reference on
+   attr_new. */
+static int
+bgp_update_path (struct peer *peer, struct bgp_node *rn, struct bgp_info *ri,
+                 struct prefix *p, u_int32_t addpath_id, struct attr *attr,
+                 struct attr *attr_new, afi_t afi, safi_t safi, int type,
+                 int sub_type, struct prefix_rd *prd, u_char *tag,
+                 struct bgp_route_evpn *evpn)
+{
+  int ret;
+  struct bgp *bgp = peer->bgp;
+  struct bgp_info *new;
+  char pfx_buf[BGP_PRD_PATH_STRLEN];
+  char label_buf[20];
+  int connected = 0;
+#if ENABLE_BGP_VNC
+  int vnc_implicit_withdraw = 0;
+#endif
+
+  label_buf[0] = '\0';
+  if (bgp_labeled_safi(safi))
+    sprintf (label_buf, "label %u", label_pton(tag));
 
   /* If the update is implicit withdraw. */
   if (ri)
@@ -2941,10 +3137,23 @@ bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
 #endif
 
   return 0;
+}
+
+/* This BGP update is filtered.  Log the reason then update BGP entry.
+   Takes over the node lock. */
+static void
+bgp_update_filtered (struct peer *peer, struct bgp_node *rn,
+                     struct bgp_info *ri, struct prefix *p,
+                     u_int32_t addpath_id, afi_t afi, safi_t safi, int type,
+                     struct prefix_rd *prd, u_char *tag, const char *reason)
+{
+  char pfx_buf[BGP_PRD_PATH_STRLEN];
+  char label_buf[20];
+
+  label_buf[0] = '\0';
+  if (bgp_labeled_safi(safi))
+    sprintf (label_buf, "label %u", label_pton(tag));
 
-  /* This BGP update is filtered.  Log the reason then update BGP
-     entry.  */
- filtered:
   if (bgp_debug_update(peer, p, NULL, 1))
     {
       if (!peer->rcvd_attr_printed)
@@ -2974,10 +3183,173 @@ bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
       rfapiProcessWithdraw(peer, NULL, p, prd, NULL, afi, safi, type, 0);
     }
 #endif
+}
 
+int
+bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
+            struct attr *attr, afi_t afi, safi_t safi, int type,
+            int sub_type, struct prefix_rd *prd, u_char *tag,
+            int soft_reconfig, struct bgp_route_evpn* evpn)
+{
+  struct bgp_node *rn;
+  struct bgp *bgp;
+  struct attr *attr_new;
+  struct bgp_info *ri;
+  const char *reason;
+
+  bgp = peer->bgp;
+  rn = bgp_afi_node_get (bgp->rib[afi][safi], afi, safi, p, prd);
+  
+  /* When peer's soft reconfiguration enabled.  Record input packet in
+     Adj-RIBs-In.  */
+  if (! soft_reconfig && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
+      && peer != bgp->peer_self)
+    bgp_adj_in_set (rn, peer, attr, addpath_id);
+
+  /* Check previously received route. */
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && ri->type == type && ri->sub_type == sub_type &&
+        ri->addpath_rx_id == addpath_id)
+      break;
+
+  reason = bgp_update_attr_filter (peer, attr, afi, safi);
+  if (reason)
+    goto filtered;
+
+  /* Apply incoming filter.  */
+  if (bgp_input_filter (peer, p, attr, afi, safi) == FILTER_DENY)
+    {
+      reason = "filter;";
+      goto filtered;
+    }
+
+  reason = bgp_update_modify (peer, p, attr, afi, safi, &attr_new);
+  if (reason)
+    goto filtered;
+
+  return bgp_update_path (peer, rn, ri, p, addpath_id, attr, attr_new, afi,
+                          safi, type, sub_type, prd, tag, evpn);
+
+ filtered:
+  bgp_update_filtered (peer, rn, ri, p, addpath_id, afi, safi, type, prd, tag,
+                       reason);
   return 0;
 }
 
+/* bgp_update() for a batch of prefixes that came in the same UPDATE, and so
+   with the same attributes.  The checks on the attributes alone are done
+   once for the batch, the prefix-list for all of it at once, and where the
+   inbound route-map treats all prefixes alike it is applied, and what
+   comes out of it interned, once too.  The batch's nodes are got together,
+   and bgp_process() puts them all on the same work queue item. */
+#define BGP_UPDATE_BATCH BGP_PLIST_BATCH
+
+static int
+bgp_update_batch (struct peer *peer, struct prefix *prefixes,
+                  u_int32_t *addpath_ids, unsigned int count,
+                  struct attr *attr, afi_t afi, safi_t safi)
+{
+  struct bgp *bgp = peer->bgp;
+  struct bgp_filter *filter = &peer->filter[afi][safi];
+  struct bgp_plist_batch plist;
+  const struct prefix *p[BGP_UPDATE_BATCH];
+  struct prefix *pp[BGP_UPDATE_BATCH];
+  struct bgp_node *nodes[BGP_UPDATE_BATCH];
+  struct attr *attr_new, *shared = NULL;
+  struct bgp_info *ri;
+  const char *attr_reason, *shared_reason = NULL, *reason;
+  unsigned int i;
+  int share;
+  int ret = 0;
+
+  assert (count <= BGP_UPDATE_BATCH);
+
+  for (i = 0; i < count; i++)
+    p[i] = pp[i] = &prefixes[i];
+  bgp_node_get_batch (bgp->rib[afi][safi], p, nodes, count);
+
+  attr_reason = bgp_update_attr_filter (peer, attr, afi, safi);
+  if (attr_reason == NULL
+      && bgp_input_filter_attr (peer, attr, afi, safi) == FILTER_DENY)
+    attr_reason = "filter;";
+
+  /* bgp_prefix_list_apply() picks the results up from here. */
+  bgp_plist_batch_start (&plist, PREFIX_LIST_IN (filter), NULL, NULL, NULL);
+  if (attr_reason == NULL && PREFIX_LIST_IN (filter))
+    {
+      for (i = 0; i < count; i++)
+        prefix_copy (&plist.prefix[i], &prefixes[i]);
+      prefix_list_apply_bulk (plist.plist[0], pp, count, plist.result[0]);
+      plist.count = count;
+    }
+
+  share = (! ROUTE_MAP_IN_NAME (filter) || ! ROUTE_MAP_IN (filter)
+           || route_map_prefix_independent (ROUTE_MAP_IN (filter)));
+
+  for (i = 0; i < count; i++)
+    {
+      /* When peer's soft reconfiguration enabled.  Record input packet in
+         Adj-RIBs-In.  */
+      if (CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
+          && peer != bgp->peer_self)
+        bgp_adj_in_set (nodes[i], peer, attr, addpath_ids[i]);
+
+      /* Check previously received route. */
+      for (ri = nodes[i]->info; ri; ri = ri->next)
+        if (ri->peer == peer && ri->type == ZEBRA_ROUTE_BGP
+            && ri->sub_type == BGP_ROUTE_NORMAL
+            && ri->addpath_rx_id == addpath_ids[i])
+          break;
+
+      reason = attr_reason;
+      plist.pos = i;
+      if (reason == NULL
+          && bgp_input_filter_prefix (peer, &prefixes[i], afi,
+                                      safi) == FILTER_DENY)
+        reason = "filter;";
+
+      if (reason == NULL && shared)
+        attr_new = bgp_attr_refcount (shared);
+      else if (reason == NULL && shared_reason)
+        reason = shared_reason;
+      else if (reason == NULL)
+        {
+          reason = bgp_update_modify (peer, &prefixes[i], attr, afi, safi,
+                                      &attr_new);
+          if (share && reason)
+            shared_reason = reason;
+          else if (share)
+            shared = bgp_attr_refcount (attr_new);
+        }
+
+      if (reason)
+        {
+          bgp_update_filtered (peer, nodes[i], ri, &prefixes[i],
+                               addpath_ids[i], afi, safi, ZEBRA_ROUTE_BGP,
+                               NULL, NULL, reason);
+          continue;
+        }
+
+      ret = bgp_update_path (peer, nodes[i], ri, &prefixes[i], addpath_ids[i],
+                             attr, attr_new, afi, safi, ZEBRA_ROUTE_BGP,
+                             BGP_ROUTE_NORMAL, NULL, NULL, NULL);
+
+      /* Maximum prefix count overflow: the rest of the batch is dropped,
+         as it would have been one prefix at a time. */
+      if (ret < 0)
+        {
+          for (i++; i < count; i++)
+            bgp_unlock_node (nodes[i]);
+          break;
+        }
+    }
+
+  bgp_plist_batch_end (&plist);
+  if (shared)
+    bgp_attr_unintern (&shared);
+  return ret;
+}
+
 int
 bgp_withdraw (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
               struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type,
@@ -3152,6 +3524,17 @@ bgp_announce_route_all (struct peer *peer)
       bgp_announce_route (peer, afi, safi);
 }
 
+static int
+bgp_soft_reconfig_want (struct bgp_node *rn, void *arg)
+{
+  struct bgp_adj_in *ain;
+
+  for (ain = rn->adj_in; ain; ain = ain->next)
+    if (ain->peer == arg)
+      return 1;
+  return 0;
+}
+
 static void
 bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
 			 struct bgp_table *table, struct prefix_rd *prd)
@@ -3159,29 +3542,44 @@ bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
   int ret;
   struct bgp_node *rn;
   struct bgp_adj_in *ain;
+  struct prefix_list *plist;
+  struct bgp_plist_batch batch;
 
   if (! table)
     table = peer->bgp->rib[afi][safi];
 
+  plist = PREFIX_LIST_IN (&peer->filter[afi][safi]);
+  if (plist)
+    bgp_plist_batch_start (&batch, plist, NULL, bgp_soft_reconfig_want, peer);
+
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
-      {
-	if (ain->peer == peer)
-	  {
-	    struct bgp_info *ri = rn->info;
-	    u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+    {
+      if (plist)
+        bgp_plist_batch_node (&batch, rn);
 
-	    ret = bgp_update (peer, &rn->p, ain->addpath_rx_id, ain->attr,
-                              afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
-			      prd, tag, 1, NULL);
+      for (ain = rn->adj_in; ain; ain = ain->next)
+        {
+          if (ain->peer == peer)
+            {
+              struct bgp_info *ri = rn->info;
+              u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
 
-	    if (ret < 0)
-	      {
-		bgp_unlock_node (rn);
-		return;
-	      }
-	  }
-      }
+              ret = bgp_update (peer, &rn->p, ain->addpath_rx_id, ain->attr,
+                                afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+                                prd, tag, 1, NULL);
+
+              if (ret < 0)
+                {
+                  bgp_unlock_node (rn);
+                  goto out;
+                }
+            }
+        }
+    }
+
+out:
+  if (plist)
+    bgp_plist_batch_end (&batch);
 }
 
 void
@@ -3292,105 +3690,56 @@ bgp_clear_node_queue_init (struct peer *peer)
 }
 
 static void
-bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
-                       struct bgp_table *table)
+bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi)
 {
   struct bgp_node *rn;
+  struct bgp_info *ri, *next, *first;
   int force = bm->process_main_queue ? 0 : 1;
-  
-  if (! table)
-    table = peer->bgp->rib[afi][safi];
-  
-  /* If still no table => afi/safi isn't configured at all or smth. */
-  if (! table)
-    return;
-  
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    {
-      struct bgp_info *ri, *next;
-      struct bgp_adj_in *ain;
-      struct bgp_adj_in *ain_next;
-
-      /* XXX:TODO: This is suboptimal, every non-empty route_node is
-       * queued for every clearing peer, regardless of whether it is
-       * relevant to the peer at hand.
-       *
-       * Overview: There are 3 different indices which need to be
-       * scrubbed, potentially, when a peer is removed:
-       *
-       * 1 peer's routes visible via the RIB (ie accepted routes)
-       * 2 peer's routes visible by the (optional) peer's adj-in index
-       * 3 other routes visible by the peer's adj-out index
-       *
-       * 3 there is no hurry in scrubbing, once the struct peer is
-       * removed from bgp->peer, we could just GC such deleted peer's
-       * adj-outs at our leisure.
-       *
-       * 1 and 2 must be 'scrubbed' in some way, at least made
-       * invisible via RIB index before peer session is allowed to be
-       * brought back up. So one needs to know when such a 'search' is
-       * complete.
-       *
-       * Ideally:
-       *
-       * - there'd be a single global queue or a single RIB walker
-       * - rather than tracking which route_nodes still need to be
-       *   examined on a peer basis, we'd track which peers still
-       *   aren't cleared
-       *
-       * Given that our per-peer prefix-counts now should be reliable,
-       * this may actually be achievable. It doesn't seem to be a huge
-       * problem at this time,
-       *
-       * It is possible that we have multiple paths for a prefix from a peer
-       * if that peer is using AddPath.
-       */
-      ain = rn->adj_in;
-      while (ain)
-        {
-          ain_next = ain->next;
 
-          if (ain->peer == peer)
-            {
-              bgp_adj_in_remove (rn, ain);
-              bgp_unlock_node (rn);
-            }
+  /* The peer's own lists have everything of it that needs scrubbing:
+   *
+   * 1 peer's routes visible via the RIB (ie accepted routes)
+   * 2 peer's routes visible by the (optional) peer's adj-in index
+   *
+   * Routes of other peers in the peer's adj-out index are left to be
+   * cleaned up by the update-groups code.
+   */
+  bgp_clear_adj_in (peer, afi, safi);
 
-          ain = ain_next;
+  LIST_FOREACH_SAFE (ri, &peer->routes[afi][safi], peer_thread, next)
+    {
+      rn = ri->net;
+
+      if (force)
+        {
+          bgp_info_reap (rn, ri);
+          continue;
         }
 
-      for (ri = rn->info; ri; ri = next)
-	{
-	  next = ri->next;
-	  if (ri->peer != peer)
-	    continue;
+      /* It is possible that we have multiple paths for a prefix from a
+       * peer if that peer is using AddPath.  bgp_clear_route_node() does
+       * all of them, so queue the node for the first only.
+       */
+      for (first = rn->info; first->peer != peer; first = first->next)
+        ;
+      if (first == ri)
+        {
+          struct bgp_clear_node_queue *cnq;
 
-	  if (force)
-	    bgp_info_reap (rn, ri);
-	  else
-	    {
-	      struct bgp_clear_node_queue *cnq;
-
-	      /* both unlocked in bgp_clear_node_queue_del */
-	      bgp_table_lock (bgp_node_table (rn));
-	      bgp_lock_node (rn);
-	      cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
-			     sizeof (struct bgp_clear_node_queue));
-	      cnq->rn = rn;
-	      work_queue_add (peer->clear_node_queue, cnq);
-	      break;
-	    }
-	}
+          /* both unlocked in bgp_clear_node_queue_del */
+          bgp_table_lock (bgp_node_table (rn));
+          bgp_lock_node (rn);
+          cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
+                         sizeof (struct bgp_clear_node_queue));
+          cnq->rn = rn;
+          work_queue_add (peer->clear_node_queue, cnq);
+        }
     }
-  return;
 }
 
 void
 bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
-
   if (peer->clear_node_queue == NULL)
     bgp_clear_node_queue_init (peer);
   
@@ -3411,19 +3760,15 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi)
    * the unlock will happen upon work-queue completion; other wise, the
    * unlock happens at the end of this function.
    */
-  if (!peer->clear_node_queue->thread)
+  if (!work_queue_is_scheduled (peer->clear_node_queue))
     peer_lock (peer);
 
-  if (safi != SAFI_MPLS_VPN && safi != SAFI_ENCAP && safi != SAFI_EVPN)
-    bgp_clear_route_table (peer, afi, safi, NULL);
-  else
-    for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-         rn = bgp_route_next (rn))
-      if ((table = rn->info) != NULL)
-        bgp_clear_route_table (peer, afi, safi, table);
+  /* The peer's lists cover the per-RD tables of MPLS-VPN, ENCAP and
+   * EVPN as well. */
+  bgp_clear_route_table (peer, afi, safi);
 
   /* unlock if no nodes got added to the clear-node-queue. */
-  if (!peer->clear_node_queue->thread)
+  if (!work_queue_is_scheduled (peer->clear_node_queue))
     peer_unlock (peer);
 
 }
@@ -3446,74 +3791,27 @@ bgp_clear_route_all (struct peer *peer)
 void
 bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_table *table;
-  struct bgp_node *rn;
   struct bgp_adj_in *ain;
   struct bgp_adj_in *ain_next;
+  struct bgp_node *rn;
 
-  table = peer->bgp->rib[afi][safi];
-
-  /* It is possible that we have multiple paths for a prefix from a peer
-   * if that peer is using AddPath.
-   */
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  LIST_FOREACH_SAFE (ain, &peer->adj_in[afi][safi], peer_thread, ain_next)
     {
-      ain = rn->adj_in;
-
-      while (ain)
-        {
-          ain_next = ain->next;
-
-          if (ain->peer == peer)
-            {
-              bgp_adj_in_remove (rn, ain);
-              bgp_unlock_node (rn);
-	    }
-
-          ain = ain_next;
-        }
+      rn = ain->rn;
+      bgp_adj_in_remove (rn, ain);
+      bgp_unlock_node (rn);
     }
 }
 
 void
 bgp_clear_stale_route (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
   struct bgp_info *ri;
-  struct bgp_table *table;
-
-  if ( safi == SAFI_MPLS_VPN)
-    {
-      for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn; rn = bgp_route_next (rn))
-        {
-          struct bgp_node *rm;
-          struct bgp_info *ri;
+  struct bgp_info *next;
 
-          /* look for neighbor in tables */
-          if ((table = rn->info) != NULL)
-            {
-              for (rm = bgp_table_top (table); rm; rm = bgp_route_next (rm))
-                for (ri = rm->info; ri; ri = ri->next)
-                  if (ri->peer == peer)
-                    {
-                      if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-                        bgp_rib_remove (rm, ri, peer, afi, safi);
-                      break;
-                    }
-            }
-        }
-    }
-  else
-    {
-      for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn; rn = bgp_route_next (rn))
-        for (ri = rn->info; ri; ri = ri->next)
-          if (ri->peer == peer)
-            {
-              if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-                bgp_rib_remove (rn, ri, peer, afi, safi);
-              break;
-            }
-    }
+  LIST_FOREACH_SAFE (ri, &peer->routes[afi][safi], peer_thread, next)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+      bgp_rib_remove (ri->net, ri, peer, afi, safi);
 }
 
 static void
@@ -3630,6 +3928,9 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
   safi_t safi;
   int addpath_encoded;
   u_int32_t addpath_id;
+  struct prefix prefixes[BGP_UPDATE_BATCH];
+  u_int32_t addpath_ids[BGP_UPDATE_BATCH];
+  unsigned int count = 0;
 
   /* Check peer status. */
   if (peer->status != Established)
@@ -3655,7 +3956,7 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
 
           /* When packet overflow occurs return immediately. */
           if (pnt + BGP_ADDPATH_ID_LEN > lim)
-            return -1;
+            goto malformed;
 
           addpath_id = ntohl(*((uint32_t*) pnt));
           pnt += BGP_ADDPATH_ID_LEN;
@@ -3671,7 +3972,7 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
         {
           zlog_err("%s [Error] Update packet error (wrong perfix length %d for afi %u)",
                    peer->host, p.prefixlen, packet->afi);
-          return -1;
+          goto malformed;
         }
 
       /* Packet size overflow check. */
@@ -3682,7 +3983,7 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
         {
           zlog_err("%s [Error] Update packet error (prefix length %d overflows packet)",
                    peer->host, p.prefixlen);
-          return -1;
+          goto malformed;
         }
 
       /* Defensive coding, double-check the psize fits in a struct prefix */
@@ -3690,7 +3991,7 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
         {
           zlog_err("%s [Error] Update packet error (prefix length %d too large for prefix storage %zu)",
                    peer->host, p.prefixlen, sizeof(p.u));
-          return -1;
+          goto malformed;
         }
 
       /* Fetch prefix from NLRI packet. */
@@ -3736,10 +4037,17 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
 	    }
 	}
 
-      /* Normal process. */
+      /* Normal process.  Updates are gathered up and done in batches. */
       if (attr)
-	ret = bgp_update (peer, &p, addpath_id, attr, afi, safi,
-			  ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 0, NULL);
+	{
+	  prefixes[count] = p;
+	  addpath_ids[count] = addpath_id;
+	  if (++count < BGP_UPDATE_BATCH)
+	    continue;
+	  ret = bgp_update_batch (peer, prefixes, addpath_ids, count, attr,
+				  afi, safi);
+	  count = 0;
+	}
       else
 	ret = bgp_withdraw (peer, &p, addpath_id, attr, afi, safi,
 			    ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, NULL);
@@ -3750,6 +4058,10 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
 	return -1;
     }
 
+  if (count && bgp_update_batch (peer, prefixes, addpath_ids, count, attr,
+				 afi, safi) < 0)
+    return -1;
+
   /* Packet length consistency check. */
   if (pnt != lim)
     {
@@ -3759,6 +4071,12 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
     }
 
   return 0;
+
+ malformed:
+  /* The prefixes before the bad one still count, as they always have. */
+  if (count)
+    bgp_update_batch (peer, prefixes, addpath_ids, count, attr, afi, safi);
+  return -1;
 }
 
 static struct bgp_static *
@@ -9702,7 +10020,7 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
         }
       else
         {
-          for (adj = rn->adj_out; adj; adj = adj->next)
+          RB_FOREACH (adj, bgp_adj_out_rb, &rn->adj_out)
             SUBGRP_FOREACH_PEER(adj->subgroup, paf)
               if (paf->peer == peer)
                 {
@@ -22,9 +22,11 @@
 #define _QUAGGA_BGP_ROUTE_H
 
 #include "queue.h"
+#include "plist.h"
 #include "bgp_table.h"
 
 struct bgp_nexthop_cache;
+struct bgp_maxpaths_cfg;
 struct bgp_route_evpn;
 
 enum bgp_show_type
@@ -110,6 +112,9 @@ struct bgp_info
   /* For nexthop linked list */
   LIST_ENTRY(bgp_info) nh_thread;
 
+  /* For the peer's list of paths */
+  LIST_ENTRY(bgp_info) peer_thread;
+
   /* Back pointer to the prefix node */
   struct bgp_node *net;
 
@@ -272,6 +277,30 @@ enum bgp_path_type
   BGP_PATH_MULTIPATH
 };
 
+/* Prefix-list results for the nodes a table walk is about to get to,
+ * worked out a batch at a time with prefix_list_apply_bulk().  While the
+ * walk is under way, the filters take their answers from it instead of
+ * applying the lists to one prefix after another. */
+#define BGP_PLIST_BATCH       256
+#define BGP_PLIST_BATCH_LISTS 2
+
+struct bgp_plist_batch
+{
+  struct prefix_list *plist[BGP_PLIST_BATCH_LISTS];
+
+  /* Which of the nodes ahead the walk is going to want filtered. */
+  int (*want) (struct bgp_node *, void *);
+  void *arg;
+
+  struct prefix prefix[BGP_PLIST_BATCH];
+  enum prefix_list_type result[BGP_PLIST_BATCH_LISTS][BGP_PLIST_BATCH];
+  unsigned int count;
+  unsigned int pos;
+
+  /* Walks within walks. */
+  struct bgp_plist_batch *prev;
+};
+
 static inline void
 bgp_bump_version (struct bgp_node *node)
 {
@@ -298,6 +327,12 @@ extern void bgp_stop_announce_route_timer(struct peer_af *paf);
 extern void bgp_announce_route_all (struct peer *);
 extern void bgp_default_originate (struct peer *, afi_t, safi_t, int);
 extern void bgp_soft_reconfig_in (struct peer *, afi_t, safi_t);
+extern void bgp_plist_batch_start (struct bgp_plist_batch *,
+                                   struct prefix_list *, struct prefix_list *,
+                                   int (*want) (struct bgp_node *, void *),
+                                   void *arg);
+extern void bgp_plist_batch_node (struct bgp_plist_batch *, struct bgp_node *);
+extern void bgp_plist_batch_end (struct bgp_plist_batch *);
 extern void bgp_clear_route (struct peer *, afi_t, safi_t);
 extern void bgp_clear_route_all (struct peer *);
 extern void bgp_clear_adj_in (struct peer *, afi_t, safi_t);
@@ -317,6 +352,10 @@ extern void bgp_info_path_with_addpath_rx_str (struct bgp_info *ri, char *buf);
 
 extern int bgp_nlri_parse_ip (struct peer *, struct attr *, struct bgp_nlri *);
 
+extern struct bgp_info *bgp_best_path (struct bgp *, struct bgp_node *,
+                                       struct bgp_maxpaths_cfg *, int debug,
+                                       const char *pfx_buf);
+
 extern int bgp_maximum_prefix_overflow (struct peer *, afi_t, safi_t, int);
 
 extern void bgp_redistribute_add (struct bgp *, struct prefix *, const struct in_addr *,
@@ -367,6 +406,10 @@ extern void bgp_aggregate_increment (struct bgp *, struct prefix *, struct bgp_i
 extern void bgp_aggregate_decrement (struct bgp *, struct prefix *, struct bgp_info *,
 			      afi_t, safi_t);
 
+extern route_map_result_t bgp_route_map_apply (struct route_map *,
+                                               struct prefix *,
+                                               struct bgp_info *);
+
 extern u_char bgp_distance_apply (struct prefix *, struct bgp_info *, afi_t, safi_t, struct bgp *);
 
 extern afi_t bgp_node_afi (struct vty *);
@@ -233,6 +233,34 @@ route_aspath_free (void *rule)
   aspath_free (aspath);
 }
 
+/* Lists named by match clauses, compiled by route_map_list_ref_compile(),
+   are looked up again only after the configuration has changed. */
+static struct access_list *
+route_match_access_list (void *rule, afi_t afi)
+{
+  struct route_map_list_ref *ref = rule;
+
+  if (ref->generation != route_map_generation ())
+    {
+      ref->list = access_list_lookup (afi, ref->name);
+      ref->generation = route_map_generation ();
+    }
+  return ref->list;
+}
+
+static struct prefix_list *
+route_match_prefix_list (void *rule, afi_t afi)
+{
+  struct route_map_list_ref *ref = rule;
+
+  if (ref->generation != route_map_generation ())
+    {
+      ref->list = prefix_list_lookup (afi, ref->name);
+      ref->generation = route_map_generation ();
+    }
+  return ref->list;
+}
+
  /* 'match peer (A.B.C.D|X:X::X:X)' */
 
 /* Compares the peer specified in the 'match peer' clause with the peer
@@ -323,7 +351,8 @@ struct route_map_rule_cmd route_match_peer_cmd =
   "peer",
   route_match_peer,
   route_match_peer_compile,
-  route_match_peer_free
+  route_match_peer_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `match ip address IP_ACCESS_LIST' */
@@ -339,7 +368,7 @@ route_match_ip_address (void *rule, struct prefix *prefix,
 
   if (type == RMAP_BGP)
     {
-      alist = access_list_lookup (AFI_IP, (char *) rule);
+      alist = route_match_access_list (rule, AFI_IP);
       if (alist == NULL)
 	return RMAP_NOMATCH;
 
@@ -349,28 +378,14 @@ route_match_ip_address (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-/* Route map `ip address' match statement.  `arg' should be
-   access-list name. */
-static void *
-route_match_ip_address_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-/* Free route map's compiled `ip address' value. */
-static void
-route_match_ip_address_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for ip address matching. */
 struct route_map_rule_cmd route_match_ip_address_cmd =
 {
   "ip address",
   route_match_ip_address,
-  route_match_ip_address_compile,
-  route_match_ip_address_free
+  route_map_list_ref_compile,
+  route_map_list_ref_free,
+  RMAP_RULE_CACHEABLE
 };
 
 /* `match ip next-hop IP_ADDRESS' */
@@ -391,7 +406,7 @@ route_match_ip_next_hop (void *rule, struct prefix *prefix,
       p.prefix = bgp_info->attr->nexthop;
       p.prefixlen = IPV4_MAX_BITLEN;
 
-      alist = access_list_lookup (AFI_IP, (char *) rule);
+      alist = route_match_access_list (rule, AFI_IP);
       if (alist == NULL)
 	return RMAP_NOMATCH;
 
@@ -401,28 +416,14 @@ route_match_ip_next_hop (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-/* Route map `ip next-hop' match statement. `arg' is
-   access-list name. */
-static void *
-route_match_ip_next_hop_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-/* Free route map's compiled `ip address' value. */
-static void
-route_match_ip_next_hop_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for ip next-hop matching. */
 struct route_map_rule_cmd route_match_ip_next_hop_cmd =
 {
   "ip next-hop",
   route_match_ip_next_hop,
-  route_match_ip_next_hop_compile,
-  route_match_ip_next_hop_free
+  route_map_list_ref_compile,
+  route_map_list_ref_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 /* `match ip route-source ACCESS-LIST' */
@@ -449,7 +450,7 @@ route_match_ip_route_source (void *rule, struct prefix *prefix,
       p.prefix = peer->su.sin.sin_addr;
       p.prefixlen = IPV4_MAX_BITLEN;
 
-      alist = access_list_lookup (AFI_IP, (char *) rule);
+      alist = route_match_access_list (rule, AFI_IP);
       if (alist == NULL)
 	return RMAP_NOMATCH;
 
@@ -459,28 +460,14 @@ route_match_ip_route_source (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-/* Route map `ip route-source' match statement. `arg' is
-   access-list name. */
-static void *
-route_match_ip_route_source_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-/* Free route map's compiled `ip address' value. */
-static void
-route_match_ip_route_source_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for ip route-source matching. */
 struct route_map_rule_cmd route_match_ip_route_source_cmd =
 {
   "ip route-source",
   route_match_ip_route_source,
-  route_match_ip_route_source_compile,
-  route_match_ip_route_source_free
+  route_map_list_ref_compile,
+  route_map_list_ref_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `match ip address prefix-list PREFIX_LIST' */
@@ -493,7 +480,7 @@ route_match_ip_address_prefix_list (void *rule, struct prefix *prefix,
 
   if (type == RMAP_BGP)
     {
-      plist = prefix_list_lookup (AFI_IP, (char *) rule);
+      plist = route_match_prefix_list (rule, AFI_IP);
       if (plist == NULL)
 	return RMAP_NOMATCH;
 
@@ -503,24 +490,13 @@ route_match_ip_address_prefix_list (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ip_address_prefix_list_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ip_address_prefix_list_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 struct route_map_rule_cmd route_match_ip_address_prefix_list_cmd =
 {
   "ip address prefix-list",
   route_match_ip_address_prefix_list,
-  route_match_ip_address_prefix_list_compile,
-  route_match_ip_address_prefix_list_free
+  route_map_list_ref_compile,
+  route_map_list_ref_free,
+  RMAP_RULE_CACHEABLE
 };
 
 /* `match ip next-hop prefix-list PREFIX_LIST' */
@@ -540,7 +516,7 @@ route_match_ip_next_hop_prefix_list (void *rule, struct prefix *prefix,
       p.prefix = bgp_info->attr->nexthop;
       p.prefixlen = IPV4_MAX_BITLEN;
 
-      plist = prefix_list_lookup (AFI_IP, (char *) rule);
+      plist = route_match_prefix_list (rule, AFI_IP);
       if (plist == NULL)
         return RMAP_NOMATCH;
 
@@ -550,24 +526,13 @@ route_match_ip_next_hop_prefix_list (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ip_next_hop_prefix_list_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ip_next_hop_prefix_list_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 struct route_map_rule_cmd route_match_ip_next_hop_prefix_list_cmd =
 {
   "ip next-hop prefix-list",
   route_match_ip_next_hop_prefix_list,
-  route_match_ip_next_hop_prefix_list_compile,
-  route_match_ip_next_hop_prefix_list_free
+  route_map_list_ref_compile,
+  route_map_list_ref_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 /* `match ip route-source prefix-list PREFIX_LIST' */
@@ -593,7 +558,7 @@ route_match_ip_route_source_prefix_list (void *rule, struct prefix *prefix,
       p.prefix = peer->su.sin.sin_addr;
       p.prefixlen = IPV4_MAX_BITLEN;
 
-      plist = prefix_list_lookup (AFI_IP, (char *) rule);
+      plist = route_match_prefix_list (rule, AFI_IP);
       if (plist == NULL)
         return RMAP_NOMATCH;
 
@@ -603,24 +568,13 @@ route_match_ip_route_source_prefix_list (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ip_route_source_prefix_list_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ip_route_source_prefix_list_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 struct route_map_rule_cmd route_match_ip_route_source_prefix_list_cmd =
 {
   "ip route-source prefix-list",
   route_match_ip_route_source_prefix_list,
-  route_match_ip_route_source_prefix_list_compile,
-  route_match_ip_route_source_prefix_list_free
+  route_map_list_ref_compile,
+  route_map_list_ref_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `match local-preference LOCAL-PREF' */
@@ -686,7 +640,8 @@ struct route_map_rule_cmd route_match_local_pref_cmd =
   "local-preference",
   route_match_local_pref,
   route_match_local_pref_compile,
-  route_match_local_pref_free
+  route_match_local_pref_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 /* `match metric METRIC' */
@@ -715,6 +670,7 @@ struct route_map_rule_cmd route_match_metric_cmd =
   route_match_metric,
   route_value_compile,
   route_value_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 /* `match as-path ASPATH' */
@@ -762,7 +718,8 @@ struct route_map_rule_cmd route_match_aspath_cmd =
   "as-path",
   route_match_aspath,
   route_match_aspath_compile,
-  route_match_aspath_free
+  route_match_aspath_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 /* `match community COMMUNIY' */
@@ -846,7 +803,8 @@ struct route_map_rule_cmd route_match_community_cmd =
   "community",
   route_match_community,
   route_match_community_compile,
-  route_match_community_free
+  route_match_community_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 /* Match function for lcommunity match. */
@@ -917,7 +875,8 @@ struct route_map_rule_cmd route_match_lcommunity_cmd =
   "large-community",
   route_match_lcommunity,
   route_match_lcommunity_compile,
-  route_match_lcommunity_free
+  route_match_lcommunity_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 
@@ -967,7 +926,8 @@ struct route_map_rule_cmd route_match_ecommunity_cmd =
   "extcommunity",
   route_match_ecommunity,
   route_match_ecommunity_compile,
-  route_match_ecommunity_free
+  route_match_ecommunity_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 /* `match nlri` and `set nlri` are replaced by `address-family ipv4`
@@ -1023,7 +983,8 @@ struct route_map_rule_cmd route_match_origin_cmd =
   "origin",
   route_match_origin,
   route_match_origin_compile,
-  route_match_origin_free
+  route_match_origin_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 /* match probability  { */
@@ -1129,7 +1090,8 @@ struct route_map_rule_cmd route_match_interface_cmd =
   "interface",
   route_match_interface,
   route_match_interface_compile,
-  route_match_interface_free
+  route_match_interface_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* } */
@@ -1166,6 +1128,7 @@ static struct route_map_rule_cmd route_match_tag_cmd =
   route_match_tag,
   route_map_rule_tag_compile,
   route_map_rule_tag_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 
@@ -1283,7 +1246,8 @@ struct route_map_rule_cmd route_set_ip_nexthop_cmd =
   "ip next-hop",
   route_set_ip_nexthop,
   route_set_ip_nexthop_compile,
-  route_set_ip_nexthop_free
+  route_set_ip_nexthop_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set local-preference LOCAL_PREF' */
@@ -1321,6 +1285,7 @@ struct route_map_rule_cmd route_set_local_pref_cmd =
   route_set_local_pref,
   route_value_compile,
   route_value_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set weight WEIGHT' */
@@ -1358,6 +1323,7 @@ struct route_map_rule_cmd route_set_weight_cmd =
   route_set_weight,
   route_value_compile,
   route_value_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set metric METRIC' */
@@ -1393,6 +1359,7 @@ struct route_map_rule_cmd route_set_metric_cmd =
   route_set_metric,
   route_value_compile,
   route_value_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set as-path prepend ASPATH' */
@@ -1458,6 +1425,7 @@ struct route_map_rule_cmd route_set_aspath_prepend_cmd =
   route_set_aspath_prepend,
   route_set_aspath_prepend_compile,
   route_set_aspath_prepend_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set as-path exclude ASn' */
@@ -1492,6 +1460,7 @@ struct route_map_rule_cmd route_set_aspath_exclude_cmd =
   route_set_aspath_exclude,
   route_aspath_compile,
   route_aspath_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set community COMMUNITY' */
@@ -1616,6 +1585,7 @@ struct route_map_rule_cmd route_set_community_cmd =
   route_set_community,
   route_set_community_compile,
   route_set_community_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set community COMMUNITY' */
@@ -1743,6 +1713,7 @@ struct route_map_rule_cmd route_set_lcommunity_cmd =
   route_set_lcommunity,
   route_set_lcommunity_compile,
   route_set_lcommunity_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set large-comm-list (<1-99>|<100-500>|WORD) delete' */
@@ -1833,6 +1804,7 @@ struct route_map_rule_cmd route_set_lcommunity_delete_cmd =
   route_set_lcommunity_delete,
   route_set_lcommunity_delete_compile,
   route_set_lcommunity_delete_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 
@@ -1923,6 +1895,7 @@ struct route_map_rule_cmd route_set_community_delete_cmd =
   route_set_community_delete,
   route_set_community_delete_compile,
   route_set_community_delete_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set extcommunity rt COMMUNITY' */
@@ -1995,6 +1968,7 @@ struct route_map_rule_cmd route_set_ecommunity_rt_cmd =
   route_set_ecommunity,
   route_set_ecommunity_rt_compile,
   route_set_ecommunity_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set extcommunity soo COMMUNITY' */
@@ -2019,6 +1993,7 @@ struct route_map_rule_cmd route_set_ecommunity_soo_cmd =
   route_set_ecommunity,
   route_set_ecommunity_soo_compile,
   route_set_ecommunity_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set origin ORIGIN' */
@@ -2073,6 +2048,7 @@ struct route_map_rule_cmd route_set_origin_cmd =
   route_set_origin,
   route_set_origin_compile,
   route_set_origin_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set atomic-aggregate' */
@@ -2114,6 +2090,7 @@ struct route_map_rule_cmd route_set_atomic_aggregate_cmd =
   route_set_atomic_aggregate,
   route_set_atomic_aggregate_compile,
   route_set_atomic_aggregate_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set aggregator as AS A.B.C.D' */
@@ -2173,6 +2150,7 @@ struct route_map_rule_cmd route_set_aggregator_as_cmd =
   route_set_aggregator_as,
   route_set_aggregator_as_compile,
   route_set_aggregator_as_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* Set tag to object. object must be pointer to struct bgp_info */
@@ -2205,6 +2183,7 @@ static struct route_map_rule_cmd route_set_tag_cmd =
   route_set_tag,
   route_map_rule_tag_compile,
   route_map_rule_tag_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 
@@ -2218,7 +2197,7 @@ route_match_ipv6_address (void *rule, struct prefix *prefix,
 
   if (type == RMAP_BGP)
     {
-      alist = access_list_lookup (AFI_IP6, (char *) rule);
+      alist = route_match_access_list (rule, AFI_IP6);
       if (alist == NULL)
 	return RMAP_NOMATCH;
 
@@ -2228,25 +2207,14 @@ route_match_ipv6_address (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ipv6_address_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ipv6_address_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for ip address matching. */
 struct route_map_rule_cmd route_match_ipv6_address_cmd =
 {
   "ipv6 address",
   route_match_ipv6_address,
-  route_match_ipv6_address_compile,
-  route_match_ipv6_address_free
+  route_map_list_ref_compile,
+  route_map_list_ref_free,
+  RMAP_RULE_CACHEABLE
 };
 
 /* `match ipv6 next-hop IP_ADDRESS' */
@@ -2307,7 +2275,8 @@ struct route_map_rule_cmd route_match_ipv6_next_hop_cmd =
   "ipv6 next-hop",
   route_match_ipv6_next_hop,
   route_match_ipv6_next_hop_compile,
-  route_match_ipv6_next_hop_free
+  route_match_ipv6_next_hop_free,
+  RMAP_RULE_CACHEABLE | RMAP_RULE_NO_PREFIX
 };
 
 /* `match ipv6 address prefix-list PREFIX_LIST' */
@@ -2320,7 +2289,7 @@ route_match_ipv6_address_prefix_list (void *rule, struct prefix *prefix,
 
   if (type == RMAP_BGP)
     {
-      plist = prefix_list_lookup (AFI_IP6, (char *) rule);
+      plist = route_match_prefix_list (rule, AFI_IP6);
       if (plist == NULL)
 	return RMAP_NOMATCH;
 
@@ -2330,24 +2299,13 @@ route_match_ipv6_address_prefix_list (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ipv6_address_prefix_list_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ipv6_address_prefix_list_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 struct route_map_rule_cmd route_match_ipv6_address_prefix_list_cmd =
 {
   "ipv6 address prefix-list",
   route_match_ipv6_address_prefix_list,
-  route_match_ipv6_address_prefix_list_compile,
-  route_match_ipv6_address_prefix_list_free
+  route_map_list_ref_compile,
+  route_map_list_ref_free,
+  RMAP_RULE_CACHEABLE
 };
 
 /* `set ipv6 nexthop global IP_ADDRESS' */
@@ -2414,7 +2372,8 @@ struct route_map_rule_cmd route_set_ipv6_nexthop_global_cmd =
   "ipv6 next-hop global",
   route_set_ipv6_nexthop_global,
   route_set_ipv6_nexthop_global_compile,
-  route_set_ipv6_nexthop_global_free
+  route_set_ipv6_nexthop_global_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* Set next-hop preference value. */
@@ -2475,7 +2434,8 @@ struct route_map_rule_cmd route_set_ipv6_nexthop_prefer_global_cmd =
   "ipv6 next-hop prefer-global",
   route_set_ipv6_nexthop_prefer_global,
   route_set_ipv6_nexthop_prefer_global_compile,
-  route_set_ipv6_nexthop_prefer_global_free
+  route_set_ipv6_nexthop_prefer_global_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set ipv6 nexthop local IP_ADDRESS' */
@@ -2542,7 +2502,8 @@ struct route_map_rule_cmd route_set_ipv6_nexthop_local_cmd =
   "ipv6 next-hop local",
   route_set_ipv6_nexthop_local,
   route_set_ipv6_nexthop_local_compile,
-  route_set_ipv6_nexthop_local_free
+  route_set_ipv6_nexthop_local_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set ipv6 nexthop peer-address' */
@@ -2629,7 +2590,8 @@ struct route_map_rule_cmd route_set_ipv6_nexthop_peer_cmd =
   "ipv6 next-hop peer-address",
   route_set_ipv6_nexthop_peer,
   route_set_ipv6_nexthop_peer_compile,
-  route_set_ipv6_nexthop_peer_free
+  route_set_ipv6_nexthop_peer_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set ip vpn nexthop A.B.C.D' */
@@ -2727,7 +2689,8 @@ struct route_map_rule_cmd route_set_vpnv4_nexthop_cmd =
   "ip vpn next-hop",
   route_set_vpnv4_nexthop,
   route_set_vpnv4_nexthop_compile,
-  route_set_vpn_nexthop_free
+  route_set_vpn_nexthop_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* Route map commands for ip nexthop set. */
@@ -2736,7 +2699,8 @@ struct route_map_rule_cmd route_set_vpnv6_nexthop_cmd =
   "ipv6 vpn next-hop",
   route_set_vpnv6_nexthop,
   route_set_vpnv6_nexthop_compile,
-  route_set_vpn_nexthop_free
+  route_set_vpn_nexthop_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* `set originator-id' */
@@ -2794,6 +2758,7 @@ struct route_map_rule_cmd route_set_originator_id_cmd =
   route_set_originator_id,
   route_set_originator_id_compile,
   route_set_originator_id_free,
+  RMAP_RULE_NO_PREFIX
 };
 
 /* Add bgp route map rule. */
@@ -4478,11 +4443,42 @@ DEFUN (no_set_originator_id,
 }
 
 
+/* route_map_apply_cached() keys bgpd's route maps on the interned
+   attribute, which it holds on to while the result is cached. */
+static void
+bgp_route_map_cache_hold (void *key)
+{
+  bgp_attr_intern (key);
+}
+
+static void
+bgp_route_map_cache_release (void *key)
+{
+  struct attr *attr = key;
+
+  bgp_attr_unintern (&attr);
+}
+
+/* Apply map to info, reusing an earlier result if the map only looks at
+   the prefix and attributes, and info->attr is the same as an interned
+   attribute it has seen with this prefix before. */
+route_map_result_t
+bgp_route_map_apply (struct route_map *map, struct prefix *p,
+                     struct bgp_info *info)
+{
+  if (route_map_cacheable (map))
+    return route_map_apply_cached (map, p, RMAP_BGP, info,
+                                   bgp_attr_lookup (info->attr));
+  return route_map_apply (map, p, RMAP_BGP, info);
+}
+
 /* Initialization of route map. */
 void
 bgp_route_map_init (void)
 {
   route_map_init ();
+  route_map_cache_key_hooks (bgp_route_map_cache_hold,
+                             bgp_route_map_cache_release);
 
   route_map_add_hook (bgp_route_map_add);
   route_map_delete_hook (bgp_route_map_delete);
@@ -4657,5 +4653,6 @@ bgp_route_map_terminate (void)
   route_map_delete_hook (NULL);
   route_map_event_hook (NULL);
   route_map_finish();
+  route_map_cache_key_hooks (NULL, NULL);
 
 }
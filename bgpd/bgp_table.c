@@ -30,6 +30,8 @@
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
 
+DEFINE_MTYPE_SLAB(BGPD, BGP_NODE, "BGP node", sizeof (struct bgp_node))
+
 void
 bgp_table_lock (struct bgp_table *rt)
 {
@@ -98,7 +100,8 @@ bgp_node_destroy (route_table_delegate_t *delegate,
  */
 route_table_delegate_t bgp_table_delegate = {
   .create_node = bgp_node_create,
-  .destroy_node = bgp_node_destroy
+  .destroy_node = bgp_node_destroy,
+  .stride = ROUTE_TABLE_STRIDE_DEFAULT
 };
 
 /*
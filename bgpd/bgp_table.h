@@ -23,6 +23,8 @@
 
 #include "table.h"
 
+#include "bgpd/bgp_advertise.h"
+
 struct bgp_table
 {
   /* afi/safi of this table */
@@ -50,7 +52,7 @@ struct bgp_node
    */
   ROUTE_NODE_FIELDS
 
-  struct bgp_adj_out *adj_out;
+  struct bgp_adj_out_rb adj_out;
 
   struct bgp_adj_in *adj_in;
 
@@ -189,6 +191,18 @@ bgp_node_get (struct bgp_table *const table, struct prefix *p)
   return bgp_node_from_rnode (route_node_get (table->route_table, p));
 }
 
+/*
+ * bgp_node_get_batch
+ */
+static inline void
+bgp_node_get_batch (struct bgp_table *const table,
+		    const struct prefix * const *p, struct bgp_node **nodes,
+		    unsigned int count)
+{
+  route_node_get_batch (table->route_table, p, (struct route_node **) nodes,
+			count);
+}
+
 /*
  * bgp_node_lookup
  */
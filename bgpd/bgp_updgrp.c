@@ -1217,7 +1217,7 @@ update_subgroup_copy_packets (struct update_subgroup *dest,
   count = 0;
   while (pkt && pkt->buffer)
     {
-      bpacket_queue_add (SUBGRP_PKTQ (dest), stream_dup (pkt->buffer),
+      bpacket_queue_add (SUBGRP_PKTQ (dest), stream_ref (pkt->buffer),
 			 &pkt->arr);
       count++;
       pkt = bpacket_next (pkt);
@@ -1926,8 +1926,7 @@ subgroup_trigger_write (struct update_subgroup *subgrp)
     {
       if (paf->peer->status == Established)
         {
-	  BGP_PEER_WRITE_ON (paf->peer->t_write, bgp_write, paf->peer->fd,
-                            paf->peer);
+	  BGP_UPDGRP_PACKETS_ON (paf->peer);
         }
     }
 }
@@ -59,7 +59,6 @@ static inline struct bgp_adj_out *
 adj_lookup (struct bgp_node *rn, struct update_subgroup *subgrp,
             u_int32_t addpath_tx_id)
 {
-  struct bgp_adj_out *adj;
   struct peer *peer;
   afi_t afi;
   safi_t safi;
@@ -75,25 +74,7 @@ adj_lookup (struct bgp_node *rn, struct update_subgroup *subgrp,
 
   /* update-groups that do not support addpath will pass 0 for
    * addpath_tx_id so do not both matching against it */
-  for (adj = rn->adj_out; adj; adj = adj->next)
-    {
-      if (adj->subgroup == subgrp)
-        {
-          if (addpath_capable)
-            {
-              if (adj->addpath_tx_id == addpath_tx_id)
-                {
-                  break;
-                }
-            }
-          else
-            {
-              break;
-            }
-        }
-    }
-
-  return adj;
+  return bgp_adj_out_find (rn, subgrp, addpath_tx_id, !addpath_capable);
 }
 
 static void
@@ -136,24 +117,22 @@ group_announce_route_walkcb (struct update_group *updgrp, void *arg)
             {
               /* Look through all of the paths we have advertised for this rn and
                * send a withdraw for the ones that are no longer present */
-              for (adj = ctx->rn->adj_out; adj; adj = adj_next)
+              for (adj = bgp_adj_out_find (ctx->rn, subgrp, 0, 1);
+                   adj && adj->subgroup == subgrp; adj = adj_next)
                 {
-                  adj_next = adj->next;
+                  adj_next = RB_NEXT (bgp_adj_out_rb, &ctx->rn->adj_out, adj);
 
-                  if (adj->subgroup == subgrp)
+                  for (ri = ctx->rn->info; ri; ri = ri->next)
                     {
-                      for (ri = ctx->rn->info; ri; ri = ri->next)
+                      if (ri->addpath_tx_id == adj->addpath_tx_id)
                         {
-                          if (ri->addpath_tx_id == adj->addpath_tx_id)
-                            {
-                              break;
-                            }
+                          break;
                         }
+                    }
 
-                      if (!ri)
-                        {
-                          subgroup_process_announce_selected (subgrp, NULL, ctx->rn, adj->addpath_tx_id);
-                        }
+                  if (!ri)
+                    {
+                      subgroup_process_announce_selected (subgrp, NULL, ctx->rn, adj->addpath_tx_id);
                     }
                 }
 
@@ -183,14 +162,10 @@ group_announce_route_walkcb (struct update_group *updgrp, void *arg)
                 {
                   /* Find the addpath_tx_id of the path we had advertised and
                    * send a withdraw */
-                  for (adj = ctx->rn->adj_out; adj; adj = adj_next)
+                  adj = bgp_adj_out_find (ctx->rn, subgrp, 0, 1);
+                  if (adj)
                     {
-                      adj_next = adj->next;
-
-                      if (adj->subgroup == subgrp)
-                        {
-                          subgroup_process_announce_selected (subgrp, NULL, ctx->rn, adj->addpath_tx_id);
-                        }
+                      subgroup_process_announce_selected (subgrp, NULL, ctx->rn, adj->addpath_tx_id);
                     }
                 }
             }
@@ -221,8 +196,9 @@ subgrp_show_adjq_vty (struct update_subgroup *subgrp, struct vty *vty,
   output_count = 0;
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (adj = rn->adj_out; adj; adj = adj->next)
-      if (adj->subgroup == subgrp)
+    for (adj = bgp_adj_out_find (rn, subgrp, 0, 1);
+         adj && adj->subgroup == subgrp;
+         adj = RB_NEXT (bgp_adj_out_rb, &rn->adj_out, adj))
 	{
 	  if (header1)
 	    {
@@ -375,14 +351,14 @@ bgp_adj_out_alloc (struct update_subgroup *subgrp, struct bgp_node *rn,
 
   adj = XCALLOC (MTYPE_BGP_ADJ_OUT, sizeof (struct bgp_adj_out));
   adj->subgroup = subgrp;
+  adj->addpath_tx_id = addpath_tx_id;
   if (rn)
     {
-      BGP_ADJ_OUT_ADD (rn, adj);
+      RB_INSERT (bgp_adj_out_rb, &rn->adj_out, adj);
       bgp_lock_node (rn);
       adj->rn = rn;
     }
 
-  adj->addpath_tx_id = addpath_tx_id;
   TAILQ_INSERT_TAIL (&(subgrp->adjq), adj, subgrp_adj_train);
   SUBGRP_INCR_STAT (subgrp, adj_count);
   return adj;
@@ -535,7 +511,7 @@ bgp_adj_out_unset_subgroup (struct bgp_node *rn,
       else
         {
           /* Remove myself from adjacency. */
-          BGP_ADJ_OUT_DEL (rn, adj);
+          RB_REMOVE (bgp_adj_out_rb, &rn->adj_out, adj);
 
           /* Free allocated information.  */
           adj_free (adj);
@@ -557,7 +533,7 @@ bgp_adj_out_remove_subgroup (struct bgp_node *rn, struct bgp_adj_out *adj,
   if (adj->adv)
     bgp_advertise_clean_subgroup (subgrp, adj);
 
-  BGP_ADJ_OUT_DEL (rn, adj);
+  RB_REMOVE (bgp_adj_out_rb, &rn->adj_out, adj);
   adj_free (adj);
 }
 
@@ -578,6 +554,12 @@ subgroup_clear_table (struct update_subgroup *subgrp)
   }
 }
 
+static int
+subgroup_announce_want (struct bgp_node *rn, void *arg)
+{
+  return rn->info != NULL;
+}
+
 /*
  * subgroup_announce_table
  */
@@ -593,6 +575,8 @@ subgroup_announce_table (struct update_subgroup *subgrp,
   afi_t afi;
   safi_t safi;
   int addpath_capable;
+  struct prefix_list *plist, *orf_plist;
+  struct bgp_plist_batch batch;
 
   peer = SUBGRP_PEER (subgrp);
   afi = SUBGRP_AFI (subgrp);
@@ -611,17 +595,31 @@ subgroup_announce_table (struct update_subgroup *subgrp,
   /* It's initialized in bgp_announce_check() */
   attr.extra = &extra;
 
+  /* The outbound prefix-lists go over the table a batch at a time. */
+  plist = PREFIX_LIST_OUT (&peer->filter[afi][safi]);
+  orf_plist = peer->orf_plist[afi][safi];
+  if (plist || orf_plist)
+    bgp_plist_batch_start (&batch, plist, orf_plist, subgroup_announce_want,
+                           NULL);
+
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ri = rn->info; ri; ri = ri->next)
+    {
+      if (plist || orf_plist)
+        bgp_plist_batch_node (&batch, rn);
+
+      for (ri = rn->info; ri; ri = ri->next)
+        if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED) ||
+            (addpath_capable && bgp_addpath_tx_path(peer, afi, safi, ri)))
+          {
+            if (subgroup_announce_check (rn, ri, subgrp, &rn->p, &attr))
+              bgp_adj_out_set_subgroup (rn, subgrp, &attr, ri);
+            else
+              bgp_adj_out_unset_subgroup (rn, subgrp, 1, ri->addpath_tx_id);
+          }
+    }
 
-      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED) ||
-          (addpath_capable && bgp_addpath_tx_path(peer, afi, safi, ri)))
-	{
-	  if (subgroup_announce_check (rn, ri, subgrp, &rn->p, &attr))
-	    bgp_adj_out_set_subgroup (rn, subgrp, &attr, ri);
-	  else
-	    bgp_adj_out_unset_subgroup (rn, subgrp, 1, ri->addpath_tx_id);
-	}
+  if (plist || orf_plist)
+    bgp_plist_batch_end (&batch);
 
   /*
    * We walked through the whole table -- make sure our version number
@@ -413,16 +413,18 @@ bpacket_reformat_for_peer (struct bpacket *pkt, struct peer_af *paf)
   char buf[BUFSIZ];
   char buf2[BUFSIZ];
 
-  s = stream_dup (pkt->buffer);
   peer = PAF_PEER(paf);
 
+  /* The subgroup's copy of the packet is shared by all its peers; it is
+     only copied for a peer whose nexthop has to be rewritten. */
+
   vec = &pkt->arr.entries[BGP_ATTR_VEC_NH];
   if (CHECK_FLAG (vec->flags, BPKT_ATTRVEC_FLAGS_UPDATED))
     {
       u_int8_t nhlen;
       afi_t    nhafi = AFI_MAX; /* NH AFI is based on nhlen! */
       int route_map_sets_nh;
-      nhlen = stream_getc_from (s, vec->offset);
+      nhlen = stream_getc_from (pkt->buffer, vec->offset);
       if (paf->afi == AFI_IP || paf->afi == AFI_IP6)
         {
           nhafi = BGP_NEXTHOP_AFI_FROM_NHLEN(nhlen);
@@ -454,7 +456,7 @@ bpacket_reformat_for_peer (struct bpacket *pkt, struct peer_af *paf)
 		return NULL;
 	    }
 
-          stream_get_from (&v4nh, s, offset_nh, IPV4_MAX_BYTELEN);
+          stream_get_from (&v4nh, pkt->buffer, offset_nh, IPV4_MAX_BYTELEN);
           mod_v4nh = &v4nh;
 
           /*
@@ -495,7 +497,10 @@ bpacket_reformat_for_peer (struct bpacket *pkt, struct peer_af *paf)
             }
 
           if (nh_modified)      /* allow for VPN RD */
-            stream_put_in_addr_at (s, offset_nh, mod_v4nh);
+            {
+              s = stream_dup (pkt->buffer);
+              stream_put_in_addr_at (s, offset_nh, mod_v4nh);
+            }
 
           if (bgp_debug_update(peer, NULL, NULL, 0))
             zlog_debug ("u%" PRIu64 ":s%" PRIu64 " %s send UPDATE w/ nexthop %s%s",
@@ -545,7 +550,8 @@ bpacket_reformat_for_peer (struct bpacket *pkt, struct peer_af *paf)
 		return NULL;
 	    }
 
-          stream_get_from (&v6nhglobal, s, offset_nhglobal, IPV6_MAX_BYTELEN);
+          stream_get_from (&v6nhglobal, pkt->buffer, offset_nhglobal,
+                           IPV6_MAX_BYTELEN);
           if (route_map_sets_nh)
             {
                if (CHECK_FLAG(vec->flags,
@@ -575,7 +581,8 @@ bpacket_reformat_for_peer (struct bpacket *pkt, struct peer_af *paf)
 	  if (nhlen == BGP_ATTR_NHLEN_IPV6_GLOBAL_AND_LL ||
 	      nhlen == BGP_ATTR_NHLEN_VPNV6_GLOBAL_AND_LL)
 	    {
-              stream_get_from (&v6nhlocal, s, offset_nhlocal, IPV6_MAX_BYTELEN);
+              stream_get_from (&v6nhlocal, pkt->buffer, offset_nhlocal,
+                               IPV6_MAX_BYTELEN);
               if (IN6_IS_ADDR_UNSPECIFIED (&v6nhlocal))
                 {
                    mod_v6nhl = &peer->nexthop.v6_local;
@@ -583,6 +590,8 @@ bpacket_reformat_for_peer (struct bpacket *pkt, struct peer_af *paf)
                 }
 	    }
 
+          if (gnh_modified || lnh_modified)
+            s = stream_dup (pkt->buffer);
           if (gnh_modified)
             stream_put_in6_addr_at (s, offset_nhglobal, mod_v6nhg);
           if (lnh_modified)
@@ -609,6 +618,9 @@ bpacket_reformat_for_peer (struct bpacket *pkt, struct peer_af *paf)
 	}
     }
 
+  if (s == NULL)
+    s = stream_ref (pkt->buffer);
+
   bgp_packet_add (peer, s);
   return s;
 }
@@ -57,6 +57,7 @@
 #include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_updgrp.h"
 #include "bgpd/bgp_bfd.h"
+#include "bgpd/bgp_bestpath.h"
 
 static struct peer_group *
 listen_range_exists (struct bgp *bgp, struct prefix *range, int exact);
@@ -1490,6 +1491,51 @@ DEFUN (no_bgp_wpkt_quanta,
   return bgp_wpkt_quanta_config_vty(vty, argv[idx_number]->arg, 0);
 }
 
+static int
+bgp_rpkt_quanta_config_vty (struct vty *vty, const char *num, char set)
+{
+  VTY_DECLVAR_CONTEXT(bgp, bgp);
+
+  if (set)
+    VTY_GET_INTEGER_RANGE ("read-quanta", bgp->rpkt_quanta, num,
+			   1, 10000);
+  else
+    bgp->rpkt_quanta = BGP_READ_PACKET_MAX;
+
+  return CMD_SUCCESS;
+}
+
+int
+bgp_config_write_rpkt_quanta (struct vty *vty, struct bgp *bgp)
+{
+  if (bgp->rpkt_quanta != BGP_READ_PACKET_MAX)
+      vty_out (vty, " read-quanta %d%s",
+               bgp->rpkt_quanta, VTY_NEWLINE);
+
+  return 0;
+}
+
+DEFUN (bgp_rpkt_quanta,
+       bgp_rpkt_quanta_cmd,
+       "read-quanta (1-10000)",
+       "How many packets to read from peer socket per run\n"
+       "Number of packets\n")
+{
+  int idx_number = 1;
+  return bgp_rpkt_quanta_config_vty(vty, argv[idx_number]->arg, 1);
+}
+
+DEFUN (no_bgp_rpkt_quanta,
+       no_bgp_rpkt_quanta_cmd,
+       "no read-quanta (1-10000)",
+       NO_STR
+       "How many packets to read from peer socket per run\n"
+       "Number of packets\n")
+{
+  int idx_number = 2;
+  return bgp_rpkt_quanta_config_vty(vty, argv[idx_number]->arg, 0);
+}
+
 static int
 bgp_coalesce_config_vty (struct vty *vty, const char *num, char set)
 {
@@ -1963,6 +2009,17 @@ DEFUN (no_bgp_fast_external_failover,
   return CMD_SUCCESS;
 }
 
+/* Attributes already parsed were checked against the old setting. */
+static void
+bgp_enforce_first_as_changed (struct bgp *bgp)
+{
+  struct listnode *node, *nnode;
+  struct peer *peer;
+
+  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+    bgp_attr_cache_flush (peer);
+}
+
 /* "bgp enforce-first-as" configuration. */
 DEFUN (bgp_enforce_first_as,
        bgp_enforce_first_as_cmd,
@@ -1972,6 +2029,7 @@ DEFUN (bgp_enforce_first_as,
 {
   VTY_DECLVAR_CONTEXT(bgp, bgp);
   bgp_flag_set (bgp, BGP_FLAG_ENFORCE_FIRST_AS);
+  bgp_enforce_first_as_changed (bgp);
   bgp_clear_star_soft_in (vty, bgp->name);
 
   return CMD_SUCCESS;
@@ -1986,6 +2044,7 @@ DEFUN (no_bgp_enforce_first_as,
 {
   VTY_DECLVAR_CONTEXT(bgp, bgp);
   bgp_flag_unset (bgp, BGP_FLAG_ENFORCE_FIRST_AS);
+  bgp_enforce_first_as_changed (bgp);
   bgp_clear_star_soft_in (vty, bgp->name);
 
   return CMD_SUCCESS;
@@ -5311,6 +5370,34 @@ DEFUN (no_bgp_set_route_map_delay_timer,
   return CMD_SUCCESS;
 }
 
+/* Pthreads to select best paths on */
+DEFUN (bgp_set_bestpath_workers,
+       bgp_set_bestpath_workers_cmd,
+       "bgp bestpath workers (1-64)",
+       "BGP specific commands\n"
+       "Change the default bestpath selection\n"
+       "Pthreads to select best paths on\n"
+       "Number of pthreads, the main one included\n")
+{
+  int idx_number = 3;
+
+  bgp_bestpath_workers_set (strtoul (argv[idx_number]->arg, NULL, 10));
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_set_bestpath_workers,
+       no_bgp_set_bestpath_workers_cmd,
+       "no bgp bestpath workers [(1-64)]",
+       NO_STR
+       "BGP specific commands\n"
+       "Change the default bestpath selection\n"
+       "Pthreads to select best paths on\n"
+       "Number of pthreads, the main one included\n")
+{
+  bgp_bestpath_workers_set (BGP_BESTPATH_WORKERS_DEFAULT);
+  return CMD_SUCCESS;
+}
+
 
 /* neighbor interface */
 static int
@@ -6851,10 +6938,11 @@ DEFUN (show_bgp_memory,
                            count * sizeof (struct bgp_adj_in)),
              VTY_NEWLINE);
   if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_OUT)))
-    vty_out (vty, "%ld Adj-Out entries, using %s of memory%s", count,
+    vty_out (vty, "%ld Adj-Out entries, using %s of memory, %zu bytes each%s",
+             count,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
                            count * sizeof (struct bgp_adj_out)),
-             VTY_NEWLINE);
+             sizeof (struct bgp_adj_out), VTY_NEWLINE);
 
   if ((count = mtype_stats_alloc (MTYPE_BGP_NEXTHOP_CACHE)))
     vty_out (vty, "%ld Nexthop cache entries, using %s of memory%s", count,
@@ -8070,6 +8158,7 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
   u_char *msg;
   json_object *json_neigh = NULL;
   time_t epoch_tbuf;
+  unsigned long inq_count, outq_count;
 
   bgp = p->bgp;
 
@@ -8851,13 +8940,22 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
                      thread_timer_remain_second (p->t_gr_stale), VTY_NEWLINE);
         }
     }
+
+  /* Both queues are shared with the I/O pthread. */
+  pthread_mutex_lock (&p->io_mtx);
+  {
+    inq_count = p->inq->count;
+    outq_count = p->obuf->count;
+  }
+  pthread_mutex_unlock (&p->io_mtx);
+
   if (use_json)
     {
       json_object *json_stat = NULL;
       json_stat = json_object_new_object();
       /* Packet counts. */
-      json_object_int_add(json_stat, "depthInq", 0);
-      json_object_int_add(json_stat, "depthOutq", (unsigned long) p->obuf->count);
+      json_object_int_add(json_stat, "depthInq", inq_count);
+      json_object_int_add(json_stat, "depthOutq", outq_count);
       json_object_int_add(json_stat, "opensSent",  p->open_out);
       json_object_int_add(json_stat, "opensRecv", p->open_in);
       json_object_int_add(json_stat, "notificationsSent", p->notify_out);
@@ -8872,14 +8970,29 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
       json_object_int_add(json_stat, "capabilityRecv", p->dynamic_cap_in);
       json_object_int_add(json_stat, "totalSent", p->open_out + p->notify_out + p->update_out + p->keepalive_out + p->refresh_out + p->dynamic_cap_out);
       json_object_int_add(json_stat, "totalRecv", p->open_in + p->notify_in + p->update_in + p->keepalive_in + p->refresh_in + p->dynamic_cap_in);
+      json_object_long_add(json_stat, "bytesSent",
+                           atomic_load_explicit (&p->write_bytes, memory_order_relaxed));
+      json_object_long_add(json_stat, "bytesRecv",
+                           atomic_load_explicit (&p->read_bytes, memory_order_relaxed));
+      json_object_long_add(json_stat, "writeSyscalls",
+                           atomic_load_explicit (&p->write_calls, memory_order_relaxed));
+      json_object_long_add(json_stat, "readSyscalls",
+                           atomic_load_explicit (&p->read_calls, memory_order_relaxed));
+      json_object_long_add(json_stat, "attrCacheHits", p->attr_cache_hit);
+      json_object_long_add(json_stat, "attrCacheMisses", p->attr_cache_miss);
       json_object_object_add(json_neigh, "messageStats", json_stat);
     }
   else
     {
+      u_int64_t wbytes = atomic_load_explicit (&p->write_bytes, memory_order_relaxed);
+      u_int64_t rbytes = atomic_load_explicit (&p->read_bytes, memory_order_relaxed);
+      u_int64_t wcalls = atomic_load_explicit (&p->write_calls, memory_order_relaxed);
+      u_int64_t rcalls = atomic_load_explicit (&p->read_calls, memory_order_relaxed);
+
       /* Packet counts. */
       vty_out (vty, "  Message statistics:%s", VTY_NEWLINE);
-      vty_out (vty, "    Inq depth is 0%s", VTY_NEWLINE);
-      vty_out (vty, "    Outq depth is %lu%s", (unsigned long) p->obuf->count, VTY_NEWLINE);
+      vty_out (vty, "    Inq depth is %lu%s", inq_count, VTY_NEWLINE);
+      vty_out (vty, "    Outq depth is %lu%s", outq_count, VTY_NEWLINE);
       vty_out (vty, "                         Sent       Rcvd%s", VTY_NEWLINE);
       vty_out (vty, "    Opens:         %10d %10d%s", p->open_out, p->open_in, VTY_NEWLINE);
       vty_out (vty, "    Notifications: %10d %10d%s", p->notify_out, p->notify_in, VTY_NEWLINE);
@@ -8891,6 +9004,15 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
                p->update_out + p->keepalive_out + p->refresh_out + p->dynamic_cap_out,
                p->open_in + p->notify_in + p->update_in + p->keepalive_in + p->refresh_in +
                p->dynamic_cap_in, VTY_NEWLINE);
+      vty_out (vty, "    Bytes:         %10" PRIu64 " %10" PRIu64 "%s",
+               wbytes, rbytes, VTY_NEWLINE);
+      vty_out (vty, "    Syscalls:      %10" PRIu64 " %10" PRIu64 "%s",
+               wcalls, rcalls, VTY_NEWLINE);
+      vty_out (vty, "    Bytes/syscall: %10" PRIu64 " %10" PRIu64 "%s",
+               wcalls ? wbytes / wcalls : 0, rcalls ? rbytes / rcalls : 0,
+               VTY_NEWLINE);
+      vty_out (vty, "    Attribute cache: %u hits, %u misses%s",
+               p->attr_cache_hit, p->attr_cache_miss, VTY_NEWLINE);
     }
 
   if (use_json)
@@ -9196,6 +9318,20 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
         }
       if (p->password)
 	json_object_int_add(json_neigh, "authenticationEnabled", 1);
+      if (p->ka_on)
+        {
+          u_int32_t ka_count = atomic_load_explicit (&p->ka_jitter_count,
+                                                     memory_order_relaxed);
+          u_int64_t ka_total = atomic_load_explicit (&p->ka_jitter_total,
+                                                     memory_order_relaxed);
+
+          json_object_int_add(json_neigh, "keepalivesTimed", ka_count);
+          json_object_int_add(json_neigh, "keepaliveJitterAvgUsecs",
+                              ka_count ? ka_total / ka_count : 0);
+          json_object_int_add(json_neigh, "keepaliveJitterMaxUsecs",
+                              atomic_load_explicit (&p->ka_jitter_max,
+                                                    memory_order_relaxed));
+        }
 
       if (p->t_read)
         json_object_string_add(json_neigh, "readThread", "on");
@@ -9225,6 +9361,20 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
                  VTY_NEWLINE);
       if (p->password)
 	vty_out (vty, "Peer Authentication Enabled%s", VTY_NEWLINE);
+      if (p->ka_on)
+        {
+          u_int32_t ka_count = atomic_load_explicit (&p->ka_jitter_count,
+                                                     memory_order_relaxed);
+          u_int64_t ka_total = atomic_load_explicit (&p->ka_jitter_total,
+                                                     memory_order_relaxed);
+
+          vty_out (vty, "Keepalive jitter: avg %" PRIu64 " usecs, "
+                   "max %u usecs over %u keepalives%s",
+                   ka_count ? ka_total / ka_count : 0,
+                   atomic_load_explicit (&p->ka_jitter_max,
+                                         memory_order_relaxed),
+                   ka_count, VTY_NEWLINE);
+        }
 
       vty_out (vty, "Read thread: %s  Write thread: %s%s",
                p->t_read ? "on" : "off",
@@ -10961,6 +11111,10 @@ bgp_vty_init (void)
   install_element (CONFIG_NODE, &bgp_set_route_map_delay_timer_cmd);
   install_element (CONFIG_NODE, &no_bgp_set_route_map_delay_timer_cmd);
 
+  /* "bgp bestpath workers" commands. */
+  install_element (CONFIG_NODE, &bgp_set_bestpath_workers_cmd);
+  install_element (CONFIG_NODE, &no_bgp_set_bestpath_workers_cmd);
+
   /* Dummy commands (Currently not supported) */
   install_element (BGP_NODE, &no_synchronization_cmd);
   install_element (BGP_NODE, &no_auto_summary_cmd);
@@ -11006,6 +11160,8 @@ bgp_vty_init (void)
 
   install_element (BGP_NODE, &bgp_wpkt_quanta_cmd);
   install_element (BGP_NODE, &no_bgp_wpkt_quanta_cmd);
+  install_element (BGP_NODE, &bgp_rpkt_quanta_cmd);
+  install_element (BGP_NODE, &no_bgp_rpkt_quanta_cmd);
 
   install_element (BGP_NODE, &bgp_coalesce_time_cmd);
   install_element (BGP_NODE, &no_bgp_coalesce_time_cmd);
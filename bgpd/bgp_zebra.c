@@ -2251,6 +2251,9 @@ bgp_zebra_init (struct thread_master *master)
   /* Set default values. */
   zclient = zclient_new (master);
   zclient_init (zclient, ZEBRA_ROUTE_BGP, 0);
+  /* Full tables make for a lot of route messages; pass them to zebra
+     through shared memory where we can. */
+  zclient->ring_enable = 1;
   zclient->zebra_connected = bgp_zebra_connected;
   zclient->router_id_update = bgp_router_id_update;
   zclient->interface_add = bgp_interface_add;
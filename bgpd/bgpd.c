@@ -24,6 +24,7 @@
 #include "thread.h"
 #include "buffer.h"
 #include "stream.h"
+#include "ringbuf.h"
 #include "command.h"
 #include "sockunion.h"
 #include "sockopt.h"
@@ -42,6 +43,7 @@
 #include "jhash.h"
 #include "table.h"
 #include "lib/json.h"
+#include "frr_pthread.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -55,6 +57,9 @@
 #include "bgpd/bgp_clist.h"
 #include "bgpd/bgp_fsm.h"
 #include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_io.h"
+#include "bgpd/bgp_keepalives.h"
+#include "bgpd/bgp_bestpath.h"
 #include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_open.h"
 #include "bgpd/bgp_filter.h"
@@ -1059,8 +1064,9 @@ peer_free (struct peer *peer)
    * but just to be sure.. 
    */
   bgp_timer_set (peer);
-  BGP_READ_OFF (peer->t_read);
-  BGP_WRITE_OFF (peer->t_write);
+  THREAD_OFF (peer->t_connect_check);
+  bgp_reads_off (peer);
+  bgp_writes_off (peer);
   BGP_EVENT_FLUSH (peer);
   
   /* Free connected nexthop, if present */
@@ -1068,6 +1074,8 @@ peer_free (struct peer *peer)
       !peer_dynamic_neighbor (peer))
     bgp_delete_connected_nexthop (family2afi(peer->su.sa.sa_family), peer);
 
+  bgp_attr_cache_flush (peer);
+
   XFREE (MTYPE_PEER_TX_SHUTDOWN_MSG, peer->tx_shutdown_message);
 
   if (peer->desc)
@@ -1130,6 +1138,8 @@ peer_free (struct peer *peer)
 
   bgp_unlock(peer->bgp);
 
+  pthread_mutex_destroy (&peer->io_mtx);
+
   memset (peer, 0, sizeof (struct peer));
   
   XFREE (MTYPE_BGP_PEER, peer);
@@ -1217,7 +1227,10 @@ peer_new (struct bgp *bgp)
   SET_FLAG (peer->sflags, PEER_STATUS_CAPABILITY_OPEN);
 
   /* Create buffers.  */
+  pthread_mutex_init (&peer->io_mtx, NULL);
   peer->ibuf = stream_new (BGP_MAX_PACKET_SIZE);
+  peer->inq = stream_fifo_new ();
+  peer->ibuf_work = ringbuf_new (BGP_IBUF_WORK_SIZE);
   peer->obuf = stream_fifo_new ();
 
   /* We use a larger buffer for peer->work in the event that:
@@ -2058,6 +2071,18 @@ peer_delete (struct peer *peer)
       peer->ibuf = NULL;
     }
 
+  if (peer->inq)
+    {
+      stream_fifo_free (peer->inq);
+      peer->inq = NULL;
+    }
+
+  if (peer->ibuf_work)
+    {
+      ringbuf_del (peer->ibuf_work);
+      peer->ibuf_work = NULL;
+    }
+
   if (peer->obuf)
     {
       stream_fifo_free (peer->obuf);
@@ -2973,6 +2998,7 @@ bgp_create (as_t *as, const char *name, enum bgp_instance_type inst_type)
     }
 
   bgp->wpkt_quanta = BGP_WRITE_PACKET_MAX;
+  bgp->rpkt_quanta = BGP_READ_PACKET_MAX;
   bgp->coalesce_time = BGP_DEFAULT_SUBGROUP_COALESCE_TIME;
 
   QOBJ_REG (bgp, bgp);
@@ -7369,6 +7395,10 @@ bgp_config_write (struct vty *vty)
     vty_out (vty, "bgp route-map delay-timer %d%s", bm->rmap_update_timer,
              VTY_NEWLINE);
 
+  if (bgp_bestpath_workers () != BGP_BESTPATH_WORKERS_DEFAULT)
+    vty_out (vty, "bgp bestpath workers %u%s", bgp_bestpath_workers (),
+             VTY_NEWLINE);
+
   /* BGP configuration. */
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
@@ -7492,8 +7522,9 @@ bgp_config_write (struct vty *vty)
           vty_out (vty, "%s", VTY_NEWLINE);
         }
 
-      /* write quanta */
+      /* write and read quanta */
       bgp_config_write_wpkt_quanta (vty, bgp);
+      bgp_config_write_rpkt_quanta (vty, bgp);
 
       /* coalesce time */
       bgp_config_write_coalesce_time(vty, bgp);
@@ -7682,6 +7713,11 @@ bgp_init (void)
 
   /* allocates some vital data structures used by peer commands in vty_init */
 
+  /* BGP I/O and keepalives pthreads, started once the daemon has forked. */
+  frr_pthread_init ();
+  bgp_io_init ();
+  bgp_keepalives_init ();
+
   /* Init zebra. */
   bgp_zebra_init(bm->master);
 
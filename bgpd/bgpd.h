@@ -21,6 +21,9 @@
 #ifndef _QUAGGA_BGPD_H
 #define _QUAGGA_BGPD_H
 
+#include <pthread.h>
+
+#include "frratomic.h"
 #include "qobj.h"
 #include "lib/json.h"
 #include "vrf.h"
@@ -357,6 +360,7 @@ struct bgp
   } maxpaths[AFI_MAX][SAFI_MAX];
 
   u_int32_t wpkt_quanta;  /* per peer packet quanta to write */
+  u_int32_t rpkt_quanta;  /* per peer packet quanta to read and process */
   u_int32_t coalesce_time;
 
   u_int32_t addpath_tx_id;
@@ -561,8 +565,14 @@ struct peer
   /* Local router ID. */
   struct in_addr local_id;
 
-  /* Packet receive and send buffer. */
+  /* Packet receive and send buffer.  inq and obuf are shared with the I/O
+   * pthread and protected by io_mtx; ibuf_work, the raw bytes read off the
+   * socket but not yet framed, belongs to the I/O pthread while reads are
+   * on.  ibuf is the packet the main thread is currently processing. */
+  pthread_mutex_t io_mtx;
   struct stream *ibuf;
+  struct stream_fifo *inq;
+  struct ringbuf *ibuf_work;
   struct stream_fifo *obuf;
   struct stream *work;
 
@@ -764,9 +774,13 @@ struct peer
   u_int32_t v_pmax_restart;
   u_int32_t v_gr_restart;
 
-  /* Threads. */
+  /* Threads.  t_read and t_write are scheduled on the I/O pthread,
+     t_keepalive on the keepalives pthread. */
   struct thread *t_read;
   struct thread *t_write;
+  struct thread *t_connect_check;
+  struct thread *t_process_packet;
+  struct thread *t_generate_updgrp_packets;
   struct thread *t_start;
   struct thread *t_connect;
   struct thread *t_holdtime;
@@ -778,21 +792,47 @@ struct peer
   
   /* workqueues */
   struct work_queue *clear_node_queue;
+
+  /* Paths and Adj-RIB-In entries this peer has in the RIB, so that
+   * clearing the peer doesn't have to walk the whole table. */
+  LIST_HEAD(peer_route_list, bgp_info) routes[AFI_MAX][SAFI_MAX];
+  LIST_HEAD(peer_adj_in_list, bgp_adj_in) adj_in[AFI_MAX][SAFI_MAX];
+
+  /* Attribute sections recently received from this peer, parsed. */
+  struct bgp_attr_cache *attr_cache;
   
-  /* Statistics field */
+  /* Statistics field.  The output counts are bumped by the I/O pthread as
+   * packets go out on the wire. */
   u_int32_t open_in;		/* Open message input count */
-  u_int32_t open_out;		/* Open message output count */
+  _Atomic u_int32_t open_out;	/* Open message output count */
   u_int32_t update_in;		/* Update message input count */
-  u_int32_t update_out;		/* Update message ouput count */
+  _Atomic u_int32_t update_out;	/* Update message ouput count */
   time_t update_time;		/* Update message received time. */
   u_int32_t keepalive_in;	/* Keepalive input count */
-  u_int32_t keepalive_out;	/* Keepalive output count */
+  _Atomic u_int32_t keepalive_out; /* Keepalive output count */
   u_int32_t notify_in;		/* Notify input count */
-  u_int32_t notify_out;		/* Notify output count */
+  _Atomic u_int32_t notify_out;	/* Notify output count */
   u_int32_t refresh_in;		/* Route Refresh input count */
-  u_int32_t refresh_out;	/* Route Refresh output count */
+  _Atomic u_int32_t refresh_out; /* Route Refresh output count */
   u_int32_t dynamic_cap_in;	/* Dynamic Capability input count.  */
-  u_int32_t dynamic_cap_out;	/* Dynamic Capability output count.  */
+  _Atomic u_int32_t dynamic_cap_out; /* Dynamic Capability output count.  */
+  u_int32_t attr_cache_hit;	/* Attribute sections found in cache */
+  u_int32_t attr_cache_miss;	/* Attribute sections parsed */
+
+  /* Socket syscalls made by the I/O pthread and the bytes they moved. */
+  _Atomic u_int64_t read_calls;
+  _Atomic u_int64_t read_bytes;
+  _Atomic u_int64_t write_calls;
+  _Atomic u_int64_t write_bytes;
+
+  /* t_keepalive is armed; only looked at by the main thread. */
+  bool ka_on;
+
+  /* How late KEEPALIVEs went out since the session came up, in
+     microseconds.  Written by the keepalives pthread only. */
+  _Atomic u_int32_t ka_jitter_max;
+  _Atomic u_int64_t ka_jitter_total;
+  _Atomic u_int32_t ka_jitter_count;
 
   /* BGP state count */
   u_int32_t established;	/* Established */
@@ -816,9 +856,6 @@ struct peer
   /* Notify data. */
   struct bgp_notify notify;
 
-  /* Whole packet size to be read. */
-  unsigned long packet_size;
-
   /* Filter structure. */
   struct bgp_filter filter[AFI_MAX][SAFI_MAX];
 
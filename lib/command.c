@@ -502,6 +502,9 @@ config_write_host (struct vty *vty)
     vty_out (vty, "log timestamp precision %d%s",
              zlog_default->timestamp_precision, VTY_NEWLINE);
 
+  if (zlog_default->async)
+    vty_out (vty, "log async%s", VTY_NEWLINE);
+
   if (host.advanced)
     vty_out (vty, "service advanced-vty%s", VTY_NEWLINE);
 
@@ -512,6 +515,19 @@ config_write_host (struct vty *vty)
     vty_out (vty, "service terminal-length %d%s", host.lines,
              VTY_NEWLINE);
 
+  if (!cputime_enabled)
+    vty_out (vty, "no service cputime-stats%s", VTY_NEWLINE);
+
+  if (walltime_warning != WALLTIME_WARNING_DEFAULT || walltime_backtrace)
+    {
+      if (walltime_warning)
+        vty_out (vty, "service walltime-warning %lu%s%s",
+                 walltime_warning / 1000, walltime_backtrace ? " backtrace" : "",
+                 VTY_NEWLINE);
+      else
+        vty_out (vty, "no service walltime-warning%s", VTY_NEWLINE);
+    }
+
   if (host.motdfile)
     vty_out (vty, "banner motd file %s%s", host.motdfile, VTY_NEWLINE);
   else if (! host.motd)
@@ -2053,6 +2069,17 @@ DEFUN (show_logging,
            (zl->record_priority ? "enabled" : "disabled"), VTY_NEWLINE);
   vty_out (vty, "Timestamp precision: %d%s",
            zl->timestamp_precision, VTY_NEWLINE);
+  if (zl->async)
+    {
+      struct zlog_async_stats stats;
+
+      zlog_async_get_stats (&stats);
+      vty_out (vty, "Asynchronous logging: enabled, %lu queued, %lu written,"
+               " %lu dropped%s", stats.queued, stats.written, stats.dropped,
+               VTY_NEWLINE);
+    }
+  else
+    vty_out (vty, "Asynchronous logging: disabled%s", VTY_NEWLINE);
 
   return CMD_SUCCESS;
 }
@@ -2361,6 +2388,27 @@ DEFUN (no_config_log_timestamp_precision,
   return CMD_SUCCESS;
 }
 
+DEFUN (config_log_async,
+       config_log_async_cmd,
+       "log async",
+       "Logging control\n"
+       "Write log messages from a separate pthread\n")
+{
+  zlog_set_async (1);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_config_log_async,
+       no_config_log_async_cmd,
+       "no log async",
+       NO_STR
+       "Logging control\n"
+       "Write log messages from the pthread logging them\n")
+{
+  zlog_set_async (0);
+  return CMD_SUCCESS;
+}
+
 int
 cmd_banner_motd_file (const char *file)
 {
@@ -2556,6 +2604,8 @@ cmd_init (int terminal)
       install_element (CONFIG_NODE, &no_config_log_record_priority_cmd);
       install_element (CONFIG_NODE, &config_log_timestamp_precision_cmd);
       install_element (CONFIG_NODE, &no_config_log_timestamp_precision_cmd);
+      install_element (CONFIG_NODE, &config_log_async_cmd);
+      install_element (CONFIG_NODE, &no_config_log_async_cmd);
       install_element (CONFIG_NODE, &service_password_encrypt_cmd);
       install_element (CONFIG_NODE, &no_service_password_encrypt_cmd);
       install_element (CONFIG_NODE, &banner_motd_default_cmd);
@@ -33,6 +33,45 @@
 DEFINE_MTYPE_STATIC(LIB, ACCESS_LIST,     "Access List")
 DEFINE_MTYPE_STATIC(LIB, ACCESS_LIST_STR, "Access List Str")
 DEFINE_MTYPE_STATIC(LIB, ACCESS_FILTER,   "Access Filter")
+DEFINE_MTYPE_STATIC(LIB, ACCESS_LIST_TRIE, "Access List Trie Table")
+
+/* Lists with fewer filters than this are just walked. */
+#define ACCESS_TRIE_MIN	8
+
+/* Same layout as the prefix-list trie: one table per byte of the address,
+ * down to ACCESS_TRIE_MAXLEVEL{V4,V6} bytes; filters longer than that hang
+ * off the last level's final_chain. */
+#define ACCESS_TRIE_BITS	8
+#define ACCESS_TRIE_LEN		(1 << ACCESS_TRIE_BITS)
+#define ACCESS_TRIE_MAXLEVELV4	2	/* /24 for IPv4 */
+#define ACCESS_TRIE_MAXLEVELV6	4	/* /48 for IPv6 */
+
+struct access_trie_entry {
+	union {
+		struct access_trie_table *next_table;
+		struct filter *final_chain;
+	};
+
+	struct filter *up_chain;
+};
+
+struct access_trie_table {
+	struct access_trie_entry entries[ACCESS_TRIE_LEN];
+};
+
+struct access_trie
+{
+  /* Zebra-style filters, looked up by the prefix being filtered. */
+  struct access_trie_table *zebra;
+  size_t zebra_depth;
+
+  /* Cisco-style filters whose wildcard bits are a contiguous host part,
+     looked up by address only. */
+  struct access_trie_table *cisco;
+
+  /* Everything else, in order. */
+  struct filter *linear;
+};
 
 struct filter_cisco
 {
@@ -71,6 +110,12 @@ struct filter
       struct filter_cisco cfilter;
       struct filter_zebra zfilter;
     } u;
+
+  /* Position in the list, and the key this filter is found under in the
+     access_list's trie.  Only valid while the list has a trie. */
+  int seq;
+  u_char trie_len;
+  struct filter *next_best;
 };
 
 /* List of access_list. */
@@ -210,6 +255,247 @@ filter_match_zebra (struct filter *mfilter, struct prefix *p)
     return 0;
 }
 
+static int
+filter_match (struct filter *mfilter, struct prefix *p)
+{
+  if (mfilter->cisco)
+    return filter_match_cisco (mfilter, p);
+  else
+    return filter_match_zebra (mfilter, p);
+}
+
+static void
+access_trie_walk_affected (size_t validbits, struct access_trie_table *table,
+			   uint8_t byte, struct filter *object,
+			   void (*fn)(struct filter *object,
+				      struct filter **updptr))
+{
+  uint8_t mask;
+  uint16_t bwalk;
+
+  if (validbits > ACCESS_TRIE_BITS)
+    {
+      fn (object, &table->entries[byte].final_chain);
+      return;
+    }
+
+  mask = (1 << (8 - validbits)) - 1;
+  for (bwalk = byte & ~mask; bwalk <= byte + mask; bwalk++)
+    {
+      fn (object, &table->entries[bwalk].up_chain);
+    }
+}
+
+/* Chains are sorted by length, longest first, and then by position in
+   the list; every chain an entry is on continues the same way after it. */
+static void
+access_trie_install_fn (struct filter *object, struct filter **updptr)
+{
+  while (*updptr)
+    {
+      if (*updptr == object)
+        return;
+      if ((*updptr)->trie_len < object->trie_len)
+        break;
+      if ((*updptr)->seq > object->seq)
+        break;
+      updptr = &(*updptr)->next_best;
+    }
+
+  if (!object->next_best)
+    object->next_best = *updptr;
+  else
+    assert (object->next_best == *updptr || !*updptr);
+
+  *updptr = object;
+}
+
+static void
+access_trie_add (struct access_trie_table **root, size_t depth,
+		 const uint8_t *bytes, struct filter *filter)
+{
+  size_t validbits = filter->trie_len;
+  struct access_trie_table *table;
+
+  if (!*root)
+    *root = XCALLOC (MTYPE_ACCESS_LIST_TRIE,
+		     sizeof (struct access_trie_table));
+
+  table = *root;
+  while (validbits > ACCESS_TRIE_BITS && depth > 1)
+    {
+      if (!table->entries[*bytes].next_table)
+        table->entries[*bytes].next_table = XCALLOC (MTYPE_ACCESS_LIST_TRIE,
+                sizeof(struct access_trie_table));
+      table = table->entries[*bytes].next_table;
+      bytes++;
+      depth--;
+      validbits -= ACCESS_TRIE_BITS;
+    }
+
+  access_trie_walk_affected (validbits, table, *bytes, filter,
+			     access_trie_install_fn);
+}
+
+static void
+access_trie_table_free (struct access_trie_table *table, size_t depth)
+{
+  size_t i;
+
+  if (table == NULL)
+    return;
+  if (depth > 1)
+    for (i = 0; i < ACCESS_TRIE_LEN; i++)
+      access_trie_table_free (table->entries[i].next_table, depth - 1);
+  XFREE (MTYPE_ACCESS_LIST_TRIE, table);
+}
+
+/* Forget the trie; it is rebuilt the next time the list is applied. */
+static void
+access_list_trie_free (struct access_list *access)
+{
+  struct access_trie *trie = access->trie;
+
+  if (trie == NULL)
+    return;
+
+  access_trie_table_free (trie->zebra, trie->zebra_depth);
+  access_trie_table_free (trie->cisco, ACCESS_TRIE_MAXLEVELV4);
+  XFREE (MTYPE_ACCESS_LIST_TRIE, trie);
+  access->trie = NULL;
+}
+
+/* Sort the filters into a trie.  Each filter is found under the addresses
+   it can possibly match, so that looking up a prefix only needs to check
+   the filters on one path through the trie; the one first on the list
+   wins, as with a linear walk. */
+static void
+access_list_trie_build (struct access_list *access)
+{
+  struct access_trie *trie;
+  struct filter *filter, **linear_tail;
+  struct filter_cisco *cfilter;
+  u_int32_t wildcard;
+  int seq = 0;
+
+  trie = XCALLOC (MTYPE_ACCESS_LIST_TRIE, sizeof (struct access_trie));
+  if (access->master == &access_master_ipv6)
+    trie->zebra_depth = ACCESS_TRIE_MAXLEVELV6;
+  else
+    trie->zebra_depth = ACCESS_TRIE_MAXLEVELV4;
+  linear_tail = &trie->linear;
+
+  for (filter = access->head; filter; filter = filter->next)
+    {
+      filter->seq = seq++;
+      filter->next_best = NULL;
+
+      if (!filter->cisco)
+	{
+	  filter->trie_len = filter->u.zfilter.prefix.prefixlen;
+	  access_trie_add (&trie->zebra, trie->zebra_depth,
+			   &filter->u.zfilter.prefix.u.prefix, filter);
+	  continue;
+	}
+
+      /* A wildcard of the form 0.0.0.255 covers an address prefix; others
+	 can't be put in the trie. */
+      cfilter = &filter->u.cfilter;
+      wildcard = ntohl (cfilter->addr_mask.s_addr);
+      if ((wildcard & (wildcard + 1)) == 0)
+	{
+	  struct in_addr netmask;
+
+	  netmask.s_addr = ~cfilter->addr_mask.s_addr;
+	  filter->trie_len = ip_masklen (netmask);
+	  access_trie_add (&trie->cisco, ACCESS_TRIE_MAXLEVELV4,
+			   (uint8_t *) &cfilter->addr.s_addr, filter);
+	}
+      else
+	{
+	  *linear_tail = filter;
+	  linear_tail = &filter->next_best;
+	}
+    }
+
+  access->trie = trie;
+}
+
+/* Best (first on the list) filter matching p among those in the trie
+   under bytes, or fbest if that comes first. */
+static struct filter *
+access_trie_lookup (struct access_trie_table *table, size_t depth,
+		    const uint8_t *byte, size_t validbits,
+		    struct prefix *p, struct filter *fbest)
+{
+  struct filter *filter;
+
+  while (table)
+    {
+      for (filter = table->entries[*byte].up_chain; filter;
+	   filter = filter->next_best)
+        {
+          if (fbest && fbest->seq < filter->seq)
+            continue;
+          if (filter_match (filter, p))
+            fbest = filter;
+        }
+
+      if (validbits <= ACCESS_TRIE_BITS)
+        break;
+      validbits -= ACCESS_TRIE_BITS;
+
+      if (--depth)
+        {
+          table = table->entries[*byte].next_table;
+          byte++;
+          continue;
+        }
+
+      for (filter = table->entries[*byte].final_chain; filter;
+	   filter = filter->next_best)
+        {
+          if (fbest && fbest->seq < filter->seq)
+            continue;
+          if (filter_match (filter, p))
+            fbest = filter;
+        }
+      break;
+    }
+
+  return fbest;
+}
+
+static enum filter_type
+access_list_trie_apply (struct access_list *access, struct prefix *p)
+{
+  struct access_trie *trie = access->trie;
+  struct filter *filter, *fbest = NULL;
+
+  fbest = access_trie_lookup (trie->zebra, trie->zebra_depth,
+			      &p->u.prefix, p->prefixlen, p, fbest);
+  /* Cisco-style filters only look at the address. */
+  fbest = access_trie_lookup (trie->cisco, ACCESS_TRIE_MAXLEVELV4,
+			      (uint8_t *) &p->u.prefix4.s_addr,
+			      IPV4_MAX_BITLEN, p, fbest);
+
+  for (filter = trie->linear; filter; filter = filter->next_best)
+    {
+      if (fbest && fbest->seq < filter->seq)
+	break;
+      if (filter_match_cisco (filter, p))
+	{
+	  fbest = filter;
+	  break;
+	}
+    }
+
+  if (fbest == NULL)
+    return FILTER_DENY;
+
+  return fbest->type;
+}
+
 /* Allocate new access list structure. */
 static struct access_list *
 access_list_new (void)
@@ -234,6 +520,11 @@ access_list_delete (struct access_list *access)
   struct access_list_list *list;
   struct access_master *master;
 
+  access_list_trie_free (access);
+
+  /* Route maps may be holding on to this list. */
+  route_map_generation_bump ();
+
   for (filter = access->head; filter; filter = next)
     {
       next = filter->next;
@@ -408,6 +699,13 @@ access_list_apply (struct access_list *access, void *object)
   if (access == NULL)
     return FILTER_DENY;
 
+  if (access->count >= ACCESS_TRIE_MIN)
+    {
+      if (access->trie == NULL)
+	access_list_trie_build (access);
+      return access_list_trie_apply (access, p);
+    }
+
   for (filter = access->head; filter; filter = filter->next)
     {
       if (filter->cisco)
@@ -453,6 +751,8 @@ access_list_filter_add (struct access_list *access, struct filter *filter)
   else
     access->head = filter;
   access->tail = filter;
+  access->count++;
+  access_list_trie_free (access);
 
   /* Run hook function. */
   if (access->master->add_hook)
@@ -490,6 +790,8 @@ access_list_filter_delete (struct access_list *access, struct filter *filter)
     access->head = filter->next;
 
   filter_free (filter);
+  access->count--;
+  access_list_trie_free (access);
 
   route_map_notify_dependencies(access->name, RMAP_EVENT_FILTER_DELETED);
   /* Run hook function. */
@@ -61,6 +61,13 @@ struct access_list
 
   struct filter *head;
   struct filter *tail;
+
+  /* Number of filters on the list. */
+  int count;
+
+  /* Lookup trie over the filters; built on first use and dropped whenever
+     the list changes. */
+  struct access_trie *trie;
 };
 
 /* Prototypes for access-list. */
@@ -19,6 +19,7 @@
 
 #include <zebra.h>
 #include <pthread.h>
+#include <signal.h>
 
 #include "frr_pthread.h"
 #include "memory.h"
@@ -82,14 +83,14 @@ struct frr_pthread *frr_pthread_new(const char *name, unsigned int id,
                 holder.id = id;
 
                 if (!hash_lookup(pthread_table, &holder)) {
-                        struct frr_pthread *fpt =
-                            XCALLOC(MTYPE_FRR_PTHREAD,
-                                    sizeof(struct frr_pthread));
+                        fpt = XCALLOC(MTYPE_FRR_PTHREAD,
+                                      sizeof(struct frr_pthread));
                         fpt->id = id;
                         fpt->master = thread_master_create();
                         fpt->start_routine = start_routine;
                         fpt->stop_routine = stop_routine;
                         fpt->name = XSTRDUP(MTYPE_FRR_PTHREAD, name);
+                        fpt->master->name = fpt->name;
 
                         hash_get(pthread_table, fpt, hash_alloc_intern);
                 }
@@ -124,17 +125,28 @@ struct frr_pthread *frr_pthread_get(unsigned int id)
 int frr_pthread_run(unsigned int id, const pthread_attr_t * attr, void *arg)
 {
         struct frr_pthread *fpt = frr_pthread_get(id);
+        sigset_t blocked, oldmask;
         int ret;
 
         if (!fpt)
                 return -1;
 
+        /* the new pthread inherits our signal mask */
+        sigfillset(&blocked);
+        pthread_sigmask(SIG_SETMASK, &blocked, &oldmask);
+
+        atomic_store_explicit(&fpt->running, true, memory_order_relaxed);
         ret = pthread_create(&fpt->thread, attr, fpt->start_routine, arg);
 
         /* Per pthread_create(3), the contents of fpt->thread are undefined if
          * pthread_create() did not succeed. Reset this value to zero. */
-        if (ret < 0)
+        if (ret != 0) {
+                atomic_store_explicit(&fpt->running, false,
+                                      memory_order_relaxed);
                 memset(&fpt->thread, 0x00, sizeof(fpt->thread));
+        }
+
+        pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
 
         return ret;
 }
@@ -177,6 +189,33 @@ void frr_pthread_stop_all()
         pthread_mutex_unlock(&pthread_table_mtx);
 }
 
+/* Only there to wake the pthread up so it notices it should stop. */
+static int frr_pthread_loop_wakeup(struct thread *thread)
+{
+        return 0;
+}
+
+void *frr_pthread_loop(void *arg)
+{
+        struct frr_pthread *fpt = arg;
+        struct thread task;
+
+        while (atomic_load_explicit(&fpt->running, memory_order_relaxed))
+                if (thread_fetch(fpt->master, &task))
+                        thread_call(&task);
+
+        return NULL;
+}
+
+int frr_pthread_loop_stop(void **result, struct frr_pthread *fpt)
+{
+        atomic_store_explicit(&fpt->running, false, memory_order_relaxed);
+        thread_add_event(fpt->master, frr_pthread_loop_wakeup, NULL, 0, NULL);
+
+        pthread_join(fpt->thread, result);
+        return 0;
+}
+
 unsigned int frr_pthread_get_id()
 {
         return next_id++;
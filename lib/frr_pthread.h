@@ -21,6 +21,7 @@
 #define _FRR_PTHREAD_H
 
 #include <pthread.h>
+#include "frratomic.h"
 #include "thread.h"
 
 struct frr_pthread {
@@ -42,6 +43,9 @@ struct frr_pthread {
 
         /* the (hopefully descriptive) name of this thread */
         char *name;
+
+        /* cleared to make frr_pthread_loop() return */
+        _Atomic bool running;
 };
 
 /* Initializes this module.
@@ -103,7 +107,8 @@ struct frr_pthread *frr_pthread_get(unsigned int id);
  *
  * This function is a wrapper for pthread_create. The first parameter is the
  * frr_pthread to bind the created pthread to. All subsequent arguments are
- * passed unmodified to pthread_create().
+ * passed unmodified to pthread_create(). All signals are blocked in the new
+ * pthread; they are left to the main thread to handle.
  *
  * This function returns the same code as pthread_create(). If the value is
  * zero, the provided frr_pthread is bound to a running POSIX thread. If the
@@ -129,6 +134,13 @@ int frr_pthread_stop(unsigned int id, void **result);
 /* Stops all frr_pthread's. */
 void frr_pthread_stop_all(void);
 
+/* Start and stop routines for a pthread that does nothing but run its
+ * thread_master's event loop; pass them to frr_pthread_new(). The frr_pthread
+ * itself must be given as the argument to frr_pthread_run().
+ */
+void *frr_pthread_loop(void *arg);
+int frr_pthread_loop_stop(void **result, struct frr_pthread *fpt);
+
 /* Returns a unique identifier for use with frr_pthread_new().
  *
  * Internally, this is an integer that increments after each call to this
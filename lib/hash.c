@@ -24,7 +24,7 @@
 #include "memory.h"
 
 DEFINE_MTYPE(       LIB, HASH,        "Hash")
-DEFINE_MTYPE(       LIB, HASH_BACKET, "Hash Bucket")
+DEFINE_MTYPE_SLAB(  LIB, HASH_BACKET, "Hash Bucket", sizeof (struct hash_backet))
 DEFINE_MTYPE_STATIC(LIB, HASH_INDEX,  "Hash Index")
 
 /* Allocate a new hash.  */
@@ -43,6 +43,11 @@ hash_create_size (unsigned int size, unsigned int (*hash_key) (void *),
   hash->hash_key = hash_key;
   hash->hash_cmp = hash_cmp;
   hash->count = 0;
+  hash->slots = NULL;
+  hash->tombstones = 0;
+  hash->old_slots = NULL;
+  hash->old_size = 0;
+  hash->migrated = 0;
 
   return hash;
 }
@@ -55,6 +60,31 @@ hash_create (unsigned int (*hash_key) (void *),
   return hash_create_size (HASH_INITIAL_SIZE, hash_key, hash_cmp);
 }
 
+/* Allocate a new open addressing hash.  */
+struct hash *
+hash_create_open_size (unsigned int size, unsigned int (*hash_key) (void *),
+		       int (*hash_cmp) (const void *, const void *))
+{
+  struct hash *hash;
+
+  assert ((size & (size-1)) == 0);
+  hash = XCALLOC (MTYPE_HASH, sizeof (struct hash));
+  hash->slots = XCALLOC (MTYPE_HASH_INDEX,
+			 sizeof (struct hash_backet) * size);
+  hash->size = size;
+  hash->hash_key = hash_key;
+  hash->hash_cmp = hash_cmp;
+
+  return hash;
+}
+
+struct hash *
+hash_create_open (unsigned int (*hash_key) (void *),
+		  int (*hash_cmp) (const void *, const void *))
+{
+  return hash_create_open_size (HASH_INITIAL_SIZE, hash_key, hash_cmp);
+}
+
 /* Utility function for hash_get().  When this function is specified
    as alloc_func, return arugment as it is.  This function is used for
    intern already allocated value.  */
@@ -110,6 +140,243 @@ static void hash_expand (struct hash *hash)
     hash->no_expand = 1;
 }
 
+/* Open addressing.  Slots are probed linearly from key & (size - 1).  An
+   empty slot has NULL data and ends a probe; a released entry leaves a
+   tombstone behind so that probes carry on past it. */
+
+static char hash_tombstone;
+#define HASH_TOMBSTONE ((void *) &hash_tombstone)
+
+/* Keep slots at most 3/4 full, counting tombstones. */
+#define HASH_OPEN_FULL(hash, n) \
+  (((unsigned long) (n) + (hash)->tombstones) * 4 > (unsigned long) (hash)->size * 3)
+
+/* Old slots moved over per insert while growing.  A table grows to twice
+   its size at 3/4 load, so this is done long before the new one fills. */
+#define HASH_OPEN_MIGRATE 32
+
+#define HASH_LIVE(hb) ((hb)->data != NULL && (hb)->data != HASH_TOMBSTONE)
+
+/* Find data in one table of slots.  If unused is given, it is set to the
+   first slot along the probe that an insert could take. */
+static struct hash_backet *
+hash_open_find (struct hash *hash, struct hash_backet *slots,
+		unsigned int size, unsigned int key, void *data,
+		struct hash_backet **unused)
+{
+  unsigned int mask = size - 1;
+  unsigned int i, n;
+  struct hash_backet *hb;
+
+  if (unused)
+    *unused = NULL;
+
+  for (i = key & mask, n = 0; n < size; i = (i + 1) & mask, n++)
+    {
+      hb = &slots[i];
+      if (hb->data == NULL || hb->data == HASH_TOMBSTONE)
+	{
+	  if (unused && !*unused)
+	    *unused = hb;
+	  if (hb->data == NULL)
+	    break;
+	  continue;
+	}
+      if (hb->key == key && (*hash->hash_cmp) (hb->data, data))
+	return hb;
+    }
+  return NULL;
+}
+
+/* Put an entry known not to be in the table yet into hash->slots. */
+static struct hash_backet *
+hash_open_place (struct hash *hash, struct hash_backet *hb,
+		 unsigned int key, void *data)
+{
+  unsigned int mask = hash->size - 1;
+  unsigned int i;
+
+  if (!hb)
+    for (i = key & mask; ; i = (i + 1) & mask)
+      {
+	hb = &hash->slots[i];
+	if (!HASH_LIVE (hb))
+	  break;
+      }
+
+  if (hb->data == HASH_TOMBSTONE)
+    hash->tombstones--;
+  hb->key = key;
+  hb->data = data;
+  return hb;
+}
+
+/* Move up to steps of the old slots over, freeing them once all are. */
+static void
+hash_open_migrate (struct hash *hash, unsigned int steps)
+{
+  struct hash_backet *hb;
+
+  while (hash->old_slots && steps--)
+    {
+      hb = &hash->old_slots[hash->migrated];
+      if (HASH_LIVE (hb))
+	{
+	  hash_open_place (hash, NULL, hb->key, hb->data);
+	  /* not NULL, lookups must still probe past it */
+	  hb->data = HASH_TOMBSTONE;
+	}
+
+      if (++hash->migrated == hash->old_size)
+	{
+	  XFREE (MTYPE_HASH_INDEX, hash->old_slots);
+	  hash->old_size = 0;
+	  hash->migrated = 0;
+	}
+    }
+}
+
+/* Start over with fresh slots, twice as many if more than half of the
+   current ones are in use; otherwise this just gets rid of tombstones. */
+static void
+hash_open_resize (struct hash *hash)
+{
+  unsigned int new_size = hash->size;
+
+  /* can't have two generations of old slots */
+  hash_open_migrate (hash, UINT_MAX);
+
+  if (hash->count * 2 >= hash->size)
+    new_size *= 2;
+
+  hash->old_slots = hash->slots;
+  hash->old_size = hash->size;
+  hash->migrated = 0;
+
+  hash->slots = XCALLOC (MTYPE_HASH_INDEX,
+			 sizeof (struct hash_backet) * new_size);
+  hash->size = new_size;
+  hash->tombstones = 0;
+}
+
+static void *
+hash_open_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
+{
+  unsigned int key;
+  void *newdata;
+  struct hash_backet *hb, *unused;
+
+  key = (*hash->hash_key) (data);
+
+  hb = hash_open_find (hash, hash->slots, hash->size, key, data, &unused);
+  if (!hb && hash->old_slots)
+    hb = hash_open_find (hash, hash->old_slots, hash->old_size, key, data,
+			 NULL);
+  if (hb)
+    return hb->data;
+
+  if (!alloc_func)
+    return NULL;
+
+  newdata = (*alloc_func) (data);
+  if (newdata == NULL)
+    return NULL;
+
+  /* reusing a tombstone doesn't make the table any fuller */
+  if ((!unused || unused->data == NULL)
+      && HASH_OPEN_FULL (hash, hash->count + 1))
+    {
+      hash_open_resize (hash);
+      unused = NULL;
+    }
+
+  hash_open_place (hash, unused, key, newdata);
+  hash->count++;
+
+  hash_open_migrate (hash, HASH_OPEN_MIGRATE);
+  return newdata;
+}
+
+static void *
+hash_open_release (struct hash *hash, void *data)
+{
+  unsigned int key;
+  void *ret;
+  struct hash_backet *hb;
+
+  key = (*hash->hash_key) (data);
+
+  hb = hash_open_find (hash, hash->slots, hash->size, key, data, NULL);
+  if (hb)
+    hash->tombstones++;
+  else if (hash->old_slots)
+    hb = hash_open_find (hash, hash->old_slots, hash->old_size, key, data,
+			 NULL);
+  if (!hb)
+    return NULL;
+
+  ret = hb->data;
+  hb->data = HASH_TOMBSTONE;
+  hash->count--;
+  return ret;
+}
+
+/* Call func on every entry, old slots first.  func may release the entry
+   it is called for. */
+static int
+hash_open_walk (struct hash *hash,
+		int (*func) (struct hash_backet *, void *), void *arg)
+{
+  struct hash_backet *tables[2] = { hash->old_slots, hash->slots };
+  unsigned int sizes[2] = { hash->old_size, hash->size };
+  unsigned int t, i;
+
+  for (t = 0; t < 2; t++)
+    for (i = 0; tables[t] && i < sizes[t]; i++)
+      if (HASH_LIVE (&tables[t][i])
+	  && (*func) (&tables[t][i], arg) == HASHWALK_ABORT)
+	return HASHWALK_ABORT;
+
+  return HASHWALK_CONTINUE;
+}
+
+struct hash_open_iterate_arg
+{
+  void (*func) (struct hash_backet *, void *);
+  void *arg;
+};
+
+static int
+hash_open_iterate_one (struct hash_backet *hb, void *arg)
+{
+  struct hash_open_iterate_arg *ia = arg;
+
+  (*ia->func) (hb, ia->arg);
+  return HASHWALK_CONTINUE;
+}
+
+static void
+hash_open_clean (struct hash *hash, void (*free_func) (void *))
+{
+  unsigned int i;
+
+  for (i = 0; i < hash->old_size; i++)
+    if (HASH_LIVE (&hash->old_slots[i]) && free_func)
+      (*free_func) (hash->old_slots[i].data);
+  XFREE (MTYPE_HASH_INDEX, hash->old_slots);
+  hash->old_size = 0;
+  hash->migrated = 0;
+
+  for (i = 0; i < hash->size; i++)
+    {
+      if (HASH_LIVE (&hash->slots[i]) && free_func)
+	(*free_func) (hash->slots[i].data);
+      hash->slots[i].data = NULL;
+    }
+  hash->tombstones = 0;
+  hash->count = 0;
+}
+
 /* Lookup and return hash backet in hash.  If there is no
    corresponding hash backet and alloc_func is specified, create new
    hash backet.  */
@@ -122,6 +389,9 @@ hash_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
   unsigned int len;
   struct hash_backet *backet;
 
+  if (hash->slots)
+    return hash_open_get (hash, data, alloc_func);
+
   key = (*hash->hash_key) (data);
   index = key & (hash->size - 1);
   len = 0;
@@ -186,6 +456,9 @@ hash_release (struct hash *hash, void *data)
   struct hash_backet *backet;
   struct hash_backet *pp;
 
+  if (hash->slots)
+    return hash_open_release (hash, data);
+
   key = (*hash->hash_key) (data);
   index = key & (hash->size - 1);
 
@@ -217,6 +490,14 @@ hash_iterate (struct hash *hash,
   struct hash_backet *hb;
   struct hash_backet *hbnext;
 
+  if (hash->slots)
+    {
+      struct hash_open_iterate_arg ia = { func, arg };
+
+      hash_open_walk (hash, hash_open_iterate_one, &ia);
+      return;
+    }
+
   for (i = 0; i < hash->size; i++)
     for (hb = hash->index[i]; hb; hb = hbnext)
       {
@@ -238,6 +519,12 @@ hash_walk (struct hash *hash,
   struct hash_backet *hbnext;
   int ret = HASHWALK_CONTINUE;
 
+  if (hash->slots)
+    {
+      hash_open_walk (hash, func, arg);
+      return;
+    }
+
   for (i = 0; i < hash->size; i++)
     {
       for (hb = hash->index[i]; hb; hb = hbnext)
@@ -261,6 +548,12 @@ hash_clean (struct hash *hash, void (*free_func) (void *))
   struct hash_backet *hb;
   struct hash_backet *next;
 
+  if (hash->slots)
+    {
+      hash_open_clean (hash, free_func);
+      return;
+    }
+
   for (i = 0; i < hash->size; i++)
     {
       for (hb = hash->index[i]; hb; hb = next)
@@ -283,5 +576,7 @@ void
 hash_free (struct hash *hash)
 {
   XFREE (MTYPE_HASH_INDEX, hash->index);
+  XFREE (MTYPE_HASH_INDEX, hash->slots);
+  XFREE (MTYPE_HASH_INDEX, hash->old_slots);
   XFREE (MTYPE_HASH, hash);
 }
@@ -64,6 +64,19 @@ struct hash
 
   /* Backet alloc. */
   unsigned long count;
+
+  /* Open addressing, see hash_create_open().  slots replaces index and
+     has size entries; NULL for a chained hash. */
+  struct hash_backet *slots;
+
+  /* Slots in slots that held a released entry. */
+  unsigned int tombstones;
+
+  /* While growing, the previous slots, moved over into the new ones a few
+     at a time on each insert; migrated is how far that has got. */
+  struct hash_backet *old_slots;
+  unsigned int old_size;
+  unsigned int migrated;
 };
 
 extern struct hash *hash_create (unsigned int (*) (void *), 
@@ -71,6 +84,22 @@ extern struct hash *hash_create (unsigned int (*) (void *),
 extern struct hash *hash_create_size (unsigned int, unsigned int (*) (void *), 
 				      int (*) (const void *, const void *));
 
+/* Like hash_create()/hash_create_size(), but the entries live in one array
+   of backets rather than chained off an index, and growing the table is
+   spread over the inserts that follow.  Meant for large hashes, where the
+   one-off rehash of hash_create() tables stalls the daemon.
+
+   All the other hash functions work the same on either kind.  The
+   struct hash_backet passed to hash_iterate()/hash_walk() callbacks has
+   no meaningful next pointer and must not be kept; neither must
+   hash->index be looked at. */
+extern struct hash *hash_create_open (unsigned int (*) (void *),
+				      int (*) (const void *, const void *));
+extern struct hash *hash_create_open_size (unsigned int,
+					   unsigned int (*) (void *),
+					   int (*) (const void *,
+						    const void *));
+
 extern void *hash_get (struct hash *, void *, void * (*) (void *));
 extern void *hash_alloc_intern (void *);
 extern void *hash_lookup (struct hash *, void *);
@@ -22,12 +22,14 @@
 #define FRR_DEFINE_DESC_TABLE
 
 #include <zebra.h>
+#include <pthread.h>
 
 #include "zclient.h"
 #include "log.h"
 #include "log_int.h"
 #include "memory.h"
 #include "command.h"
+#include "frratomic.h"
 #ifndef SUNOS_5
 #include <sys/un.h>
 #endif
@@ -40,6 +42,10 @@ DEFINE_MTYPE_STATIC(LIB, ZLOG, "Logging")
 
 static int logfile_fd = -1;	/* Used in signal handler. */
 
+/* vzlog() may be called from several pthreads; keep their messages from
+ * interleaving and the cached timestamp consistent. */
+static pthread_mutex_t loglock = PTHREAD_MUTEX_INITIALIZER;
+
 struct zlog *zlog_default = NULL;
 
 const char *zlog_priority[] =
@@ -85,12 +91,22 @@ static void write_wrapper (int fd, const void *buf, size_t count)
   return;
 }
 
+/* Same for writev. */
+static void writev_wrapper (int fd, const struct iovec *iov, int iovcnt)
+{
+  if (writev (fd, iov, iovcnt) <= 0)
+    return;
+
+  return;
+}
+
 /* For time string format. */
 
 size_t
 quagga_timestamp(int timestamp_precision, char *buf, size_t buflen)
 {
-  static struct {
+  /* per pthread, since asynchronous logging formats without loglock */
+  static __thread struct {
     time_t last;
     size_t len;
     char buf[28];
@@ -102,11 +118,11 @@ quagga_timestamp(int timestamp_precision, char *buf, size_t buflen)
   /* first, we update the cache if the time has changed */
   if (cache.last != clock.tv_sec)
     {
-      struct tm *tm;
+      struct tm tm;
       cache.last = clock.tv_sec;
-      tm = localtime(&cache.last);
+      localtime_r(&cache.last, &tm);
       cache.len = strftime(cache.buf, sizeof(cache.buf),
-      			   "%Y/%m/%d %H:%M:%S", tm);
+      			   "%Y/%m/%d %H:%M:%S", &tm);
     }
   /* note: it's not worth caching the subsecond part, because
      chances are that back-to-back calls are not sufficiently close together
@@ -160,6 +176,587 @@ time_print(FILE *fp, struct timestamp_control *ctl)
 }
   
 
+/* Asynchronous output.
+ *
+ * With "log async", file, stdout and syslog output is not written by the
+ * pthread calling zlog().  Instead the message is formatted, complete with
+ * timestamp and protocol prefix, into a ring buffer belonging to the
+ * calling pthread, and a writer pthread picks it up from there and hands
+ * whatever has accumulated to a single writev().  Each ring has exactly one
+ * producer (its pthread) and one consumer (whoever holds loglock, normally
+ * the writer), so neither side takes a lock on the fast path.
+ *
+ * When a ring is full the message is dropped and counted; the writer logs
+ * how many went missing once there is room again.  Records carry a global
+ * sequence number so that messages from different pthreads come out in the
+ * order they were logged in.
+ *
+ * Monitor vtys are left to vty_log(), which writes to them on the main
+ * pthread.
+ */
+
+DEFINE_MTYPE_STATIC(LIB, ZLOG_RING, "Log ring buffer")
+
+#define ZLOG_RING_SIZE		(256 * 1024)
+#define ZLOG_RING_MASK		(ZLOG_RING_SIZE - 1)
+/* Most records handed to a single writev(). */
+#define ZLOG_ASYNC_BATCH	64
+
+struct zlog_rec
+{
+  uint64_t seq;
+  uint32_t len;		/* of the text following the header; 0 tells the
+			   reader to continue at the start of the ring */
+  uint16_t msgoff;	/* start of the message proper, for syslog */
+  u_char priority;
+  u_char dests;		/* bitmask of (1 << ZLOG_DEST_*) */
+};
+
+/* Records start on 16 byte boundaries, so that there is always room for a
+ * wrap marker at the end of the ring. */
+#define ZLOG_REC_SIZE(len) \
+  ((sizeof (struct zlog_rec) + (len) + 15) & ~(size_t) 15)
+
+struct zlog_ring
+{
+  struct zlog_ring *next;
+
+  /* head is only written by the owning pthread, tail only by the reader;
+   * both count bytes ever written and are masked when used. */
+  _Atomic size_t head;
+  _Atomic size_t tail;
+
+  _Atomic unsigned long queued;
+  _Atomic unsigned long dropped;
+  _Atomic bool dead;		/* owning pthread has exited */
+
+  /* reader-private state, protected by loglock */
+  size_t cursor;
+  size_t limit;
+  unsigned long dropped_seen;
+
+  char buf[ZLOG_RING_SIZE];
+};
+
+/* All rings; protected by loglock. */
+static struct zlog_ring *zlog_rings;
+static __thread struct zlog_ring *zlog_ring_self;
+static pthread_key_t zlog_ring_key;
+static pthread_once_t zlog_async_once = PTHREAD_ONCE_INIT;
+
+static _Atomic uint64_t zlog_seq;
+
+/* Counters of rings that have been released, and of records written;
+ * protected by loglock. */
+static unsigned long zlog_retired_queued, zlog_retired_dropped;
+static unsigned long zlog_written;
+
+/* The writer pthread.  wakelock and wakeup are used to put it to sleep
+ * when there is nothing to write; writer_idle tells producers whether it
+ * needs waking up. */
+static pthread_t writer;
+static pthread_mutex_t wakelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeup = PTHREAD_COND_INITIALIZER;
+static _Atomic bool writer_running;
+static _Atomic bool writer_idle;
+static bool writer_stop;
+
+static void
+zlog_ring_release (void *arg)
+{
+  struct zlog_ring *ring = arg;
+
+  atomic_store_explicit (&ring->dead, true, memory_order_release);
+}
+
+static void
+zlog_async_prefork (void)
+{
+  pthread_mutex_lock (&loglock);
+  pthread_mutex_lock (&wakelock);
+}
+
+static void
+zlog_async_postfork_parent (void)
+{
+  pthread_mutex_unlock (&wakelock);
+  pthread_mutex_unlock (&loglock);
+}
+
+/* The writer doesn't survive fork(), and whatever is queued will be
+ * written out by the parent; start over with empty rings. */
+static void
+zlog_async_postfork_child (void)
+{
+  struct zlog_ring *ring;
+
+  for (ring = zlog_rings; ring; ring = ring->next)
+    {
+      atomic_store_explicit (&ring->tail,
+			     atomic_load_explicit (&ring->head,
+						   memory_order_relaxed),
+			     memory_order_relaxed);
+      if (ring != zlog_ring_self)
+	atomic_store_explicit (&ring->dead, true, memory_order_relaxed);
+    }
+  atomic_store_explicit (&writer_running, false, memory_order_relaxed);
+  atomic_store_explicit (&writer_idle, false, memory_order_relaxed);
+
+  pthread_mutex_unlock (&wakelock);
+  pthread_mutex_unlock (&loglock);
+}
+
+static void
+zlog_async_init_once (void)
+{
+  pthread_key_create (&zlog_ring_key, zlog_ring_release);
+  pthread_atfork (zlog_async_prefork, zlog_async_postfork_parent,
+		  zlog_async_postfork_child);
+}
+
+static struct zlog_ring *
+zlog_ring_new (void)
+{
+  struct zlog_ring *ring;
+
+  ring = XCALLOC (MTYPE_ZLOG_RING, sizeof (struct zlog_ring));
+  pthread_setspecific (zlog_ring_key, ring);
+
+  pthread_mutex_lock (&loglock);
+  ring->next = zlog_rings;
+  zlog_rings = ring;
+  pthread_mutex_unlock (&loglock);
+
+  zlog_ring_self = ring;
+  return ring;
+}
+
+/* Next unwritten record on the ring, or NULL. */
+static struct zlog_rec *
+zlog_ring_peek (struct zlog_ring *ring)
+{
+  struct zlog_rec *rec;
+
+  while (ring->cursor != ring->limit)
+    {
+      rec = (struct zlog_rec *) (ring->buf + (ring->cursor & ZLOG_RING_MASK));
+      if (rec->len)
+	return rec;
+      ring->cursor += ZLOG_RING_SIZE - (ring->cursor & ZLOG_RING_MASK);
+    }
+  return NULL;
+}
+
+/* Tell whoever is reading the log that messages were lost. */
+static void
+zlog_async_report_drops (unsigned long dropped)
+{
+  struct zlog *zl = zlog_default;
+  char buf[QUAGGA_TIMESTAMP_LEN + 128];
+  size_t len;
+
+  len = quagga_timestamp (zl->timestamp_precision, buf, sizeof (buf));
+  len += snprintf (buf + len, sizeof (buf) - len,
+		   " %s: %lu log messages dropped, log buffer full\n",
+		   zl->protoname, dropped);
+  if (len >= sizeof (buf))
+    len = sizeof (buf) - 1;
+
+  if (logfile_fd >= 0 && LOG_WARNING <= zl->maxlvl[ZLOG_DEST_FILE])
+    write_wrapper (logfile_fd, buf, len);
+  if (LOG_WARNING <= zl->maxlvl[ZLOG_DEST_STDOUT])
+    write_wrapper (STDOUT_FILENO, buf, len);
+  if (LOG_WARNING <= zl->maxlvl[ZLOG_DEST_SYSLOG])
+    syslog (LOG_WARNING | zl->facility,
+	    "%lu log messages dropped, log buffer full", dropped);
+}
+
+/* Write out everything queued on the rings, in batches of up to
+ * ZLOG_ASYNC_BATCH records.  Must be called with loglock held.  Returns the
+ * number of records written. */
+static unsigned long
+zlog_async_drain (void)
+{
+  struct zlog *zl = zlog_default;
+  struct iovec iov_file[ZLOG_ASYNC_BATCH], iov_out[ZLOG_ASYNC_BATCH];
+  struct zlog_ring *ring, *best, **prev;
+  struct zlog_rec *rec, *bestrec;
+  unsigned long dropped, total = 0;
+  int n, nfile, nout;
+  char *text;
+
+  if (!zl)
+    return 0;
+
+  for (;;)
+    {
+      for (ring = zlog_rings; ring; ring = ring->next)
+	{
+	  ring->cursor = atomic_load_explicit (&ring->tail,
+					       memory_order_relaxed);
+	  ring->limit = atomic_load_explicit (&ring->head,
+					      memory_order_acquire);
+	  dropped = atomic_load_explicit (&ring->dropped,
+					  memory_order_relaxed);
+	  if (dropped != ring->dropped_seen)
+	    {
+	      zlog_async_report_drops (dropped - ring->dropped_seen);
+	      ring->dropped_seen = dropped;
+	    }
+	}
+
+      n = nfile = nout = 0;
+      while (n < ZLOG_ASYNC_BATCH)
+	{
+	  best = NULL;
+	  bestrec = NULL;
+	  for (ring = zlog_rings; ring; ring = ring->next)
+	    {
+	      rec = zlog_ring_peek (ring);
+	      if (rec && (!bestrec || rec->seq < bestrec->seq))
+		{
+		  best = ring;
+		  bestrec = rec;
+		}
+	    }
+	  if (!best)
+	    break;
+
+	  text = (char *) (bestrec + 1);
+	  if ((bestrec->dests & (1 << ZLOG_DEST_FILE)) && logfile_fd >= 0)
+	    {
+	      iov_file[nfile].iov_base = text;
+	      iov_file[nfile++].iov_len = bestrec->len;
+	    }
+	  if (bestrec->dests & (1 << ZLOG_DEST_STDOUT))
+	    {
+	      iov_out[nout].iov_base = text;
+	      iov_out[nout++].iov_len = bestrec->len;
+	    }
+	  if (bestrec->dests & (1 << ZLOG_DEST_SYSLOG))
+	    syslog (bestrec->priority | zl->facility, "%.*s",
+		    (int) (bestrec->len - bestrec->msgoff - 1),
+		    text + bestrec->msgoff);
+
+	  best->cursor += ZLOG_REC_SIZE (bestrec->len);
+	  n++;
+	}
+      if (!n)
+	break;
+
+      if (nfile)
+	writev_wrapper (logfile_fd, iov_file, nfile);
+      if (nout)
+	writev_wrapper (STDOUT_FILENO, iov_out, nout);
+
+      for (ring = zlog_rings; ring; ring = ring->next)
+	atomic_store_explicit (&ring->tail, ring->cursor,
+			       memory_order_release);
+      zlog_written += n;
+      total += n;
+    }
+
+  /* Let go of the rings of pthreads that have exited. */
+  prev = &zlog_rings;
+  while ((ring = *prev))
+    {
+      if (atomic_load_explicit (&ring->dead, memory_order_acquire)
+	  && atomic_load_explicit (&ring->head, memory_order_acquire)
+	     == ring->cursor)
+	{
+	  *prev = ring->next;
+	  zlog_retired_queued += ring->queued;
+	  zlog_retired_dropped += ring->dropped;
+	  XFREE (MTYPE_ZLOG_RING, ring);
+	  continue;
+	}
+      prev = &ring->next;
+    }
+
+  return total;
+}
+
+static int
+zlog_async_empty (void)
+{
+  struct zlog_ring *ring;
+
+  for (ring = zlog_rings; ring; ring = ring->next)
+    if (atomic_load_explicit (&ring->head, memory_order_seq_cst)
+	!= atomic_load_explicit (&ring->tail, memory_order_relaxed))
+      return 0;
+  return 1;
+}
+
+static void *
+zlog_async_writer (void *arg)
+{
+  bool stop = false;
+
+  while (!stop)
+    {
+      pthread_mutex_lock (&loglock);
+      if (zlog_async_drain ())
+	{
+	  pthread_mutex_unlock (&loglock);
+	  continue;
+	}
+
+      /* Producers check writer_idle after publishing a record; whichever
+       * of us comes second sees the other. */
+      pthread_mutex_lock (&wakelock);
+      atomic_store_explicit (&writer_idle, true, memory_order_seq_cst);
+      if (!writer_stop && zlog_async_empty ())
+	{
+	  pthread_mutex_unlock (&loglock);
+	  pthread_cond_wait (&wakeup, &wakelock);
+	}
+      else
+	pthread_mutex_unlock (&loglock);
+      atomic_store_explicit (&writer_idle, false, memory_order_relaxed);
+      stop = writer_stop;
+      pthread_mutex_unlock (&wakelock);
+    }
+
+  pthread_mutex_lock (&loglock);
+  zlog_async_drain ();
+  pthread_mutex_unlock (&loglock);
+  return NULL;
+}
+
+/* Started on first use rather than by "log async", since the
+ * configuration is read before the daemon forks. */
+static int
+zlog_async_start (void)
+{
+  sigset_t blocked, oldmask;
+  int ret = 0;
+
+  pthread_once (&zlog_async_once, zlog_async_init_once);
+
+  pthread_mutex_lock (&wakelock);
+  if (!atomic_load_explicit (&writer_running, memory_order_relaxed))
+    {
+      /* signals are for the main thread to handle */
+      sigfillset (&blocked);
+      pthread_sigmask (SIG_BLOCK, &blocked, &oldmask);
+      writer_stop = false;
+      ret = pthread_create (&writer, NULL, zlog_async_writer, NULL);
+      pthread_sigmask (SIG_SETMASK, &oldmask, NULL);
+      if (ret == 0)
+	atomic_store_explicit (&writer_running, true, memory_order_release);
+    }
+  pthread_mutex_unlock (&wakelock);
+
+  return ret == 0 ? 0 : -1;
+}
+
+static void
+zlog_async_stop (void)
+{
+  pthread_mutex_lock (&wakelock);
+  if (!atomic_load_explicit (&writer_running, memory_order_relaxed))
+    {
+      pthread_mutex_unlock (&wakelock);
+      return;
+    }
+  writer_stop = true;
+  pthread_cond_signal (&wakeup);
+  pthread_mutex_unlock (&wakelock);
+
+  pthread_join (writer, NULL);
+  atomic_store_explicit (&writer_running, false, memory_order_relaxed);
+}
+
+/* Format one record into p, which has space bytes available.  Returns the
+ * space used, or 0 if the record doesn't fit. */
+static size_t
+zlog_rec_format (char *p, size_t space, int priority, u_char dests,
+		 const char *prefix, size_t plen,
+		 const char *format, va_list args)
+{
+  struct zlog_rec *rec = (struct zlog_rec *) p;
+  char *text = p + sizeof (*rec);
+  va_list ac;
+  int len;
+
+  if (space < sizeof (*rec) + plen + 2)
+    return 0;
+  space -= sizeof (*rec);
+
+  memcpy (text, prefix, plen);
+  va_copy (ac, args);
+  len = vsnprintf (text + plen, space - plen, format, ac);
+  va_end (ac);
+  /* the terminating NUL's place is taken by a newline */
+  if (len < 0 || (size_t) len >= space - plen)
+    return 0;
+  text[plen + len] = '\n';
+
+  rec->len = plen + len + 1;
+  rec->msgoff = plen;
+  rec->priority = priority;
+  rec->dests = dests;
+  return ZLOG_REC_SIZE (rec->len);
+}
+
+/* Queue a message for the writer.  Returns 0 if it should be written
+ * synchronously after all. */
+static int
+zlog_async_vlog (struct zlog *zl, int priority, const char *proto_str,
+		 const char *format, va_list args)
+{
+  struct zlog_ring *ring;
+  struct zlog_rec *rec;
+  char prefix[QUAGGA_TIMESTAMP_LEN + 64];
+  size_t plen, head, tail, off, avail, contig, used;
+  u_char dests = 0;
+
+  if (priority <= zl->maxlvl[ZLOG_DEST_SYSLOG])
+    dests |= 1 << ZLOG_DEST_SYSLOG;
+  if (priority <= zl->maxlvl[ZLOG_DEST_STDOUT])
+    dests |= 1 << ZLOG_DEST_STDOUT;
+  if ((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp)
+    dests |= 1 << ZLOG_DEST_FILE;
+  if (!dests)
+    return 1;
+
+  if (!atomic_load_explicit (&writer_running, memory_order_acquire)
+      && zlog_async_start () < 0)
+    return 0;
+  if (!(ring = zlog_ring_self))
+    ring = zlog_ring_new ();
+
+  plen = quagga_timestamp (zl->timestamp_precision, prefix, sizeof (prefix));
+  prefix[plen++] = ' ';
+  if (zl->record_priority)
+    plen += snprintf (prefix + plen, sizeof (prefix) - plen, "%s: ",
+		      zlog_priority[priority]);
+  plen += snprintf (prefix + plen, sizeof (prefix) - plen, "%s", proto_str);
+  if (plen >= sizeof (prefix))
+    plen = sizeof (prefix) - 1;
+
+  head = atomic_load_explicit (&ring->head, memory_order_relaxed);
+  tail = atomic_load_explicit (&ring->tail, memory_order_acquire);
+  off = head & ZLOG_RING_MASK;
+  avail = ZLOG_RING_SIZE - (head - tail);
+  contig = MIN (avail, ZLOG_RING_SIZE - off);
+
+  used = zlog_rec_format (ring->buf + off, contig, priority, dests,
+			  prefix, plen, format, args);
+  if (!used && contig < avail)
+    {
+      /* try again at the start of the ring, leaving a marker behind */
+      used = zlog_rec_format (ring->buf, avail - contig, priority, dests,
+			      prefix, plen, format, args);
+      if (used)
+	{
+	  rec = (struct zlog_rec *) (ring->buf + off);
+	  rec->len = 0;
+	  used += contig;
+	  rec = (struct zlog_rec *) ring->buf;
+	}
+    }
+  else
+    rec = (struct zlog_rec *) (ring->buf + off);
+
+  if (!used)
+    {
+      atomic_fetch_add_explicit (&ring->dropped, 1, memory_order_relaxed);
+      return 1;
+    }
+
+  rec->seq = atomic_fetch_add_explicit (&zlog_seq, 1, memory_order_relaxed);
+  atomic_store_explicit (&ring->head, head + used, memory_order_seq_cst);
+  atomic_fetch_add_explicit (&ring->queued, 1, memory_order_relaxed);
+
+  if (atomic_load_explicit (&writer_idle, memory_order_seq_cst))
+    {
+      pthread_mutex_lock (&wakelock);
+      pthread_cond_signal (&wakeup);
+      pthread_mutex_unlock (&wakelock);
+    }
+  return 1;
+}
+
+/* Write out whatever is queued, on the calling pthread. */
+static void
+zlog_async_flush (void)
+{
+  pthread_mutex_lock (&loglock);
+  zlog_async_drain ();
+  pthread_mutex_unlock (&loglock);
+}
+
+/* Write out what is queued for the log file and stdout using only
+ * async-signal-safe functions, and stop queueing.  Nothing is taken off
+ * the rings; the process is about to go away. */
+static void
+zlog_async_flush_sigsafe (void)
+{
+  struct zlog_ring *ring;
+  struct zlog_rec *rec;
+  size_t pos, head;
+
+  if (!zlog_default || !zlog_default->async)
+    return;
+  zlog_default->async = 0;
+
+  for (ring = zlog_rings; ring; ring = ring->next)
+    {
+      pos = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+      head = atomic_load_explicit (&ring->head, memory_order_acquire);
+      while (pos != head)
+	{
+	  rec = (struct zlog_rec *) (ring->buf + (pos & ZLOG_RING_MASK));
+	  if (!rec->len)
+	    {
+	      pos += ZLOG_RING_SIZE - (pos & ZLOG_RING_MASK);
+	      continue;
+	    }
+	  if ((rec->dests & (1 << ZLOG_DEST_FILE)) && logfile_fd >= 0)
+	    write_wrapper (logfile_fd, rec + 1, rec->len);
+	  if (rec->dests & (1 << ZLOG_DEST_STDOUT))
+	    write_wrapper (STDOUT_FILENO, rec + 1, rec->len);
+	  pos += ZLOG_REC_SIZE (rec->len);
+	}
+    }
+}
+
+void
+zlog_set_async (int enable)
+{
+  struct zlog *zl = zlog_default;
+
+  if (zl->async == enable)
+    return;
+  zl->async = enable;
+  if (!enable)
+    {
+      zlog_async_stop ();
+      zlog_async_flush ();
+    }
+}
+
+void
+zlog_async_get_stats (struct zlog_async_stats *stats)
+{
+  struct zlog_ring *ring;
+
+  pthread_mutex_lock (&loglock);
+  stats->queued = zlog_retired_queued;
+  stats->dropped = zlog_retired_dropped;
+  for (ring = zlog_rings; ring; ring = ring->next)
+    {
+      stats->queued += atomic_load_explicit (&ring->queued,
+					     memory_order_relaxed);
+      stats->dropped += atomic_load_explicit (&ring->dropped,
+					      memory_order_relaxed);
+    }
+  stats->written = zlog_written;
+  pthread_mutex_unlock (&loglock);
+}
+
 /* va_list version of zlog. */
 void
 vzlog (int priority, const char *format, va_list args)
@@ -170,6 +767,28 @@ vzlog (int priority, const char *format, va_list args)
   tsctl.already_rendered = 0;
   struct zlog *zl = zlog_default;
 
+  if (zl && zl->instance)
+   sprintf (proto_str, "%s[%d]: ", zl->protoname, zl->instance);
+  else if (zl)
+   sprintf (proto_str, "%s: ", zl->protoname);
+
+  /* Everything but the monitor vtys goes through the writer pthread.
+     vty_log() takes care of those itself, without loglock. */
+  if (zl && zl->async && zlog_async_vlog (zl, priority, proto_str,
+					  format, args))
+    {
+      if (priority <= zl->maxlvl[ZLOG_DEST_MONITOR])
+	{
+	  tsctl.precision = zl->timestamp_precision;
+	  vty_log ((zl->record_priority ? zlog_priority[priority] : NULL),
+		   proto_str, format, &tsctl, args);
+	}
+      errno = original_errno;
+      return;
+    }
+
+  pthread_mutex_lock (&loglock);
+
   /* When zlog_default is also NULL, use stderr for logging. */
   if (zl == NULL)
     {
@@ -181,6 +800,7 @@ vzlog (int priority, const char *format, va_list args)
       fflush (stderr);
 
       /* In this case we return at here. */
+      pthread_mutex_unlock (&loglock);
       errno = original_errno;
       return;
     }
@@ -195,11 +815,6 @@ vzlog (int priority, const char *format, va_list args)
       va_end(ac);
     }
 
-  if (zl->instance)
-   sprintf (proto_str, "%s[%d]: ", zl->protoname, zl->instance);
-  else
-   sprintf (proto_str, "%s: ", zl->protoname);
-
   /* File output. */
   if ((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp)
     {
@@ -230,7 +845,10 @@ vzlog (int priority, const char *format, va_list args)
       fflush (stdout);
     }
 
-  /* Terminal monitor. */
+  pthread_mutex_unlock (&loglock);
+
+  /* Terminal monitor.  Outside loglock, since writing to a vty may
+     log again. */
   if (priority <= zl->maxlvl[ZLOG_DEST_MONITOR])
     vty_log ((zl->record_priority ? zlog_priority[priority] : NULL),
 	     proto_str, format, &tsctl, args);
@@ -425,6 +1043,9 @@ zlog_signal(int signo, const char *action
   char *msgstart = buf;
 #define LOC s,buf+sizeof(buf)-s
 
+  /* Get out what was logged before we came here. */
+  zlog_async_flush_sigsafe ();
+
   time(&now);
   if (zlog_default)
     {
@@ -687,6 +1308,9 @@ void
 _zlog_assert_failed (const char *assertion, const char *file,
 		     unsigned int line, const char *function)
 {
+  /* Log synchronously from here on; we are about to abort. */
+  zlog_async_flush_sigsafe ();
+
   /* Force fallback file logging? */
   if (zlog_default && !zlog_default->fp &&
       ((logfile_fd = open_crashlog()) >= 0) &&
@@ -750,6 +1374,30 @@ void
 closezlog (void)
 {
   struct zlog *zl = zlog_default;
+  struct zlog_ring *ring, **prev;
+
+  zlog_async_stop ();
+
+  pthread_mutex_lock (&loglock);
+  zlog_async_drain ();
+  /* Rings of pthreads that are still running stay where they are. */
+  prev = &zlog_rings;
+  while ((ring = *prev))
+    {
+      if (ring == zlog_ring_self || ring->dead)
+	{
+	  *prev = ring->next;
+	  XFREE (MTYPE_ZLOG_RING, ring);
+	  continue;
+	}
+      prev = &ring->next;
+    }
+  if (zlog_ring_self)
+    {
+      pthread_setspecific (zlog_ring_key, NULL);
+      zlog_ring_self = NULL;
+    }
+  pthread_mutex_unlock (&loglock);
 
   closelog();
 
@@ -802,11 +1450,15 @@ zlog_reset_file (void)
 {
   struct zlog *zl = zlog_default;
 
+  /* queued messages still go to the old file */
+  pthread_mutex_lock (&loglock);
+  zlog_async_drain ();
   if (zl->fp)
     fclose (zl->fp);
   zl->fp = NULL;
   logfile_fd = -1;
   zl->maxlvl[ZLOG_DEST_FILE] = ZLOG_DISABLED;
+  pthread_mutex_unlock (&loglock);
 
   if (zl->filename)
     XFREE(MTYPE_ZLOG, zl->filename);
@@ -822,6 +1474,8 @@ zlog_rotate (void)
   struct zlog *zl = zlog_default;
   int level;
 
+  pthread_mutex_lock (&loglock);
+  zlog_async_drain ();
   if (zl->fp)
     fclose (zl->fp);
   zl->fp = NULL;
@@ -840,6 +1494,7 @@ zlog_rotate (void)
       umask(oldumask);
       if (zl->fp == NULL)
         {
+	  pthread_mutex_unlock (&loglock);
 	  zlog_err("Log rotate failed: cannot open file %s for append: %s",
 	  	   zl->filename, safe_strerror(save_errno));
 	  return -1;
@@ -847,6 +1502,7 @@ zlog_rotate (void)
       logfile_fd = fileno(zl->fp);
       zl->maxlvl[ZLOG_DEST_FILE] = level;
     }
+  pthread_mutex_unlock (&loglock);
 
   return 1;
 }
@@ -971,6 +1627,9 @@ static const struct zebra_desc_table command_types[] = {
   DESC_ENTRY    (ZEBRA_LABEL_MANAGER_CONNECT),
   DESC_ENTRY    (ZEBRA_GET_LABEL_CHUNK),
   DESC_ENTRY    (ZEBRA_RELEASE_LABEL_CHUNK),
+  DESC_ENTRY    (ZEBRA_ROUTE_BATCH),
+  DESC_ENTRY    (ZEBRA_ZAPI_RING),
+  DESC_ENTRY    (ZEBRA_ZAPI_RING_START),
 };
 #undef DESC_ENTRY
 
@@ -99,6 +99,21 @@ extern int zlog_reset_file (void);
 /* Rotate log. */
 extern int zlog_rotate (void);
 
+/* Hand file, stdout and syslog output to a writer pthread instead of
+   writing it out on the calling pthread.  Messages are queued on a ring
+   buffer per pthread; when that is full, they are dropped and counted
+   rather than holding up the caller.  Monitor vtys are still written to
+   directly. */
+extern void zlog_set_async (int enable);
+
+struct zlog_async_stats
+{
+  unsigned long queued;
+  unsigned long written;
+  unsigned long dropped;
+};
+extern void zlog_async_get_stats (struct zlog_async_stats *);
+
 /* For hackey message lookup and check */
 #define LOOKUP_DEF(x, y, def) mes_lookup(x, x ## _max, y, def, #x)
 #define LOOKUP(x, y) LOOKUP_DEF(x, y, "(no item found)")
@@ -39,6 +39,8 @@ struct zlog
                            priority of the message? */
   int syslog_options;   /* 2nd arg to openlog */
   int timestamp_precision;      /* # of digits of subsecond precision */
+  int async;		/* write file, stdout and syslog output from a
+			   separate pthread, see zlog_set_async() */
 };
 
 /* Default logging strucutre. */
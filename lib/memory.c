@@ -17,6 +17,7 @@
 #include <zebra.h>
 
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "memory.h"
 #include "log.h"
@@ -56,18 +57,280 @@ static inline void *mt_checkalloc(struct memtype *mt, void *ptr, size_t size)
 	return ptr;
 }
 
+/* Slabs.
+ *
+ * Each slab memtype has a pool of free objects, and the slabs they were
+ * carved from, behind a mutex.  On top of that, every pthread keeps up to
+ * MSLAB_CACHE_MAX free objects per slab memtype of its own; the mutex is
+ * only taken when that cache runs empty or overflows, and then to move
+ * MSLAB_BATCH objects at a time.  A pthread's cache goes back to the pool
+ * when it exits.
+ *
+ * Slabs are never given back; a daemon that once held a full table will
+ * likely do so again.
+ */
+#define MSLAB_PAGE_SIZE	65536
+#define MSLAB_ALIGN	sizeof(void *)
+#define MSLAB_BATCH	64
+#define MSLAB_CACHE_MAX	(MSLAB_BATCH * 2)
+#define MSLAB_TYPES_MAX	64
+
+#define MSLAB_ROUNDUP(x) (((x) + MSLAB_ALIGN - 1) & ~(MSLAB_ALIGN - 1))
+
+struct memslab_page {
+	struct memslab_page *next;
+};
+#define MSLAB_PAGE_HDR	MSLAB_ROUNDUP(sizeof(struct memslab_page))
+
+struct memslab_obj {
+	struct memslab_obj *next;
+};
+
+struct memslab {
+	pthread_mutex_t mtx;
+	size_t objsize;
+	size_t per_page;
+	unsigned int index;
+
+	struct memslab_page *pages;
+	size_t n_pages;
+	struct memslab_obj *free;
+	size_t n_free;
+};
+
+struct memslab_cache {
+	struct memslab_obj *free;
+	unsigned int count;
+};
+
+static struct memslab *mslab_types[MSLAB_TYPES_MAX];
+static unsigned int mslab_count;
+
+static __thread struct memslab_cache mslab_cache[MSLAB_TYPES_MAX];
+static __thread bool mslab_registered;
+static pthread_key_t mslab_key;
+static pthread_once_t mslab_once = PTHREAD_ONCE_INIT;
+
+/* called from the memtype's constructor */
+void qmem_slab_init(struct memtype *mt)
+{
+	struct memslab *slab;
+
+#if defined(__SANITIZE_ADDRESS__)
+	/* let ASan see every object on its own */
+	return;
+#elif defined(__has_feature)
+# if __has_feature(address_sanitizer)
+	return;
+# endif
+#endif
+	if (mslab_count == MSLAB_TYPES_MAX)
+		return;
+	if (mt->slab_size > (MSLAB_PAGE_SIZE - MSLAB_PAGE_HDR) / 16)
+		return;
+
+	slab = calloc(1, sizeof(*slab));
+	if (!slab)
+		return;
+
+	pthread_mutex_init(&slab->mtx, NULL);
+	slab->objsize = MSLAB_ROUNDUP(mt->slab_size);
+	if (slab->objsize < sizeof(struct memslab_obj))
+		slab->objsize = sizeof(struct memslab_obj);
+	slab->per_page = (MSLAB_PAGE_SIZE - MSLAB_PAGE_HDR) / slab->objsize;
+	slab->index = mslab_count;
+
+	mslab_types[mslab_count++] = slab;
+	mt->slab = slab;
+}
+
+/* move up to n objects from a pthread's cache back to the pool */
+static void mslab_flush(struct memslab *slab, struct memslab_cache *cache,
+			unsigned int n)
+{
+	struct memslab_obj *first, *last;
+	unsigned int i;
+
+	if (n == 0 || cache->free == NULL)
+		return;
+
+	first = last = cache->free;
+	for (i = 1; i < n && last->next; i++)
+		last = last->next;
+	cache->free = last->next;
+	cache->count -= i;
+
+	pthread_mutex_lock(&slab->mtx);
+	last->next = slab->free;
+	slab->free = first;
+	slab->n_free += i;
+	pthread_mutex_unlock(&slab->mtx);
+}
+
+static void mslab_thread_exit(void *arg)
+{
+	unsigned int i;
+
+	for (i = 0; i < mslab_count; i++)
+		mslab_flush(mslab_types[i], &mslab_cache[i],
+			    mslab_cache[i].count);
+}
+
+static void mslab_key_init(void)
+{
+	pthread_key_create(&mslab_key, mslab_thread_exit);
+}
+
+/* make sure mslab_thread_exit() runs for this pthread */
+static void mslab_register(void)
+{
+	pthread_once(&mslab_once, mslab_key_init);
+	pthread_setspecific(mslab_key, mslab_cache);
+	mslab_registered = true;
+}
+
+/* carve a new slab into the pool; called with the mutex held */
+static void mslab_grow(struct memslab *slab)
+{
+	struct memslab_page *page;
+	struct memslab_obj *obj;
+	char *base;
+	size_t i;
+
+	page = malloc(MSLAB_PAGE_SIZE);
+	if (!page)
+		return;
+
+	page->next = slab->pages;
+	slab->pages = page;
+	slab->n_pages++;
+
+	/* in reverse, so the pool hands out ascending addresses */
+	base = (char *)page + MSLAB_PAGE_HDR;
+	for (i = slab->per_page; i-- > 0;) {
+		obj = (struct memslab_obj *)(base + i * slab->objsize);
+		obj->next = slab->free;
+		slab->free = obj;
+	}
+	slab->n_free += slab->per_page;
+}
+
+/* move up to MSLAB_BATCH objects from the pool to a pthread's cache */
+static void mslab_refill(struct memslab *slab, struct memslab_cache *cache)
+{
+	struct memslab_obj *obj;
+	unsigned int i;
+
+	if (!mslab_registered)
+		mslab_register();
+
+	pthread_mutex_lock(&slab->mtx);
+	if (slab->free == NULL)
+		mslab_grow(slab);
+	for (i = 0; i < MSLAB_BATCH && slab->free; i++) {
+		obj = slab->free;
+		slab->free = obj->next;
+		obj->next = cache->free;
+		cache->free = obj;
+	}
+	slab->n_free -= i;
+	pthread_mutex_unlock(&slab->mtx);
+
+	cache->count += i;
+}
+
+static inline void *mslab_alloc(struct memtype *mt, size_t size)
+{
+	struct memslab_cache *cache = &mslab_cache[mt->slab->index];
+	struct memslab_obj *obj;
+
+	assert(size <= mt->slab_size);
+
+	if (__builtin_expect(cache->free == NULL, 0)) {
+		mslab_refill(mt->slab, cache);
+		if (cache->free == NULL)
+			return NULL;
+	}
+	obj = cache->free;
+	cache->free = obj->next;
+	cache->count--;
+	return obj;
+}
+
+static inline void mslab_free(struct memtype *mt, void *ptr)
+{
+	struct memslab_cache *cache = &mslab_cache[mt->slab->index];
+	struct memslab_obj *obj = ptr;
+
+	if (__builtin_expect(!mslab_registered, 0))
+		mslab_register();
+
+	obj->next = cache->free;
+	cache->free = obj;
+	if (++cache->count > MSLAB_CACHE_MAX)
+		mslab_flush(mt->slab, cache, MSLAB_BATCH);
+}
+
+bool mtype_slab_stats(struct memtype *mt, struct memslab_stats *st)
+{
+	struct memslab *slab = mt->slab;
+	size_t n_alloc;
+
+	if (!slab)
+		return false;
+
+	pthread_mutex_lock(&slab->mtx);
+	st->pages = slab->n_pages;
+	st->free = slab->n_free;
+	pthread_mutex_unlock(&slab->mtx);
+
+	st->objsize = slab->objsize;
+	st->bytes = st->pages * MSLAB_PAGE_SIZE;
+	st->total = st->pages * slab->per_page;
+
+	/* whatever is neither in the pool nor allocated is in some pthread's
+	 * cache.  The counters aren't read atomically together, so this is
+	 * only approximate while other pthreads are busy. */
+	n_alloc = atomic_load_explicit(&mt->n_alloc, memory_order_relaxed);
+	if (st->free + n_alloc < st->total)
+		st->cached = st->total - st->free - n_alloc;
+	else
+		st->cached = 0;
+	st->free += st->cached;
+	return true;
+}
+
 void *qmalloc(struct memtype *mt, size_t size)
 {
+	if (mt->slab)
+		return mt_checkalloc(mt, mslab_alloc(mt, size), size);
 	return mt_checkalloc(mt, malloc(size), size);
 }
 
 void *qcalloc(struct memtype *mt, size_t size)
 {
+	void *ptr;
+
+	if (mt->slab) {
+		ptr = mslab_alloc(mt, size);
+		if (ptr)
+			memset(ptr, 0, size);
+		return mt_checkalloc(mt, ptr, size);
+	}
 	return mt_checkalloc(mt, calloc(size, 1), size);
 }
 
 void *qrealloc(struct memtype *mt, void *ptr, size_t size)
 {
+	if (mt->slab && ptr) {
+		/* the object already has all the room it can have */
+		assert(size <= mt->slab_size);
+		mt_count_free(mt);
+		return mt_checkalloc(mt, ptr, size);
+	}
+	if (mt->slab)
+		return qmalloc(mt, size);
+
 	if (ptr)
 		mt_count_free(mt);
 	return mt_checkalloc(mt, ptr ? realloc(ptr, size) : malloc(size), size);
@@ -75,14 +338,28 @@ void *qrealloc(struct memtype *mt, void *ptr, size_t size)
 
 void *qstrdup(struct memtype *mt, const char *str)
 {
-	return mt_checkalloc(mt, strdup(str), strlen(str) + 1);
+	size_t len = strlen(str) + 1;
+	void *ptr;
+
+	if (mt->slab) {
+		ptr = mslab_alloc(mt, len);
+		if (ptr)
+			memcpy(ptr, str, len);
+		return mt_checkalloc(mt, ptr, len);
+	}
+	return mt_checkalloc(mt, strdup(str), len);
 }
 
 void qfree(struct memtype *mt, void *ptr)
 {
-	if (ptr)
-		mt_count_free(mt);
-	free(ptr);
+	if (!ptr)
+		return;
+
+	mt_count_free(mt);
+	if (mt->slab)
+		mslab_free(mt, ptr);
+	else
+		free(ptr);
 }
 
 int qmem_walk(qmem_walk_fn *func, void *arg)
@@ -18,16 +18,20 @@
 #define _QUAGGA_MEMORY_H
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <frratomic.h>
 
 #define array_size(ar) (sizeof(ar) / sizeof(ar[0]))
 
 #define SIZE_VAR ~0UL
+struct memslab;
 struct memtype {
 	struct memtype *next, **ref;
 	const char *name;
 	_Atomic size_t n_alloc;
 	_Atomic size_t size;
+	size_t slab_size;
+	struct memslab *slab;
 };
 
 struct memgroup {
@@ -123,11 +127,12 @@ struct memgroup {
 	extern struct memtype _mt_##name; \
 	static struct memtype * const MTYPE_ ## name = &_mt_##name;
 
-#define DEFINE_MTYPE_ATTR(group, mname, attr, desc) \
+#define DEFINE_MTYPE_ATTR_SLAB(group, mname, attr, desc, objsize) \
 	attr struct memtype _mt_##mname \
 	__attribute__ ((section (".data.mtypes"))) = { \
 		.name = desc, \
 		.next = NULL, .n_alloc = 0, .size = 0, .ref = NULL, \
+		.slab_size = objsize, .slab = NULL, \
 	}; \
 	static void _mtinit_##mname (void) \
 	  __attribute__ ((_CONSTRUCTOR (1001))); \
@@ -136,7 +141,9 @@ struct memgroup {
 			_mg_##group.insert = &_mg_##group.types; \
 		_mt_##mname.ref = _mg_##group.insert; \
 		*_mg_##group.insert = &_mt_##mname; \
-		_mg_##group.insert =  &_mt_##mname.next; } \
+		_mg_##group.insert =  &_mt_##mname.next; \
+		if (_mt_##mname.slab_size) \
+			qmem_slab_init(&_mt_##mname); } \
 	static void _mtfini_##mname (void) \
 	  __attribute__ ((_DESTRUCTOR (1001))); \
 	static void _mtfini_##mname (void) \
@@ -144,12 +151,33 @@ struct memgroup {
 			_mt_##mname.next->ref = _mt_##mname.ref; \
 		*_mt_##mname.ref = _mt_##mname.next; }
 
+#define DEFINE_MTYPE_ATTR(group, mname, attr, desc) \
+	DEFINE_MTYPE_ATTR_SLAB(group, mname, attr, desc, 0)
+
 #define DEFINE_MTYPE(group, name, desc) \
 	DEFINE_MTYPE_ATTR(group, name, , desc)
 #define DEFINE_MTYPE_STATIC(group, name, desc) \
 	DEFINE_MTYPE_ATTR(group, name, static, desc) \
 	static struct memtype * const MTYPE_ ## name = &_mt_##name;
 
+/* Slab-backed memtypes, for objects allocated and freed in great numbers.
+ * Allocations of up to objsize bytes are carved from 64k slabs and go
+ * through a small per-pthread cache of free objects, rather than each
+ * being a trip through malloc().  Asking a slab memtype for more than
+ * objsize bytes is a bug.  Slabs are kept until the process exits; "show
+ * memory" reports how much of them is in use.
+ *
+ *    DEFINE_MTYPE_SLAB(MYDAEMON, MYDAEMON_ROUTE, "my route",
+ *                      sizeof(struct my_route))
+ */
+#define DEFINE_MTYPE_SLAB(group, name, desc, objsize) \
+	DEFINE_MTYPE_ATTR_SLAB(group, name, , desc, objsize)
+#define DEFINE_MTYPE_STATIC_SLAB(group, name, desc, objsize) \
+	DEFINE_MTYPE_ATTR_SLAB(group, name, static, desc, objsize) \
+	static struct memtype * const MTYPE_ ## name = &_mt_##name;
+
+extern void qmem_slab_init(struct memtype *mt);
+
 DECLARE_MGROUP(LIB)
 DECLARE_MTYPE(TMP)
 
@@ -177,6 +205,17 @@ static inline size_t mtype_stats_alloc(struct memtype *mt)
 	return mt->n_alloc;
 }
 
+struct memslab_stats {
+	size_t objsize;		/* bytes per object */
+	size_t pages;		/* slabs allocated */
+	size_t bytes;		/* ... and the memory they take up */
+	size_t total;		/* objects the slabs have room for */
+	size_t free;		/* ... of which unused */
+	size_t cached;		/* ... of which unused, held by a pthread */
+};
+/* returns false if mt isn't slab-backed */
+extern bool mtype_slab_stats(struct memtype *mt, struct memslab_stats *st);
+
 /* NB: calls are ordered by memgroup; and there is a call with mt == NULL for
  * each memgroup (so that a header can be printed, and empty memgroups show)
  *
@@ -81,6 +81,9 @@ show_memory_mallinfo (struct vty *vty)
 static int qmem_walker(void *arg, struct memgroup *mg, struct memtype *mt)
 {
 	struct vty *vty = arg;
+	struct memslab_stats st;
+	char buf[MTYPE_MEMSTR_LEN];
+
 	if (!mt)
 		vty_out (vty, "--- qmem %s ---%s", mg->name, VTY_NEWLINE);
 	else {
@@ -93,6 +96,17 @@ static int qmem_walker(void *arg, struct memgroup *mg, struct memtype *mt)
 				 mt->size == SIZE_VAR ? "(variably sized)" :
 				 size, VTY_NEWLINE);
 		}
+		if (mtype_slab_stats(mt, &st) && st.pages != 0) {
+			if (mt->n_alloc == 0)
+				vty_out (vty, "%-30s: %10d%s",
+					 mt->name, 0, VTY_NEWLINE);
+			vty_out (vty, "%-30s  slab: %zu x %zu bytes in %s, "
+				 "%zu%% free (%zu cached)%s", "",
+				 st.total, st.objsize,
+				 mtype_memstr (buf, sizeof(buf), st.bytes),
+				 st.free * 100 / st.total, st.cached,
+				 VTY_NEWLINE);
+		}
 	}
 	return 0;
 }
@@ -596,7 +596,10 @@ static void trie_install_fn (struct prefix_list_entry *object,
         return;
       if ((*updptr)->prefix.prefixlen < object->prefix.prefixlen)
         break;
-      if ((*updptr)->seq > object->seq)
+      /* only by seq among the same length, otherwise what follows the
+       * entry differs between the chains it is on */
+      if ((*updptr)->prefix.prefixlen == object->prefix.prefixlen
+          && (*updptr)->seq > object->seq)
         break;
       updptr = &(*updptr)->next_best;
     }
@@ -739,10 +742,47 @@ prefix_list_entry_match (struct prefix_list_entry *pentry, struct prefix *p)
   return 1;
 }
 
+/* Only the lengths of an entry found on an up_chain need checking: it is
+ * on the chain for its leading bits, which the prefix looked up shares by
+ * the time it gets there. */
+static int
+prefix_list_entry_match_len (struct prefix_list_entry *pentry, u_char plen)
+{
+  if (pentry->prefix.prefixlen > plen)
+    return 0;
+
+  if (! pentry->le && ! pentry->ge)
+    return pentry->prefix.prefixlen == plen;
+
+  if (pentry->le && plen > pentry->le)
+    return 0;
+  if (pentry->ge && plen < pentry->ge)
+    return 0;
+  return 1;
+}
+
+/* The first entry by seq to match p out of a trie chain and pbest.
+ * Entries on final_chains go beyond the trie, so need the whole prefix
+ * compared. */
+static struct prefix_list_entry *
+prefix_list_chain_best (struct prefix_list_entry *pentry, struct prefix *p,
+                        struct prefix_list_entry *pbest, int final)
+{
+  for (; pentry; pentry = pentry->next_best)
+    {
+      if (pbest && pbest->seq < pentry->seq)
+        continue;
+      if (final ? prefix_list_entry_match (pentry, p)
+                : prefix_list_entry_match_len (pentry, p->prefixlen))
+        pbest = pentry;
+    }
+  return pbest;
+}
+
 enum prefix_list_type
 prefix_list_apply (struct prefix_list *plist, void *object)
 {
-  struct prefix_list_entry *pentry, *pbest = NULL;
+  struct prefix_list_entry *pbest = NULL;
 
   struct prefix *p = (struct prefix *) object;
   uint8_t *byte = &p->u.prefix;
@@ -756,17 +796,15 @@ prefix_list_apply (struct prefix_list *plist, void *object)
   if (plist->count == 0)
     return PREFIX_PERMIT;
 
+  if (p->family != plist->head->prefix.family)
+    return PREFIX_DENY;
+
   depth = plist->master->trie_depth;
   table = plist->trie;
   while (1)
     {
-      for (pentry = table->entries[*byte].up_chain; pentry; pentry = pentry->next_best)
-        {
-          if (pbest && pbest->seq < pentry->seq)
-            continue;
-          if (prefix_list_entry_match (pentry, p))
-            pbest = pentry;
-        }
+      pbest = prefix_list_chain_best (table->entries[*byte].up_chain, p,
+                                      pbest, 0);
 
       if (validbits <= PLC_BITS)
         break;
@@ -782,13 +820,8 @@ prefix_list_apply (struct prefix_list *plist, void *object)
           continue;
         }
 
-      for (pentry = table->entries[*byte].final_chain; pentry; pentry = pentry->next_best)
-        {
-          if (pbest && pbest->seq < pentry->seq)
-            continue;
-          if (prefix_list_entry_match (pentry, p))
-            pbest = pentry;
-        }
+      pbest = prefix_list_chain_best (table->entries[*byte].final_chain, p,
+                                      pbest, 1);
       break;
     }
 
@@ -798,6 +831,93 @@ prefix_list_apply (struct prefix_list *plist, void *object)
   return pbest->type;
 }
 
+/* What the up_chain at one level of the trie came to for the last prefix
+ * looked up through it. */
+struct pltrie_memo
+{
+  uint8_t byte;
+  u_char prefixlen;
+  struct prefix_list_entry *best;
+};
+
+void
+prefix_list_apply_bulk (struct prefix_list *plist, struct prefix **prefixes,
+                        size_t count, enum prefix_list_type *results)
+{
+  struct pltrie_memo memo[PLC_MAXLEVEL];
+  size_t i, depth, maxdepth, known = 0;
+
+  if (plist == NULL || plist->count == 0)
+    {
+      for (i = 0; i < count; i++)
+        results[i] = plist ? PREFIX_PERMIT : PREFIX_DENY;
+      return;
+    }
+
+  maxdepth = plist->master->trie_depth;
+  for (i = 0; i < count; i++)
+    {
+      struct prefix *p = prefixes[i];
+      uint8_t *bytes = &p->u.prefix;
+      size_t validbits = p->prefixlen;
+      struct pltrie_table *table = plist->trie;
+      struct prefix_list_entry *pbest = NULL;
+
+      if (p->family != plist->head->prefix.family)
+        {
+          results[i] = PREFIX_DENY;
+          continue;
+        }
+
+      /* memo[0 .. known - 1] are along the path to the last prefix, and
+       * the trie doesn't change under us, so as long as this one takes
+       * the same way down there is no need to walk the chains again. */
+      for (depth = 0; ; depth++)
+        {
+          struct pltrie_memo *m = &memo[depth];
+          struct prefix_list_entry *best;
+          uint8_t byte = bytes[depth];
+
+          if (depth >= known || m->byte != byte)
+            {
+              known = depth + 1;
+              m->byte = byte;
+              m->prefixlen = p->prefixlen;
+              m->best = prefix_list_chain_best (table->entries[byte].up_chain,
+                                                p, NULL, 0);
+            }
+          else if (m->prefixlen != p->prefixlen)
+            {
+              m->prefixlen = p->prefixlen;
+              m->best = prefix_list_chain_best (table->entries[byte].up_chain,
+                                                p, NULL, 0);
+            }
+
+          best = m->best;
+          if (best && (!pbest || best->seq < pbest->seq))
+            pbest = best;
+
+          if (validbits <= PLC_BITS)
+            break;
+          validbits -= PLC_BITS;
+
+          if (depth + 1 < maxdepth)
+            {
+              if (!table->entries[byte].next_table)
+                break;
+              table = table->entries[byte].next_table;
+              continue;
+            }
+
+          pbest = prefix_list_chain_best (table->entries[byte].final_chain, p,
+                                          pbest, 1);
+          break;
+        }
+
+      results[i] = pbest ? pbest->type : PREFIX_DENY;
+    }
+}
+
 static void __attribute__ ((unused))
 prefix_list_print (struct prefix_list *plist)
 {
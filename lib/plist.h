@@ -53,6 +53,14 @@ extern const char *prefix_list_name (struct prefix_list *);
 extern struct prefix_list *prefix_list_lookup (afi_t, const char *);
 extern enum prefix_list_type prefix_list_apply (struct prefix_list *, void *);
 
+/* prefix_list_apply() to count prefixes at once, with the result for each
+ * going into results[].  Prefixes that follow each other in a route table
+ * walk mostly share their way down the prefix-list's trie, so doing them
+ * in table order saves going over the same entries again. */
+extern void prefix_list_apply_bulk (struct prefix_list *, struct prefix **,
+                                    size_t count,
+                                    enum prefix_list_type *results);
+
 extern struct prefix_list *prefix_bgp_orf_lookup (afi_t, const char *);
 extern struct stream * prefix_bgp_orf_entry (struct stream *,
                                              struct prefix_list *,
@@ -0,0 +1,196 @@
+/*
+ * Circular byte buffer.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "ringbuf.h"
+#include "log.h"
+#include "network.h"
+
+DEFINE_MTYPE_STATIC(LIB, RINGBUFFER,      "Ring buffer")
+DEFINE_MTYPE_STATIC(LIB, RINGBUFFER_DATA, "Ring buffer data")
+
+/* It should always be true that: start < size && count <= size */
+
+struct ringbuf *
+ringbuf_new (size_t size)
+{
+  struct ringbuf *buf;
+
+  assert (size > 0);
+
+  buf = XCALLOC (MTYPE_RINGBUFFER, sizeof (struct ringbuf));
+  buf->data = XMALLOC (MTYPE_RINGBUFFER_DATA, size);
+  buf->size = size;
+
+  return buf;
+}
+
+void
+ringbuf_del (struct ringbuf *buf)
+{
+  XFREE (MTYPE_RINGBUFFER_DATA, buf->data);
+  XFREE (MTYPE_RINGBUFFER, buf);
+}
+
+size_t
+ringbuf_remain (const struct ringbuf *buf)
+{
+  return buf->count;
+}
+
+size_t
+ringbuf_space (const struct ringbuf *buf)
+{
+  return buf->size - buf->count;
+}
+
+/* Offset of the byte offset bytes past the first readable one. */
+static inline size_t
+ringbuf_offset (const struct ringbuf *buf, size_t offset)
+{
+  offset += buf->start;
+  return (offset >= buf->size) ? offset - buf->size : offset;
+}
+
+size_t
+ringbuf_put (struct ringbuf *buf, const void *data, size_t size)
+{
+  const u_char *src = data;
+  size_t end, chunk;
+
+  if (size > ringbuf_space (buf))
+    size = ringbuf_space (buf);
+
+  end = ringbuf_offset (buf, buf->count);
+  chunk = MIN (size, buf->size - end);
+  memcpy (buf->data + end, src, chunk);
+  memcpy (buf->data, src + chunk, size - chunk);
+
+  buf->count += size;
+  return size;
+}
+
+size_t
+ringbuf_peek (const struct ringbuf *buf, size_t offset, void *data,
+              size_t size)
+{
+  u_char *dst = data;
+  size_t from, chunk;
+
+  if (offset >= buf->count)
+    return 0;
+  if (size > buf->count - offset)
+    size = buf->count - offset;
+
+  from = ringbuf_offset (buf, offset);
+  chunk = MIN (size, buf->size - from);
+  memcpy (dst, buf->data + from, chunk);
+  memcpy (dst + chunk, buf->data, size - chunk);
+
+  return size;
+}
+
+size_t
+ringbuf_get (struct ringbuf *buf, void *data, size_t size)
+{
+  size = ringbuf_peek (buf, 0, data, size);
+
+  buf->start = ringbuf_offset (buf, size);
+  buf->count -= size;
+
+  /* keep the free space in one piece while we can */
+  if (buf->count == 0)
+    buf->start = 0;
+
+  return size;
+}
+
+size_t
+ringbuf_copy (struct ringbuf *to, struct ringbuf *from, size_t size)
+{
+  size_t from_start, chunk, done;
+
+  if (size > ringbuf_remain (from))
+    size = ringbuf_remain (from);
+  if (size > ringbuf_space (to))
+    size = ringbuf_space (to);
+
+  /* at most two contiguous pieces to take out of from */
+  from_start = from->start;
+  chunk = MIN (size, from->size - from_start);
+  done = ringbuf_put (to, from->data + from_start, chunk);
+  done += ringbuf_put (to, from->data, size - chunk);
+
+  from->start = ringbuf_offset (from, done);
+  from->count -= done;
+  if (from->count == 0)
+    from->start = 0;
+
+  return done;
+}
+
+void
+ringbuf_reset (struct ringbuf *buf)
+{
+  buf->start = buf->count = 0;
+}
+
+ssize_t
+ringbuf_read_try (struct ringbuf *buf, int fd)
+{
+  struct iovec iov[2];
+  size_t end, space;
+  int iovcnt = 1;
+  ssize_t nbytes;
+
+  space = ringbuf_space (buf);
+  if (space == 0)
+    {
+      /* Fatal (not transient) error, since retrying will not help
+         until someone empties the buffer. */
+      zlog_warn ("%s: no room left to read fd %d into", __func__, fd);
+      return -1;
+    }
+
+  end = ringbuf_offset (buf, buf->count);
+  iov[0].iov_base = buf->data + end;
+  iov[0].iov_len = MIN (space, buf->size - end);
+  if (iov[0].iov_len < space)
+    {
+      iov[1].iov_base = buf->data;
+      iov[1].iov_len = space - iov[0].iov_len;
+      iovcnt = 2;
+    }
+
+  if ((nbytes = readv (fd, iov, iovcnt)) >= 0)
+    {
+      buf->count += nbytes;
+      return nbytes;
+    }
+  /* Error: was it transient (return -2) or fatal (return -1)? */
+  if (ERRNO_IO_RETRY (errno))
+    return -2;
+  zlog_warn ("%s: read failed on fd %d: %s", __func__, fd,
+             safe_strerror (errno));
+  return -1;
+}
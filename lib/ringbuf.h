@@ -0,0 +1,78 @@
+/*
+ * Circular byte buffer.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _ZEBRA_RINGBUF_H
+#define _ZEBRA_RINGBUF_H
+
+/* A fixed size FIFO of bytes.  Unlike struct stream, space freed by reading
+   from the front can be reused at once, so a socket can be read in large
+   chunks and parsed a message at a time without ever moving data around.
+   Not thread safe. */
+struct ringbuf
+{
+  size_t size;
+  /* Offset of the first readable byte. */
+  size_t start;
+  /* Number of readable bytes. */
+  size_t count;
+  u_char *data;
+};
+
+/* Create a ring buffer holding up to size bytes. */
+extern struct ringbuf *ringbuf_new (size_t size);
+
+/* Free the ring buffer and its contents. */
+extern void ringbuf_del (struct ringbuf *);
+
+/* Number of bytes that can be read. */
+extern size_t ringbuf_remain (const struct ringbuf *);
+
+/* Number of bytes that can be written. */
+extern size_t ringbuf_space (const struct ringbuf *);
+
+/* Append up to size bytes from data.  Returns how many were written, which
+   is less than size if the buffer filled up. */
+extern size_t ringbuf_put (struct ringbuf *, const void *data, size_t size);
+
+/* Copy up to size bytes into data and drop them from the buffer.  Returns
+   how many were read. */
+extern size_t ringbuf_get (struct ringbuf *, void *data, size_t size);
+
+/* Like ringbuf_get, but starting offset bytes in, and without dropping
+   anything. */
+extern size_t ringbuf_peek (const struct ringbuf *, size_t offset,
+                            void *data, size_t size);
+
+/* Move up to size bytes from the front of one buffer to the end of the
+   other.  Returns how many were moved. */
+extern size_t ringbuf_copy (struct ringbuf *to, struct ringbuf *from,
+                            size_t size);
+
+/* Drop everything in the buffer. */
+extern void ringbuf_reset (struct ringbuf *);
+
+/* Fill as much of the free space as the fd has data for, with a single
+   readv() call.  Returns the number of bytes read, 0 on EOF, -2 for a
+   transient error (the caller should try again later) and -1 for a fatal
+   error or if the buffer is full; same as stream_read_try(). */
+extern ssize_t ringbuf_read_try (struct ringbuf *, int fd);
+
+#endif /* _ZEBRA_RINGBUF_H */
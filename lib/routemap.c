@@ -29,6 +29,7 @@
 #include "command.h"
 #include "log.h"
 #include "hash.h"
+#include "jhash.h"
 #include "libfrr.h"
 
 DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP,          "Route map")
@@ -735,6 +736,13 @@ static void route_map_rule_delete (struct route_map_rule_list *,
 				   struct route_map_rule *);
 static int rmap_debug = 0;
 
+/* See route_map_generation().  Never 0, so that 0 can stand for "not
+   worked out yet". */
+static unsigned int rmap_generation = 1;
+
+static void route_map_cache_free (struct route_map *map);
+static void route_map_cache_show (struct vty *vty, struct route_map *map);
+
 static void
 route_map_index_delete (struct route_map_index *, int);
 
@@ -782,6 +790,8 @@ route_map_add (const char *name)
   if (!list->tail)
     list->tail = map;
 
+  route_map_generation_bump ();
+
   /* Execute hook. */
   if (route_map_master.add_hook)
     {
@@ -822,6 +832,7 @@ route_map_free_map (struct route_map *map)
     list->head = map->next;
 
   hash_release(route_map_master_hash, map);
+  route_map_cache_free (map);
   XFREE (MTYPE_ROUTE_MAP_NAME, map->name);
   XFREE (MTYPE_ROUTE_MAP, map);
 }
@@ -838,6 +849,8 @@ route_map_delete (struct route_map *map)
 
   name = map->name;
   map->head = NULL;
+  route_map_cache_free (map);
+  route_map_generation_bump ();
 
   /* Clear all dependencies */
   route_map_clear_all_references(name);
@@ -1027,6 +1040,8 @@ vty_show_route_map_entry (struct vty *vty, struct route_map *map)
       else if (index->exitpolicy == RMAP_EXIT)
         vty_out (vty, "    Exit routemap%s", VTY_NEWLINE);
     }
+
+  route_map_cache_show (vty, map);
 }
 
 static int
@@ -1104,6 +1119,8 @@ route_map_index_delete (struct route_map_index *index, int notify)
   if (index->nextrm)
     XFREE (MTYPE_ROUTE_MAP_NAME, index->nextrm);
 
+  route_map_generation_bump ();
+
     /* Execute event hook. */
   if (route_map_master.event_hook && notify)
     {
@@ -1172,6 +1189,8 @@ route_map_index_add (struct route_map *map, enum route_map_type type,
       point->prev = index;
     }
 
+  route_map_generation_bump ();
+
   /* Execute event hook. */
   if (route_map_master.event_hook)
     {
@@ -1265,6 +1284,8 @@ route_map_rule_add (struct route_map_rule_list *list,
   else
     list->head = rule;
   list->tail = rule;
+
+  route_map_generation_bump ();
 }
 
 /* Delete rule from rule list. */
@@ -1288,6 +1309,8 @@ route_map_rule_delete (struct route_map_rule_list *list,
     list->head = rule->next;
 
   XFREE (MTYPE_ROUTE_MAP_RULE, rule);
+
+  route_map_generation_bump ();
 }
 
 /* strcmp wrapper function which don't crush even argument is NULL. */
@@ -1636,8 +1659,15 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
               /* Call another route-map if available */
               if (index->nextrm)
                 {
-                  struct route_map *nextrm =
+                  struct route_map *nextrm;
+
+                  if (index->nextrm_generation != rmap_generation)
+                    {
+                      index->nextrm_map =
                                     route_map_lookup_by_name (index->nextrm);
+                      index->nextrm_generation = rmap_generation;
+                    }
+                  nextrm = index->nextrm_map;
 
                   if (nextrm) /* Target route-map found, jump to it */
                     {
@@ -1687,6 +1717,312 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
   return RMAP_DENYMATCH;
 }
 
+unsigned int
+route_map_generation (void)
+{
+  return rmap_generation;
+}
+
+void
+route_map_generation_bump (void)
+{
+  if (++rmap_generation == 0)
+    rmap_generation = 1;
+}
+
+/* Compile a list name into a route_map_list_ref. */
+void *
+route_map_list_ref_compile (const char *arg)
+{
+  struct route_map_list_ref *ref;
+
+  ref = XCALLOC (MTYPE_ROUTE_MAP_COMPILED, sizeof (struct route_map_list_ref));
+  ref->name = XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
+  return ref;
+}
+
+void
+route_map_list_ref_free (void *rule)
+{
+  struct route_map_list_ref *ref = rule;
+
+  XFREE (MTYPE_ROUTE_MAP_COMPILED, ref->name);
+  XFREE (MTYPE_ROUTE_MAP_COMPILED, ref);
+}
+
+/* Memoized results of route_map_apply_cached().
+
+   A map is cacheable if it has neither set nor call clauses and all its
+   matches are RMAP_RULE_CACHEABLE: its result is then a function of the
+   prefix and the caller's key alone, and applying it changes nothing.
+   Whether the map qualifies, and everything it has cached, holds for one
+   route_map_generation(); after any configuration change the cache starts
+   over.  Whether the map is route_map_prefix_independent() is worked out
+   along with it, and if so results are kept by key and address family
+   alone, so that one entry serves every prefix.
+
+   At most ROUTE_MAP_CACHE_MAX results are kept, which bounds both the
+   cache's size and the number of keys it holds on to.  Once it is full,
+   each new result takes the place of one picked by the clock algorithm:
+   the hand sweeps over the entries in the order they were added, passing
+   over, just once, those that were hit since it last came by. */
+#define ROUTE_MAP_CACHE_MAX 65536
+
+struct route_map_cache
+{
+  unsigned int generation;
+  int cacheable;
+  int prefix_independent;
+
+  struct hash *hash;
+  unsigned long hits;
+  unsigned long misses;
+
+  /* The entries, the first hash->count of them in use, and where the hand
+     is once all ROUTE_MAP_CACHE_MAX are. */
+  struct route_map_cache_entry **clock;
+  unsigned int hand;
+};
+
+struct route_map_cache_entry
+{
+  void *key;
+  struct prefix prefix;
+  route_map_result_t result;
+  int referenced;
+};
+
+DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_CACHE, "Route map cache")
+DEFINE_MTYPE_STATIC_SLAB(LIB, ROUTE_MAP_CACHE_ENTRY, "Route map cached result",
+                         sizeof (struct route_map_cache_entry))
+
+static struct
+{
+  void (*hold) (void *);
+  void (*release) (void *);
+} route_map_cache_keys;
+
+static unsigned int
+route_map_cache_hash_key (void *p)
+{
+  const struct route_map_cache_entry *entry = p;
+  const struct prefix *prefix = &entry->prefix;
+  u_int32_t key;
+
+  key = jhash (&entry->key, sizeof (entry->key),
+               prefix->family << 8 | prefix->prefixlen);
+  if (prefix->family == AF_INET || prefix->family == AF_INET6)
+    key = jhash (&prefix->u.prefix, PSIZE (prefix->prefixlen), key);
+  return key;
+}
+
+static int
+route_map_cache_hash_cmp (const void *p1, const void *p2)
+{
+  const struct route_map_cache_entry *entry1 = p1;
+  const struct route_map_cache_entry *entry2 = p2;
+
+  return (entry1->key == entry2->key
+          && prefix_same (&entry1->prefix, &entry2->prefix));
+}
+
+static void
+route_map_cache_entry_free (void *arg)
+{
+  struct route_map_cache_entry *entry = arg;
+
+  if (route_map_cache_keys.release)
+    (*route_map_cache_keys.release) (entry->key);
+  XFREE (MTYPE_ROUTE_MAP_CACHE_ENTRY, entry);
+}
+
+static int
+route_map_compute_cacheable (struct route_map *map)
+{
+  struct route_map_index *index;
+  struct route_map_rule *rule;
+
+  for (index = map->head; index; index = index->next)
+    {
+      if (index->set_list.head || index->nextrm)
+        return 0;
+      for (rule = index->match_list.head; rule; rule = rule->next)
+        if (!CHECK_FLAG (rule->cmd->flags, RMAP_RULE_CACHEABLE))
+          return 0;
+    }
+  return 1;
+}
+
+static int
+route_map_compute_prefix_independent (struct route_map *map)
+{
+  struct route_map_index *index;
+  struct route_map_rule *rule;
+
+  for (index = map->head; index; index = index->next)
+    {
+      if (index->nextrm)
+        return 0;
+      for (rule = index->match_list.head; rule; rule = rule->next)
+        if (!CHECK_FLAG (rule->cmd->flags, RMAP_RULE_NO_PREFIX))
+          return 0;
+      for (rule = index->set_list.head; rule; rule = rule->next)
+        if (!CHECK_FLAG (rule->cmd->flags, RMAP_RULE_NO_PREFIX))
+          return 0;
+    }
+  return 1;
+}
+
+/* Get map's cache, emptied and reassessed if the configuration has changed
+   since it was last used. */
+static struct route_map_cache *
+route_map_cache_get (struct route_map *map)
+{
+  struct route_map_cache *cache = map->cache;
+
+  if (!cache)
+    {
+      cache = XCALLOC (MTYPE_ROUTE_MAP_CACHE, sizeof (struct route_map_cache));
+      cache->hash = hash_create_open (route_map_cache_hash_key,
+                                      route_map_cache_hash_cmp);
+      map->cache = cache;
+    }
+
+  if (cache->generation != rmap_generation)
+    {
+      hash_clean (cache->hash, route_map_cache_entry_free);
+      cache->hand = 0;
+      cache->cacheable = route_map_compute_cacheable (map);
+      cache->prefix_independent = route_map_compute_prefix_independent (map);
+      cache->generation = rmap_generation;
+    }
+  return cache;
+}
+
+static void
+route_map_cache_free (struct route_map *map)
+{
+  if (!map->cache)
+    return;
+
+  hash_clean (map->cache->hash, route_map_cache_entry_free);
+  hash_free (map->cache->hash);
+  if (map->cache->clock)
+    XFREE (MTYPE_ROUTE_MAP_CACHE, map->cache->clock);
+  XFREE (MTYPE_ROUTE_MAP_CACHE, map->cache);
+}
+
+/* Add entry to cache, in place of the entry the clock's hand stops at if
+   the cache is full. */
+static void
+route_map_cache_add (struct route_map_cache *cache,
+                     struct route_map_cache_entry *entry)
+{
+  struct route_map_cache_entry *victim;
+
+  if (!cache->clock)
+    cache->clock = XMALLOC (MTYPE_ROUTE_MAP_CACHE,
+                            ROUTE_MAP_CACHE_MAX * sizeof (*cache->clock));
+
+  if (cache->hash->count < ROUTE_MAP_CACHE_MAX)
+    {
+      cache->clock[cache->hash->count] = entry;
+      hash_get (cache->hash, entry, hash_alloc_intern);
+      return;
+    }
+
+  while ((victim = cache->clock[cache->hand])->referenced)
+    {
+      victim->referenced = 0;
+      cache->hand = (cache->hand + 1) % ROUTE_MAP_CACHE_MAX;
+    }
+
+  hash_release (cache->hash, victim);
+  route_map_cache_entry_free (victim);
+
+  cache->clock[cache->hand] = entry;
+  cache->hand = (cache->hand + 1) % ROUTE_MAP_CACHE_MAX;
+  hash_get (cache->hash, entry, hash_alloc_intern);
+}
+
+static void
+route_map_cache_show (struct vty *vty, struct route_map *map)
+{
+  struct route_map_cache *cache = map->cache;
+
+  if (cache && cache->cacheable && cache->generation == rmap_generation)
+    vty_out (vty, "  Cached results: %lu (%lu hits, %lu misses)%s",
+             cache->hash->count, cache->hits, cache->misses, VTY_NEWLINE);
+}
+
+int
+route_map_cacheable (struct route_map *map)
+{
+  if (map == NULL)
+    return 0;
+  return route_map_cache_get (map)->cacheable;
+}
+
+int
+route_map_prefix_independent (struct route_map *map)
+{
+  if (map == NULL)
+    return 0;
+  return route_map_cache_get (map)->prefix_independent;
+}
+
+route_map_result_t
+route_map_apply_cached (struct route_map *map, struct prefix *prefix,
+                        route_map_object_t type, void *object, void *key)
+{
+  struct route_map_cache *cache;
+  struct route_map_cache_entry lookup;
+  struct route_map_cache_entry *entry;
+  route_map_result_t ret;
+
+  if (map == NULL)
+    return RMAP_DENYMATCH;
+
+  cache = route_map_cache_get (map);
+  if (!cache->cacheable || key == NULL)
+    return route_map_apply (map, prefix, type, object);
+
+  memset (&lookup, 0, sizeof (lookup));
+  lookup.key = key;
+  if (cache->prefix_independent)
+    lookup.prefix.family = prefix->family;
+  else
+    prefix_copy (&lookup.prefix, prefix);
+
+  entry = hash_lookup (cache->hash, &lookup);
+  if (entry)
+    {
+      cache->hits++;
+      entry->referenced = 1;
+      return entry->result;
+    }
+
+  cache->misses++;
+  ret = route_map_apply (map, prefix, type, object);
+
+  entry = XMALLOC (MTYPE_ROUTE_MAP_CACHE_ENTRY,
+                   sizeof (struct route_map_cache_entry));
+  *entry = lookup;
+  entry->result = ret;
+  if (route_map_cache_keys.hold)
+    (*route_map_cache_keys.hold) (key);
+  route_map_cache_add (cache, entry);
+
+  return ret;
+}
+
+void
+route_map_cache_key_hooks (void (*hold) (void *), void (*release) (void *))
+{
+  route_map_cache_keys.hold = hold;
+  route_map_cache_keys.release = release;
+}
+
 void
 route_map_add_hook (void (*func) (const char *))
 {
@@ -1949,6 +2285,8 @@ route_map_notify_dependencies (const char *affected_name, route_map_event_t even
   struct hash *upd8_hash;
   char *name;
 
+  route_map_generation_bump ();
+
   if (!affected_name)
     return;
 
@@ -2645,6 +2983,7 @@ DEFUN (rmap_onmatch_next,
 	  return CMD_WARNING;
         }
       index->exitpolicy = RMAP_NEXT;
+      route_map_generation_bump ();
     }
   return CMD_SUCCESS;
 }
@@ -2659,7 +2998,10 @@ DEFUN (no_rmap_onmatch_next,
   struct route_map_index *index = VTY_GET_CONTEXT (route_map_index);
   
   if (index)
-    index->exitpolicy = RMAP_EXIT;
+    {
+      index->exitpolicy = RMAP_EXIT;
+      route_map_generation_bump ();
+    }
 
   return CMD_SUCCESS;
 }
@@ -2702,6 +3044,7 @@ DEFUN (rmap_onmatch_goto,
 	{
 	  index->exitpolicy = RMAP_GOTO;
 	  index->nextpref = d;
+	  route_map_generation_bump ();
 	}
     }
   return CMD_SUCCESS;
@@ -2717,7 +3060,10 @@ DEFUN (no_rmap_onmatch_goto,
   struct route_map_index *index = VTY_GET_CONTEXT (route_map_index);
 
   if (index)
-    index->exitpolicy = RMAP_EXIT;
+    {
+      index->exitpolicy = RMAP_EXIT;
+      route_map_generation_bump ();
+    }
   
   return CMD_SUCCESS;
 }
@@ -2777,6 +3123,7 @@ DEFUN (rmap_call,
       XFREE (MTYPE_ROUTE_MAP_NAME, index->nextrm);
     }
   index->nextrm = XSTRDUP (MTYPE_ROUTE_MAP_NAME, rmap);
+  route_map_generation_bump ();
 
   /* Execute event hook. */
   route_map_upd8_dependency (RMAP_EVENT_CALL_ADDED,
@@ -2800,6 +3147,7 @@ DEFUN (no_rmap_call,
 				 index->map->name);
       XFREE (MTYPE_ROUTE_MAP_NAME, index->nextrm);
       index->nextrm = NULL;
+      route_map_generation_bump ();
     }
 
   return CMD_SUCCESS;
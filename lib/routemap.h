@@ -109,8 +109,24 @@ struct route_map_rule_cmd
 
   /* Free allocated value by func_compile (). */
   void (*func_free)(void *);
+
+  /* RMAP_RULE_* flags. */
+  int flags;
 };
 
+/* The match depends on nothing but the prefix, the part of the object
+   that callers of route_map_apply_cached() key on, and lists whose changes
+   are announced with route_map_notify_dependencies().  A route map made of
+   such matches only, with no set or call clauses, has its results
+   memoized by route_map_apply_cached(). */
+#define RMAP_RULE_CACHEABLE	(1 << 0)
+
+/* The rule looks at nothing in the prefix but its family, and does the
+   same thing every time for the same object.  A route map made of such
+   rules only, with no call clauses, treats all prefixes of a family alike;
+   see route_map_prefix_independent(). */
+#define RMAP_RULE_NO_PREFIX	(1 << 1)
+
 /* Route map apply error. */
 enum
 {
@@ -149,6 +165,10 @@ struct route_map_index
   /* If we're using "CALL", to which route-map do ew go? */
   char *nextrm;
 
+  /* nextrm as looked up under route_map_generation() nextrm_generation. */
+  struct route_map *nextrm_map;
+  unsigned int nextrm_generation;
+
   /* Matching rule list. */
   struct route_map_rule_list match_list;
   struct route_map_rule_list set_list;
@@ -179,10 +199,24 @@ struct route_map
   int to_be_processed;	 /* True if modification isn't acted on yet */
   int deleted;		 /* If 1, then this node will be deleted */
 
+  /* Results memoized by route_map_apply_cached(). */
+  struct route_map_cache *cache;
+
   QOBJ_FIELDS
 };
 DECLARE_QOBJ_TYPE(route_map)
 
+/* Compiled form of a match on a named list, for func_compile/func_free of
+   rules such as "ip address prefix-list NAME".  The list itself is looked
+   up by the rule's func_apply, which need only do so again once
+   route_map_generation() has moved on from generation. */
+struct route_map_list_ref
+{
+  char *name;
+  void *list;
+  unsigned int generation;
+};
+
 /* Prototypes. */
 extern void route_map_init (void);
 extern void route_map_finish (void);
@@ -225,6 +259,40 @@ extern route_map_result_t route_map_apply (struct route_map *map,
                                            route_map_object_t object_type,
                                            void *object);
 
+/* Like route_map_apply(), but if the map can be cached (see
+   RMAP_RULE_CACHEABLE) the result is remembered by key and prefix, or
+   by key and address family if the map is route_map_prefix_independent(),
+   and returned again for the same pair until the configuration changes or
+   it makes way for newer results.  key must identify everything in object
+   that the map's matches look at; for bgpd, that's the interned
+   attribute. */
+extern route_map_result_t route_map_apply_cached (struct route_map *map,
+                                                  struct prefix *,
+                                                  route_map_object_t object_type,
+                                                  void *object, void *key);
+
+/* Whether route_map_apply_cached() will memoize map's results. */
+extern int route_map_cacheable (struct route_map *map);
+
+/* Whether applying map to an object comes to the same result, and makes
+   the same changes to it, whatever prefix of a family it is for.  Callers
+   with one object for many prefixes need then apply the map only once. */
+extern int route_map_prefix_independent (struct route_map *map);
+
+/* Take and drop a reference on a key while it sits in a cache, so that it
+   can't be freed and its address reused for something else. */
+extern void route_map_cache_key_hooks (void (*hold) (void *),
+                                       void (*release) (void *));
+
+/* Bumped whenever a route map, or any list a route map may refer to,
+   changes.  Whatever has been derived from the configuration is good only
+   for the generation it was worked out in. */
+extern unsigned int route_map_generation (void);
+extern void route_map_generation_bump (void);
+
+extern void *route_map_list_ref_compile (const char *arg);
+extern void route_map_list_ref_free (void *rule);
+
 extern void route_map_add_hook (void (*func) (const char *));
 extern void route_map_delete_hook (void (*func) (const char *));
 extern void route_map_event_hook (void (*func) (route_map_event_t,
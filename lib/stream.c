@@ -21,6 +21,7 @@
 
 #include <zebra.h>
 #include <stddef.h>
+#include <pthread.h>
 
 #include "stream.h"
 #include "memory.h"
@@ -28,10 +29,121 @@
 #include "prefix.h"
 #include "log.h"
 
-DEFINE_MTYPE_STATIC(LIB, STREAM,      "Stream")
+DEFINE_MTYPE_STATIC_SLAB(LIB, STREAM, "Stream", sizeof (struct stream))
 DEFINE_MTYPE_STATIC(LIB, STREAM_DATA, "Stream data")
 DEFINE_MTYPE_STATIC(LIB, STREAM_FIFO, "Stream FIFO")
 
+/* Stream data buffer.  Streams made by stream_ref() share the buffer of
+ * the stream they were made from; it goes away with the last of them. */
+struct stream_buf
+{
+  _Atomic unsigned int refcnt;
+  unsigned int pool;
+  unsigned char data[] __attribute__ ((aligned (16)));
+};
+
+#define STREAM_BUF(S) \
+  ((struct stream_buf *)((S)->data - offsetof (struct stream_buf, data)))
+
+/* Freed buffers of 256 bytes and up are kept in per-size pools, power of two
+ * sized, so that the stream_new()/stream_free() done for every packet
+ * doesn't each time cost a trip through malloc().  Each pool holds on to
+ * at most STREAM_POOL_BYTES worth of free buffers. */
+#define STREAM_POOL_MIN_SHIFT 8
+#define STREAM_POOL_MAX_SHIFT 16
+#define STREAM_POOL_BYTES (1024 * 1024)
+
+struct stream_pool
+{
+  pthread_mutex_t mtx;
+  struct stream_buf *free;
+  unsigned int count;
+};
+
+#define STREAM_POOLS (STREAM_POOL_MAX_SHIFT - STREAM_POOL_MIN_SHIFT + 1)
+#define STREAM_POOL_NONE STREAM_POOLS
+#define STREAM_POOL_SIZE(I) ((size_t) 1 << ((I) + STREAM_POOL_MIN_SHIFT))
+#define STREAM_POOL_MAX(I) (STREAM_POOL_BYTES / STREAM_POOL_SIZE (I))
+
+static struct stream_pool stream_pools[STREAM_POOLS] = {
+  [0 ... STREAM_POOLS - 1] = { .mtx = PTHREAD_MUTEX_INITIALIZER },
+};
+
+/* Smallest pool with buffers of at least size bytes */
+static unsigned int
+stream_pool_index (size_t size)
+{
+  unsigned int i;
+
+  if (size < STREAM_POOL_SIZE (0) / 2)
+    return STREAM_POOL_NONE;
+  for (i = 0; i < STREAM_POOLS; i++)
+    if (size <= STREAM_POOL_SIZE (i))
+      return i;
+  return STREAM_POOL_NONE;
+}
+
+static struct stream_buf *
+stream_buf_get (size_t size)
+{
+  struct stream_pool *pool;
+  struct stream_buf *buf = NULL;
+  unsigned int i;
+
+  i = stream_pool_index (size);
+  if (i == STREAM_POOL_NONE)
+    buf = XMALLOC (MTYPE_STREAM_DATA, sizeof (struct stream_buf) + size);
+  else
+    {
+      pool = &stream_pools[i];
+      pthread_mutex_lock (&pool->mtx);
+      if ((buf = pool->free) != NULL)
+	{
+	  pool->free = *(struct stream_buf **) buf->data;
+	  pool->count--;
+	}
+      pthread_mutex_unlock (&pool->mtx);
+
+      if (buf == NULL)
+	buf = XMALLOC (MTYPE_STREAM_DATA,
+		       sizeof (struct stream_buf) + STREAM_POOL_SIZE (i));
+    }
+
+  if (buf == NULL)
+    return NULL;
+
+  buf->pool = i;
+  atomic_store_explicit (&buf->refcnt, 1, memory_order_relaxed);
+  return buf;
+}
+
+static void
+stream_buf_put (struct stream_buf *buf)
+{
+  struct stream_pool *pool;
+
+  if (atomic_fetch_sub_explicit (&buf->refcnt, 1, memory_order_acq_rel) > 1)
+    return;
+
+  if (buf->pool != STREAM_POOL_NONE)
+    {
+      pool = &stream_pools[buf->pool];
+      pthread_mutex_lock (&pool->mtx);
+      if (pool->count < STREAM_POOL_MAX (buf->pool))
+	{
+	  *(struct stream_buf **) buf->data = pool->free;
+	  pool->free = buf;
+	  pool->count++;
+	  buf = NULL;
+	}
+      pthread_mutex_unlock (&pool->mtx);
+      if (buf == NULL)
+	return;
+    }
+
+  XFREE (MTYPE_STREAM_DATA, buf);
+}
+
 /* Tests whether a position is valid */ 
 #define GETP_VALID(S,G) \
   ((G) <= (S)->endp)
@@ -93,6 +205,7 @@ struct stream *
 stream_new (size_t size)
 {
   struct stream *s;
+  struct stream_buf *buf;
 
   assert (size > 0);
   
@@ -101,12 +214,13 @@ stream_new (size_t size)
   if (s == NULL)
     return s;
   
-  if ( (s->data = XMALLOC (MTYPE_STREAM_DATA, size)) == NULL)
+  if ( (buf = stream_buf_get (size)) == NULL)
     {
       XFREE (MTYPE_STREAM, s);
       return NULL;
     }
   
+  s->data = buf->data;
   s->size = size;
   return s;
 }
@@ -118,10 +232,31 @@ stream_free (struct stream *s)
   if (!s)
     return;
   
-  XFREE (MTYPE_STREAM_DATA, s->data);
+  stream_buf_put (STREAM_BUF (s));
   XFREE (MTYPE_STREAM, s);
 }
 
+/* Another stream over the same data, see stream.h. */
+struct stream *
+stream_ref (struct stream *s)
+{
+  struct stream *new;
+
+  STREAM_VERIFY_SANE (s);
+
+  new = XCALLOC (MTYPE_STREAM, sizeof (struct stream));
+  if (new == NULL)
+    return NULL;
+
+  atomic_fetch_add_explicit (&STREAM_BUF (s)->refcnt, 1,
+			     memory_order_relaxed);
+  new->getp = s->getp;
+  new->endp = s->endp;
+  new->size = s->size;
+  new->data = s->data;
+  return new;
+}
+
 struct stream *
 stream_copy (struct stream *new, struct stream *src)
 {
@@ -173,15 +308,35 @@ stream_dupcat (struct stream *s1, struct stream *s2, size_t offset)
 size_t
 stream_resize (struct stream *s, size_t newsize)
 {
-  u_char *newdata;
+  struct stream_buf *buf, *newbuf;
+  unsigned int pool;
+
   STREAM_VERIFY_SANE (s);
-  
-  newdata = XREALLOC (MTYPE_STREAM_DATA, s->data, newsize);
-  
-  if (newdata == NULL)
-    return s->size;
-  
-  s->data = newdata;
+
+  buf = STREAM_BUF (s);
+  assert (atomic_load_explicit (&buf->refcnt, memory_order_relaxed) == 1);
+
+  pool = stream_pool_index (newsize);
+  if (pool != STREAM_POOL_NONE && pool == buf->pool)
+    ; /* the buffer already has room */
+  else if (pool == STREAM_POOL_NONE && buf->pool == STREAM_POOL_NONE)
+    {
+      newbuf = XREALLOC (MTYPE_STREAM_DATA, buf,
+			 sizeof (struct stream_buf) + newsize);
+      if (newbuf == NULL)
+	return s->size;
+      s->data = newbuf->data;
+    }
+  else
+    {
+      newbuf = stream_buf_get (newsize);
+      if (newbuf == NULL)
+	return s->size;
+      memcpy (newbuf->data, s->data, MIN (s->size, newsize));
+      stream_buf_put (buf);
+      s->data = newbuf->data;
+    }
+
   s->size = newsize;
   
   if (s->endp > s->size)
@@ -1111,6 +1266,20 @@ stream_reset (struct stream *s)
   s->getp = s->endp = 0;
 }
 
+/* Move the unread part of the stream to the start of its buffer, to make
+   room behind it for more. */
+void
+stream_pulldown (struct stream *s)
+{
+  size_t rlen = STREAM_READABLE (s);
+
+  STREAM_VERIFY_SANE (s);
+
+  memmove (s->data, s->data + s->getp, rlen);
+  s->getp = 0;
+  s->endp = rlen;
+}
+
 /* Write stream contens to the file discriptor. */
 int
 stream_flush (struct stream *s, int fd)
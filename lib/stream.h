@@ -88,6 +88,14 @@
  *
  * Best practice is to use stream_put (<stream *>, NULL, <size>) to zero out
  * any part of a stream which isn't otherwise written to.
+ *
+ * Shared streams:
+ * stream_ref() makes another stream over the same data, for handing one
+ * message to several consumers (e.g. queueing it to many peers) without
+ * copying it.  Each stream has its own getp and endp and is freed on its
+ * own; the data goes with the last of them.  Neither the original nor the
+ * new stream may be written to or resized afterwards.  Shared streams
+ * may be freed from any pthread.
  */
 
 /* Stream buffer. */
@@ -138,6 +146,7 @@ struct stream_fifo
  * q: quad (four words)
  */
 extern struct stream *stream_new (size_t);
+extern struct stream *stream_ref (struct stream *);
 extern void stream_free (struct stream *);
 extern struct stream * stream_copy (struct stream *, struct stream *src);
 extern struct stream *stream_dup (struct stream *);
@@ -228,6 +237,7 @@ extern size_t stream_write (struct stream *, const void *, size_t);
 
 /* reset the stream. See Note above */
 extern void stream_reset (struct stream *);
+extern void stream_pulldown (struct stream *);
 extern int stream_flush (struct stream *, int);
 extern int stream_empty (struct stream *); /* is the stream empty? */
 
@@ -28,6 +28,7 @@
 
 DEFINE_MTYPE(       LIB, ROUTE_TABLE, "Route table")
 DEFINE_MTYPE(       LIB, ROUTE_NODE,  "Route node")
+DEFINE_MTYPE(       LIB, ROUTE_TABLE_STRIDE, "Route table stride index")
 
 static void route_node_delete (struct route_node *);
 static void route_table_free (struct route_table *);
@@ -41,6 +42,8 @@ route_table_init_with_delegate (route_table_delegate_t *delegate)
 {
   struct route_table *rt;
 
+  assert (delegate->stride <= ROUTE_TABLE_STRIDE_MAX);
+
   rt = XCALLOC (MTYPE_ROUTE_TABLE, sizeof (struct route_table));
   rt->delegate = delegate;
   return rt;
@@ -133,6 +136,8 @@ route_table_free (struct route_table *rt)
  
   assert (rt->count == 0);
 
+  if (rt->stride_index)
+    XFREE (MTYPE_ROUTE_TABLE_STRIDE, rt->stride_index);
   XFREE (MTYPE_ROUTE_TABLE, rt);
   return;
 }
@@ -187,6 +192,108 @@ set_link (struct route_node *node, struct route_node *new)
   new->parent = node;
 }
 
+/* Slot of an IPv4 prefix in the stride index. */
+static inline u_int32_t
+route_stride_slot (const struct route_table *table, const struct prefix *p)
+{
+  return ntohl (p->u.prefix4.s_addr)
+    >> (IPV4_MAX_BITLEN - table->delegate->stride);
+}
+
+/* Point the stride index slots covered by a new node at it, unless they
+   already point at something deeper. */
+static void
+route_stride_add (struct route_table *table, struct route_node *node)
+{
+  u_int32_t slot, count, i;
+  u_char stride = table->delegate->stride;
+
+  if (node->p.family != AF_INET || node->p.prefixlen > stride)
+    return;
+
+  count = 1U << (stride - node->p.prefixlen);
+  slot = route_stride_slot (table, &node->p) & ~(count - 1);
+  for (i = slot; i < slot + count; i++)
+    if (table->stride_index[i] == NULL
+	|| table->stride_index[i]->p.prefixlen < node->p.prefixlen)
+      table->stride_index[i] = node;
+}
+
+/* Hand the stride index slots of a node that is going away to its parent.
+   Any deeper node covering one of them would be in the slot instead. */
+static void
+route_stride_del (struct route_table *table, struct route_node *node)
+{
+  u_int32_t slot, count, i;
+  u_char stride = table->delegate->stride;
+
+  if (node->p.family != AF_INET || node->p.prefixlen > stride)
+    return;
+
+  count = 1U << (stride - node->p.prefixlen);
+  slot = route_stride_slot (table, &node->p) & ~(count - 1);
+  for (i = slot; i < slot + count; i++)
+    if (table->stride_index[i] == node)
+      table->stride_index[i] = node->parent;
+}
+
+/* Build the stride index for a table that has grown big enough.  The walk
+   is pre-order, so deeper nodes take over slots from their ancestors, and
+   does not descend past the stride. */
+static void
+route_stride_build (struct route_table *table)
+{
+  struct route_node *node;
+  u_char stride = table->delegate->stride;
+
+  table->stride_index = XCALLOC (MTYPE_ROUTE_TABLE_STRIDE,
+				 sizeof (struct route_node *) << stride);
+
+  node = table->top;
+  while (node)
+    {
+      route_stride_add (table, node);
+
+      if (node->p.prefixlen < stride && node->l_left)
+	{
+	  node = node->l_left;
+	  continue;
+	}
+      if (node->p.prefixlen < stride && node->l_right)
+	{
+	  node = node->l_right;
+	  continue;
+	}
+
+      while (node->parent)
+	{
+	  if (node->parent->l_left == node && node->parent->l_right)
+	    break;
+	  node = node->parent;
+	}
+      node = node->parent ? node->parent->l_right : NULL;
+    }
+}
+
+/* Node to start walking down from when looking for p: the deepest node of
+   at most stride bits covering it if the table has a stride index, else
+   the top of the tree.  Either way, it is on the path to p. */
+static inline struct route_node *
+route_stride_start (const struct route_table *table, const struct prefix *p)
+{
+  struct route_node *node;
+
+  if (table->stride_index && p->family == AF_INET
+      && p->prefixlen >= table->delegate->stride)
+    {
+      node = table->stride_index[route_stride_slot (table, p)];
+      if (node)
+	return node;
+    }
+
+  return table->top;
+}
+
 /* Lock node. */
 struct route_node *
 route_lock_node (struct route_node *node)
@@ -206,15 +313,15 @@ route_unlock_node (struct route_node *node)
     route_node_delete (node);
 }
 
-/* Find matched prefix. */
-struct route_node *
-route_node_match (const struct route_table *table, const struct prefix *p)
+/* Find matched prefix, walking down from start. */
+static struct route_node *
+route_node_match_from (struct route_node *start, const struct prefix *p)
 {
   struct route_node *node;
   struct route_node *matched;
 
   matched = NULL;
-  node = table->top;
+  node = start;
 
   /* Walk down tree.  If there is matched route then store it to
      matched. */
@@ -230,6 +337,16 @@ route_node_match (const struct route_table *table, const struct prefix *p)
       node = node->link[prefix_bit(&p->u.prefix, node->p.prefixlen)];
     }
 
+  /* Nothing below the stride index entry, but what's above it covers p
+     as well. */
+  if (!matched && start)
+    for (node = start->parent; node; node = node->parent)
+      if (node->info)
+	{
+	  matched = node;
+	  break;
+	}
+
   /* If matched route found, return it. */
   if (matched)
     return route_lock_node (matched);
@@ -237,6 +354,42 @@ route_node_match (const struct route_table *table, const struct prefix *p)
   return NULL;
 }
 
+/* Find matched prefix. */
+struct route_node *
+route_node_match (const struct route_table *table, const struct prefix *p)
+{
+  return route_node_match_from (route_stride_start (table, p), p);
+}
+
+/* Find matched prefixes for a batch of lookups.  The starting nodes are
+   all fetched first, so that their cache misses overlap instead of being
+   taken one lookup at a time. */
+#define ROUTE_MATCH_BATCH 16U
+
+void
+route_node_match_batch (const struct route_table *table,
+			const struct prefix * const *p,
+			struct route_node **matched, unsigned int count)
+{
+  struct route_node *start[ROUTE_MATCH_BATCH];
+  unsigned int i, j, n;
+
+  for (i = 0; i < count; i += n)
+    {
+      n = MIN (count - i, ROUTE_MATCH_BATCH);
+
+      for (j = 0; j < n; j++)
+	{
+	  start[j] = route_stride_start (table, p[i + j]);
+	  if (start[j])
+	    __builtin_prefetch (start[j]);
+	}
+
+      for (j = 0; j < n; j++)
+	matched[i + j] = route_node_match_from (start[j], p[i + j]);
+    }
+}
+
 struct route_node *
 route_node_match_ipv4 (const struct route_table *table,
 		       const struct in_addr *addr)
@@ -273,7 +426,7 @@ route_node_lookup (const struct route_table *table, const struct prefix *p)
   u_char prefixlen = p->prefixlen;
   const u_char *prefix = &p->u.prefix;
 
-  node = table->top;
+  node = route_stride_start (table, p);
 
   while (node && node->p.prefixlen <= prefixlen &&
 	 prefix_match (&node->p, p))
@@ -295,7 +448,7 @@ route_node_lookup_maynull (const struct route_table *table, const struct prefix
   u_char prefixlen = p->prefixlen;
   const u_char *prefix = &p->u.prefix;
 
-  node = table->top;
+  node = route_stride_start (table, p);
 
   while (node && node->p.prefixlen <= prefixlen &&
 	 prefix_match (&node->p, p))
@@ -309,18 +462,18 @@ route_node_lookup_maynull (const struct route_table *table, const struct prefix
   return NULL;
 }
 
-/* Add node to routing table. */
-struct route_node *
-route_node_get (struct route_table *const table, const struct prefix *p)
+/* Add node to routing table, looking for its place from node down. */
+static struct route_node *
+route_node_get_from (struct route_table *const table, struct route_node *node,
+		     const struct prefix *p)
 {
   struct route_node *new;
-  struct route_node *node;
   struct route_node *match;
+  struct route_node *glue = NULL;
   u_char prefixlen = p->prefixlen;
   const u_char *prefix = &p->u.prefix;
 
-  match = NULL;
-  node = table->top;
+  match = node ? node->parent : NULL;
   while (node && node->p.prefixlen <= prefixlen &&
 	 prefix_match (&node->p, p))
     {
@@ -354,18 +507,71 @@ route_node_get (struct route_table *const table, const struct prefix *p)
 
       if (new->p.prefixlen != p->prefixlen)
 	{
-	  match = new;
+	  match = glue = new;
 	  new = route_node_set (table, p);
 	  set_link (match, new);
 	  table->count++;
 	}
     }
   table->count++;
+
+  if (table->stride_index)
+    {
+      route_stride_add (table, new);
+      if (glue)
+	route_stride_add (table, glue);
+    }
+  else if (table->delegate->stride && new->p.family == AF_INET
+	   && table->count > ROUTE_TABLE_STRIDE_MIN)
+    route_stride_build (table);
+
   route_lock_node (new);
   
   return new;
 }
 
+/* Add node to routing table. */
+struct route_node *
+route_node_get (struct route_table *const table, const struct prefix *p)
+{
+  return route_node_get_from (table, route_stride_start (table, p), p);
+}
+
+/* Add nodes for a batch of prefixes.  Prefixes that arrive together tend
+   to sit next to each other in the tree, so each one is looked for from
+   the deepest node above the previous one that covers it, rather than
+   from the top each time. */
+void
+route_node_get_batch (struct route_table *const table,
+		      const struct prefix * const *p,
+		      struct route_node **nodes, unsigned int count)
+{
+  struct route_node *start, *node;
+  unsigned int i;
+
+  for (i = 0; i < count; i++)
+    {
+      start = route_stride_start (table, p[i]);
+
+      /* Every node covering p[i] is on its way down from the top, so the
+	 first one found going up is as deep as the descent can start. */
+      if (i > 0)
+	for (node = nodes[i - 1]; node; node = node->parent)
+	  {
+	    if (start && node->p.prefixlen <= start->p.prefixlen)
+	      break;
+	    if (node->p.prefixlen <= p[i]->prefixlen
+		&& prefix_match (&node->p, p[i]))
+	      {
+		start = node;
+		break;
+	      }
+	  }
+
+      nodes[i] = route_node_get_from (table, start, p[i]);
+    }
+}
+
 /* Delete node from the routing table. */
 static void
 route_node_delete (struct route_node *node)
@@ -386,6 +592,9 @@ route_node_delete (struct route_node *node)
 
   parent = node->parent;
 
+  if (node->table->stride_index)
+    route_stride_del (node->table, node);
+
   if (child)
     child->parent = parent;
 
@@ -558,6 +767,21 @@ route_table_get_default_delegate(void)
   return &default_delegate;
 }
 
+/*
+ * Default delegate with a stride index, for big IPv4 tables.
+ */
+static route_table_delegate_t stride_delegate = {
+  .create_node = route_node_create,
+  .destroy_node = route_node_destroy,
+  .stride = ROUTE_TABLE_STRIDE_DEFAULT
+};
+
+route_table_delegate_t *
+route_table_get_stride_delegate(void)
+{
+  return &stride_delegate;
+}
+
 /*
  * route_table_init
  */
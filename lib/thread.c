@@ -22,6 +22,9 @@
 
 #include <zebra.h>
 #include <sys/resource.h>
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
 
 #include "thread.h"
 #include "memory.h"
@@ -31,6 +34,8 @@
 #include "command.h"
 #include "sigevent.h"
 #include "network.h"
+#include "linklist.h"
+#include "json.h"
 
 DEFINE_MTYPE_STATIC(LIB, THREAD,        "Thread")
 DEFINE_MTYPE_STATIC(LIB, THREAD_MASTER, "Thread master")
@@ -41,14 +46,32 @@ DEFINE_MTYPE_STATIC(LIB, THREAD_STATS,  "Thread stats")
 #include <mach/mach_time.h>
 #endif
 
+#ifdef HAVE_EVENTFD
+/* io_pipe[0] and io_pipe[1] are the same eventfd */
+#define AWAKEN(m) \
+  do { \
+      static const uint64_t wakeval = 1; \
+      write (m->io_pipe[1], &wakeval, sizeof (wakeval)); \
+  } while (0);
+#else
 #define AWAKEN(m) \
   do { \
       static unsigned char wakebyte = 0x01; \
       write (m->io_pipe[1], &wakebyte, 1); \
   } while (0);
+#endif
 
-static pthread_mutex_t cpu_record_mtx = PTHREAD_MUTEX_INITIALIZER;
-static struct hash *cpu_record = NULL;
+/* all thread masters, for show thread cpu */
+static pthread_mutex_t masters_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct list *masters = NULL;
+
+/* Measure the CPU time each task takes, besides its wall clock time.  That
+   costs a clock_gettime() syscall before and after every task, where wall
+   clock time comes out of the vDSO for next to nothing. */
+bool cputime_enabled = true;
+
+_Atomic unsigned long walltime_warning = WALLTIME_WARNING_DEFAULT;
+_Atomic bool walltime_backtrace = false;
 
 static unsigned long
 timeval_elapsed (struct timeval a, struct timeval b)
@@ -57,6 +80,19 @@ timeval_elapsed (struct timeval a, struct timeval b)
 	  + (a.tv_usec - b.tv_usec));
 }
 
+static unsigned long
+timespec_elapsed (const struct timespec *a, const struct timespec *b)
+{
+  return ((a->tv_sec - b->tv_sec) * TIMER_SECOND_MICRO
+	  + (a->tv_nsec - b->tv_nsec) / 1000);
+}
+
+/* Each thread_master keeps the histories of its own tasks, so that
+   thread_call() can account for a task without any locking: entries are
+   only added under m->mtx, which thread_get() holds anyway, and only
+   updated by the pthread running the master.  show thread cpu adds up
+   the entries for the same function across all masters. */
+
 static unsigned int
 cpu_record_hash_key (struct cpu_thread_history *a)
 {
@@ -88,14 +124,98 @@ cpu_record_hash_free (void *a)
   XFREE (MTYPE_THREAD_STATS, hist);
 }
 
+static void
+time_stats_add (struct time_stats *stats, unsigned long usec)
+{
+  atomic_fetch_add_explicit (&stats->total, usec, memory_order_relaxed);
+  if (atomic_load_explicit (&stats->max, memory_order_relaxed) < usec)
+    atomic_store_explicit (&stats->max, usec, memory_order_relaxed);
+}
+
+/* Bucket for a run of usec, see THREAD_HIST_BUCKETS. */
+static unsigned int
+cpu_hist_bucket (unsigned long usec)
+{
+  unsigned int bits;
+
+  if (usec < THREAD_HIST_SUB)
+    return usec;
+  bits = sizeof (usec) * 8 - 1 - __builtin_clzl (usec);
+  if (bits >= THREAD_HIST_MAX_BITS)
+    return THREAD_HIST_BUCKETS - 1;
+  return (((bits - THREAD_HIST_SUB_BITS + 1) << THREAD_HIST_SUB_BITS)
+	  + ((usec >> (bits - THREAD_HIST_SUB_BITS)) & (THREAD_HIST_SUB - 1)));
+}
+
+/* Shortest run that goes into bucket i. */
+static unsigned long
+cpu_hist_bucket_min (unsigned int i)
+{
+  unsigned int shift;
+
+  if (i < THREAD_HIST_SUB)
+    return i;
+  shift = (i >> THREAD_HIST_SUB_BITS) - 1;
+  return (unsigned long) (THREAD_HIST_SUB + (i & (THREAD_HIST_SUB - 1)))
+	 << shift;
+}
+
+/* How long the given fraction of count runs took at most, going by the
+   upper bound of the bucket that fraction is reached in, or the longest
+   run if that is less. */
+static unsigned long
+cpu_hist_percentile (_Atomic unsigned long *buckets, unsigned long count,
+		     unsigned long max, double fraction)
+{
+  unsigned long want, seen = 0;
+  unsigned int i;
+
+  want = count * fraction;
+  if (want < count * fraction || want == 0)
+    want++;
+  for (i = 0; i < THREAD_HIST_BUCKETS - 1; i++)
+    {
+      seen += buckets[i];
+      if (seen >= want)
+	return MIN (cpu_hist_bucket_min (i + 1) - 1, max);
+    }
+  return max;
+}
+
+/* The buckets runs went into, as [{minUsec, maxUsec, count}]; the last
+   bucket has no maxUsec. */
+static json_object *
+cpu_hist_json (_Atomic unsigned long *buckets)
+{
+  json_object *json = json_object_new_array ();
+  json_object *json_bucket;
+  unsigned int i;
+
+  for (i = 0; i < THREAD_HIST_BUCKETS; i++)
+    {
+      if (buckets[i] == 0)
+	continue;
+      json_bucket = json_object_new_object ();
+      json_object_long_add (json_bucket, "minUsec", cpu_hist_bucket_min (i));
+      if (i < THREAD_HIST_BUCKETS - 1)
+	json_object_long_add (json_bucket, "maxUsec",
+			      cpu_hist_bucket_min (i + 1) - 1);
+      json_object_long_add (json_bucket, "count", buckets[i]);
+      json_object_array_add (json, json_bucket);
+    }
+  return json;
+}
+
 static void 
 vty_out_cpu_thread_history(struct vty* vty,
 			   struct cpu_thread_history *a)
 {
-  vty_out(vty, "%5d %10ld.%03ld %9d %8ld %9ld %8ld %9ld",
+  vty_out(vty, "%5d %10ld.%03ld %9d %8ld %9ld %8ld %9ld %8lu %8lu",
 	  a->total_active, a->cpu.total/1000, a->cpu.total%1000, a->total_calls,
 	  a->cpu.total/a->total_calls, a->cpu.max,
-	  a->real.total/a->total_calls, a->real.max);
+	  a->real.total/a->total_calls, a->real.max,
+	  cpu_hist_percentile (a->buckets, a->total_calls, a->real.max, 0.5),
+	  cpu_hist_percentile (a->buckets, a->total_calls, a->real.max, 0.99));
   vty_out(vty, " %c%c%c%c%c%c %s%s",
 	  a->types & (1 << THREAD_READ) ? 'R':' ',
 	  a->types & (1 << THREAD_WRITE) ? 'W':' ',
@@ -106,6 +226,48 @@ vty_out_cpu_thread_history(struct vty* vty,
 	  a->funcname, VTY_NEWLINE);
 }
 
+/* Add a to sum, reading a's counters as its pthread may be bumping them
+   just now. */
+static void
+cpu_record_merge (struct cpu_thread_history *sum, struct cpu_thread_history *a)
+{
+  unsigned long max;
+  unsigned int i;
+
+  sum->total_active += atomic_load_explicit (&a->total_active,
+					     memory_order_relaxed);
+  sum->total_calls += atomic_load_explicit (&a->total_calls,
+					    memory_order_relaxed);
+  sum->real.total += atomic_load_explicit (&a->real.total,
+					   memory_order_relaxed);
+  max = atomic_load_explicit (&a->real.max, memory_order_relaxed);
+  if (sum->real.max < max)
+    sum->real.max = max;
+  sum->cpu.total += atomic_load_explicit (&a->cpu.total, memory_order_relaxed);
+  max = atomic_load_explicit (&a->cpu.max, memory_order_relaxed);
+  if (sum->cpu.max < max)
+    sum->cpu.max = max;
+  sum->lag_calls += atomic_load_explicit (&a->lag_calls, memory_order_relaxed);
+  sum->lag.total += atomic_load_explicit (&a->lag.total, memory_order_relaxed);
+  max = atomic_load_explicit (&a->lag.max, memory_order_relaxed);
+  if (sum->lag.max < max)
+    sum->lag.max = max;
+  sum->types |= atomic_load_explicit (&a->types, memory_order_relaxed);
+  for (i = 0; i < THREAD_HIST_BUCKETS; i++)
+    sum->buckets[i] += atomic_load_explicit (&a->buckets[i],
+					     memory_order_relaxed);
+}
+
+static void
+cpu_record_hash_merge (struct hash_backet *bucket, void *arg)
+{
+  struct hash *merged = arg;
+  struct cpu_thread_history *a = bucket->data;
+
+  cpu_record_merge (hash_get (merged, a,
+			      (void * (*) (void *))cpu_record_hash_alloc), a);
+}
+
 static void
 cpu_record_hash_print(struct hash_backet *bucket, 
 		      void *args[])
@@ -115,60 +277,181 @@ cpu_record_hash_print(struct hash_backet *bucket,
   thread_type *filter = args[2];
   struct cpu_thread_history *a = bucket->data;
 
-  if ( !(a->types & *filter) )
+  if ( !(a->types & *filter) || a->total_calls == 0 )
        return;
   vty_out_cpu_thread_history(vty,a);
-  totals->total_active += a->total_active;
-  totals->total_calls += a->total_calls;
-  totals->real.total += a->real.total;
-  if (totals->real.max < a->real.max)
-    totals->real.max = a->real.max;
-  totals->cpu.total += a->cpu.total;
-  if (totals->cpu.max < a->cpu.max)
-    totals->cpu.max = a->cpu.max;
+  cpu_record_merge (totals, a);
+}
+
+static json_object *
+cpu_record_json (struct cpu_thread_history *a)
+{
+  json_object *json = json_object_new_object ();
+  char types[8], *t = types;
+
+  json_object_int_add (json, "totalActive", a->total_active);
+  json_object_long_add (json, "totalCalls", a->total_calls);
+  json_object_long_add (json, "cpuTotalUsec", a->cpu.total);
+  json_object_long_add (json, "cpuMaxUsec", a->cpu.max);
+  json_object_long_add (json, "realTotalUsec", a->real.total);
+  json_object_long_add (json, "realMaxUsec", a->real.max);
+  json_object_long_add (json, "realP50Usec",
+			cpu_hist_percentile (a->buckets, a->total_calls,
+					     a->real.max, 0.5));
+  json_object_long_add (json, "realP99Usec",
+			cpu_hist_percentile (a->buckets, a->total_calls,
+					     a->real.max, 0.99));
+  json_object_long_add (json, "lagCalls", a->lag_calls);
+  json_object_long_add (json, "lagTotalUsec", a->lag.total);
+  json_object_long_add (json, "lagMaxUsec", a->lag.max);
+  if (a->types & (1 << THREAD_READ))
+    *t++ = 'R';
+  if (a->types & (1 << THREAD_WRITE))
+    *t++ = 'W';
+  if (a->types & (1 << THREAD_TIMER))
+    *t++ = 'T';
+  if (a->types & (1 << THREAD_EVENT))
+    *t++ = 'E';
+  if (a->types & (1 << THREAD_EXECUTE))
+    *t++ = 'X';
+  if (a->types & (1 << THREAD_BACKGROUND))
+    *t++ = 'B';
+  *t = '\0';
+  json_object_string_add (json, "type", types);
+  return json;
+}
+
+static void
+cpu_record_hash_json (struct hash_backet *bucket, void *args[])
+{
+  json_object *json = args[0];
+  thread_type *filter = args[1];
+  struct cpu_thread_history *a = bucket->data;
+
+  if (!(a->types & *filter) || a->total_calls == 0)
+    return;
+  json_object_object_add (json, a->funcname, cpu_record_json (a));
+}
+
+/* The histories of all masters, added up per function. */
+static struct hash *
+cpu_record_collect (void)
+{
+  struct hash *merged;
+  struct listnode *node;
+  struct thread_master *m;
+
+  merged = hash_create ((unsigned int (*) (void *))cpu_record_hash_key,
+			(int (*) (const void *, const void *))
+			cpu_record_hash_cmp);
+  pthread_mutex_lock (&masters_mtx);
+  {
+    for (ALL_LIST_ELEMENTS_RO (masters, node, m))
+      {
+	pthread_mutex_lock (&m->mtx);
+	hash_iterate (m->cpu_record, cpu_record_hash_merge, merged);
+	pthread_mutex_unlock (&m->mtx);
+      }
+  }
+  pthread_mutex_unlock (&masters_mtx);
+  return merged;
 }
 
 static void
-cpu_record_print(struct vty *vty, thread_type filter)
+cpu_record_collect_free (struct hash *merged)
+{
+  hash_clean (merged, cpu_record_hash_free);
+  hash_free (merged);
+}
+
+static void
+cpu_record_print(struct vty *vty, thread_type filter, u_char uj)
 {
   struct cpu_thread_history tmp;
   void *args[3] = {&tmp, vty, &filter};
+  struct hash *merged;
+  json_object *json;
+
+  merged = cpu_record_collect ();
+
+  if (uj)
+    {
+      json = json_object_new_object ();
+      args[0] = json;
+      args[1] = &filter;
+      hash_iterate (merged,
+		    (void (*) (struct hash_backet *, void *))cpu_record_hash_json,
+		    args);
+      cpu_record_collect_free (merged);
+      vty_out (vty, "%s%s",
+	       json_object_to_json_string_ext (json, JSON_C_TO_STRING_PRETTY),
+	       VTY_NEWLINE);
+      json_object_free (json);
+      return;
+    }
 
   memset(&tmp, 0, sizeof tmp);
   tmp.funcname = "TOTAL";
   tmp.types = filter;
 
-  vty_out(vty, "%21s %18s %18s%s",
-	  "", "CPU (user+system):", "Real (wall-clock):", VTY_NEWLINE);
+  vty_out(vty, "%21s %18s %18s %17s%s",
+	  "", "CPU (user+system):", "Real (wall-clock):", "Real percentiles:",
+	  VTY_NEWLINE);
   vty_out(vty, "Active   Runtime(ms)   Invoked Avg uSec Max uSecs");
   vty_out(vty, " Avg uSec Max uSecs");
+  vty_out(vty, " P50 uSec P99 uSec");
   vty_out(vty, "  Type  Thread%s", VTY_NEWLINE);
 
-  pthread_mutex_lock (&cpu_record_mtx);
-  {
-    hash_iterate(cpu_record,
-                 (void(*)(struct hash_backet*,void*))cpu_record_hash_print,
-                 args);
-  }
-  pthread_mutex_unlock (&cpu_record_mtx);
+  hash_iterate(merged,
+	       (void(*)(struct hash_backet*,void*))cpu_record_hash_print,
+	       args);
+  cpu_record_collect_free (merged);
 
   if (tmp.total_calls > 0)
     vty_out_cpu_thread_history(vty, &tmp);
+  if (!cputime_enabled)
+    vty_out(vty, "%sCPU time is not being measured "
+	    "(no service cputime-stats).%s", VTY_NEWLINE, VTY_NEWLINE);
+}
+
+static void
+mailbox_print(struct vty *vty)
+{
+  struct listnode *node;
+  struct thread_master *m;
+
+  vty_out(vty, "%sEvents posted from other pthreads:%s",
+          VTY_NEWLINE, VTY_NEWLINE);
+  vty_out(vty, "%-20s %12s %12s %12s%s",
+          "Thread master", "Posted", "Wakeups", "Drains", VTY_NEWLINE);
+
+  pthread_mutex_lock (&masters_mtx);
+  {
+    for (ALL_LIST_ELEMENTS_RO (masters, node, m))
+      vty_out(vty, "%-20s %12lu %12lu %12lu%s",
+              m->name ? m->name : "(unnamed)",
+              atomic_load_explicit(&m->mailbox_posted, memory_order_relaxed),
+              atomic_load_explicit(&m->mailbox_wakeups, memory_order_relaxed),
+              m->mailbox_drains, VTY_NEWLINE);
+  }
+  pthread_mutex_unlock (&masters_mtx);
 }
 
 DEFUN (show_thread_cpu,
        show_thread_cpu_cmd,
-       "show thread cpu [FILTER]",
+       "show thread cpu [FILTER] [json]",
        SHOW_STR
        "Thread information\n"
        "Thread CPU usage\n"
-       "Display filter (rwtexb)\n")
+       "Display filter (rwtexb)\n"
+       JSON_STR)
 {
   int idx_filter = 3;
   int i = 0;
   thread_type filter = (thread_type) -1U;
+  u_char uj = use_json (argc, argv);
 
-  if (argc > 3)
+  if (argc > 3 + uj)
     {
       filter = 0;
       while (argv[idx_filter]->arg[i] != '\0')
@@ -213,39 +496,231 @@ DEFUN (show_thread_cpu,
 	}
     }
 
-  cpu_record_print(vty, filter);
+  cpu_record_print(vty, filter, uj);
+  if (!uj)
+    mailbox_print(vty);
   return CMD_SUCCESS;
 }
 
+/* Runtimes of each function and lag of each master at these fractions,
+   for show thread latency. */
+static const struct
+{
+  double fraction;
+  const char *json;
+} latency_percentiles[] =
+{
+  { 0.5, "p50Usec" },
+  { 0.9, "p90Usec" },
+  { 0.99, "p99Usec" },
+  { 0.999, "p999Usec" },
+};
+
+static void
+latency_vty_out (struct vty *vty, _Atomic unsigned long *buckets,
+		 unsigned long count, unsigned long max)
+{
+  unsigned int i;
+
+  for (i = 0; i < array_size (latency_percentiles); i++)
+    vty_out (vty, " %10lu",
+	     cpu_hist_percentile (buckets, count, max,
+				  latency_percentiles[i].fraction));
+  vty_out (vty, " %10lu", max);
+}
+
+static void
+latency_json (json_object *json, _Atomic unsigned long *buckets,
+	      unsigned long count, unsigned long max)
+{
+  unsigned int i;
+
+  for (i = 0; i < array_size (latency_percentiles); i++)
+    json_object_long_add (json, latency_percentiles[i].json,
+			  cpu_hist_percentile (buckets, count, max,
+					       latency_percentiles[i].fraction));
+  json_object_long_add (json, "maxUsec", max);
+  json_object_object_add (json, "histogram", cpu_hist_json (buckets));
+}
+
+static void
+latency_hash_print (struct hash_backet *bucket, void *args[])
+{
+  struct vty *vty = args[0];
+  json_object *json = args[1];
+  struct cpu_thread_history *a = bucket->data;
+  json_object *json_task;
+  unsigned long lag_avg;
+
+  if (a->total_calls == 0)
+    return;
+
+  lag_avg = a->lag_calls ? a->lag.total / a->lag_calls : 0;
+  if (json)
+    {
+      json_task = json_object_new_object ();
+      json_object_long_add (json_task, "invoked", a->total_calls);
+      latency_json (json_task, a->buckets, a->total_calls, a->real.max);
+      json_object_long_add (json_task, "lagCalls", a->lag_calls);
+      json_object_long_add (json_task, "lagAvgUsec", lag_avg);
+      json_object_long_add (json_task, "lagMaxUsec", a->lag.max);
+      json_object_object_add (json, a->funcname, json_task);
+      return;
+    }
+
+  vty_out (vty, "%9u", a->total_calls);
+  latency_vty_out (vty, a->buckets, a->total_calls, a->real.max);
+  vty_out (vty, " %10lu %10lu  %s%s", lag_avg, a->lag.max, a->funcname,
+	   VTY_NEWLINE);
+}
+
+static void
+latency_print (struct vty *vty, u_char uj)
+{
+  json_object *json = NULL, *json_masters = NULL, *json_master;
+  json_object *json_tasks = NULL;
+  void *args[2] = { vty, NULL };
+  struct listnode *node;
+  struct thread_master *m;
+  struct hash *merged;
+  unsigned long count, total, max;
+  const char *name;
+
+  if (uj)
+    {
+      json = json_object_new_object ();
+      json_masters = json_object_new_array ();
+      json_tasks = json_object_new_object ();
+      args[1] = json_tasks;
+    }
+  else
+    {
+      vty_out (vty, "Event loop lag (how late timers and events ran):%s",
+	       VTY_NEWLINE);
+      vty_out (vty, "%-20s %9s %10s %10s %10s %10s %10s %10s%s",
+	       "Thread master", "Runs", "Avg uSec", "P50 uSec", "P90 uSec",
+	       "P99 uSec", "P99.9 uSec", "Max uSec", VTY_NEWLINE);
+    }
+
+  pthread_mutex_lock (&masters_mtx);
+  {
+    for (ALL_LIST_ELEMENTS_RO (masters, node, m))
+      {
+	name = m->name ? m->name : "(unnamed)";
+	count = atomic_load_explicit (&m->lag_count, memory_order_relaxed);
+	total = atomic_load_explicit (&m->lag.total, memory_order_relaxed);
+	max = atomic_load_explicit (&m->lag.max, memory_order_relaxed);
+	if (json)
+	  {
+	    json_master = json_object_new_object ();
+	    json_object_string_add (json_master, "name", name);
+	    json_object_long_add (json_master, "runs", count);
+	    json_object_long_add (json_master, "avgUsec",
+				  count ? total / count : 0);
+	    latency_json (json_master, m->lag_buckets, count, max);
+	    json_object_array_add (json_masters, json_master);
+	    continue;
+	  }
+	vty_out (vty, "%-20s %9lu %10lu", name, count,
+		 count ? total / count : 0);
+	latency_vty_out (vty, m->lag_buckets, count, max);
+	vty_out (vty, "%s", VTY_NEWLINE);
+      }
+  }
+  pthread_mutex_unlock (&masters_mtx);
+
+  if (!json)
+    {
+      vty_out (vty, "%sTask runtimes (wall-clock), and how late they ran:%s",
+	       VTY_NEWLINE, VTY_NEWLINE);
+      vty_out (vty, "%9s %10s %10s %10s %10s %10s %10s %10s  %s%s",
+	       "Invoked", "P50 uSec", "P90 uSec", "P99 uSec", "P99.9 uSec",
+	       "Max uSec", "Lag avg", "Lag max", "Thread", VTY_NEWLINE);
+    }
+
+  merged = cpu_record_collect ();
+  hash_iterate (merged,
+		(void (*) (struct hash_backet *, void *))latency_hash_print,
+		args);
+  cpu_record_collect_free (merged);
+
+  if (json)
+    {
+      json_object_object_add (json, "threadMasters", json_masters);
+      json_object_object_add (json, "tasks", json_tasks);
+      vty_out (vty, "%s%s",
+	       json_object_to_json_string_ext (json, JSON_C_TO_STRING_PRETTY),
+	       VTY_NEWLINE);
+      json_object_free (json);
+    }
+}
+
+DEFUN (show_thread_latency,
+       show_thread_latency_cmd,
+       "show thread latency [json]",
+       SHOW_STR
+       "Thread information\n"
+       "Task runtime and event loop lag distribution\n"
+       JSON_STR)
+{
+  latency_print (vty, use_json (argc, argv));
+  return CMD_SUCCESS;
+}
+
+/* Entries stay around, since tasks point at them, and total_active is
+   still accurate; everything else starts over. */
 static void
 cpu_record_hash_clear (struct hash_backet *bucket, 
 		      void *args)
 {
   thread_type *filter = args;
   struct cpu_thread_history *a = bucket->data;
+  unsigned int i;
 
   if ( !(a->types & *filter) )
        return;
-  
-  pthread_mutex_lock (&cpu_record_mtx);
-  {
-    hash_release (cpu_record, bucket->data);
-  }
-  pthread_mutex_unlock (&cpu_record_mtx);
+
+  atomic_store_explicit (&a->total_calls, 0, memory_order_relaxed);
+  atomic_store_explicit (&a->real.total, 0, memory_order_relaxed);
+  atomic_store_explicit (&a->real.max, 0, memory_order_relaxed);
+  atomic_store_explicit (&a->cpu.total, 0, memory_order_relaxed);
+  atomic_store_explicit (&a->cpu.max, 0, memory_order_relaxed);
+  atomic_store_explicit (&a->lag_calls, 0, memory_order_relaxed);
+  atomic_store_explicit (&a->lag.total, 0, memory_order_relaxed);
+  atomic_store_explicit (&a->lag.max, 0, memory_order_relaxed);
+  atomic_store_explicit (&a->types, 0, memory_order_relaxed);
+  for (i = 0; i < THREAD_HIST_BUCKETS; i++)
+    atomic_store_explicit (&a->buckets[i], 0, memory_order_relaxed);
 }
 
 static void
 cpu_record_clear (thread_type filter)
 {
   thread_type *tmp = &filter;
+  struct listnode *node;
+  struct thread_master *m;
+  unsigned int i;
 
-  pthread_mutex_lock (&cpu_record_mtx);
+  pthread_mutex_lock (&masters_mtx);
   {
-    hash_iterate (cpu_record,
-                  (void (*) (struct hash_backet*,void*)) cpu_record_hash_clear,
-                  tmp);
+    for (ALL_LIST_ELEMENTS_RO (masters, node, m))
+      {
+	pthread_mutex_lock (&m->mtx);
+	hash_iterate (m->cpu_record,
+		      (void (*) (struct hash_backet*,void*)) cpu_record_hash_clear,
+		      tmp);
+	pthread_mutex_unlock (&m->mtx);
+
+	if (!(filter & ((1 << THREAD_TIMER) | (1 << THREAD_EVENT))))
+	  continue;
+	atomic_store_explicit (&m->lag_count, 0, memory_order_relaxed);
+	atomic_store_explicit (&m->lag.total, 0, memory_order_relaxed);
+	atomic_store_explicit (&m->lag.max, 0, memory_order_relaxed);
+	for (i = 0; i < THREAD_HIST_BUCKETS; i++)
+	  atomic_store_explicit (&m->lag_buckets[i], 0, memory_order_relaxed);
+      }
   }
-  pthread_mutex_unlock (&cpu_record_mtx);
+  pthread_mutex_unlock (&masters_mtx);
 }
 
 DEFUN (clear_thread_cpu,
@@ -309,11 +784,68 @@ DEFUN (clear_thread_cpu,
   return CMD_SUCCESS;
 }
 
+DEFUN (service_cputime_stats,
+       service_cputime_stats_cmd,
+       "service cputime-stats",
+       "Set up miscellaneous service\n"
+       "Measure the CPU time tasks take\n")
+{
+  cputime_enabled = true;
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_service_cputime_stats,
+       no_service_cputime_stats_cmd,
+       "no service cputime-stats",
+       NO_STR
+       "Set up miscellaneous service\n"
+       "Measure the CPU time tasks take\n")
+{
+  cputime_enabled = false;
+  return CMD_SUCCESS;
+}
+
+DEFUN (service_walltime_warning,
+       service_walltime_warning_cmd,
+       "service walltime-warning (1-3600000) [backtrace]",
+       "Set up miscellaneous service\n"
+       "Warn about tasks running for longer than this\n"
+       "Wall clock time in milliseconds\n"
+       "Take a backtrace of such tasks while they are still running\n")
+{
+  int idx_number = 2;
+
+  atomic_store_explicit (&walltime_warning,
+			 strtoul (argv[idx_number]->arg, NULL, 10) * 1000,
+			 memory_order_relaxed);
+  atomic_store_explicit (&walltime_backtrace, argc > 3, memory_order_relaxed);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_service_walltime_warning,
+       no_service_walltime_warning_cmd,
+       "no service walltime-warning [(1-3600000) [backtrace]]",
+       NO_STR
+       "Set up miscellaneous service\n"
+       "Warn about tasks running for longer than this\n"
+       "Wall clock time in milliseconds\n"
+       "Take a backtrace of such tasks while they are still running\n")
+{
+  atomic_store_explicit (&walltime_warning, 0, memory_order_relaxed);
+  atomic_store_explicit (&walltime_backtrace, false, memory_order_relaxed);
+  return CMD_SUCCESS;
+}
+
 void
 thread_cmd_init (void)
 {
   install_element (VIEW_NODE, &show_thread_cpu_cmd);
+  install_element (VIEW_NODE, &show_thread_latency_cmd);
   install_element (ENABLE_NODE, &clear_thread_cpu_cmd);
+  install_element (CONFIG_NODE, &service_cputime_stats_cmd);
+  install_element (CONFIG_NODE, &no_service_cputime_stats_cmd);
+  install_element (CONFIG_NODE, &service_walltime_warning_cmd);
+  install_element (CONFIG_NODE, &no_service_walltime_warning_cmd);
 }
 
 static int
@@ -337,6 +869,277 @@ thread_timer_update(void *node, int actual_position)
   thread->index = actual_position;
 }
 
+static void
+thread_poll_init (struct thread_master *m)
+{
+  m->handler.pfdsize = m->fd_limit;
+  m->handler.pfdcount = 0;
+  m->handler.pfds = XCALLOC (MTYPE_THREAD_MASTER,
+                             sizeof (struct pollfd) * m->handler.pfdsize);
+  m->handler.copy = XCALLOC (MTYPE_THREAD_MASTER,
+                             sizeof (struct pollfd) * m->handler.pfdsize);
+}
+
+#ifdef HAVE_EPOLL
+/* Upper bound on events returned by a single epoll_wait(); anything beyond
+ * this stays pending (level-triggered) and is picked up on the next pass. */
+#define THREAD_EPOLL_EVENTS 1024
+
+static int thread_process_io_helper (struct thread_master *, struct thread *,
+                                     short, int);
+
+static int
+thread_epoll_init (struct thread_master *m)
+{
+  struct epoll_event ev;
+
+  m->handler.epfd = epoll_create1 (EPOLL_CLOEXEC);
+  if (m->handler.epfd < 0)
+    {
+      zlog_warn ("epoll_create1() failed, falling back to poll(): %s",
+                 safe_strerror (errno));
+      return -1;
+    }
+
+  memset (&ev, 0, sizeof (ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = m->io_pipe[0];
+  if (epoll_ctl (m->handler.epfd, EPOLL_CTL_ADD, m->io_pipe[0], &ev) < 0)
+    {
+      zlog_warn ("epoll_ctl() failed, falling back to poll(): %s",
+                 safe_strerror (errno));
+      close (m->handler.epfd);
+      m->handler.epfd = -1;
+      return -1;
+    }
+
+  m->handler.eparmed = XCALLOC (MTYPE_THREAD_MASTER,
+                                sizeof (uint32_t) * m->fd_limit);
+  m->handler.epevents = XCALLOC (MTYPE_THREAD_MASTER,
+                                 sizeof (struct epoll_event)
+                                 * THREAD_EPOLL_EVENTS);
+  return 0;
+}
+
+static void
+thread_epoll_fini (struct thread_master *m)
+{
+  close (m->handler.epfd);
+  m->handler.epfd = -1;
+  XFREE (MTYPE_THREAD_MASTER, m->handler.eparmed);
+  XFREE (MTYPE_THREAD_MASTER, m->handler.epevents);
+}
+
+/* Make the epoll registration for fd match the read/write threads currently
+ * scheduled on it.  Registrations are not dropped on thread_cancel() or when
+ * a thread is dispatched, so the common "run handler, reschedule read" cycle
+ * only ever needs an EPOLL_CTL_MOD.  That MOD can't be skipped altogether:
+ * the daemon may have closed the fd (which silently drops it from the epoll
+ * set) and gotten the same number back for a new socket since we last saw
+ * it.  The only case where we know better is if a thread for the other
+ * direction is still pending, which pins the fd open. */
+static void
+thread_epoll_arm (struct thread_master *m, int fd, int dir)
+{
+  uint32_t *armed = &m->handler.eparmed[fd];
+  struct thread *other;
+  struct epoll_event ev;
+  uint32_t want = 0;
+  int ret = -1;
+
+  if (m->read[fd])
+    want |= EPOLLIN;
+  if (m->write[fd])
+    want |= EPOLLOUT;
+
+  other = (dir == THREAD_READ) ? m->write[fd] : m->read[fd];
+  if (other && (*armed & want) == want)
+    return;
+
+  memset (&ev, 0, sizeof (ev));
+  ev.events = want;
+  ev.data.fd = fd;
+
+  errno = ENOENT;
+  if (*armed)
+    ret = epoll_ctl (m->handler.epfd, EPOLL_CTL_MOD, fd, &ev);
+  if (ret < 0 && errno == ENOENT)
+    {
+      ret = epoll_ctl (m->handler.epfd, EPOLL_CTL_ADD, fd, &ev);
+      if (ret < 0 && errno == EEXIST)
+        ret = epoll_ctl (m->handler.epfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+  if (ret < 0)
+    {
+      if (errno == EPERM)
+        {
+          /* regular files and the like can't be epoll()ed; poll() reports
+           * them as always ready, so do the same here */
+          if (m->read[fd])
+            thread_process_io_helper (m, m->read[fd], 0, -1);
+          if (m->write[fd])
+            thread_process_io_helper (m, m->write[fd], 0, -1);
+        }
+      else
+        zlog_warn ("epoll_ctl() on fd %d failed: %s", fd,
+                   safe_strerror (errno));
+      want = 0;
+    }
+  *armed = want;
+}
+#endif /* HAVE_EPOLL */
+
+static void thread_list_add (struct thread_list *, struct thread *);
+static struct thread *thread_trim_head (struct thread_list *);
+
+#define THREAD_WHEEL_MASK     (THREAD_WHEEL_SLOTS - 1)
+#define THREAD_WHEEL_SPAN(l)  ((time_t)1 << (THREAD_WHEEL_BITS * (l)))
+
+static struct thread_wheel *
+thread_wheel_new (void)
+{
+  struct thread_wheel *wheel;
+  struct timeval now;
+
+  wheel = XCALLOC (MTYPE_THREAD_MASTER, sizeof (struct thread_wheel));
+  monotime (&now);
+  wheel->tick = now.tv_sec + 1;
+  return wheel;
+}
+
+static void
+thread_wheel_insert (struct thread_master *m, struct thread *thread)
+{
+  struct thread_wheel *wheel = m->wheel;
+  time_t expires = thread->u.sands.tv_sec;
+  time_t delta = expires - wheel->tick;
+  struct thread_list *slot;
+  int level;
+
+  /* already due, the heap can deal with it right away */
+  if (delta < 0)
+    {
+      pqueue_enqueue (thread, m->timer);
+      return;
+    }
+
+  for (level = 0; level < THREAD_WHEEL_LEVELS - 1; level++)
+    if (delta < THREAD_WHEEL_SPAN (level + 1))
+      break;
+
+  /* past the end of the wheel; park it in the last slot, it will be
+   * cascaded down again from there */
+  if (delta >= THREAD_WHEEL_SPAN (THREAD_WHEEL_LEVELS))
+    expires = wheel->tick + THREAD_WHEEL_SPAN (THREAD_WHEEL_LEVELS) - 1;
+
+  slot = &wheel->slot[level][(expires >> (THREAD_WHEEL_BITS * level))
+                             & THREAD_WHEEL_MASK];
+  thread_list_add (slot, thread);
+  thread->wheel_slot = slot;
+  wheel->count++;
+}
+
+static void
+thread_wheel_cascade (struct thread_master *m, struct thread_list *slot)
+{
+  struct thread_list list = *slot;
+  struct thread *thread;
+
+  memset (slot, 0, sizeof (*slot));
+  while ((thread = thread_trim_head (&list)) != NULL)
+    {
+      m->wheel->count--;
+      thread_wheel_insert (m, thread);
+    }
+}
+
+/* Move the timers of all seconds up to and including now onto the heap. */
+static void
+thread_wheel_advance (struct thread_master *m, struct timeval *now)
+{
+  struct thread_wheel *wheel = m->wheel;
+  struct thread *thread;
+
+  if (!wheel)
+    return;
+
+  while (wheel->tick <= now->tv_sec)
+    {
+      time_t tick = wheel->tick;
+      int idx = tick & THREAD_WHEEL_MASK;
+      int level;
+
+      if (!wheel->count)
+        {
+          wheel->tick = now->tv_sec + 1;
+          break;
+        }
+
+      for (level = 1; idx == 0 && level < THREAD_WHEEL_LEVELS; level++)
+        {
+          idx = (tick >> (THREAD_WHEEL_BITS * level)) & THREAD_WHEEL_MASK;
+          thread_wheel_cascade (m, &wheel->slot[level][idx]);
+        }
+
+      while ((thread = thread_trim_head (
+                 &wheel->slot[0][tick & THREAD_WHEEL_MASK])) != NULL)
+        {
+          wheel->count--;
+          thread->wheel_slot = NULL;
+          pqueue_enqueue (thread, m->timer);
+        }
+
+      wheel->tick++;
+    }
+}
+
+/* When does thread_wheel_advance() next have something to do? */
+static struct timeval *
+thread_wheel_wait (struct thread_master *m, struct timeval *timer_val)
+{
+  struct thread_wheel *wheel = m->wheel;
+  struct timeval when = { .tv_sec = 0, .tv_usec = 0 };
+  time_t tick;
+
+  if (!wheel || !wheel->count)
+    return NULL;
+
+  /* stop at the first non-empty slot or the next cascade, whichever
+   * comes first */
+  tick = wheel->tick;
+  do
+    {
+      if (wheel->slot[0][tick & THREAD_WHEEL_MASK].head)
+        break;
+      tick++;
+    }
+  while (tick & THREAD_WHEEL_MASK);
+
+  when.tv_sec = tick;
+  monotime_until (&when, timer_val);
+  return timer_val;
+}
+
+static void
+thread_wheel_free (struct thread_master *m)
+{
+  struct thread_wheel *wheel = m->wheel;
+  struct thread *thread;
+  int level, idx;
+
+  /* hand whatever is left over to the heap */
+  for (level = 0; level < THREAD_WHEEL_LEVELS; level++)
+    for (idx = 0; idx < THREAD_WHEEL_SLOTS; idx++)
+      while ((thread = thread_trim_head (&wheel->slot[level][idx])) != NULL)
+        {
+          thread->wheel_slot = NULL;
+          pqueue_enqueue (thread, m->timer);
+        }
+
+  XFREE (MTYPE_THREAD_MASTER, m->wheel);
+}
+
 /* Allocate new thread master.  */
 struct thread_master *
 thread_master_create (void)
@@ -346,20 +1149,17 @@ thread_master_create (void)
 
   getrlimit(RLIMIT_NOFILE, &limit);
 
-  pthread_mutex_lock (&cpu_record_mtx);
-  {
-    if (cpu_record == NULL)
-      cpu_record = hash_create ((unsigned int (*) (void *))cpu_record_hash_key,
-                                (int (*) (const void *, const void *))
-                                cpu_record_hash_cmp);
-  }
-  pthread_mutex_unlock (&cpu_record_mtx);
-
   rv = XCALLOC (MTYPE_THREAD_MASTER, sizeof (struct thread_master));
   if (rv == NULL)
     return NULL;
 
+  rv->cpu_record = hash_create ((unsigned int (*) (void *))cpu_record_hash_key,
+                                (int (*) (const void *, const void *))
+                                cpu_record_hash_cmp);
+
   pthread_mutex_init (&rv->mtx, NULL);
+  pthread_cond_init (&rv->cancel_cond, NULL);
+  rv->cancel_req = list_new ();
 
   rv->fd_limit = (int)limit.rlim_cur;
   rv->read = XCALLOC (MTYPE_THREAD, sizeof (struct thread *) * rv->fd_limit);
@@ -382,21 +1182,67 @@ thread_master_create (void)
   rv->background = pqueue_create();
   rv->timer->cmp = rv->background->cmp = thread_timer_cmp;
   rv->timer->update = rv->background->update = thread_timer_update;
+  rv->wheel = thread_wheel_new ();
   rv->spin = true;
   rv->handle_signals = true;
-  rv->owner = pthread_self();
+  atomic_store_explicit (&rv->owner, pthread_self (), memory_order_relaxed);
+#ifdef HAVE_EVENTFD
+  rv->io_pipe[0] = rv->io_pipe[1] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
   pipe (rv->io_pipe);
   set_nonblocking (rv->io_pipe[0]);
   set_nonblocking (rv->io_pipe[1]);
+#endif
 
-  rv->handler.pfdsize = rv->fd_limit;
-  rv->handler.pfdcount = 0;
-  rv->handler.pfds = XCALLOC (MTYPE_THREAD_MASTER,
-                              sizeof (struct pollfd) * rv->handler.pfdsize);
+#ifdef HAVE_EPOLL
+  if (thread_epoll_init (rv) < 0)
+#endif
+    thread_poll_init (rv);
+
+  pthread_mutex_lock (&masters_mtx);
+  {
+    if (masters == NULL)
+      masters = list_new ();
+    listnode_add (masters, rv);
+  }
+  pthread_mutex_unlock (&masters_mtx);
 
   return rv;
 }
 
+/* Switch a freshly created master from epoll() back to poll().  Must be
+ * called before any read or write thread is scheduled on it. */
+void
+thread_master_use_poll (struct thread_master *m)
+{
+  pthread_mutex_lock (&m->mtx);
+  {
+#ifdef HAVE_EPOLL
+    if (m->handler.epfd >= 0)
+      {
+        thread_epoll_fini (m);
+        thread_poll_init (m);
+      }
+#endif
+  }
+  pthread_mutex_unlock (&m->mtx);
+}
+
+/* Enable or disable keeping timers one second or more out on the timer
+ * wheel rather than on the heap. */
+void
+thread_master_set_timer_wheel (struct thread_master *m, bool enable)
+{
+  pthread_mutex_lock (&m->mtx);
+  {
+    if (enable && !m->wheel)
+      m->wheel = thread_wheel_new ();
+    else if (!enable && m->wheel)
+      thread_wheel_free (m);
+  }
+  pthread_mutex_unlock (&m->mtx);
+}
+
 /* Add a new thread to the list.  */
 static void
 thread_list_add (struct thread_list *list, struct thread *thread)
@@ -454,7 +1300,8 @@ thread_add_unuse (struct thread_master *m, struct thread *thread)
   thread->ref = NULL;
 
   thread->type = THREAD_UNUSED;
-  thread->hist->total_active--;
+  atomic_fetch_sub_explicit (&thread->hist->total_active, 1,
+                             memory_order_relaxed);
   thread_list_add (&m->unuse, thread);
 }
 
@@ -526,36 +1373,58 @@ thread_master_free_unused (struct thread_master *m)
       }
   }
   pthread_mutex_unlock (&m->mtx);
-}
-
-/* Stop thread scheduler. */
-void
-thread_master_free (struct thread_master *m)
-{
+}
+
+static void thread_mailbox_drain (struct thread_master *);
+
+/* Stop thread scheduler. */
+void
+thread_master_free (struct thread_master *m)
+{
+  bool last;
+
+  pthread_mutex_lock (&masters_mtx);
+  {
+    listnode_delete (masters, m);
+    last = (listcount (masters) == 0);
+    if (last)
+      {
+        list_free (masters);
+        masters = NULL;
+      }
+  }
+  pthread_mutex_unlock (&masters_mtx);
+
+  pthread_mutex_lock (&m->mtx);
+  {
+    thread_mailbox_drain (m);
+  }
+  pthread_mutex_unlock (&m->mtx);
   thread_array_free (m, m->read);
   thread_array_free (m, m->write);
+  if (m->wheel)
+    thread_wheel_free (m);
   thread_queue_free (m, m->timer);
   thread_list_free (m, &m->event);
   thread_list_free (m, &m->ready);
   thread_list_free (m, &m->unuse);
   thread_queue_free (m, m->background);
+  list_delete (m->cancel_req);
+  pthread_cond_destroy (&m->cancel_cond);
   pthread_mutex_destroy (&m->mtx);
   close (m->io_pipe[0]);
-  close (m->io_pipe[1]);
+  if (m->io_pipe[1] != m->io_pipe[0])
+    close (m->io_pipe[1]);
 
+#ifdef HAVE_EPOLL
+  if (m->handler.epfd >= 0)
+    thread_epoll_fini (m);
+#endif
   XFREE (MTYPE_THREAD_MASTER, m->handler.pfds);
+  XFREE (MTYPE_THREAD_MASTER, m->handler.copy);
+  hash_clean (m->cpu_record, cpu_record_hash_free);
+  hash_free (m->cpu_record);
   XFREE (MTYPE_THREAD_MASTER, m);
-
-  pthread_mutex_lock (&cpu_record_mtx);
-  {
-    if (cpu_record)
-      {
-        hash_clean (cpu_record, cpu_record_hash_free);
-        hash_free (cpu_record);
-        cpu_record = NULL;
-      }
-  }
-  pthread_mutex_unlock (&cpu_record_mtx);
 }
 
 /* Return remain time in second. */
@@ -588,13 +1457,25 @@ thread_timer_remain(struct thread *thread)
   return remain;
 }
 
+/* Must be called with m->mtx held. */
+static struct cpu_thread_history *
+thread_hist_get (struct thread_master *m, int (*func) (struct thread *),
+                 const char *funcname)
+{
+  struct cpu_thread_history tmp;
+
+  tmp.func = func;
+  tmp.funcname = funcname;
+  return hash_get (m->cpu_record, &tmp,
+                   (void * (*) (void *))cpu_record_hash_alloc);
+}
+
 /* Get new thread.  */
 static struct thread *
 thread_get (struct thread_master *m, u_char type,
 	    int (*func) (struct thread *), void *arg, debugargdef)
 {
   struct thread *thread = thread_trim_head (&m->unuse);
-  struct cpu_thread_history tmp;
 
   if (! thread)
     {
@@ -609,6 +1490,7 @@ thread_get (struct thread_master *m, u_char type,
   thread->master = m;
   thread->arg = arg;
   thread->index = -1;
+  thread->wheel_slot = NULL;
   thread->yield = THREAD_YIELD_TIME_SLOT; /* default */
   thread->ref = NULL;
 
@@ -624,17 +1506,9 @@ thread_get (struct thread_master *m, u_char type,
    */
   if (thread->funcname != funcname ||
       thread->func != func)
-    {
-      tmp.func = func;
-      tmp.funcname = funcname;
-      pthread_mutex_lock (&cpu_record_mtx);
-      {
-        thread->hist = hash_get (cpu_record, &tmp,
-                                 (void * (*) (void *))cpu_record_hash_alloc);
-      }
-      pthread_mutex_unlock (&cpu_record_mtx);
-    }
-  thread->hist->total_active++;
+    thread->hist = thread_hist_get (m, func, funcname);
+  atomic_fetch_add_explicit (&thread->hist->total_active, 1,
+                             memory_order_relaxed);
   thread->func = func;
   thread->funcname = funcname;
   thread->schedfrom = schedfrom;
@@ -644,12 +1518,8 @@ thread_get (struct thread_master *m, u_char type,
 }
 
 static int
-fd_poll (struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
-         nfds_t count, struct timeval *timer_wait)
+fd_poll_timeout (struct thread_master *m, struct timeval *timer_wait)
 {
-  if (count == 0)
-    return 0;
-
   /* If timer_wait is null here, that means poll() should block indefinitely,
    * unless the thread_master has overriden it by setting ->selectpoll_timeout.
    * If the value is positive, it specifies the maximum number of milliseconds
@@ -658,9 +1528,6 @@ fd_poll (struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
    * zero, the behavior is default. */
   int timeout = -1;
 
-  /* number of file descriptors with events */
-  int num;
-
   if (timer_wait != NULL && m->selectpoll_timeout == 0) // use the default value
     timeout = (timer_wait->tv_sec*1000) + (timer_wait->tv_usec/1000);
   else if (m->selectpoll_timeout > 0) // use the user's timeout
@@ -668,6 +1535,21 @@ fd_poll (struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
   else if (m->selectpoll_timeout < 0) // effect a poll (return immediately)
     timeout = 0;
 
+  return timeout;
+}
+
+static int
+fd_poll (struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
+         nfds_t count, struct timeval *timer_wait)
+{
+  if (count == 0)
+    return 0;
+
+  int timeout = fd_poll_timeout (m, timer_wait);
+
+  /* number of file descriptors with events */
+  int num;
+
   /* add poll pipe poker */
   assert (count + 1 < pfdsize);
   pfds[count].fd = m->io_pipe[0];
@@ -683,6 +1565,25 @@ fd_poll (struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
   return num;
 }
 
+#ifdef HAVE_EPOLL
+static int
+fd_epoll (struct thread_master *m, struct timeval *timer_wait)
+{
+  return epoll_wait (m->handler.epfd, m->handler.epevents,
+                     THREAD_EPOLL_EVENTS, fd_poll_timeout (m, timer_wait));
+}
+#endif
+
+static bool
+thread_master_epoll (struct thread_master *m)
+{
+#ifdef HAVE_EPOLL
+  return m->handler.epfd >= 0;
+#else
+  return false;
+#endif
+}
+
 /* Add new read thread. */
 struct thread *
 funcname_thread_add_read_write (int dir, struct thread_master *m,
@@ -699,27 +1600,32 @@ funcname_thread_add_read_write (int dir, struct thread_master *m,
         return NULL;
       }
 
-    /* default to a new pollfd */
-    nfds_t queuepos = m->handler.pfdcount;
+    if (!thread_master_epoll (m))
+      {
+        /* default to a new pollfd */
+        nfds_t queuepos = m->handler.pfdcount;
 
-    /* if we already have a pollfd for our file descriptor, find and use it */
-    for (nfds_t i = 0; i < m->handler.pfdcount; i++)
-      if (m->handler.pfds[i].fd == fd)
-        {
-          queuepos = i;
-          break;
-        }
+        /* if we already have a pollfd for our file descriptor, find and use
+         * it */
+        for (nfds_t i = 0; i < m->handler.pfdcount; i++)
+          if (m->handler.pfds[i].fd == fd)
+            {
+              queuepos = i;
+              break;
+            }
 
-    /* make sure we have room for this fd + pipe poker fd */
-    assert (queuepos + 1 < m->handler.pfdsize);
+        /* make sure we have room for this fd + pipe poker fd */
+        assert (queuepos + 1 < m->handler.pfdsize);
 
-    thread = thread_get (m, dir, func, arg, debugargpass);
+        m->handler.pfds[queuepos].fd = fd;
+        m->handler.pfds[queuepos].events |=
+          (dir == THREAD_READ ? POLLIN : POLLOUT);
 
-    m->handler.pfds[queuepos].fd = fd;
-    m->handler.pfds[queuepos].events |= (dir == THREAD_READ ? POLLIN : POLLOUT);
+        if (queuepos == m->handler.pfdcount)
+          m->handler.pfdcount++;
+      }
 
-    if (queuepos == m->handler.pfdcount)
-      m->handler.pfdcount++;
+    thread = thread_get (m, dir, func, arg, debugargpass);
 
     if (thread)
       {
@@ -740,7 +1646,14 @@ funcname_thread_add_read_write (int dir, struct thread_master *m,
           }
       }
 
-    AWAKEN (m);
+#ifdef HAVE_EPOLL
+    /* the kernel picks up epoll_ctl() changes even while another pthread
+     * sits in epoll_wait(), so there is nobody to wake up */
+    if (thread_master_epoll (m))
+      thread_epoll_arm (m, fd, dir);
+    else
+#endif
+      AWAKEN (m);
   }
   pthread_mutex_unlock (&m->mtx);
 
@@ -775,7 +1688,11 @@ funcname_thread_add_timer_timeval (struct thread_master *m,
     {
       monotime(&thread->u.sands);
       timeradd(&thread->u.sands, time_relative, &thread->u.sands);
-      pqueue_enqueue(thread, queue);
+      thread->due = thread->u.sands;
+      if (type == THREAD_TIMER && m->wheel && time_relative->tv_sec >= 1)
+        thread_wheel_insert (m, thread);
+      else
+        pqueue_enqueue(thread, queue);
       if (t_ptr)
         {
           *t_ptr = thread;
@@ -784,7 +1701,9 @@ funcname_thread_add_timer_timeval (struct thread_master *m,
     }
     pthread_mutex_unlock (&thread->mtx);
 
-    AWAKEN (m);
+    /* the owner can't be sleeping in poll() while it's adding timers */
+    if (!thread_master_owned (m))
+      AWAKEN (m);
   }
   pthread_mutex_unlock (&m->mtx);
 
@@ -861,16 +1780,100 @@ funcname_thread_add_background (struct thread_master *m,
                                             t_ptr, debugargpass);
 }
 
-/* Add simple event thread. */
+/* Post an event from a pthread other than the owner of m.  The thread is
+ * allocated here rather than taken from m->unuse (which belongs to the
+ * owner) and pushed onto m->mailbox without taking m->mtx; the owner moves
+ * it onto the event list on its next pass through thread_fetch(). */
+static struct thread *
+thread_mailbox_post (struct thread_master *m,
+        int (*func) (struct thread *), void *arg, int val, debugargdef)
+{
+  struct thread *thread, *head;
+
+  thread = XCALLOC (MTYPE_THREAD, sizeof (struct thread));
+  pthread_mutex_init (&thread->mtx, NULL);
+  thread->type = THREAD_EVENT;
+  thread->add_type = THREAD_EVENT;
+  thread->master = m;
+  thread->func = func;
+  thread->arg = arg;
+  thread->u.val = val;
+  thread->index = -1;
+  thread->yield = THREAD_YIELD_TIME_SLOT;
+  thread->funcname = funcname;
+  thread->schedfrom = schedfrom;
+  thread->schedfrom_line = fromln;
+  monotime (&thread->due);
+
+  head = atomic_load_explicit (&m->mailbox, memory_order_relaxed);
+  do
+    thread->next = head;
+  while (!atomic_compare_exchange_weak_explicit (&m->mailbox, &head, thread,
+                                                 memory_order_release,
+                                                 memory_order_relaxed));
+
+  atomic_fetch_add_explicit (&m->mailbox_posted, 1, memory_order_relaxed);
+
+  /* if the mailbox wasn't empty, whoever filled it has already woken up the
+   * owner, and it hasn't gotten around to emptying it yet */
+  if (head == NULL)
+    {
+      atomic_fetch_add_explicit (&m->mailbox_wakeups, 1,
+                                 memory_order_relaxed);
+      AWAKEN (m);
+    }
+
+  return thread;
+}
+
+/* Move events posted from other pthreads onto the event list, in the order
+ * they were posted.  Must be called with m->mtx held. */
+static void
+thread_mailbox_drain (struct thread_master *m)
+{
+  struct thread *thread, *next, *fifo = NULL;
+
+  if (atomic_load_explicit (&m->mailbox, memory_order_relaxed) == NULL)
+    return;
+
+  thread = atomic_exchange_explicit (&m->mailbox, NULL, memory_order_acquire);
+  for (; thread; thread = next)
+    {
+      next = thread->next;
+      thread->next = fifo;
+      fifo = thread;
+    }
+
+  for (thread = fifo; thread; thread = next)
+    {
+      next = thread->next;
+      thread->next = NULL;
+      thread->hist = thread_hist_get (m, thread->func, thread->funcname);
+      atomic_fetch_add_explicit (&thread->hist->total_active, 1,
+                                 memory_order_relaxed);
+      m->alloc++;
+      thread_list_add (&m->event, thread);
+    }
+  m->mailbox_drains++;
+}
+
+/* Add simple event thread.  May be called from any pthread; events without
+ * a back reference posted from outside the owning pthread go through the
+ * lock-free mailbox. */
 struct thread *
 funcname_thread_add_event (struct thread_master *m,
         int (*func) (struct thread *), void *arg, int val,
         struct thread **t_ptr, debugargdef)
 {
   struct thread *thread;
+  bool foreign;
 
   assert (m != NULL);
 
+  foreign = !thread_master_owned (m);
+  if (foreign && !t_ptr)
+    return thread_mailbox_post (m, func, arg, val, debugargpass);
+
   pthread_mutex_lock (&m->mtx);
   {
     if (t_ptr && *t_ptr) // thread is already scheduled; don't reschedule
@@ -883,6 +1886,7 @@ funcname_thread_add_event (struct thread_master *m,
     pthread_mutex_lock (&thread->mtx);
     {
       thread->u.val = val;
+      monotime (&thread->due);
       thread_list_add (&m->event, thread);
     }
     pthread_mutex_unlock (&thread->mtx);
@@ -893,7 +1897,8 @@ funcname_thread_add_event (struct thread_master *m,
         thread->ref = t_ptr;
       }
 
-    AWAKEN (m);
+    if (foreign)
+      AWAKEN (m);
   }
   pthread_mutex_unlock (&m->mtx);
 
@@ -903,6 +1908,10 @@ funcname_thread_add_event (struct thread_master *m,
 static void
 thread_cancel_read_or_write (struct thread *thread, short int state)
 {
+  /* epoll registrations are left in place, see thread_epoll_arm() */
+  if (thread_master_epoll (thread->master))
+    return;
+
   for (nfds_t i = 0; i < thread->master->handler.pfdcount; ++i)
     if (thread->master->handler.pfds[i].fd == thread->u.fd)
       {
@@ -920,23 +1929,16 @@ thread_cancel_read_or_write (struct thread *thread, short int state)
       }
 }
 
-/**
- * Cancel thread from scheduler.
- *
- * This function is *NOT* MT-safe. DO NOT call it from any other pthread except
- * the one which owns thread->master. You will crash.
- */
-void
-thread_cancel (struct thread *thread)
+/* Take a thread off whatever list, queue or array it is scheduled on.
+ * Called with thread->master->mtx held. */
+static void
+thread_cancel_locked (struct thread *thread)
 {
   struct thread_list *list = NULL;
   struct pqueue *queue = NULL;
   struct thread **thread_array = NULL;
 
   pthread_mutex_lock (&thread->mtx);
-  pthread_mutex_lock (&thread->master->mtx);
-
-  assert (pthread_self() == thread->master->owner);
 
   switch (thread->type)
     {
@@ -949,7 +1951,14 @@ thread_cancel (struct thread *thread)
       thread_array = thread->master->write;
       break;
     case THREAD_TIMER:
-      queue = thread->master->timer;
+      if (thread->wheel_slot)
+        {
+          list = thread->wheel_slot;
+          thread->wheel_slot = NULL;
+          thread->master->wheel->count--;
+        }
+      else
+        queue = thread->master->timer;
       break;
     case THREAD_EVENT:
       list = &thread->master->event;
@@ -968,7 +1977,7 @@ thread_cancel (struct thread *thread)
   if (queue)
     {
       assert(thread->index >= 0);
-      pqueue_remove (thread, queue);
+      pqueue_remove_at (thread->index, queue);
     }
   else if (list)
     {
@@ -989,10 +1998,82 @@ thread_cancel (struct thread *thread)
   thread_add_unuse (thread->master, thread);
 
 done:
-  pthread_mutex_unlock (&thread->master->mtx);
   pthread_mutex_unlock (&thread->mtx);
 }
 
+/**
+ * Cancel thread from scheduler.
+ *
+ * This function is *NOT* MT-safe. DO NOT call it from any other pthread except
+ * the one which owns thread->master. You will crash.  Other pthreads must use
+ * thread_cancel_async().
+ */
+void
+thread_cancel (struct thread *thread)
+{
+  struct thread_master *m = thread->master;
+
+  pthread_mutex_lock (&m->mtx);
+  {
+    assert (thread_master_owned (m));
+    thread_cancel_locked (thread);
+  }
+  pthread_mutex_unlock (&m->mtx);
+}
+
+/* Carry out cancellation requests queued by thread_cancel_async().  Called
+ * by the owner with m->mtx held, only ever between two tasks. */
+static void
+thread_cancel_process (struct thread_master *m)
+{
+  struct listnode *node;
+  struct thread **ref;
+
+  if (listcount (m->cancel_req) == 0)
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (m->cancel_req, node, ref))
+    if (*ref)
+      thread_cancel_locked (*ref);
+
+  list_delete_all_node (m->cancel_req);
+  m->canceled = true;
+  pthread_cond_broadcast (&m->cancel_cond);
+}
+
+/**
+ * Cancel a thread from a pthread other than the one running its master.
+ *
+ * The request is queued for the owner, which handles it in between two
+ * tasks, and the caller blocks until that has happened.  On return the task
+ * *thread referred to is neither scheduled nor running, and *thread is NULL.
+ * *thread must only be set through the thread_add_* functions of m.
+ *
+ * Called from the owner itself this is the same as thread_cancel().
+ */
+void
+thread_cancel_async (struct thread_master *m, struct thread **thread)
+{
+  pthread_mutex_lock (&m->mtx);
+  {
+    if (thread_master_owned (m))
+      {
+        if (*thread)
+          thread_cancel_locked (*thread);
+      }
+    else
+      {
+        listnode_add (m->cancel_req, thread);
+        m->canceled = false;
+        AWAKEN (m);
+
+        while (!m->canceled)
+          pthread_cond_wait (&m->cancel_cond, &m->mtx);
+      }
+  }
+  pthread_mutex_unlock (&m->mtx);
+}
+
 /* Delete all events which has argument value arg. */
 unsigned int
 thread_cancel_event (struct thread_master *m, void *arg)
@@ -1003,6 +2084,8 @@ thread_cancel_event (struct thread_master *m, void *arg)
 
   pthread_mutex_lock (&m->mtx);
   {
+    thread_mailbox_drain (m);
+
     thread = m->event.head;
     while (thread)
       {
@@ -1088,10 +2171,60 @@ thread_process_io_helper (struct thread_master *m, struct thread *thread,
   thread->type = THREAD_READY;
   /* if another pthread scheduled this file descriptor for the event we're
    * responding to, no problem; we're getting to it now */
-  thread->master->handler.pfds[pos].events &= ~(state);
+  if (pos >= 0)
+    thread->master->handler.pfds[pos].events &= ~(state);
   return 1;
 }
 
+#ifdef HAVE_EPOLL
+static void
+thread_process_epoll (struct thread_master *m, unsigned int num)
+{
+  static unsigned char trash[64];
+
+  for (unsigned int i = 0; i < num; i++)
+    {
+      struct epoll_event *ev = &m->handler.epevents[i];
+      int fd = ev->data.fd;
+      struct thread *rt, *wt;
+      struct epoll_event mod;
+
+      if (fd == m->io_pipe[0])
+        {
+          while (read (m->io_pipe[0], &trash, sizeof (trash)) > 0);
+          continue;
+        }
+
+      rt = m->read[fd];
+      wt = m->write[fd];
+
+      /* lazily drop registrations left behind by thread_cancel() or by a
+       * handler that didn't reschedule itself */
+      if (!rt && !wt)
+        {
+          epoll_ctl (m->handler.epfd, EPOLL_CTL_DEL, fd, NULL);
+          m->handler.eparmed[fd] = 0;
+          continue;
+        }
+      if (((ev->events & EPOLLIN) && !rt) || ((ev->events & EPOLLOUT) && !wt))
+        {
+          memset (&mod, 0, sizeof (mod));
+          mod.events = (rt ? EPOLLIN : 0) | (wt ? EPOLLOUT : 0);
+          mod.data.fd = fd;
+          epoll_ctl (m->handler.epfd, EPOLL_CTL_MOD, fd, &mod);
+          m->handler.eparmed[fd] = mod.events;
+        }
+
+      /* errors and hangups are reported regardless of the registered mask;
+       * hand them to whoever is waiting so the condition gets cleared */
+      if (ev->events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        thread_process_io_helper (m, rt, 0, -1);
+      if (ev->events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+        thread_process_io_helper (m, wt, 0, -1);
+    }
+}
+#endif /* HAVE_EPOLL */
+
 static void
 thread_process_io (struct thread_master *m, struct pollfd *pfds,
         unsigned int num, unsigned int count)
@@ -1182,8 +2315,15 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
   struct timeval now;
   struct timeval timer_val = { .tv_sec = 0, .tv_usec = 0 };
   struct timeval timer_val_bg;
+  struct timeval timer_val_wheel;
   struct timeval *timer_wait = &timer_val;
   struct timeval *timer_wait_bg;
+  struct timeval *timer_wait_wheel;
+
+  /* whoever runs the loop owns it; for frr_pthreads, the master is created
+   * before the pthread that runs it */
+  if (!thread_master_owned (m))
+    atomic_store_explicit (&m->owner, pthread_self (), memory_order_relaxed);
 
   do
     {
@@ -1194,6 +2334,8 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
         quagga_sigevent_process ();
        
       pthread_mutex_lock (&m->mtx);
+      thread_cancel_process (m);
+
       /* Drain the ready queue of already scheduled jobs, before scheduling
        * more.
        */
@@ -1212,6 +2354,7 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
        */
        
       /* Normal event are the next highest priority.  */
+      thread_mailbox_drain (m);
       thread_process (&m->event);
       
       /* Calculate select wait timer if nothing else to do */
@@ -1219,7 +2362,11 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
         {
           timer_wait = thread_timer_wait (m->timer, &timer_val);
           timer_wait_bg = thread_timer_wait (m->background, &timer_val_bg);
-          
+          timer_wait_wheel = thread_wheel_wait (m, &timer_val_wheel);
+
+          if (timer_wait_wheel &&
+              (!timer_wait || (timercmp (timer_wait, timer_wait_wheel, >))))
+            timer_wait = timer_wait_wheel;
           if (timer_wait_bg &&
               (!timer_wait || (timercmp (timer_wait, timer_wait_bg, >))))
             timer_wait = timer_wait_bg;
@@ -1231,17 +2378,36 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
           timer_wait = &timer_val;
         }
 
-      /* copy pollfds so we can unlock during blocking calls to poll() */
-      struct pollfd pfds[m->handler.pfdsize];
-      unsigned int count = m->handler.pfdcount + m->handler.pfdcountsnmp;
-      memcpy (pfds, m->handler.pfds, count * sizeof (struct pollfd));
+      unsigned int count = 0;
 
-      pthread_mutex_unlock (&m->mtx);
-      {
-        num = fd_poll (m, pfds, m->handler.pfdsize, count, timer_wait);
-      }
-      pthread_mutex_lock (&m->mtx);
+#ifdef HAVE_EPOLL
+      if (thread_master_epoll (m))
+        {
+          pthread_mutex_unlock (&m->mtx);
+          {
+            num = fd_epoll (m, timer_wait);
+          }
+          pthread_mutex_lock (&m->mtx);
+        }
+      else
+#endif
+        {
+          /* copy pollfds so we can unlock during blocking calls to poll() */
+          count = m->handler.pfdcount + m->handler.pfdcountsnmp;
+          memcpy (m->handler.copy, m->handler.pfds,
+                  count * sizeof (struct pollfd));
+
+          pthread_mutex_unlock (&m->mtx);
+          {
+            num = fd_poll (m, m->handler.copy, m->handler.pfdsize, count,
+                           timer_wait);
+          }
+          pthread_mutex_lock (&m->mtx);
+        }
       
+      /* someone may have been waiting on us while we were blocked */
+      thread_cancel_process (m);
+
       /* Signals should get quick treatment */
       if (num < 0)
         {
@@ -1250,7 +2416,9 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
               pthread_mutex_unlock (&m->mtx);
               continue; /* signal received - process it */
             }
-          zlog_warn ("poll() error: %s", safe_strerror (errno));
+          zlog_warn ("%s() error: %s",
+                     thread_master_epoll (m) ? "epoll_wait" : "poll",
+                     safe_strerror (errno));
           pthread_mutex_unlock (&m->mtx);
           return NULL;
         }
@@ -1259,11 +2427,17 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
        * priority than I/O threads, so let's push them onto the ready
        * list in front of the I/O threads. */
       monotime(&now);
+      thread_wheel_advance (m, &now);
       thread_process_timers (m->timer, &now);
       
       /* Got IO, process it */
+#ifdef HAVE_EPOLL
+      if (num > 0 && thread_master_epoll (m))
+        thread_process_epoll (m, num);
+      else
+#endif
       if (num > 0)
-        thread_process_io (m, pfds, num, count);
+        thread_process_io (m, m->handler.copy, num, count);
 
 #if 0
       /* If any threads were made ready above (I/O or foreground timer),
@@ -1344,54 +2518,285 @@ void
 thread_getrusage (RUSAGE_T *r)
 {
   monotime(&r->real);
+#ifdef RUSAGE_THREAD
+  getrusage(RUSAGE_THREAD, &(r->cpu));
+#else
   getrusage(RUSAGE_SELF, &(r->cpu));
+#endif
+}
+
+/* CPU time of the calling pthread. */
+static void
+thread_cputime (struct timespec *ts)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, ts);
+#else
+  struct rusage ru;
+
+  getrusage (RUSAGE_SELF, &ru);
+  ts->tv_sec = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec;
+  ts->tv_nsec = (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000;
+#endif
+}
+
+#ifdef HAVE_GLIBC_BACKTRACE
+/* Slow tasks are only logged once they are done, which for a task that
+   has the whole daemon stuck is far too late to find out what it is stuck
+   on.  With "service walltime-warning N backtrace", a watchdog pthread
+   looks in on the task each master is running, and once it is running
+   late, signals the pthread running it to take a backtrace right then.
+   thread_call() logs it along with the warning when the task is done. */
+#define THREAD_WATCHDOG_SIGNAL  SIGRTMIN
+#define THREAD_BACKTRACE_DEPTH  32
+
+static __thread void *thread_backtrace[THREAD_BACKTRACE_DEPTH];
+static __thread volatile sig_atomic_t thread_backtrace_size;
+static __thread bool thread_watchdog_unblocked;
+
+static _Atomic bool watchdog_running;
+
+static unsigned long
+monotime_usec (const struct timespec *ts)
+{
+  return ts->tv_sec * TIMER_SECOND_MICRO + ts->tv_nsec / 1000;
+}
+
+static void
+thread_watchdog_signal (int signo)
+{
+  int saved_errno = errno;
+
+  if (thread_backtrace_size == 0)
+    thread_backtrace_size = backtrace (thread_backtrace,
+				       THREAD_BACKTRACE_DEPTH);
+  errno = saved_errno;
+}
+
+static void *
+thread_watchdog (void *arg)
+{
+  struct cpu_thread_history *hist;
+  struct thread_master *m;
+  struct listnode *node;
+  struct timespec now, nap;
+  unsigned long warning, start, usec;
+
+  for (;;)
+    {
+      /* look in often enough to catch a task not too long after it has
+	 gone past the warning */
+      warning = atomic_load_explicit (&walltime_warning, memory_order_relaxed);
+      if (!atomic_load_explicit (&walltime_backtrace, memory_order_relaxed))
+	warning = 0;
+      usec = warning ? warning / 4 : TIMER_SECOND_MICRO;
+      usec = MAX (MIN (usec, (unsigned long) TIMER_SECOND_MICRO), 10000UL);
+      nap.tv_sec = usec / TIMER_SECOND_MICRO;
+      nap.tv_nsec = usec % TIMER_SECOND_MICRO * 1000;
+      nanosleep (&nap, NULL);
+      if (!warning)
+	continue;
+
+      clock_gettime (CLOCK_MONOTONIC, &now);
+      usec = monotime_usec (&now);
+
+      pthread_mutex_lock (&masters_mtx);
+      for (ALL_LIST_ELEMENTS_RO (masters, node, m))
+	{
+	  start = atomic_load_explicit (&m->task_start, memory_order_acquire);
+	  if (!start || start == m->watchdog_start || usec - start <= warning)
+	    continue;
+	  hist = atomic_load_explicit (&m->task_hist, memory_order_relaxed);
+	  if (start != atomic_load_explicit (&m->task_start,
+					     memory_order_acquire))
+	    continue;
+
+	  /* once per task */
+	  m->watchdog_start = start;
+	  zlog_warn ("SLOW THREAD: task %s has been running for %lums",
+		     hist->funcname, (usec - start) / 1000);
+	  pthread_kill (atomic_load_explicit (&m->owner, memory_order_relaxed),
+			THREAD_WATCHDOG_SIGNAL);
+	}
+      pthread_mutex_unlock (&masters_mtx);
+    }
+
+  return NULL;
+}
+
+static void
+thread_watchdog_atfork (void)
+{
+  atomic_store_explicit (&watchdog_running, false, memory_order_relaxed);
+}
+
+/* Get the watchdog going, if need be, and let it signal this pthread.
+   Done from thread_call() rather than when configured, as a daemon forks
+   after reading its config, leaving any pthreads behind. */
+static bool
+thread_watchdog_start (void)
+{
+  struct sigaction sa;
+  sigset_t set, oldmask;
+  pthread_t watchdog;
+  bool running = false;
+
+  if (!thread_watchdog_unblocked)
+    {
+      /* frr_pthreads start out with all signals blocked */
+      sigemptyset (&set);
+      sigaddset (&set, THREAD_WATCHDOG_SIGNAL);
+      pthread_sigmask (SIG_UNBLOCK, &set, NULL);
+      thread_watchdog_unblocked = true;
+    }
+
+  if (atomic_load_explicit (&watchdog_running, memory_order_relaxed)
+      || !atomic_compare_exchange_strong (&watchdog_running, &running, true))
+    return true;
+
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = thread_watchdog_signal;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset (&sa.sa_mask);
+  sigaction (THREAD_WATCHDOG_SIGNAL, &sa, NULL);
+  pthread_atfork (NULL, NULL, thread_watchdog_atfork);
+
+  /* backtrace() loads libgcc the first time around, which can't be done
+     in a signal handler */
+  backtrace (thread_backtrace, THREAD_BACKTRACE_DEPTH);
+
+  /* the watchdog doesn't take any signals */
+  sigfillset (&set);
+  pthread_sigmask (SIG_SETMASK, &set, &oldmask);
+  if (pthread_create (&watchdog, NULL, thread_watchdog, NULL) == 0)
+    pthread_detach (watchdog);
+  else
+    zlog_warn ("Can't start the slow task watchdog: %s",
+	       safe_strerror (errno));
+  pthread_sigmask (SIG_SETMASK, &oldmask, NULL);
+  return true;
+}
+#endif /* HAVE_GLIBC_BACKTRACE */
+
+static void
+thread_walltime_warn (struct thread *thread, unsigned long realtime,
+		      unsigned long cputime, unsigned long lag, bool traced)
+{
+  /*
+   * We have a CPU Hog on our hands.
+   * Whinge about it now, so we're aware this is yet another task
+   * to fix.
+   */
+  zlog_warn ("SLOW THREAD: task %s (%lx) scheduled from %s:%d ran for %lums "
+	     "(cpu time %lums, started %lums late)",
+	     thread->funcname, (unsigned long) thread->func,
+	     thread->schedfrom, thread->schedfrom_line,
+	     realtime / 1000, cputime / 1000, lag / 1000);
+
+#ifdef HAVE_GLIBC_BACKTRACE
+  {
+    int i, size = thread_backtrace_size;
+    char **strings;
+
+    if (!traced || size <= 0)
+      return;
+    zlog_warn ("SLOW THREAD: task %s was at:", thread->funcname);
+    strings = backtrace_symbols (thread_backtrace, size);
+    for (i = 0; i < size; i++)
+      if (strings)
+	zlog_warn ("[bt %d] %s", i, strings[i]);
+      else
+	zlog_warn ("[bt %d] %p", i, thread_backtrace[i]);
+    free (strings);
+  }
+#endif /* HAVE_GLIBC_BACKTRACE */
 }
 
 struct thread *thread_current = NULL;
 
-/* We check thread consumed time. If the system has getrusage, we'll
-   use that to get in-depth stats on the performance of the thread in addition
-   to wall clock time stats from gettimeofday. */
+/* We check thread consumed time: wall clock time always, and the CPU time
+   of this pthread unless switched off with "no service cputime-stats".
+   Only the pthread running the task's master updates its history, so
+   this doesn't need any locks. */
 void
 thread_call (struct thread *thread)
 {
-  unsigned long realtime, cputime;
-  RUSAGE_T before, after;
-
-  GETRUSAGE (&before);
-  thread->real = before.real;
+  struct cpu_thread_history *hist = thread->hist;
+  struct thread_master *m = thread->master;
+  unsigned long realtime, cputime = 0, lag = 0, warning;
+  struct timespec before, after, cpu_before, cpu_after;
+  bool cputime_stats = cputime_enabled;
+  bool lagged, traced = false;
+  thread_type types;
+
+  clock_gettime (CLOCK_MONOTONIC, &before);
+  if (cputime_stats)
+    thread_cputime (&cpu_before);
+  thread->real.tv_sec = before.tv_sec;
+  thread->real.tv_usec = before.tv_nsec / 1000;
+
+  /* how late the task is, if it was due at some point */
+  lagged = (thread->add_type == THREAD_TIMER
+	    || thread->add_type == THREAD_EVENT);
+  if (lagged && timercmp (&thread->real, &thread->due, >))
+    lag = timeval_elapsed (thread->real, thread->due);
+
+#ifdef HAVE_GLIBC_BACKTRACE
+  /* let the watchdog know, unless this is a task run from within another
+     one */
+  if (m && atomic_load_explicit (&walltime_backtrace, memory_order_relaxed)
+      && atomic_load_explicit (&m->task_start, memory_order_relaxed) == 0
+      && thread_watchdog_start ())
+    {
+      traced = true;
+      thread_backtrace_size = 0;
+      atomic_store_explicit (&m->task_hist, hist, memory_order_relaxed);
+      atomic_store_explicit (&m->task_start, monotime_usec (&before),
+			     memory_order_release);
+    }
+#endif
 
   thread_current = thread;
   (*thread->func) (thread);
   thread_current = NULL;
 
-  GETRUSAGE (&after);
+  if (traced)
+    atomic_store_explicit (&m->task_start, 0, memory_order_release);
 
-  realtime = thread_consumed_time (&after, &before, &cputime);
-  thread->hist->real.total += realtime;
-  if (thread->hist->real.max < realtime)
-    thread->hist->real.max = realtime;
-  thread->hist->cpu.total += cputime;
-  if (thread->hist->cpu.max < cputime)
-    thread->hist->cpu.max = cputime;
-
-  ++(thread->hist->total_calls);
-  thread->hist->types |= (1 << thread->add_type);
+  clock_gettime (CLOCK_MONOTONIC, &after);
+  realtime = timespec_elapsed (&after, &before);
+  if (cputime_stats)
+    {
+      thread_cputime (&cpu_after);
+      cputime = timespec_elapsed (&cpu_after, &cpu_before);
+    }
 
-#ifdef CONSUMED_TIME_CHECK
-  if (realtime > CONSUMED_TIME_CHECK)
+  time_stats_add (&hist->real, realtime);
+  time_stats_add (&hist->cpu, cputime);
+  atomic_fetch_add_explicit (&hist->buckets[cpu_hist_bucket (realtime)], 1,
+                             memory_order_relaxed);
+  atomic_fetch_add_explicit (&hist->total_calls, 1, memory_order_relaxed);
+  types = atomic_load_explicit (&hist->types, memory_order_relaxed);
+  if (!(types & (1 << thread->add_type)))
+    atomic_store_explicit (&hist->types, types | (1 << thread->add_type),
+                           memory_order_relaxed);
+
+  if (lagged)
     {
-      /*
-       * We have a CPU Hog on our hands.
-       * Whinge about it now, so we're aware this is yet another task
-       * to fix.
-       */
-      zlog_warn ("SLOW THREAD: task %s (%lx) ran for %lums (cpu time %lums)",
-		 thread->funcname,
-		 (unsigned long) thread->func,
-		 realtime/1000, cputime/1000);
+      time_stats_add (&hist->lag, lag);
+      atomic_fetch_add_explicit (&hist->lag_calls, 1, memory_order_relaxed);
+      if (m)
+	{
+	  time_stats_add (&m->lag, lag);
+	  atomic_fetch_add_explicit (&m->lag_count, 1, memory_order_relaxed);
+	  atomic_fetch_add_explicit (&m->lag_buckets[cpu_hist_bucket (lag)],
+				     1, memory_order_relaxed);
+	}
     }
-#endif /* CONSUMED_TIME_CHECK */
+
+  warning = atomic_load_explicit (&walltime_warning, memory_order_relaxed);
+  if (warning && realtime > warning)
+    thread_walltime_warn (thread, realtime, cputime, lag, traced);
 }
 
 /* Execute thread */
@@ -1402,7 +2807,6 @@ funcname_thread_execute (struct thread_master *m,
                 int val,
 		debugargdef)
 {
-  struct cpu_thread_history tmp;
   struct thread dummy;
 
   memset (&dummy, 0, sizeof (struct thread));
@@ -1414,14 +2818,13 @@ funcname_thread_execute (struct thread_master *m,
   dummy.arg = arg;
   dummy.u.val = val;
 
-  tmp.func = dummy.func = func;
-  tmp.funcname = dummy.funcname = funcname;
-  pthread_mutex_lock (&cpu_record_mtx);
+  dummy.func = func;
+  dummy.funcname = funcname;
+  pthread_mutex_lock (&m->mtx);
   {
-    dummy.hist = hash_get (cpu_record, &tmp,
-                           (void * (*) (void *))cpu_record_hash_alloc);
+    dummy.hist = thread_hist_get (m, func, funcname);
   }
-  pthread_mutex_unlock (&cpu_record_mtx);
+  pthread_mutex_unlock (&m->mtx);
 
   dummy.schedfrom = schedfrom;
   dummy.schedfrom_line = fromln;
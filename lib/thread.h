@@ -24,7 +24,11 @@
 #include <zebra.h>
 #include <pthread.h>
 #include <poll.h>
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
 #include "monotime.h"
+#include "frratomic.h"
 
 struct rusage_t
 {
@@ -45,6 +49,25 @@ struct thread_list
 
 struct pqueue;
 
+/* Hierarchical timing wheel for timers at least one second out.  Level 0
+ * has one slot per second; each further level covers THREAD_WHEEL_SLOTS
+ * slots of the level below.  Timers are moved onto the timer heap once
+ * their second comes up, so expiry precision and ordering are the same as
+ * for timers kept on the heap all along. */
+#define THREAD_WHEEL_BITS     6
+#define THREAD_WHEEL_SLOTS    (1 << THREAD_WHEEL_BITS)
+#define THREAD_WHEEL_LEVELS   4
+
+struct thread_wheel
+{
+  /* next second (monotonic clock) whose level 0 slot hasn't been moved to
+   * the timer heap yet */
+  time_t tick;
+  /* number of timers on the wheel */
+  unsigned long count;
+  struct thread_list slot[THREAD_WHEEL_LEVELS][THREAD_WHEEL_SLOTS];
+};
+
 struct fd_handler
 {
   /* number of pfd stored in pfds */
@@ -54,14 +77,43 @@ struct fd_handler
   /* number of pfd that fit in the allocated space of pfds */
   nfds_t pfdsize;
   struct pollfd *pfds;
+  /* scratch copy of pfds handed to poll() while the master is unlocked */
+  struct pollfd *copy;
+#ifdef HAVE_EPOLL
+  /* epoll instance, or -1 if this master uses poll() */
+  int epfd;
+  /* event mask each fd is currently registered for with epfd, indexed by
+   * fd; registrations are kept across thread_cancel() and only dropped when
+   * the kernel reports activity nobody is waiting for */
+  uint32_t *eparmed;
+  struct epoll_event *epevents;
+#endif
+};
+
+/* Runtime histograms, HDR style: values under THREAD_HIST_SUB (usec) have
+ * a bucket each, and every power of 2 above that is split into
+ * THREAD_HIST_SUB buckets, so a bucket is never wider than 1/THREAD_HIST_SUB
+ * of the values in it.  Anything from 2^THREAD_HIST_MAX_BITS usec (about
+ * 2 minutes) up goes into the last bucket. */
+#define THREAD_HIST_SUB_BITS  3
+#define THREAD_HIST_SUB       (1 << THREAD_HIST_SUB_BITS)
+#define THREAD_HIST_MAX_BITS  27
+#define THREAD_HIST_BUCKETS \
+  ((THREAD_HIST_MAX_BITS - THREAD_HIST_SUB_BITS + 1) << THREAD_HIST_SUB_BITS)
+
+struct time_stats
+{
+  _Atomic unsigned long total, max;
 };
 
 /* Master of the theads. */
 struct thread_master
 {
+  const char *name;
   struct thread **read;
   struct thread **write;
   struct pqueue *timer;
+  struct thread_wheel *wheel;
   struct thread_list event;
   struct thread_list ready;
   struct thread_list unuse;
@@ -74,7 +126,36 @@ struct thread_master
   bool spin;
   bool handle_signals;
   pthread_mutex_t mtx;
-  pthread_t owner;
+  /* The pthread running the loop.  Set by thread_fetch(), read by
+   * whichever pthread is adding to or cancelling from this master. */
+  _Atomic pthread_t owner;
+
+  /* Events posted from other pthreads.  Producers push onto this stack
+   * without taking mtx; the owner takes the whole stack in one go. */
+  struct thread * _Atomic mailbox;
+  _Atomic unsigned long mailbox_posted;
+  _Atomic unsigned long mailbox_wakeups;
+  unsigned long mailbox_drains;
+
+  /* Cancellation requests from other pthreads, see thread_cancel_async().
+   * Entries are the callers' struct thread ** references. */
+  struct list *cancel_req;
+  bool canceled;
+  pthread_cond_t cancel_cond;
+
+  /* cpu_thread_history for each function run on this master. */
+  struct hash *cpu_record;
+
+  /* How late timers and events ran, in usec, see thread_call(). */
+  _Atomic unsigned long lag_count;
+  struct time_stats lag;
+  _Atomic unsigned long lag_buckets[THREAD_HIST_BUCKETS];
+
+  /* The task running right now, for the watchdog that takes backtraces of
+   * slow tasks; task_start (monotonic usec) is 0 in between tasks. */
+  _Atomic unsigned long task_start;
+  struct cpu_thread_history * _Atomic task_hist;
+  unsigned long watchdog_start;
 };
 
 typedef unsigned char thread_type;
@@ -96,7 +177,9 @@ struct thread
     struct timeval sands;           /* rest of time sands value. */
   } u;
   int index;                        /* queue position for timers */
+  struct thread_list *wheel_slot;   /* timer wheel slot, if not on the heap */
   struct timeval real;
+  struct timeval due;               /* when a timer or event was due to run */
   struct cpu_thread_history *hist;  /* cache pointer to cpu_history */
   unsigned long yield;              /* yield time in microseconds */
   const char *funcname;             /* name of thread function */
@@ -105,18 +188,22 @@ struct thread
   pthread_mutex_t mtx;              /* mutex for thread.c functions */
 };
 
+/* Counters are updated by the pthread running the master the history
+   belongs to, and may be read from any pthread. */
 struct cpu_thread_history 
 {
   int (*func)(struct thread *);
-  unsigned int total_calls;
-  unsigned int total_active;
-  struct time_stats
-  {
-    unsigned long total, max;
-  } real;
+  _Atomic unsigned int total_calls;
+  _Atomic unsigned int total_active;
+  struct time_stats real;
   struct time_stats cpu;
-  thread_type types;
+  /* how late timers and events for the function ran, and how many */
+  struct time_stats lag;
+  _Atomic unsigned int lag_calls;
+  _Atomic thread_type types;
   const char *funcname;
+  /* wall clock runtimes */
+  _Atomic unsigned long buckets[THREAD_HIST_BUCKETS];
 };
 
 /* Struct timeval's tv_usec one second value.  */
@@ -170,6 +257,8 @@ struct cpu_thread_history
 extern struct thread_master *thread_master_create (void);
 extern void thread_master_free (struct thread_master *);
 extern void thread_master_free_unused(struct thread_master *);
+extern void thread_master_use_poll (struct thread_master *);
+extern void thread_master_set_timer_wheel (struct thread_master *, bool);
 
 extern struct thread * funcname_thread_add_read_write (int dir, struct thread_master *,
     int (*)(struct thread *), void *, int, struct thread **, debugargdef);
@@ -194,6 +283,7 @@ extern void funcname_thread_execute (struct thread_master *,
 #undef debugargdef
 
 extern void thread_cancel (struct thread *);
+extern void thread_cancel_async (struct thread_master *, struct thread **);
 extern unsigned int thread_cancel_event (struct thread_master *, void *);
 extern struct thread *thread_fetch (struct thread_master *, struct thread *);
 extern void thread_call (struct thread *);
@@ -203,10 +293,33 @@ extern int thread_should_yield (struct thread *);
 /* set yield time for thread */
 extern void thread_set_yield_time (struct thread *, unsigned long);
 
+/* Is the calling pthread the one running m's loop? */
+static inline bool
+thread_master_owned (struct thread_master *m)
+{
+  return pthread_equal (pthread_self (),
+                        atomic_load_explicit (&m->owner,
+                                              memory_order_relaxed));
+}
+
 /* Internal libfrr exports */
 extern void thread_getrusage (RUSAGE_T *);
 extern void thread_cmd_init (void);
 
+/* Whether thread_call() measures CPU time ("service cputime-stats"). */
+extern bool cputime_enabled;
+
+/* Tasks running for longer than this many usec are logged, 0 for none
+   ("service walltime-warning"), with a backtrace taken while they are
+   still at it if walltime_backtrace is set. */
+#ifdef CONSUMED_TIME_CHECK
+#define WALLTIME_WARNING_DEFAULT CONSUMED_TIME_CHECK
+#else
+#define WALLTIME_WARNING_DEFAULT 0
+#endif
+extern _Atomic unsigned long walltime_warning;
+extern _Atomic bool walltime_backtrace;
+
 /* Returns elapsed real (wall clock) time. */
 extern unsigned long thread_consumed_time(RUSAGE_T *after, RUSAGE_T *before,
 					  unsigned long *cpu_time_elapsed);
@@ -42,6 +42,7 @@
 DEFINE_MTYPE_STATIC(LIB, VTY,         "VTY")
 DEFINE_MTYPE_STATIC(LIB, VTY_OUT_BUF, "VTY output buffer")
 DEFINE_MTYPE_STATIC(LIB, VTY_HIST,    "VTY history")
+DEFINE_MTYPE_STATIC(LIB, VTY_LOG,     "VTY monitor line")
 
 /* Vty events */
 enum event
@@ -65,6 +66,16 @@ extern struct host host;
 /* Vector which store each vty structure. */
 static vector vtyvec;
 
+/* Master of the threads. */
+static struct thread_master *vty_master;
+
+/* Number of vtys with monitor set, for pthreads other than the main one
+   to tell whether to pass their log messages on; and how many of those
+   are waiting for the main one. */
+static _Atomic unsigned int vty_monitors;
+static _Atomic unsigned int vty_log_pending;
+#define VTY_LOG_PENDING_MAX 1024
+
 /* Vty timeout value. */
 static unsigned long vty_timeout_val = VTY_TIMEOUT_DEFAULT;
 
@@ -92,6 +103,18 @@ char integrate_default[] = SYSCONFDIR INTEGRATE_DEFAULT_CONFIG;
 
 static int do_log_commands = 0;
 
+static void
+vty_monitor_set (struct vty *vty, int monitor)
+{
+  if (!vty->monitor == !monitor)
+    return;
+  vty->monitor = monitor;
+  if (monitor)
+    atomic_fetch_add_explicit (&vty_monitors, 1, memory_order_relaxed);
+  else
+    atomic_fetch_sub_explicit (&vty_monitors, 1, memory_order_relaxed);
+}
+
 /* VTY standard output function. */
 int
 vty_out (struct vty *vty, const char *format, ...)
@@ -153,39 +176,46 @@ vty_out (struct vty *vty, const char *format, ...)
   return len;
 }
 
+/* Format a line for the terminal monitors into buf.  Returns its length,
+   or -1 if it doesn't fit. */
 static int
-vty_log_out (struct vty *vty, const char *level, const char *proto_str,
-             const char *format, struct timestamp_control *ctl, va_list va)
+vty_log_format (char *buf, size_t size, const char *level,
+                const char *proto_str, const char *format,
+                struct timestamp_control *ctl, va_list va)
 {
   int ret;
   int len;
-  char buf[1024];
 
   if (!ctl->already_rendered)
     {
       ctl->len = quagga_timestamp(ctl->precision, ctl->buf, sizeof(ctl->buf));
       ctl->already_rendered = 1;
     }
-  if (ctl->len+1 >= sizeof(buf))
+  if (ctl->len+1 >= size)
     return -1;
   memcpy(buf, ctl->buf, len = ctl->len);
   buf[len++] = ' ';
   buf[len] = '\0';
 
   if (level)
-    ret = snprintf(buf+len, sizeof(buf)-len, "%s: %s: ", level, proto_str);
+    ret = snprintf(buf+len, size-len, "%s: %s: ", level, proto_str);
   else
-    ret = snprintf(buf+len, sizeof(buf)-len, "%s: ", proto_str);
-  if ((ret < 0) || ((size_t)(len += ret) >= sizeof(buf)))
+    ret = snprintf(buf+len, size-len, "%s: ", proto_str);
+  if ((ret < 0) || ((size_t)(len += ret) >= size))
     return -1;
 
-  if (((ret = vsnprintf(buf+len, sizeof(buf)-len, format, va)) < 0) ||
-      ((size_t)((len += ret)+2) > sizeof(buf)))
+  if (((ret = vsnprintf(buf+len, size-len, format, va)) < 0) ||
+      ((size_t)((len += ret)+2) > size))
     return -1;
 
   buf[len++] = '\r';
   buf[len++] = '\n';
+  return len;
+}
 
+static int
+vty_log_out (struct vty *vty, const char *buf, size_t len)
+{
   if (write(vty->wfd, buf, len) < 0)
     {
       if (ERRNO_IO_RETRY(errno))
@@ -193,7 +223,7 @@ vty_log_out (struct vty *vty, const char *level, const char *proto_str,
            drop the data and ignore. */
         return -1;
       /* Fatal I/O error. */
-      vty->monitor = 0; /* disable monitoring to avoid infinite recursion */
+      vty_monitor_set (vty, 0); /* disable monitoring to avoid infinite recursion */
       zlog_warn("%s: write failed to vty client fd %d, closing: %s",
                 __func__, vty->fd, safe_strerror(errno));
       buffer_reset(vty->obuf);
@@ -1440,7 +1470,7 @@ vty_read (struct thread *thread)
               vty_event (VTY_READ, vty_sock, vty);
               return 0;
             }
-          vty->monitor = 0; /* disable monitoring to avoid infinite recursion */
+          vty_monitor_set (vty, 0); /* disable monitoring to avoid infinite recursion */
           zlog_warn("%s: read error on vty client fd %d, closing: %s",
                     __func__, vty->fd, safe_strerror(errno));
           buffer_reset(vty->obuf);
@@ -1663,7 +1693,7 @@ vty_flush (struct thread *thread)
   switch (flushrc)
     {
     case BUFFER_ERROR:
-      vty->monitor = 0; /* disable monitoring to avoid infinite recursion */
+      vty_monitor_set (vty, 0); /* disable monitoring to avoid infinite recursion */
       zlog_warn("buffer_flush failed on vty client fd %d, closing",
                 vty->fd);
       buffer_reset(vty->obuf);
@@ -2118,7 +2148,7 @@ vtysh_flush(struct vty *vty)
       vty_event(VTYSH_WRITE, vty->wfd, vty);
       break;
     case BUFFER_ERROR:
-      vty->monitor = 0; /* disable monitoring to avoid infinite recursion */
+      vty_monitor_set (vty, 0); /* disable monitoring to avoid infinite recursion */
       zlog_warn("%s: write error to fd %d, closing", __func__, vty->fd);
       buffer_reset(vty->obuf);
       vty_close(vty);
@@ -2154,7 +2184,7 @@ vtysh_read (struct thread *thread)
               vty_event (VTYSH_READ, sock, vty);
               return 0;
             }
-          vty->monitor = 0; /* disable monitoring to avoid infinite recursion */
+          vty_monitor_set (vty, 0); /* disable monitoring to avoid infinite recursion */
           zlog_warn("%s: read failed on vtysh client fd %d, closing: %s",
                     __func__, sock, safe_strerror(errno));
         }
@@ -2273,6 +2303,7 @@ vty_close (struct vty *vty)
 
   /* Unset vector. */
   vector_unset (vtyvec, vty->fd);
+  vty_monitor_set (vty, 0);
 
   if (vty->wfd > 0 && vty->type == VTY_FILE)
     fsync (vty->wfd);
@@ -2540,10 +2571,9 @@ tmp_free_and_out:
     XFREE (MTYPE_TMP, tmp);
 }
 
-/* Small utility function which output log to the VTY. */
-void
-vty_log (const char *level, const char *proto_str,
-         const char *format, struct timestamp_control *ctl, va_list va)
+/* Write a formatted line to every terminal monitor.  Main pthread only. */
+static void
+vty_log_all (const char *buf, size_t len)
 {
   unsigned int i;
   struct vty *vty;
@@ -2554,12 +2584,55 @@ vty_log (const char *level, const char *proto_str,
   for (i = 0; i < vector_active (vtyvec); i++)
     if ((vty = vector_slot (vtyvec, i)) != NULL)
       if (vty->monitor)
-        {
-          va_list ac;
-          va_copy(ac, va);
-          vty_log_out (vty, level, proto_str, format, ctl, ac);
-          va_end(ac);
-        }
+        vty_log_out (vty, buf, len);
+}
+
+static int
+vty_log_queued (struct thread *thread)
+{
+  char *line = THREAD_ARG (thread);
+
+  atomic_fetch_sub_explicit (&vty_log_pending, 1, memory_order_relaxed);
+  vty_log_all (line, strlen (line));
+  XFREE (MTYPE_VTY_LOG, line);
+  return 0;
+}
+
+/* Small utility function which output log to the VTY.  The vtys belong
+   to the main pthread, so lines logged on others are handed to it in an
+   event, and dropped if it has too many of those waiting already. */
+void
+vty_log (const char *level, const char *proto_str,
+         const char *format, struct timestamp_control *ctl, va_list va)
+{
+  char buf[1024];
+  char *line;
+  int len;
+
+  if (!vty_master
+      || atomic_load_explicit (&vty_monitors, memory_order_relaxed) == 0)
+    return;
+
+  len = vty_log_format (buf, sizeof (buf), level, proto_str, format, ctl, va);
+  if (len < 0)
+    return;
+
+  if (thread_master_owned (vty_master))
+    {
+      vty_log_all (buf, len);
+      return;
+    }
+
+  if (atomic_fetch_add_explicit (&vty_log_pending, 1, memory_order_relaxed)
+      >= VTY_LOG_PENDING_MAX)
+    {
+      atomic_fetch_sub_explicit (&vty_log_pending, 1, memory_order_relaxed);
+      return;
+    }
+  line = XMALLOC (MTYPE_VTY_LOG, len + 1);
+  memcpy (line, buf, len);
+  line[len] = '\0';
+  thread_add_event (vty_master, vty_log_queued, line, 0, NULL);
 }
 
 /* Async-signal-safe version of vty_log for fixed strings. */
@@ -2625,9 +2698,6 @@ vty_config_lockless (void)
   vty_config_is_lockless = 1;
 }
 
-/* Master of the threads. */
-static struct thread_master *vty_master;
-
 static void
 vty_event (enum event event, int sock, struct vty *vty)
 {
@@ -2899,7 +2969,7 @@ DEFUN_NOSH (terminal_monitor,
        "Set terminal line parameters\n"
        "Copy debug output to the current terminal line\n")
 {
-  vty->monitor = 1;
+  vty_monitor_set (vty, 1);
   return CMD_SUCCESS;
 }
 
@@ -2910,7 +2980,7 @@ DEFUN_NOSH (terminal_no_monitor,
        NO_STR
        "Copy debug output to the current terminal line\n")
 {
-  vty->monitor = 0;
+  vty_monitor_set (vty, 0);
   return CMD_SUCCESS;
 }
 
@@ -31,6 +31,7 @@
 DEFINE_MTYPE(LIB, WORK_QUEUE,             "Work queue")
 DEFINE_MTYPE_STATIC(LIB, WORK_QUEUE_ITEM, "Work queue item")
 DEFINE_MTYPE_STATIC(LIB, WORK_QUEUE_NAME, "Work queue name string")
+DEFINE_MTYPE_STATIC(LIB, WORK_QUEUE_SCHED, "Work queue scheduler")
 
 /* master list of work_queues */
 static struct list _work_queues;
@@ -39,7 +40,96 @@ static struct list _work_queues;
  */
 static struct list *work_queues = &_work_queues;
 
-#define WORK_QUEUE_MIN_GRANULARITY 1
+/* The queues of a thread master are run by one background task between
+ * them, rather than each queue having a task of its own that knows nothing
+ * about the others.  Queues that have work to do, and whose hold time is
+ * up, are on the ready list.  Each run of the task has a time slot, which
+ * every pass of it shares out between the ready queues by weight; time a
+ * queue doesn't use, because it ran out of items, goes to the next pass.
+ */
+struct work_queue_sched
+{
+  struct thread_master *master;
+  struct list *ready;                 /* queues with work to do */
+  struct thread *thread;              /* the task running them */
+  struct work_queue *running;         /* queue being run right now */
+  bool active;                        /* in work_queue_run() */
+  unsigned long runs;                 /* runs of the task */
+  unsigned long passes;               /* passes over the ready queues */
+  unsigned int refcnt;                /* queues on this master */
+};
+
+/* Until a queue has measured how long its items take, guess 10 usec. */
+#define WORK_QUEUE_ITEM_COST 10000
+
+static struct work_queue_sched *
+work_queue_sched_get (struct thread_master *m)
+{
+  struct work_queue_sched *sched;
+  struct work_queue *wq;
+  struct listnode *node;
+
+  for (ALL_LIST_ELEMENTS_RO (work_queues, node, wq))
+    if (wq->master == m)
+      {
+        wq->sched->refcnt++;
+        return wq->sched;
+      }
+
+  sched = XCALLOC (MTYPE_WORK_QUEUE_SCHED, sizeof (struct work_queue_sched));
+  sched->master = m;
+  sched->ready = list_new ();
+  sched->refcnt = 1;
+  return sched;
+}
+
+static void
+work_queue_sched_put (struct work_queue_sched *sched)
+{
+  /* work_queue_run() frees it on its way out */
+  if (--sched->refcnt > 0 || sched->active)
+    return;
+
+  if (sched->thread)
+    thread_cancel (sched->thread);
+  list_delete (sched->ready);
+  XFREE (MTYPE_WORK_QUEUE_SCHED, sched);
+}
+
+static void
+work_queue_ready (struct work_queue *wq)
+{
+  struct work_queue_sched *sched = wq->sched;
+
+  if (wq->ready)
+    return;
+
+  wq->ready = true;
+  listnode_add (sched->ready, wq);
+  if (sched->thread == NULL)
+    thread_add_background (sched->master, work_queue_run, sched, 0,
+                           &sched->thread);
+}
+
+static void
+work_queue_unready (struct work_queue *wq)
+{
+  if (!wq->ready)
+    return;
+
+  wq->ready = false;
+  listnode_delete (wq->sched->ready, wq);
+}
+
+/* Monotonic time, in nsec. */
+static int64_t
+work_queue_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
 static struct work_queue_item *
 work_queue_item_new (struct work_queue *wq)
@@ -85,13 +175,15 @@ work_queue_new (struct thread_master *m, const char *queue_name)
   
   new->items->del = (void (*)(void *)) work_queue_item_free;  
   
+  new->sched = work_queue_sched_get (m);
   listnode_add (work_queues, new);
   
-  new->cycles.granularity = WORK_QUEUE_MIN_GRANULARITY;
+  new->item_cost = WORK_QUEUE_ITEM_COST;
 
   /* Default values, can be overriden by caller */
   new->spec.hold = WORK_QUEUE_DEFAULT_HOLD;
   new->spec.yield = THREAD_YIELD_TIME_SLOT;
+  new->spec.weight = WORK_QUEUE_DEFAULT_WEIGHT;
     
   return new;
 }
@@ -101,6 +193,12 @@ work_queue_free (struct work_queue *wq)
 {
   if (wq->thread != NULL)
     thread_cancel(wq->thread);
+
+  /* the scheduler may be running it, from one of its own callbacks */
+  work_queue_unready (wq);
+  if (wq->sched->running == wq)
+    wq->sched->running = NULL;
+  work_queue_sched_put (wq->sched);
   
   /* list_delete frees items via callback */
   list_delete (wq->items);
@@ -114,23 +212,33 @@ work_queue_free (struct work_queue *wq)
 bool
 work_queue_is_scheduled (struct work_queue *wq)
 {
-  return (wq->thread != NULL);
+  return (wq->thread != NULL || wq->ready);
+}
+
+static int
+work_queue_hold_expired (struct thread *thread)
+{
+  struct work_queue *wq = THREAD_ARG (thread);
+
+  wq->thread = NULL;
+  if (CHECK_FLAG (wq->flags, WQ_UNPLUGGED) && listcount (wq->items) > 0)
+    work_queue_ready (wq);
+  return 0;
 }
 
 static int
 work_queue_schedule (struct work_queue *wq, unsigned int delay)
 {
-  /* if appropriate, schedule work queue thread */
+  /* if appropriate, hand the queue to the scheduler once the hold time is
+   * up */
   if ( CHECK_FLAG (wq->flags, WQ_UNPLUGGED)
        && (wq->thread == NULL)
+       && !wq->ready
+       && (wq->sched->running != wq)
        && (listcount (wq->items) > 0) )
     {
-      wq->thread = NULL;
-      thread_add_background(wq->master, work_queue_run, wq, delay,
+      thread_add_background(wq->master, work_queue_hold_expired, wq, delay,
                             &wq->thread);
-      /* set thread yield time, if needed */
-      if (wq->thread && wq->spec.yield != THREAD_YIELD_TIME_SLOT)
-        thread_set_yield_time (wq->thread, wq->spec.yield);
       return 1;
     }
   else
@@ -151,6 +259,7 @@ work_queue_add (struct work_queue *wq, void *data)
     }
   
   item->data = data;
+  item->added = work_queue_now ();
   listnode_add (wq->items, item);
   
   work_queue_schedule (wq, wq->spec.hold);
@@ -188,36 +297,57 @@ DEFUN (show_work_queues,
        SHOW_STR
        "Work Queue information\n")
 {
-  struct listnode *node;
-  struct work_queue *wq;
+  struct listnode *node, *snode;
+  struct work_queue *wq, *other;
   
   vty_out (vty, 
-           "%c %8s %5s %8s %8s %21s%s",
-           ' ', "List","(ms) ","Q. Runs","Yields","Cycle Counts   ",
-           VTY_NEWLINE);
+           "%c %8s %5s %6s %8s %8s %8s %28s%s",
+           ' ', "List","(ms) ","","Q. Runs","Yields","Item",
+           "Latency (added to done)", VTY_NEWLINE);
   vty_out (vty,
-           "%c %8s %5s %8s %8s %7s %6s %8s %6s %s%s",
+           "%c %8s %5s %6s %8s %8s %8s %9s %9s %8s %s%s",
            'P',
            "Items",
            "Hold",
+           "Weight",
            "Total","Total",
-           "Best","Gran.","Total","Avg.",
+           "Cost(ns)",
+           "Done","Avg.(ms)","Max(ms)",
            "Name", 
            VTY_NEWLINE);
  
   for (ALL_LIST_ELEMENTS_RO (work_queues, node, wq))
     {
-      vty_out (vty,"%c %8d %5d %8ld %8ld %7d %6d %8ld %6u %s%s",
+      vty_out (vty,"%c %8d %5d %6u %8ld %8ld %8lu %9lu %9lu %8lu %s%s",
                (CHECK_FLAG (wq->flags, WQ_UNPLUGGED) ? ' ' : 'P'),
                listcount (wq->items),
                wq->spec.hold,
+               wq->spec.weight,
                wq->runs, wq->yields,
-               wq->cycles.best, wq->cycles.granularity, wq->cycles.total,
-                 (wq->runs) ? 
-                   (unsigned int) (wq->cycles.total / wq->runs) : 0,
+               wq->item_cost,
+               wq->latency.items,
+               (wq->latency.items) ?
+                 wq->latency.total / wq->latency.items / 1000 : 0,
+               wq->latency.max / 1000,
                wq->name,
                VTY_NEWLINE);
     }
+
+  /* one line per scheduler, after the first of its queues is found */
+  for (ALL_LIST_ELEMENTS_RO (work_queues, node, wq))
+    {
+      for (ALL_LIST_ELEMENTS_RO (work_queues, snode, other))
+        if (other->sched == wq->sched)
+          break;
+      if (other != wq)
+        continue;
+      vty_out (vty, "%sScheduler for %s: %lu runs, %lu passes, "
+               "%d queues ready%s",
+               VTY_NEWLINE,
+               wq->master->name ? wq->master->name : "(unnamed)",
+               wq->sched->runs, wq->sched->passes,
+               listcount (wq->sched->ready), VTY_NEWLINE);
+    }
     
   return CMD_SUCCESS;
 }
@@ -238,6 +368,7 @@ work_queue_plug (struct work_queue *wq)
     thread_cancel (wq->thread);
   
   wq->thread = NULL;
+  work_queue_unready (wq);
   
   UNSET_FLAG (wq->flags, WQ_UNPLUGGED);
 }
@@ -254,45 +385,65 @@ work_queue_unplug (struct work_queue *wq)
   work_queue_schedule (wq, wq->spec.hold);
 }
 
-/* timer thread to process a work queue
- * will reschedule itself if required,
- * otherwise work_queue_item_add 
+/* Number of items to run before looking at the clock again, given the
+ * usec left of the queue's share of the time slot: about half of what
+ * the items look like they'd take, so as not to overshoot by much when
+ * they take longer. */
+static unsigned long
+work_queue_batch (struct work_queue *wq, int64_t budget)
+{
+  unsigned long batch;
+
+  batch = budget * 1000 / (int64_t) wq->item_cost / 2;
+  return batch > 0 ? batch : 1;
+}
+
+/* Account for a batch of cycles items that ran from start to now, done of
+ * them being done rather than requeued or left to retry.  Up to start,
+ * those had waited for waited nsec between them, and oldest nsec at most.
  */
-int
-work_queue_run (struct thread *thread)
+static void
+work_queue_account (struct work_queue *wq, int64_t start, int64_t now,
+                    unsigned long cycles, unsigned long done,
+                    int64_t waited, int64_t oldest)
+{
+  unsigned long cost, latency;
+
+  if (cycles > 0)
+    {
+      /* go up at once, but come down slowly */
+      cost = (now - start) / cycles;
+      if (cost > wq->item_cost)
+        wq->item_cost = cost;
+      else
+        wq->item_cost = (wq->item_cost * 7 + cost) / 8;
+      if (wq->item_cost == 0)
+        wq->item_cost = 1;
+    }
+
+  if (done == 0)
+    return;
+  wq->latency.items += done;
+  wq->latency.total += (waited + (now - start) * done) / 1000;
+  latency = (oldest + now - start) / 1000;
+  if (latency > wq->latency.max)
+    wq->latency.max = latency;
+}
+
+/* Run items off wq for up to budget usec.  Returns false if an item
+ * asked for the queue not to be run again for now. */
+static bool
+work_queue_process (struct work_queue *wq, int64_t budget)
 {
-  struct work_queue *wq;
   struct work_queue_item *item;
   wq_item_status ret;
-  unsigned int cycles = 0;
   struct listnode *node, *nnode;
-  char yielded = 0;
-
-  wq = THREAD_ARG (thread);
-  wq->thread = NULL;
+  int64_t start, batch_start, now, waited = 0, oldest = 0;
+  unsigned long batch, cycles = 0, done = 0;
+  bool stop = false, yielded = false;
 
-  assert (wq && wq->items);
-
-  /* calculate cycle granularity:
-   * list iteration == 1 run
-   * listnode processing == 1 cycle
-   * granularity == # cycles between checks whether we should yield.
-   *
-   * granularity should be > 0, and can increase slowly after each run to
-   * provide some hysteris, but not past cycles.best or 2*cycles.
-   *
-   * Best: starts low, can only increase
-   *
-   * Granularity: starts at WORK_QUEUE_MIN_GRANULARITY, can be decreased 
-   *              if we run to end of time slot, can increase otherwise 
-   *              by a small factor.
-   *
-   * We could use just the average and save some work, however we want to be
-   * able to adjust quickly to CPU pressure. Average wont shift much if
-   * daemon has been running a long time.
-   */
-   if (wq->cycles.granularity == 0)
-     wq->cycles.granularity = WORK_QUEUE_MIN_GRANULARITY;
+  start = batch_start = work_queue_now ();
+  batch = work_queue_batch (wq, budget);
 
   for (ALL_LIST_ELEMENTS (wq->items, node, nnode, item))
   {
@@ -328,6 +479,7 @@ work_queue_run (struct thread *thread)
         }
       case WQ_RETRY_LATER:
 	{
+	  stop = true;
 	  goto stats;
 	}
       case WQ_REQUEUE:
@@ -351,67 +503,153 @@ work_queue_run (struct thread *thread)
 	  if (wq->spec.errorfunc)
 	    wq->spec.errorfunc (wq, item);
 	}
-	/* fall through here is deliberate */
+	/* fallthrough */
       case WQ_SUCCESS:
       default:
 	{
+	  if (batch_start - item->added > oldest)
+	    oldest = batch_start - item->added;
+	  waited += batch_start - item->added;
+	  done++;
 	  work_queue_item_remove (wq, node);
 	  break;
 	}
       }
 
-    /* completed cycle */
-    cycles++;
+    /* completed cycle; once the batch is done, test if we should yield */
+    if (++cycles < batch)
+      continue;
 
-    /* test if we should yield */
-    if ( !(cycles % wq->cycles.granularity) 
-        && thread_should_yield (thread))
+    now = work_queue_now ();
+    work_queue_account (wq, batch_start, now, cycles, done, waited, oldest);
+    if ((now - start) / 1000 >= budget)
       {
-        yielded = 1;
-        goto stats;
+        yielded = true;
+        goto yield;
       }
+    batch = work_queue_batch (wq, budget - (now - start) / 1000);
+    batch_start = now;
+    cycles = done = 0;
+    waited = oldest = 0;
   }
 
 stats:
+  work_queue_account (wq, batch_start, work_queue_now (), cycles, done,
+                      waited, oldest);
+
+yield:
+  wq->runs++;
+  if (yielded && listcount (wq->items) > 0)
+    wq->yields++;
+  return !stop;
+}
+
+/* Time slot for a run of the scheduler: the longest yield time of the
+ * queues ready to run, in usec. */
+static int64_t
+work_queue_sched_slot (struct work_queue_sched *sched)
+{
+  struct listnode *node;
+  struct work_queue *wq;
+  int64_t slot = THREAD_YIELD_TIME_SLOT;
+
+  for (ALL_LIST_ELEMENTS_RO (sched->ready, node, wq))
+    if ((int64_t) wq->spec.yield > slot)
+      slot = wq->spec.yield;
+  return slot;
+}
+
+/* background task running the queues of a thread master that are ready,
+ * see struct work_queue_sched; reschedules itself while any of them has
+ * work left
+ */
+int
+work_queue_run (struct thread *thread)
+{
+  struct work_queue_sched *sched;
+  struct work_queue *wq;
+  struct listnode *node;
+  int64_t start, slot, left, budget;
+  unsigned long weights;
+  unsigned int ran;
+  bool more;
+
+  sched = THREAD_ARG (thread);
+  sched->thread = NULL;
+  sched->runs++;
+  sched->active = true;
 
-#define WQ_HYSTERESIS_FACTOR 4
+  start = work_queue_now ();
+  slot = work_queue_sched_slot (sched);
 
-  /* we yielded, check whether granularity should be reduced */
-  if (yielded && (cycles < wq->cycles.granularity))
+  while (listcount (sched->ready) > 0)
     {
-      wq->cycles.granularity = ((cycles > 0) ? cycles
-                                             : WORK_QUEUE_MIN_GRANULARITY);
+      left = slot - (work_queue_now () - start) / 1000;
+      if (left <= 0)
+        break;
+
+      /* share what's left of the slot between the queues that haven't
+       * asked to stop */
+      sched->passes++;
+      weights = 0;
+      for (ALL_LIST_ELEMENTS_RO (sched->ready, node, wq))
+        if (wq->stopped != sched->runs)
+          weights += wq->spec.weight ? wq->spec.weight : 1;
+      if (weights == 0)
+        break;
+
+      /* each queue once, in turn; queues go to the back of the list once
+       * they've had their turn */
+      ran = 0;
+      while ((wq = listnode_head (sched->ready)) != NULL
+             && wq->pass != sched->passes)
+        {
+          work_queue_unready (wq);
+          wq->pass = sched->passes;
+
+          if (wq->stopped != sched->runs)
+            {
+              budget = left * (wq->spec.weight ? wq->spec.weight : 1)
+                       / weights;
+              sched->running = wq;
+              more = work_queue_process (wq, budget > 0 ? budget : 1);
+              ran++;
+
+              /* freed by one of its own items? */
+              if (sched->running != wq)
+                continue;
+              sched->running = NULL;
+              if (!more)
+                wq->stopped = sched->runs;
+            }
+
+          if (listcount (wq->items) == 0)
+            {
+              /* Is the queue done yet? If it is, call the completion
+               * callback, which may free it. */
+              if (wq->spec.completion_func)
+                wq->spec.completion_func (wq);
+              continue;
+            }
+          if (CHECK_FLAG (wq->flags, WQ_UNPLUGGED) && wq->thread == NULL)
+            {
+              wq->ready = true;
+              listnode_add (sched->ready, wq);
+            }
+        }
+      if (ran == 0)
+        break;
     }
-  /* otherwise, should granularity increase? */
-  else if (cycles >= (wq->cycles.granularity))
+
+  sched->active = false;
+  if (sched->refcnt == 0)
     {
-      if (cycles > wq->cycles.best)
-        wq->cycles.best = cycles;
-
-      /* along with yielded check, provides hysteresis for granularity */
-      if (cycles > (wq->cycles.granularity * WQ_HYSTERESIS_FACTOR
-                                           * WQ_HYSTERESIS_FACTOR))
-        wq->cycles.granularity *= WQ_HYSTERESIS_FACTOR; /* quick ramp-up */
-      else if (cycles > (wq->cycles.granularity * WQ_HYSTERESIS_FACTOR))
-        wq->cycles.granularity += WQ_HYSTERESIS_FACTOR;
+      sched->refcnt = 1;
+      work_queue_sched_put (sched);
+      return 0;
     }
-#undef WQ_HYSTERIS_FACTOR
-  
-  wq->runs++;
-  wq->cycles.total += cycles;
-  if (yielded)
-    wq->yields++;
-
-#if 0
-  printf ("%s: cycles %d, new: best %d, worst %d\n",
-            __func__, cycles, wq->cycles.best, wq->cycles.granularity);
-#endif
-  
-  /* Is the queue done yet? If it is, call the completion callback. */
-  if (listcount (wq->items) > 0)
-    work_queue_schedule (wq, 0);
-  else if (wq->spec.completion_func)
-    wq->spec.completion_func (wq);
-  
+  if (listcount (sched->ready) > 0 && sched->thread == NULL)
+    thread_add_background (sched->master, work_queue_run, sched, 0,
+                           &sched->thread);
   return 0;
 }
@@ -29,6 +29,9 @@ DECLARE_MTYPE(WORK_QUEUE)
 /* Hold time for the initial schedule of a queue run, in  millisec */
 #define WORK_QUEUE_DEFAULT_HOLD  50 
 
+/* Share of the work queue scheduler's time a queue gets by default */
+#define WORK_QUEUE_DEFAULT_WEIGHT  10
+
 /* action value, for use by item processor and item error handlers */
 typedef enum
 {
@@ -47,17 +50,20 @@ struct work_queue_item
 {
   void *data;                           /* opaque data */
   unsigned short ran;			/* # of times item has been run */
+  int64_t added;			/* monotonic nsec it was added at */
 };
 
 #define WQ_UNPLUGGED	(1 << 0) /* available for draining */
 
+struct work_queue_sched;
+
 struct work_queue
 {
   /* Everything but the specification struct is private
    * the following may be read
    */
   struct thread_master *master;       /* thread master */
-  struct thread *thread;              /* thread, if one is active */
+  struct thread *thread;              /* hold timer, if one is active */
   char *name;                         /* work queue name */
   
   /* Specification for this work queue.
@@ -88,21 +94,37 @@ struct work_queue
     unsigned int hold;	/* hold time for first run, in ms */
 
     unsigned long yield; /* yield time in us for associated thread */
+
+    /* share of the scheduler's time this queue gets, relative to the
+     * weights of the other queues on the same thread master that have
+     * work to do at the same time */
+    unsigned int weight;
   } spec;
   
   /* remaining fields should be opaque to users */
   struct list *items;                 /* queue item list */
   unsigned long runs;                 /* runs count */
   unsigned long yields;               /* yields count */
-  
+
+  /* average time an item takes, in nsec, which sets the number of items
+   * run before checking the time */
+  unsigned long item_cost;
+
+  /* how long items took from being added to being done, in usec */
   struct {
-    unsigned int best;
-    unsigned int granularity;
+    unsigned long items;
     unsigned long total;
-  } cycles;	/* cycle counts */
+    unsigned long max;
+  } latency;
   
   /* private state */
   u_int16_t flags;		/* user set flag */
+
+  /* scheduler shared by the queues of this thread master */
+  struct work_queue_sched *sched;
+  bool ready;                         /* on the scheduler's ready list */
+  unsigned long pass;                 /* scheduler pass it last ran in */
+  unsigned long stopped;              /* scheduler run it asked to stop */
 };
 
 /* User API */
@@ -124,6 +146,8 @@ extern void work_queue_plug (struct work_queue *wq);
 /* unplug the queue, allow it to be drained again */
 extern void work_queue_unplug (struct work_queue *wq);
 
+/* whether the queue is due to be run, either once its hold time is up or
+ * by the scheduler */
 bool work_queue_is_scheduled (struct work_queue *);
 
 /* Helpers, exported for thread.c and command.c */
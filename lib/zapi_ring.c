@@ -0,0 +1,397 @@
+/*
+ * Shared memory transport for zapi messages.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <sys/mman.h>
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
+#include "frratomic.h"
+#include "log.h"
+#include "memory.h"
+#include "network.h"
+#include "stream.h"
+#include "zclient.h"
+#include "zapi_ring.h"
+
+DEFINE_MTYPE_STATIC(LIB, ZAPI_RING, "zapi shared memory ring")
+
+#define ZAPI_RING_MAGIC 0x5a524e47
+
+/* The start of the shared memory; the messages follow.  head and tail
+ * count the bytes ever put into and taken out of the ring, and only wrap
+ * around at 2^32.  They are kept apart so that the producer and consumer
+ * don't keep stealing each other's cache line. */
+struct zapi_ring_shared
+{
+  uint32_t magic;
+  uint32_t size;
+
+  /* Written by the producer only. */
+  _Atomic uint32_t head __attribute__ ((aligned (64)));
+
+  /* Written by the consumer only. */
+  _Atomic uint32_t tail __attribute__ ((aligned (64)));
+
+  /* Set by the consumer before it waits on the eventfd, cleared by
+   * whoever gets to it first. */
+  _Atomic uint32_t sleeping;
+} __attribute__ ((aligned (64)));
+
+struct zapi_ring
+{
+  struct zapi_ring_shared *shm;
+  u_char *data;
+
+  /* Our own copy, so that the other side can't make us run off the end
+   * of the mapping by changing shm->size. */
+  uint32_t size;
+  size_t maplen;
+
+  int memfd;
+  int eventfd;
+};
+
+struct zapi_ring *
+zapi_ring_create (size_t size)
+{
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_EVENTFD)
+  struct zapi_ring *ring;
+  struct zapi_ring_shared *shm;
+  size_t maplen = sizeof (struct zapi_ring_shared) + size;
+  int memfd, efd;
+
+  assert (size > 0 && (size & (size - 1)) == 0 && size <= (1U << 31));
+
+  memfd = memfd_create ("zapi-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (memfd < 0)
+    {
+      zlog_warn ("%s: memfd_create() failed: %s", __func__,
+                 safe_strerror (errno));
+      return NULL;
+    }
+  if (ftruncate (memfd, maplen) < 0)
+    {
+      zlog_warn ("%s: ftruncate() failed: %s", __func__,
+                 safe_strerror (errno));
+      close (memfd);
+      return NULL;
+    }
+  /* zebra would take SIGBUS if the ring could shrink under it. */
+  fcntl (memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+  efd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (efd < 0)
+    {
+      zlog_warn ("%s: eventfd() failed: %s", __func__, safe_strerror (errno));
+      close (memfd);
+      return NULL;
+    }
+
+  shm = mmap (NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+  if (shm == MAP_FAILED)
+    {
+      zlog_warn ("%s: mmap() failed: %s", __func__, safe_strerror (errno));
+      close (memfd);
+      close (efd);
+      return NULL;
+    }
+  shm->magic = ZAPI_RING_MAGIC;
+  shm->size = size;
+
+  ring = XCALLOC (MTYPE_ZAPI_RING, sizeof (struct zapi_ring));
+  ring->shm = shm;
+  ring->data = (u_char *) (shm + 1);
+  ring->size = size;
+  ring->maplen = maplen;
+  ring->memfd = memfd;
+  ring->eventfd = efd;
+  return ring;
+#else
+  return NULL;
+#endif
+}
+
+struct zapi_ring *
+zapi_ring_attach (int memfd, int efd)
+{
+  struct zapi_ring *ring;
+  struct zapi_ring_shared *shm;
+  struct stat st;
+  uint32_t size;
+
+#ifdef F_SEAL_SHRINK
+  {
+    int seals = fcntl (memfd, F_GET_SEALS);
+
+    if (seals < 0 || !(seals & F_SEAL_SHRINK))
+      goto fail;
+  }
+#endif
+
+  if (fstat (memfd, &st) < 0
+      || (size_t) st.st_size < sizeof (struct zapi_ring_shared))
+    goto fail;
+
+  shm = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+  if (shm == MAP_FAILED)
+    goto fail;
+
+  size = shm->size;
+  if (shm->magic != ZAPI_RING_MAGIC || size < ZEBRA_MAX_PACKET_SIZ
+      || (size & (size - 1)) != 0
+      || sizeof (struct zapi_ring_shared) + size > (size_t) st.st_size)
+    {
+      munmap (shm, st.st_size);
+      goto fail;
+    }
+
+  ring = XCALLOC (MTYPE_ZAPI_RING, sizeof (struct zapi_ring));
+  ring->shm = shm;
+  ring->data = (u_char *) (shm + 1);
+  ring->size = size;
+  ring->maplen = st.st_size;
+  ring->memfd = memfd;
+  ring->eventfd = efd;
+  set_nonblocking (efd);
+  return ring;
+
+ fail:
+  close (memfd);
+  close (efd);
+  return NULL;
+}
+
+void
+zapi_ring_free (struct zapi_ring *ring)
+{
+  munmap (ring->shm, ring->maplen);
+  close (ring->memfd);
+  close (ring->eventfd);
+  XFREE (MTYPE_ZAPI_RING, ring);
+}
+
+int
+zapi_ring_memfd (struct zapi_ring *ring)
+{
+  return ring->memfd;
+}
+
+int
+zapi_ring_eventfd (struct zapi_ring *ring)
+{
+  return ring->eventfd;
+}
+
+int
+zapi_ring_put (struct zapi_ring *ring, const void *data, size_t size)
+{
+  struct zapi_ring_shared *shm = ring->shm;
+  uint32_t head, tail, off;
+  size_t first;
+
+  head = atomic_load_explicit (&shm->head, memory_order_relaxed);
+  tail = atomic_load_explicit (&shm->tail, memory_order_acquire);
+  if (ring->size - (head - tail) < size)
+    return -1;
+
+  off = head & (ring->size - 1);
+  first = MIN (size, ring->size - off);
+  memcpy (ring->data + off, data, first);
+  memcpy (ring->data, (const u_char *) data + first, size - first);
+
+  /* This store and the load of sleeping must not be reordered, against
+   * the opposite pair in zapi_ring_sleep(); or the consumer could go to
+   * sleep on a message without us ringing for it. */
+  atomic_store_explicit (&shm->head, head + size, memory_order_seq_cst);
+  if (atomic_load_explicit (&shm->sleeping, memory_order_seq_cst)
+      && atomic_exchange_explicit (&shm->sleeping, 0, memory_order_seq_cst))
+    {
+      uint64_t one = 1;
+
+      if (write (ring->eventfd, &one, sizeof (one)) < 0 && errno != EAGAIN)
+        zlog_warn ("%s: eventfd write failed: %s", __func__,
+                   safe_strerror (errno));
+    }
+  return 0;
+}
+
+/* Copy size bytes starting at ring position pos. */
+static void
+zapi_ring_copy (struct zapi_ring *ring, uint32_t pos, struct stream *s,
+                size_t size)
+{
+  uint32_t off = pos & (ring->size - 1);
+  size_t first = MIN (size, ring->size - off);
+
+  stream_put (s, ring->data + off, first);
+  stream_put (s, ring->data, size - first);
+}
+
+int
+zapi_ring_get (struct zapi_ring *ring, struct stream *s)
+{
+  struct zapi_ring_shared *shm = ring->shm;
+  uint32_t head, tail, used;
+  uint16_t length;
+
+  tail = atomic_load_explicit (&shm->tail, memory_order_relaxed);
+  head = atomic_load_explicit (&shm->head, memory_order_acquire);
+  used = head - tail;
+  if (used == 0)
+    return 0;
+  if (used < ZEBRA_HEADER_SIZE || used > ring->size)
+    return -1;
+
+  stream_reset (s);
+  zapi_ring_copy (ring, tail, s, 2);
+  length = stream_getw_from (s, 0);
+  if (length < ZEBRA_HEADER_SIZE || length > used || length > STREAM_SIZE (s))
+    return -1;
+
+  stream_reset (s);
+  zapi_ring_copy (ring, tail, s, length);
+  atomic_store_explicit (&shm->tail, tail + length, memory_order_release);
+  return 1;
+}
+
+int
+zapi_ring_sleep (struct zapi_ring *ring)
+{
+  struct zapi_ring_shared *shm = ring->shm;
+  uint64_t count;
+
+  /* Whatever woke us up has been dealt with. */
+  if (read (ring->eventfd, &count, sizeof (count)) < 0 && errno != EAGAIN)
+    zlog_warn ("%s: eventfd read failed: %s", __func__,
+               safe_strerror (errno));
+
+  atomic_store_explicit (&shm->sleeping, 1, memory_order_seq_cst);
+  if (atomic_load_explicit (&shm->head, memory_order_seq_cst)
+      != atomic_load_explicit (&shm->tail, memory_order_relaxed))
+    {
+      atomic_store_explicit (&shm->sleeping, 0, memory_order_relaxed);
+      return 0;
+    }
+  return 1;
+}
+
+ssize_t
+zapi_ring_send_fds (int sock, const void *data, size_t size,
+                    struct zapi_ring *ring)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union
+  {
+    char buf[CMSG_SPACE (2 * sizeof (int))];
+    struct cmsghdr align;
+  } control;
+  int fds[2] = { ring->memfd, ring->eventfd };
+
+  memset (&msg, 0, sizeof (msg));
+  memset (&control, 0, sizeof (control));
+  iov.iov_base = (void *) data;
+  iov.iov_len = size;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (fds));
+  memcpy (CMSG_DATA (cmsg), fds, sizeof (fds));
+
+  return sendmsg (sock, &msg, 0);
+}
+
+ssize_t
+zapi_ring_read_try (struct stream *s, int sock, size_t size, int fds[2])
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union
+  {
+    char buf[CMSG_SPACE (2 * sizeof (int))];
+    struct cmsghdr align;
+  } control;
+  ssize_t nbytes;
+  int flags = 0;
+
+  if (STREAM_WRITEABLE (s) < size)
+    {
+      zlog_warn ("%s: no room for %zu bytes", __func__, size);
+      return -1;
+    }
+
+  memset (&msg, 0, sizeof (msg));
+  iov.iov_base = STREAM_DATA (s) + stream_get_endp (s);
+  iov.iov_len = size;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+#ifdef MSG_CMSG_CLOEXEC
+  flags |= MSG_CMSG_CLOEXEC;
+#endif
+
+  nbytes = recvmsg (sock, &msg, flags);
+  if (nbytes < 0)
+    {
+      if (ERRNO_IO_RETRY (errno))
+        return -2;
+      zlog_warn ("%s: read failed on fd %d: %s", __func__, sock,
+                 safe_strerror (errno));
+      return -1;
+    }
+  stream_set_endp (s, stream_get_endp (s) + nbytes);
+
+  for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg))
+    {
+      int passed[2], n, i;
+
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        continue;
+
+      n = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+      if (n > 2)
+        n = 2;
+      memcpy (passed, CMSG_DATA (cmsg), n * sizeof (int));
+      if (n != 2)
+        {
+          for (i = 0; i < n; i++)
+            close (passed[i]);
+          continue;
+        }
+      for (i = 0; i < 2; i++)
+        {
+          if (fds[i] >= 0)
+            close (fds[i]);
+          fds[i] = passed[i];
+        }
+    }
+  return nbytes;
+}
@@ -0,0 +1,82 @@
+/*
+ * Shared memory transport for zapi messages.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _ZEBRA_ZAPI_RING_H
+#define _ZEBRA_ZAPI_RING_H
+
+#include "stream.h"
+
+/* A single producer, single consumer ring of zapi messages in memory
+ * shared between a client daemon and zebra, so that messages from the
+ * client can be passed without a syscall each.
+ *
+ * The client creates the ring (a memfd) together with an eventfd, and
+ * passes both to zebra over the zserv socket.  The eventfd is only
+ * written to when zebra has run out of messages and gone to sleep on it,
+ * so a busy ring is drained without any syscalls at all.
+ *
+ * Messages go in whole, and in the same format as on the socket.  zebra
+ * checks everything it takes out of the ring, since the client can write
+ * to it at any time.
+ */
+struct zapi_ring;
+
+/* Default room for messages: a couple of hundred full batches. */
+#define ZAPI_RING_SIZE (1 << 20)
+
+/* Producer: create a ring with room for size bytes of messages (a power
+ * of 2).  Returns NULL if shared memory rings aren't available here. */
+extern struct zapi_ring *zapi_ring_create (size_t size);
+
+/* Consumer: map the ring the producer created.  Takes over both fds, even
+ * on failure.  Returns NULL if they don't make up a valid ring. */
+extern struct zapi_ring *zapi_ring_attach (int memfd, int eventfd);
+
+/* Unmap the ring and close its fds. */
+extern void zapi_ring_free (struct zapi_ring *);
+
+extern int zapi_ring_memfd (struct zapi_ring *);
+extern int zapi_ring_eventfd (struct zapi_ring *);
+
+/* Producer: append a message, and wake the consumer if it is asleep.
+ * Returns -1 if there is no room for it. */
+extern int zapi_ring_put (struct zapi_ring *, const void *data, size_t size);
+
+/* Consumer: take the next message out of the ring and put it into s,
+ * which is reset first.  Returns 1 if there was one, 0 if the ring is
+ * empty and -1 if it holds garbage. */
+extern int zapi_ring_get (struct zapi_ring *, struct stream *s);
+
+/* Consumer: about to wait for the eventfd to become readable.  Returns 0
+ * if messages came in meanwhile, and there is no need to. */
+extern int zapi_ring_sleep (struct zapi_ring *);
+
+/* Send size bytes of data on a unix socket, along with the ring's fds. */
+extern ssize_t zapi_ring_send_fds (int sock, const void *data, size_t size,
+                                   struct zapi_ring *);
+
+/* Like stream_read_try(), but taking note of fds that come along with the
+ * data.  If a pair arrives, they go into fds[], any older ones there
+ * being closed. */
+extern ssize_t zapi_ring_read_try (struct stream *s, int sock, size_t size,
+                                   int fds[2]);
+
+#endif /* _ZEBRA_ZAPI_RING_H */
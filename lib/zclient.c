@@ -35,6 +35,7 @@
 #include "table.h"
 #include "nexthop.h"
 #include "mpls.h"
+#include "zapi_ring.h"
 
 DEFINE_MTYPE_STATIC(LIB, ZCLIENT, "Zclient")
 DEFINE_MTYPE_STATIC(LIB, REDIST_INST, "Redistribution instance IDs")
@@ -45,6 +46,9 @@ enum event {ZCLIENT_SCHEDULE, ZCLIENT_READ, ZCLIENT_CONNECT};
 /* Prototype for event manager. */
 static void zclient_event (enum event, struct zclient *);
 
+/* How soon to look again whether zebra has made room in a full ring. */
+#define ZCLIENT_RING_RETRY_MSEC 10
+
 const char *zclient_serv_path = NULL;
 
 /* This file local debug flag. */
@@ -59,6 +63,8 @@ zclient_new (struct thread_master *master)
 
   zclient->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   zclient->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  zclient->batch = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  zclient->ring_backlog = stream_fifo_new ();
   zclient->wb = buffer_new(0);
   zclient->master = master;
 
@@ -77,6 +83,10 @@ zclient_free (struct zclient *zclient)
     stream_free(zclient->ibuf);
   if (zclient->obuf)
     stream_free(zclient->obuf);
+  if (zclient->batch)
+    stream_free(zclient->batch);
+  if (zclient->ring_backlog)
+    stream_fifo_free(zclient->ring_backlog);
   if (zclient->wb)
     buffer_free(zclient->wb);
 
@@ -147,10 +157,22 @@ zclient_stop (struct zclient *zclient)
   THREAD_OFF(zclient->t_read);
   THREAD_OFF(zclient->t_connect);
   THREAD_OFF(zclient->t_write);
+  THREAD_OFF(zclient->t_batch);
+  THREAD_OFF(zclient->t_ring);
 
   /* Reset streams. */
   stream_reset(zclient->ibuf);
   stream_reset(zclient->obuf);
+  stream_reset(zclient->batch);
+
+  /* Drop the shared memory ring; a new one is offered on reconnecting. */
+  if (zclient->ring)
+    {
+      zapi_ring_free (zclient->ring);
+      zclient->ring = NULL;
+    }
+  zclient->ring_active = 0;
+  stream_fifo_clean (zclient->ring_backlog);
 
   /* Empty the write buffer. */
   buffer_reset(zclient->wb);
@@ -321,13 +343,54 @@ zclient_flush_data(struct thread *thread)
   return 0;
 }
 
-int
-zclient_send_message(struct zclient *zclient)
+static int
+zclient_ring_retry (struct thread *thread)
 {
-  if (zclient->sock < 0)
-    return -1;
-  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(zclient->obuf),
-		       stream_get_endp(zclient->obuf)))
+  struct zclient *zclient = THREAD_ARG(thread);
+  struct stream *s;
+
+  zclient->t_ring = NULL;
+  while ((s = stream_fifo_head (zclient->ring_backlog)) != NULL)
+    {
+      if (zapi_ring_put (zclient->ring, STREAM_DATA(s),
+                         stream_get_endp(s)) < 0)
+        {
+          thread_add_timer_msec (zclient->master, zclient_ring_retry,
+                                 zclient, ZCLIENT_RING_RETRY_MSEC,
+                                 &zclient->t_ring);
+          return 0;
+        }
+      stream_free (stream_fifo_pop (zclient->ring_backlog));
+    }
+  return 0;
+}
+
+/* Put a message into the ring, or behind the ones waiting for room in
+   it.  zebra doesn't tell us when it has made room, so we look again
+   every so often. */
+static int
+zclient_ring_write (struct zclient *zclient, struct stream *s)
+{
+  if (zclient->ring_backlog->count == 0
+      && zapi_ring_put (zclient->ring, STREAM_DATA(s),
+                        stream_get_endp(s)) == 0)
+    return 0;
+
+  stream_fifo_push (zclient->ring_backlog, stream_dup (s));
+  if (!zclient->t_ring)
+    thread_add_timer_msec (zclient->master, zclient_ring_retry, zclient,
+                           ZCLIENT_RING_RETRY_MSEC, &zclient->t_ring);
+  return 0;
+}
+
+static int
+zclient_write_stream (struct zclient *zclient, struct stream *s)
+{
+  if (zclient->ring_active)
+    return zclient_ring_write (zclient, s);
+
+  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(s),
+		       stream_get_endp(s)))
     {
     case BUFFER_ERROR:
       zlog_warn("%s: buffer_write failed to zclient fd %d, closing",
@@ -345,6 +408,87 @@ zclient_send_message(struct zclient *zclient)
   return 0;
 }
 
+/* Route adds and deletes aren't written out one by one, but gathered into
+   a ZEBRA_ROUTE_BATCH message.  That goes out when it is full, when some
+   other message is sent (to keep them in order), or from an event once
+   the daemon is done with what it is doing. */
+static int
+zclient_batchable (uint16_t command)
+{
+  switch (command)
+    {
+    case ZEBRA_IPV4_ROUTE_ADD:
+    case ZEBRA_IPV4_ROUTE_DELETE:
+    case ZEBRA_IPV4_ROUTE_IPV6_NEXTHOP_ADD:
+    case ZEBRA_IPV4_NEXTHOP_ADD:
+    case ZEBRA_IPV4_NEXTHOP_DELETE:
+    case ZEBRA_IPV6_ROUTE_ADD:
+    case ZEBRA_IPV6_ROUTE_DELETE:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+static int
+zclient_batch_flush (struct zclient *zclient)
+{
+  int ret;
+
+  THREAD_OFF(zclient->t_batch);
+  if (stream_get_endp (zclient->batch) == 0)
+    return 0;
+
+  stream_putw_at (zclient->batch, 0, stream_get_endp (zclient->batch));
+  ret = zclient_write_stream (zclient, zclient->batch);
+  stream_reset (zclient->batch);
+  return ret;
+}
+
+static int
+zclient_batch_send (struct thread *thread)
+{
+  struct zclient *zclient = THREAD_ARG(thread);
+
+  zclient->t_batch = NULL;
+  if (zclient->sock < 0)
+    return -1;
+  return zclient_batch_flush (zclient);
+}
+
+int
+zclient_send_message(struct zclient *zclient)
+{
+  struct stream *s = zclient->obuf;
+  size_t length = stream_get_endp (s);
+
+  if (zclient->sock < 0)
+    return -1;
+
+  if (length >= ZEBRA_HEADER_SIZE
+      && zclient_batchable (stream_getw_from (s, 6))
+      && length <= STREAM_SIZE (zclient->batch) - ZEBRA_HEADER_SIZE)
+    {
+      if (STREAM_WRITEABLE (zclient->batch) < length
+          && zclient_batch_flush (zclient) < 0)
+        return -1;
+
+      if (stream_get_endp (zclient->batch) == 0)
+        {
+          zclient_create_header (zclient->batch, ZEBRA_ROUTE_BATCH,
+                                 VRF_DEFAULT);
+          thread_add_event (zclient->master, zclient_batch_send, zclient, 0,
+                            &zclient->t_batch);
+        }
+      stream_put (zclient->batch, STREAM_DATA (s), length);
+      return 0;
+    }
+
+  if (zclient_batch_flush (zclient) < 0)
+    return -1;
+  return zclient_write_stream (zclient, s);
+}
+
 void
 zclient_create_header (struct stream *s, uint16_t command, vrf_id_t vrf_id)
 {
@@ -382,6 +526,90 @@ zclient_read_header (struct stream *s, int sock, u_int16_t *size, u_char *marker
   return 0;
 }
 
+/* Check the header of the message at pos in s, which can be at most max
+   bytes long.  Returns the length of the message, or 0 if it's no good. */
+uint16_t
+zapi_check_header (struct stream *s, size_t pos, size_t max)
+{
+  uint16_t length;
+  uint8_t marker, version;
+
+  length = stream_getw_from (s, pos);
+  marker = stream_getc_from (s, pos + 2);
+  version = stream_getc_from (s, pos + 3);
+
+  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
+    {
+      zlog_err("%s: version mismatch, marker %d, version %d",
+               __func__, marker, version);
+      return 0;
+    }
+  if (length < ZEBRA_HEADER_SIZE)
+    {
+      zlog_warn("%s: message length %u is less than header size %d",
+                __func__, length, ZEBRA_HEADER_SIZE);
+      return 0;
+    }
+  if (length > max)
+    {
+      zlog_warn("%s: message length %u exceeds %lu",
+                __func__, length, (u_long)max);
+      return 0;
+    }
+  return length;
+}
+
+/* Take the message at the front of work, which holds whatever has been
+   read off a socket so far, and copy it into msg.  Returns 1 if it did,
+   0 if the rest of the message is still to come, or -1 if its header is
+   no good. */
+int
+zapi_read_next (struct stream *work, struct stream *msg)
+{
+  size_t pos = stream_get_getp (work);
+  uint16_t length;
+
+  if (STREAM_READABLE (work) < ZEBRA_HEADER_SIZE)
+    return 0;
+
+  length = zapi_check_header (work, pos, STREAM_SIZE (msg));
+  if (length == 0)
+    return -1;
+  if (STREAM_READABLE (work) < length)
+    return 0;
+
+  stream_reset (msg);
+  stream_put (msg, STREAM_DATA (work) + pos, length);
+  stream_forward_getp (work, length);
+  return 1;
+}
+
+/* Whether zapi_read_next would find a whole message in work. */
+int
+zapi_read_ready (struct stream *work)
+{
+  return STREAM_READABLE (work) >= ZEBRA_HEADER_SIZE
+    && STREAM_READABLE (work) >= stream_getw_from (work,
+                                                   stream_get_getp (work));
+}
+
+/* Step through the messages packed into a ZEBRA_ROUTE_BATCH message,
+   which run up to end in s.  Returns the length of the one at pos, 0 if
+   pos is the end, or -1 if what is left is not a whole message. */
+int
+zapi_batch_next (struct stream *s, size_t pos, size_t end)
+{
+  uint16_t length;
+
+  if (pos == end)
+    return 0;
+  if (pos > end || end - pos < ZEBRA_HEADER_SIZE)
+    return -1;
+
+  length = zapi_check_header (s, pos, end - pos);
+  return length ? length : -1;
+}
+
 /* Send simple Zebra message. */
 static int
 zebra_message_send (struct zclient *zclient, int command, vrf_id_t vrf_id)
@@ -562,6 +790,68 @@ zclient_send_interface_radv_req (struct zclient *zclient, vrf_id_t vrf_id,
 }
 
 /* Make connection to zebra daemon. */
+/* Offer zebra a shared memory ring for our messages, passing it along
+   with a ZEBRA_ZAPI_RING message.  We go on using the socket until zebra
+   has answered. */
+static void
+zclient_ring_offer (struct zclient *zclient)
+{
+  struct stream *s = zclient->obuf;
+  ssize_t ret;
+
+  zclient->ring = zapi_ring_create (ZAPI_RING_SIZE);
+  if (!zclient->ring)
+    return;
+
+  stream_reset (s);
+  zclient_create_header (s, ZEBRA_ZAPI_RING, VRF_DEFAULT);
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  /* Nothing else has been written to the new socket yet, so this small
+     message goes out whole or not at all. */
+  ret = zapi_ring_send_fds (zclient->sock, STREAM_DATA (s),
+                            stream_get_endp (s), zclient->ring);
+  if (ret != (ssize_t) stream_get_endp (s))
+    {
+      zlog_warn ("%s: can't pass the ring to zebra: %s", __func__,
+                 safe_strerror (errno));
+      zapi_ring_free (zclient->ring);
+      zclient->ring = NULL;
+    }
+}
+
+/* zebra's answer to our offer.  If it took the ring, tell it with a
+   ZEBRA_ZAPI_RING_START on the socket, behind everything sent there so
+   far, and send everything after it through the ring; zebra doesn't look
+   at the ring before it has got there, so nothing is reordered. */
+static void
+zclient_ring_reply (struct zclient *zclient)
+{
+  struct stream *s;
+
+  if (!zclient->ring || zclient->ring_active)
+    return;
+
+  if (!stream_getc (zclient->ibuf))
+    {
+      zlog_info ("zebra declined the shared memory ring, using the socket");
+      zapi_ring_free (zclient->ring);
+      zclient->ring = NULL;
+      return;
+    }
+
+  s = zclient->obuf;
+  stream_reset (s);
+  zclient_create_header (s, ZEBRA_ZAPI_RING_START, VRF_DEFAULT);
+  stream_putw_at (s, 0, stream_get_endp (s));
+  if (zclient_send_message (zclient) < 0 || zclient->sock < 0)
+    return;
+
+  zclient->ring_active = 1;
+  if (zclient_debug)
+    zlog_debug ("zclient switched to the shared memory ring");
+}
+
 int
 zclient_start (struct zclient *zclient)
 {
@@ -597,6 +887,9 @@ zclient_start (struct zclient *zclient)
   if (zclient_debug)
     zlog_debug ("zclient connect success with socket [%d]", zclient->sock);
 
+  if (zclient->ring_enable)
+    zclient_ring_offer (zclient);
+
   /* Create read thread. */
   zclient_event (ZCLIENT_READ, zclient);
 
@@ -1955,6 +2248,9 @@ zclient_read (struct thread *thread)
       if (zclient->fec_update)
         (*zclient->fec_update) (command, zclient, length);
       break;
+    case ZEBRA_ZAPI_RING:
+      zclient_ring_reply (zclient);
+      break;
     default:
       break;
     }
@@ -96,6 +96,9 @@ typedef enum {
   ZEBRA_FEC_REGISTER,
   ZEBRA_FEC_UNREGISTER,
   ZEBRA_FEC_UPDATE,
+  ZEBRA_ROUTE_BATCH,
+  ZEBRA_ZAPI_RING,
+  ZEBRA_ZAPI_RING_START,
 } zebra_message_types_t;
 
 struct redist_proto
@@ -136,6 +139,21 @@ struct zclient
   /* Thread to write buffered data to zebra. */
   struct thread *t_write;
 
+  /* Route messages gathered into one ZEBRA_ROUTE_BATCH message, and the
+     event that sends it off. */
+  struct stream *batch;
+  struct thread *t_batch;
+
+  /* Set by the daemon to offer zebra a shared memory ring (see
+     zapi_ring.h) for its messages on connecting.  Once zebra has taken
+     it, everything we send goes through the ring, and messages that
+     don't fit wait on ring_backlog. */
+  int ring_enable;
+  int ring_active;
+  struct zapi_ring *ring;
+  struct stream_fifo *ring_backlog;
+  struct thread *t_ring;
+
   /* Redistribute information. */
   u_char redist_default; /* clients protocol */
   u_short instance;
@@ -266,6 +284,10 @@ extern void zclient_create_header (struct stream *, uint16_t, vrf_id_t);
 extern int zclient_read_header (struct stream *s, int sock, u_int16_t *size,
 				u_char *marker, u_char *version,
 				vrf_id_t *vrf_id, u_int16_t *cmd);
+extern uint16_t zapi_check_header (struct stream *s, size_t pos, size_t max);
+extern int zapi_read_next (struct stream *work, struct stream *msg);
+extern int zapi_read_ready (struct stream *work);
+extern int zapi_batch_next (struct stream *s, size_t pos, size_t end);
 
 extern struct interface *zebra_interface_add_read (struct stream *, vrf_id_t);
 extern struct interface *zebra_interface_state_read (struct stream *s, vrf_id_t);
@@ -50,6 +50,7 @@
 #include "ospfd/ospf_ase.h"
 #include "ospfd/ospf_zebra.h"
 
+DEFINE_MTYPE_SLAB(OSPFD, OSPF_LSA, "OSPF LSA", sizeof (struct ospf_lsa))
 
 u_int32_t
 get_metric (u_char *metric)
@@ -35,7 +35,6 @@ DEFINE_MTYPE(OSPFD, OSPF_IF,              "OSPF interface")
 DEFINE_MTYPE(OSPFD, OSPF_NEIGHBOR,        "OSPF neighbor")
 DEFINE_MTYPE(OSPFD, OSPF_ROUTE,           "OSPF route")
 DEFINE_MTYPE(OSPFD, OSPF_TMP,             "OSPF tmp mem")
-DEFINE_MTYPE(OSPFD, OSPF_LSA,             "OSPF LSA")
 DEFINE_MTYPE(OSPFD, OSPF_LSA_DATA,        "OSPF LSA data")
 DEFINE_MTYPE(OSPFD, OSPF_LSDB,            "OSPF LSDB")
 DEFINE_MTYPE(OSPFD, OSPF_PACKET,          "OSPF packet")
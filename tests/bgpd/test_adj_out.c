@@ -0,0 +1,164 @@
+/*
+ * Adj-RIB-Out lookups on a node with many subgroups.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "prng.h"
+#include "privs.h"
+#include "zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_updgrp.h"
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+#define SUBGROUPS 300
+/* Every ADDPATH-th subgroup has ADDPATH_IDS adj-outs on the node. */
+#define ADDPATH 10
+#define ADDPATH_IDS 3
+
+static struct update_subgroup subgrps[SUBGROUPS];
+static struct bgp_node *rn;
+
+static unsigned int
+ids (unsigned int i)
+{
+  return i % ADDPATH ? 1 : ADDPATH_IDS;
+}
+
+static void
+setup (void)
+{
+  struct prng *prng = prng_new (0);
+  struct bgp_table *table;
+  struct prefix p;
+  unsigned int order[SUBGROUPS];
+  unsigned int i, j, tmp;
+
+  table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+  str2prefix ("10.0.0.0/24", &p);
+  rn = bgp_node_get (table, &p);
+
+  /* Subgroups come and go, so adj-outs go in in any order. */
+  for (i = 0; i < SUBGROUPS; i++)
+    order[i] = i;
+  for (i = SUBGROUPS - 1; i > 0; i--)
+    {
+      j = prng_rand (prng) % (i + 1);
+      tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+
+  for (i = 0; i < SUBGROUPS; i++)
+    {
+      subgrps[i].id = i + 1;
+      TAILQ_INIT (&subgrps[i].adjq);
+    }
+  for (i = 0; i < SUBGROUPS; i++)
+    for (j = ids (order[i]); j > 0; j--)
+      bgp_adj_out_alloc (&subgrps[order[i]], rn, 100 + j);
+
+  prng_free (prng);
+}
+
+static void
+test_lookup (void)
+{
+  struct bgp_adj_out *adj, *prev = NULL;
+  unsigned int i, j, n = 0;
+
+  for (i = 0; i < SUBGROUPS; i++)
+    {
+      adj = bgp_adj_out_find (rn, &subgrps[i], 0, 1);
+      assert (adj && adj->subgroup == &subgrps[i]);
+      assert (adj->addpath_tx_id == 101);
+      for (j = 1; j <= ids (i); j++)
+        {
+          adj = bgp_adj_out_find (rn, &subgrps[i], 100 + j, 0);
+          assert (adj && adj->subgroup == &subgrps[i]);
+          assert (adj->addpath_tx_id == 100 + j);
+        }
+      assert (bgp_adj_out_find (rn, &subgrps[i], 100 + j, 0) == NULL);
+      assert (bgp_adj_out_find (rn, &subgrps[i], 100, 0) == NULL);
+    }
+
+  /* In subgroup, then addpath id order. */
+  RB_FOREACH (adj, bgp_adj_out_rb, &rn->adj_out)
+    {
+      if (prev)
+        assert (prev->subgroup->id < adj->subgroup->id
+                || (prev->subgroup == adj->subgroup
+                    && prev->addpath_tx_id < adj->addpath_tx_id));
+      prev = adj;
+      n++;
+    }
+  assert (n == SUBGROUPS + (SUBGROUPS / ADDPATH) * (ADDPATH_IDS - 1));
+
+  printf ("Verified adj-out lookups\n");
+}
+
+/* Taking a subgroup's adj-outs off the node leaves the others be. */
+static void
+test_remove (void)
+{
+  struct bgp_adj_out *adj, *next;
+  unsigned int i;
+
+  for (i = 0; i < SUBGROUPS; i += 2)
+    TAILQ_FOREACH_SAFE (adj, &subgrps[i].adjq, subgrp_adj_train, next)
+      {
+        bgp_adj_out_remove_subgroup (rn, adj, &subgrps[i]);
+        bgp_unlock_node (rn);
+      }
+
+  for (i = 0; i < SUBGROUPS; i++)
+    {
+      adj = bgp_adj_out_find (rn, &subgrps[i], 0, 1);
+      if (i % 2)
+        assert (adj && adj->subgroup == &subgrps[i]);
+      else
+        assert (adj == NULL && TAILQ_EMPTY (&subgrps[i].adjq));
+    }
+
+  printf ("Verified adj-out removal\n");
+}
+
+int
+main (void)
+{
+  setup ();
+  test_lookup ();
+  test_remove ();
+  return 0;
+}
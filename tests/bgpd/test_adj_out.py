@@ -0,0 +1,7 @@
+import frrtest
+
+class TestAdjOut(frrtest.TestMultiOut):
+    program = './test_adj_out'
+
+TestAdjOut.onesimple('Verified adj-out lookups')
+TestAdjOut.onesimple('Verified adj-out removal')
@@ -0,0 +1,205 @@
+/*
+ * Reusing parsed attribute sections by their raw bytes.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "queue.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+/* ORIGIN, AS_PATH, NEXT_HOP, MED and COMMUNITIES. */
+#define MED 23
+static u_char ipv4_attrs[] =
+{
+  0x40, 0x01, 0x01, 0x00,
+  0x40, 0x02, 0x06, 0x02, 0x02, 0xfd, 0xe9, 0xfd, 0xea,
+  0x40, 0x03, 0x04, 0x0a, 0x00, 0x00, 0x01,
+  0x80, 0x04, 0x04, 0x00, 0x00, 0x00, 0x0a,
+  0xc0, 0x08, 0x08, 0xfd, 0xe9, 0x00, 0x01, 0xfd, 0xe9, 0x00, 0x02,
+};
+
+/* ORIGIN, MP_REACH_NLRI for an IPv6 /64, AS_PATH; the nexthop's and the
+ * prefix' last bytes are filled in. */
+#define MP_NEXTHOP_END 26
+#define MP_PREFIX_END 36
+static u_char ipv6_attrs[] =
+{
+  0x40, 0x01, 0x01, 0x00,
+  0x80, 0x0e, 0x1e, 0x00, 0x02, 0x01, 0x10,
+  0x20, 0x01, 0x0d, 0xb8, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00,
+  0x40, 0x20, 0x01, 0x0d, 0xb8, 0x00, 0x01, 0x00, 0x00,
+  0x40, 0x02, 0x06, 0x02, 0x02, 0xfd, 0xe9, 0xfd, 0xea,
+};
+
+static struct bgp *bgp;
+static as_t asn = 100;
+static struct peer *peer;
+
+static void
+parse (u_char *data, size_t len, struct attr *attr, struct attr_extra *extra,
+       struct bgp_nlri *mp_update)
+{
+  struct bgp_nlri mp_withdraw;
+  int ret;
+
+  memset (attr, 0, sizeof (struct attr));
+  memset (extra, 0, sizeof (struct attr_extra));
+  extra->label_index = BGP_INVALID_LABEL_INDEX;
+  attr->extra = extra;
+  memset (mp_update, 0, sizeof (struct bgp_nlri));
+  memset (&mp_withdraw, 0, sizeof (mp_withdraw));
+
+  stream_reset (peer->ibuf);
+  stream_write (peer->ibuf, data, len);
+  ret = bgp_attr_parse (peer, attr, len, mp_update, &mp_withdraw);
+  assert (ret == BGP_ATTR_PARSE_PROCEED);
+  assert (stream_get_getp (peer->ibuf) == len);
+}
+
+/* The same section comes back with the same attributes. */
+static void
+test_hits (void)
+{
+  struct attr attr, *first, *again;
+  struct attr_extra extra;
+  struct bgp_nlri mp_update;
+  int i;
+
+  parse (ipv4_attrs, sizeof (ipv4_attrs), &attr, &extra, &mp_update);
+  assert (peer->attr_cache_miss == 1 && peer->attr_cache_hit == 0);
+  first = bgp_attr_intern (&attr);
+  bgp_attr_unintern_sub (&attr);
+
+  for (i = 0; i < 10; i++)
+    {
+      parse (ipv4_attrs, sizeof (ipv4_attrs), &attr, &extra, &mp_update);
+      assert (attr.nexthop.s_addr == htonl (0x0a000001));
+      assert (attr.med == 10);
+      assert (aspath_count_hops (attr.aspath) == 2);
+      assert (community_include (attr.community, 0xfde90002));
+      again = bgp_attr_intern (&attr);
+      bgp_attr_unintern_sub (&attr);
+      assert (again == first);
+      bgp_attr_unintern (&again);
+    }
+  assert (peer->attr_cache_miss == 1 && peer->attr_cache_hit == 10);
+  bgp_attr_unintern (&first);
+
+  printf ("Verified attribute cache hits\n");
+}
+
+/* The MP attributes are parsed every time, hit or not. */
+static void
+test_mp (void)
+{
+  struct attr attr;
+  struct attr_extra extra;
+  struct bgp_nlri mp_update;
+  u_int32_t hit = peer->attr_cache_hit;
+  int i;
+
+  for (i = 1; i <= 10; i++)
+    {
+      ipv6_attrs[MP_NEXTHOP_END] = i;
+      ipv6_attrs[MP_PREFIX_END] = i;
+      parse (ipv6_attrs, sizeof (ipv6_attrs), &attr, &extra, &mp_update);
+
+      assert (CHECK_FLAG (attr.flag, ATTR_FLAG_BIT (BGP_ATTR_MP_REACH_NLRI)));
+      assert (extra.mp_nexthop_len == BGP_ATTR_NHLEN_IPV6_GLOBAL);
+      assert (extra.mp_nexthop_global.s6_addr[15] == i);
+      assert (attr.nexthop.s_addr == 0);
+      assert (mp_update.afi == AFI_IP6 && mp_update.safi == SAFI_UNICAST);
+      assert (mp_update.nlri == STREAM_DATA (peer->ibuf) + MP_PREFIX_END - 8);
+      assert (mp_update.length == 9);
+      assert (aspath_count_hops (attr.aspath) == 2);
+      bgp_attr_unintern_sub (&attr);
+    }
+  assert (peer->attr_cache_hit == hit + 9);
+
+  printf ("Verified MP attributes on cache hits\n");
+}
+
+/* Flushing lets go of everything the cache had interned. */
+static void
+test_flush (unsigned long attrs)
+{
+  struct attr attr;
+  struct attr_extra extra;
+  struct bgp_nlri mp_update;
+  u_int32_t miss;
+
+  assert (attr_count () > attrs);
+  bgp_attr_cache_flush (peer);
+  assert (peer->attr_cache == NULL);
+  assert (attr_count () == attrs);
+
+  miss = peer->attr_cache_miss;
+  parse (ipv4_attrs, sizeof (ipv4_attrs), &attr, &extra, &mp_update);
+  bgp_attr_unintern_sub (&attr);
+  assert (peer->attr_cache_miss == miss + 1);
+  bgp_attr_cache_flush (peer);
+
+  printf ("Verified attribute cache flush\n");
+}
+
+int
+main (void)
+{
+  unsigned long attrs;
+
+  qobj_init ();
+  master = thread_master_create ();
+  bgp_master_init (master);
+  vrf_init (NULL, NULL, NULL, NULL);
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+
+  if (bgp_get (&bgp, &asn, NULL, BGP_INSTANCE_TYPE_DEFAULT))
+    return -1;
+
+  peer = peer_create_accept (bgp);
+  peer->host = (char *)"foo";
+  peer->status = Established;
+  peer->as = 65001;
+  peer->sort = BGP_PEER_EBGP;
+
+  attrs = attr_count ();
+  test_hits ();
+  test_mp ();
+  test_flush (attrs);
+  return 0;
+}
@@ -0,0 +1,8 @@
+import frrtest
+
+class TestAttrCache(frrtest.TestMultiOut):
+    program = './test_attr_cache'
+
+TestAttrCache.onesimple('Verified attribute cache hits')
+TestAttrCache.onesimple('Verified MP attributes on cache hits')
+TestAttrCache.onesimple('Verified attribute cache flush')
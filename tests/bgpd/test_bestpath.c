@@ -0,0 +1,192 @@
+/*
+ * BGP best path selection worker tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "privs.h"
+#include "memory.h"
+#include "prng.h"
+#include "zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_bestpath.h"
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+#define NODES 2000
+#define PEERS 8
+#define ATTRS 64
+
+static struct bgp *bgp;
+static struct bgp_table *table;
+static struct peer peers[PEERS];
+static struct attr attrs[ATTRS];
+static struct bgp_maxpaths_cfg mpath_cfg = { 1, 1 };
+
+static struct bgp_bestpath_job jobs[NODES];
+static struct bgp_info *serial[NODES];
+
+static void
+setup (void)
+{
+  struct prng *prng = prng_new (0);
+  struct bgp_info *ri;
+  struct bgp_node *rn;
+  struct prefix p;
+  char buf[64];
+  unsigned int i, j;
+
+  bgp = XCALLOC (MTYPE_BGP, sizeof (struct bgp));
+  bgp_flag_set (bgp, BGP_FLAG_DETERMINISTIC_MED);
+  table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+
+  for (i = 0; i < PEERS; i++)
+    {
+      snprintf (buf, sizeof (buf), "10.0.0.%u", i + 1);
+      peers[i].su_remote = sockunion_str2su (buf);
+      peers[i].remote_id = peers[i].su_remote->sin.sin_addr;
+      peers[i].status = Established;
+      peers[i].sort = BGP_PEER_EBGP;
+      peers[i].as = 65000 + i % 4;
+    }
+
+  /* A handful of neighbouring ASes, so that deterministic-med has
+   * groups to sort out, and local-pref and med all over the place. */
+  for (i = 0; i < ATTRS; i++)
+    {
+      bgp_attr_default_set (&attrs[i], BGP_ORIGIN_IGP);
+      snprintf (buf, sizeof (buf), "%u 65100 %u", 65000 + i % 4, 65200 + i);
+      attrs[i].aspath = aspath_str2aspath (buf);
+      attrs[i].local_pref = 100 + prng_rand (prng) % 3;
+      attrs[i].flag |= ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF);
+      attrs[i].med = prng_rand (prng) % 10;
+      attrs[i].flag |= ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC);
+    }
+
+  memset (&p, 0, sizeof (p));
+  p.family = AF_INET;
+  p.prefixlen = 24;
+  for (i = 0; i < NODES; i++)
+    {
+      p.u.prefix4.s_addr = htonl (0x0a000000 + (i << 8));
+      rn = bgp_node_get (table, &p);
+      for (j = 0; j < PEERS; j++)
+        {
+          ri = XCALLOC (MTYPE_BGP_ROUTE, sizeof (struct bgp_info));
+          ri->type = ZEBRA_ROUTE_BGP;
+          ri->sub_type = BGP_ROUTE_NORMAL;
+          ri->peer = &peers[j];
+          ri->attr = &attrs[prng_rand (prng) % ATTRS];
+          SET_FLAG (ri->flags, BGP_INFO_VALID);
+          bgp_info_add (rn, ri);
+        }
+
+      jobs[i].bgp = bgp;
+      jobs[i].rn = rn;
+      jobs[i].mpath_cfg = &mpath_cfg;
+      jobs[i].new_select = NULL;
+    }
+
+  prng_free (prng);
+}
+
+static void
+run (unsigned int workers)
+{
+  unsigned int i;
+
+  bgp_bestpath_workers_set (workers);
+  assert (bgp_bestpath_workers () == workers);
+
+  for (i = 0; i < NODES; i++)
+    jobs[i].new_select = NULL;
+
+  bgp_bestpath_run (jobs, NODES);
+}
+
+/* The workers come up with the same best paths as the main pthread does
+ * on its own. */
+static void
+test_selection (void)
+{
+  unsigned int i;
+
+  run (1);
+  for (i = 0; i < NODES; i++)
+    {
+      assert (jobs[i].new_select);
+      assert (CHECK_FLAG (jobs[i].new_select->flags, BGP_INFO_DMED_SELECTED));
+      serial[i] = jobs[i].new_select;
+    }
+
+  run (4);
+  for (i = 0; i < NODES; i++)
+    assert (jobs[i].new_select == serial[i]);
+
+  /* Again, now that the pthreads are up. */
+  run (4);
+  for (i = 0; i < NODES; i++)
+    assert (jobs[i].new_select == serial[i]);
+
+  /* Small batches stay on the main pthread. */
+  bgp_bestpath_run (jobs, BGP_BESTPATH_PARALLEL_MIN - 1);
+  for (i = 0; i < BGP_BESTPATH_PARALLEL_MIN - 1; i++)
+    assert (jobs[i].new_select == serial[i]);
+
+  /* Going back down to one joins the rest. */
+  run (1);
+  for (i = 0; i < NODES; i++)
+    assert (jobs[i].new_select == serial[i]);
+
+  printf ("Verified bestpath workers\n");
+}
+
+int
+main (void)
+{
+  qobj_init ();
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  bgp_master_init (master);
+  vrf_init (NULL, NULL, NULL, NULL);
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+
+  setup ();
+  test_selection ();
+
+  bgp_bestpath_finish ();
+  return 0;
+}
@@ -0,0 +1,6 @@
+import frrtest
+
+class TestBestpath(frrtest.TestMultiOut):
+    program = './test_bestpath'
+
+TestBestpath.onesimple('Verified bestpath workers')
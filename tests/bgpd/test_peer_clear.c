@@ -0,0 +1,209 @@
+/*
+ * Clearing a peer's routes through the per-peer indices.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "privs.h"
+#include "memory.h"
+#include "workqueue.h"
+#include "zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_advertise.h"
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+#define NODES 2000
+#define SMALL 10
+
+/* A full table from peers[BIG] and [STALE], a few routes from the
+ * others, two paths each from [QUEUED]. */
+enum { BIG, STALE, QUEUED, REAPED, PEERS };
+
+static struct bgp *bgp;
+static struct bgp_table *table;
+static struct peer peers[PEERS];
+
+static void
+add_route (struct bgp_node *rn, struct peer *peer, struct attr *attr)
+{
+  struct bgp_info *ri;
+
+  ri = bgp_info_new ();
+  ri->type = ZEBRA_ROUTE_BGP;
+  ri->sub_type = BGP_ROUTE_NORMAL;
+  ri->peer = peer;
+  ri->attr = bgp_attr_intern (attr);
+  SET_FLAG (ri->flags, BGP_INFO_VALID);
+  bgp_info_add (rn, ri);
+  bgp_adj_in_set (rn, peer, attr, 0);
+}
+
+static void
+setup (void)
+{
+  struct bgp_node *rn;
+  struct attr attr;
+  struct prefix p;
+  char buf[64];
+  unsigned int i;
+
+  bgp = XCALLOC (MTYPE_BGP, sizeof (struct bgp));
+  table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+  bgp->rib[AFI_IP][SAFI_UNICAST] = table;
+  bgp->aggregate[AFI_IP][SAFI_UNICAST] = bgp_table_init (AFI_IP, SAFI_UNICAST);
+
+  for (i = 0; i < PEERS; i++)
+    {
+      snprintf (buf, sizeof (buf), "10.0.0.%u", i + 1);
+      peers[i].host = XSTRDUP (MTYPE_BGP_PEER_HOST, buf);
+      peers[i].su_remote = sockunion_str2su (buf);
+      peers[i].status = Established;
+      peers[i].bgp = bgp;
+      /* held by the test, so that clearing never frees them */
+      peers[i].lock = 1;
+    }
+
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+
+  memset (&p, 0, sizeof (p));
+  p.family = AF_INET;
+  p.prefixlen = 24;
+  for (i = 0; i < NODES; i++)
+    {
+      p.u.prefix4.s_addr = htonl (0x0a000000 + (i << 8));
+      rn = bgp_node_get (table, &p);
+      add_route (rn, &peers[BIG], &attr);
+      add_route (rn, &peers[STALE], &attr);
+      if (i % (NODES / SMALL) == 0)
+        {
+          add_route (rn, &peers[QUEUED], &attr);
+          add_route (rn, &peers[QUEUED], &attr);
+          add_route (rn, &peers[REAPED], &attr);
+        }
+      bgp_unlock_node (rn);
+    }
+}
+
+/* How many paths, removed ones among them, and adj-ins peer has in the
+ * table, by walking it. */
+static void
+count (struct peer *peer, unsigned int *paths, unsigned int *adj_ins,
+       unsigned int *removed)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct bgp_adj_in *ain;
+
+  *paths = *adj_ins = *removed = 0;
+  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+    {
+      for (ri = rn->info; ri; ri = ri->next)
+        if (ri->peer == peer)
+          {
+            (*paths)++;
+            if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+              (*removed)++;
+          }
+      for (ain = rn->adj_in; ain; ain = ain->next)
+        if (ain->peer == peer)
+          (*adj_ins)++;
+    }
+}
+
+static void
+test_clear (void)
+{
+  struct work_queue *wq;
+  unsigned int paths, adj_ins, removed, i;
+  struct bgp_info *ri;
+
+  count (&peers[REAPED], &paths, &adj_ins, &removed);
+  assert (paths == SMALL && adj_ins == SMALL);
+
+  /* Without a process queue, the peer's paths are reaped straight away. */
+  wq = bm->process_main_queue;
+  bm->process_main_queue = NULL;
+  bgp_clear_route (&peers[REAPED], AFI_IP, SAFI_UNICAST);
+  bm->process_main_queue = wq;
+
+  count (&peers[REAPED], &paths, &adj_ins, &removed);
+  assert (paths == 0 && adj_ins == 0);
+  assert (LIST_EMPTY (&peers[REAPED].routes[AFI_IP][SAFI_UNICAST]));
+  assert (LIST_EMPTY (&peers[REAPED].adj_in[AFI_IP][SAFI_UNICAST]));
+  count (&peers[BIG], &paths, &adj_ins, &removed);
+  assert (paths == NODES && adj_ins == NODES);
+
+  /* Otherwise each node goes on the clear queue once, however many paths
+   * the peer has on it. */
+  bgp_clear_route (&peers[QUEUED], AFI_IP, SAFI_UNICAST);
+  assert (listcount (peers[QUEUED].clear_node_queue->items) == SMALL);
+  count (&peers[QUEUED], &paths, &adj_ins, &removed);
+  assert (paths == 2 * SMALL && adj_ins == 0);
+
+  printf ("Verified clearing routes\n");
+
+  bgp_clear_adj_in (&peers[BIG], AFI_IP, SAFI_UNICAST);
+  count (&peers[BIG], &paths, &adj_ins, &removed);
+  assert (paths == NODES && adj_ins == 0);
+  printf ("Verified clearing adj-in\n");
+
+  /* Every other path is stale. */
+  i = 0;
+  LIST_FOREACH (ri, &peers[STALE].routes[AFI_IP][SAFI_UNICAST], peer_thread)
+    if (i++ % 2)
+      SET_FLAG (ri->flags, BGP_INFO_STALE);
+  bgp_clear_stale_route (&peers[STALE], AFI_IP, SAFI_UNICAST);
+  count (&peers[STALE], &paths, &adj_ins, &removed);
+  assert (paths == NODES && removed == NODES / 2);
+  count (&peers[BIG], &paths, &adj_ins, &removed);
+  assert (removed == 0);
+  printf ("Verified clearing stale routes\n");
+}
+
+int
+main (void)
+{
+  qobj_init ();
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  bgp_master_init (master);
+  vrf_init (NULL, NULL, NULL, NULL);
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+
+  setup ();
+  test_clear ();
+  return 0;
+}
@@ -0,0 +1,8 @@
+import frrtest
+
+class TestPeerClear(frrtest.TestMultiOut):
+    program = './test_peer_clear'
+
+TestPeerClear.onesimple('Verified clearing routes')
+TestPeerClear.onesimple('Verified clearing adj-in')
+TestPeerClear.onesimple('Verified clearing stale routes')
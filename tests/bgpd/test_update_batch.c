@@ -0,0 +1,303 @@
+/*
+ * Applying an UPDATE's prefixes in batches.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "command.h"
+#include "privs.h"
+#include "memory.h"
+#include "plist.h"
+#include "routemap.h"
+#include "zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_vty.h"
+
+#include "config_cmd.h"
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+/* 10.0.0.0/24 up, with a multicast /24 thrown in, which is ignored. */
+#define PREFIXES 1000
+#define MULTICAST 500
+
+/* peers[BATCHED] gets the NLRI parsed, peers[SINGLE] the same prefixes
+ * one bgp_update() at a time. */
+enum { BATCHED, SINGLE, PEERS };
+
+static struct bgp *bgp;
+static as_t asn = 100;
+static struct peer *peers[PEERS];
+static struct vty *vty;
+static u_char nlri[PREFIXES * 4];
+
+static void
+make_prefix (struct prefix *p, unsigned int i)
+{
+  memset (p, 0, sizeof (*p));
+  p->family = AF_INET;
+  p->prefixlen = 24;
+  if (i == MULTICAST)
+    p->u.prefix4.s_addr = htonl (0xe0000000);
+  else
+    p->u.prefix4.s_addr = htonl (0x0a000000 + (i << 8));
+}
+
+/* The NLRI for PREFIXES prefixes from the first on. */
+static void
+make_nlri (struct bgp_nlri *packet, unsigned int first)
+{
+  struct prefix p;
+  unsigned int i;
+
+  for (i = 0; i < PREFIXES; i++)
+    {
+      make_prefix (&p, first + i);
+      nlri[i * 4] = p.prefixlen;
+      memcpy (&nlri[i * 4 + 1], &p.u.prefix4, 3);
+    }
+
+  memset (packet, 0, sizeof (*packet));
+  packet->afi = AFI_IP;
+  packet->safi = SAFI_UNICAST;
+  packet->nlri = nlri;
+  packet->length = PREFIXES * 4;
+}
+
+static void
+make_attr (struct attr *attr, const char *aspath)
+{
+  bgp_attr_default_set (attr, BGP_ORIGIN_IGP);
+  attr->aspath = aspath_intern (aspath_str2aspath (aspath));
+  attr->nexthop.s_addr = htonl (0xc0000201);
+  attr->extra->mp_nexthop_len = 0;
+}
+
+static void
+set_filters (struct peer *peer, const char *plist, const char *rmap)
+{
+  struct bgp_filter *filter = &peer->filter[AFI_IP][SAFI_UNICAST];
+
+  if (filter->plist[FILTER_IN].name)
+    free (filter->plist[FILTER_IN].name);
+  filter->plist[FILTER_IN].name = plist ? strdup (plist) : NULL;
+  filter->plist[FILTER_IN].plist =
+    plist ? prefix_list_lookup (AFI_IP, plist) : NULL;
+
+  if (filter->map[RMAP_IN].name)
+    free (filter->map[RMAP_IN].name);
+  filter->map[RMAP_IN].name = rmap ? strdup (rmap) : NULL;
+  filter->map[RMAP_IN].map = rmap ? route_map_lookup_by_name (rmap) : NULL;
+}
+
+static struct bgp_info *
+path (struct bgp_node *rn, struct peer *peer)
+{
+  struct bgp_info *ri;
+
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer && ! CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+      return ri;
+  return NULL;
+}
+
+/* Send the same UPDATE to both peers, and check that they come out with
+ * the same paths.  Returns how many got through. */
+static unsigned int
+update (struct attr *attr)
+{
+  struct bgp_table *table = bgp->rib[AFI_IP][SAFI_UNICAST];
+  struct bgp_nlri packet;
+  struct bgp_node *rn;
+  struct bgp_info *batched, *single;
+  struct prefix p;
+  unsigned int i, accepted = 0;
+
+  make_nlri (&packet, 0);
+  assert (bgp_nlri_parse_ip (peers[BATCHED], attr, &packet) == 0);
+  for (i = 0; i < PREFIXES; i++)
+    if (i != MULTICAST)
+      {
+        make_prefix (&p, i);
+        assert (bgp_update (peers[SINGLE], &p, 0, attr, AFI_IP, SAFI_UNICAST,
+                            ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 0,
+                            NULL) == 0);
+      }
+
+  for (i = 0; i < PREFIXES; i++)
+    {
+      make_prefix (&p, i);
+      rn = bgp_node_lookup (table, &p);
+      if (i == MULTICAST)
+        {
+          assert (rn == NULL);
+          continue;
+        }
+
+      batched = rn ? path (rn, peers[BATCHED]) : NULL;
+      single = rn ? path (rn, peers[SINGLE]) : NULL;
+      assert (!batched == !single);
+      if (batched)
+        {
+          assert (batched->attr == single->attr);
+          assert (CHECK_FLAG (batched->flags, BGP_INFO_VALID)
+                  == CHECK_FLAG (single->flags, BGP_INFO_VALID));
+          accepted++;
+        }
+      if (rn)
+        bgp_unlock_node (rn);
+    }
+  return accepted;
+}
+
+/* A path's attribute for the prefix i. */
+static struct attr *
+attr_of (unsigned int i)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  struct prefix p;
+
+  make_prefix (&p, i);
+  rn = bgp_node_lookup (bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+  if (rn == NULL)
+    return NULL;
+  ri = path (rn, peers[BATCHED]);
+  bgp_unlock_node (rn);
+  return ri ? ri->attr : NULL;
+}
+
+static void
+test_update (void)
+{
+  struct attr attr, *interned;
+  unsigned int accepted;
+
+  make_attr (&attr, "65001 65002");
+
+  /* No policy. */
+  accepted = update (&attr);
+  assert (accepted == PREFIXES - 1);
+  interned = attr_of (0);
+  assert (interned->refcnt == 2 * accepted);
+
+  /* A prefix-list, and a route-map that treats all prefixes alike. */
+  vty->node = CONFIG_NODE;
+  /* 10.1/16 has the multicast one among it. */
+  config_cmd (vty, "ip prefix-list PL seq 5 deny 10.1.0.0/16 le 32");
+  config_cmd (vty, "ip prefix-list PL seq 10 permit 0.0.0.0/0 le 32");
+  config_cmd (vty, "route-map SAME permit 10");
+  config_cmd (vty, "match origin igp");
+  config_cmd (vty, "set local-preference 200");
+  assert (route_map_prefix_independent (route_map_lookup_by_name ("SAME")));
+  set_filters (peers[BATCHED], "PL", "SAME");
+  set_filters (peers[SINGLE], "PL", "SAME");
+
+  accepted = update (&attr);
+  assert (accepted == PREFIXES - 256);
+  interned = attr_of (0);
+  assert (interned->local_pref == 200);
+  assert (interned->refcnt == 2 * accepted);
+  assert (attr_of (256) == NULL);
+
+  /* One that looks at the prefix, so has to be applied to each. */
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "ip prefix-list HIGH seq 5 permit 10.2.0.0/15 le 32");
+  config_cmd (vty, "route-map EACH permit 10");
+  config_cmd (vty, "match ip address prefix-list HIGH");
+  config_cmd (vty, "set local-preference 300");
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "route-map EACH permit 20");
+  config_cmd (vty, "set local-preference 100");
+  assert (! route_map_prefix_independent (route_map_lookup_by_name ("EACH")));
+  set_filters (peers[BATCHED], "PL", "EACH");
+  set_filters (peers[SINGLE], "PL", "EACH");
+
+  accepted = update (&attr);
+  assert (accepted == PREFIXES - 256);
+  assert (attr_of (0)->local_pref == 100);
+  assert (attr_of (512)->local_pref == 300);
+
+  /* Denied for every prefix by the attributes alone. */
+  set_filters (peers[BATCHED], NULL, NULL);
+  set_filters (peers[SINGLE], NULL, NULL);
+  bgp_attr_unintern_sub (&attr);
+  make_attr (&attr, "65001 100 65002");
+  accepted = update (&attr);
+  assert (accepted == 0);
+  bgp_attr_unintern_sub (&attr);
+
+  printf ("Verified batched updates\n");
+}
+
+int
+main (void)
+{
+  unsigned int i;
+
+  qobj_init ();
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  /* not connected, so nexthops aren't sent anywhere */
+  zclient->sock = -1;
+  cmd_init (1);
+  bgp_master_init (master);
+  vrf_init (NULL, NULL, NULL, NULL);
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  /* the command nodes, before anything installs commands into them */
+  bgp_vty_init ();
+  bgp_attr_init ();
+  bgp_route_map_init ();
+  prefix_list_init ();
+
+  vty = vty_new ();
+  vty->type = VTY_TERM;
+
+  if (bgp_get (&bgp, &asn, NULL, BGP_INSTANCE_TYPE_DEFAULT))
+    return -1;
+
+  for (i = 0; i < PEERS; i++)
+    {
+      peers[i] = peer_create_accept (bgp);
+      peers[i]->host = (char *)(i == BATCHED ? "batched" : "single");
+      peers[i]->status = Established;
+      peers[i]->as = 65001;
+      peers[i]->sort = BGP_PEER_EBGP;
+    }
+
+  test_update ();
+  return 0;
+}
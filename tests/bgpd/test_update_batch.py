@@ -0,0 +1,6 @@
+import frrtest
+
+class TestUpdateBatch(frrtest.TestMultiOut):
+    program = './test_update_batch'
+
+TestUpdateBatch.onesimple('Verified batched updates')
@@ -0,0 +1,49 @@
+/*
+ * Configuration commands for tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "vty.h"
+
+#include "config_cmd.h"
+
+void
+config_cmd (struct vty *vty, const char *format, ...)
+{
+  char buf[256];
+  va_list args;
+  vector vline;
+  int ret;
+
+  va_start (args, format);
+  vsnprintf (buf, sizeof (buf), format, args);
+  va_end (args);
+
+  vline = cmd_make_strvec (buf);
+  ret = cmd_execute_command (vline, vty, NULL, 0);
+  cmd_free_strvec (vline);
+  if (ret != CMD_SUCCESS)
+    {
+      fprintf (stderr, "'%s' failed: %d\n", buf, ret);
+      abort ();
+    }
+}
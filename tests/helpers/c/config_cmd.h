@@ -0,0 +1,32 @@
+/*
+ * Configuration commands for tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _CONFIG_CMD_H
+#define _CONFIG_CMD_H
+
+#include "vty.h"
+
+/* Run a command, printf-style, in whichever node vty is in, as if it had
+ * been typed in.  Aborts if the command fails. */
+extern void config_cmd (struct vty *vty, const char *format, ...)
+  PRINTF_ATTRIBUTE(2, 3);
+
+#endif
@@ -0,0 +1,348 @@
+/*
+ * Access-list lookup tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "filter.h"
+#include "memory.h"
+#include "prefix.h"
+#include "thread.h"
+#include "vty.h"
+#include "prng.h"
+
+#include "config_cmd.h"
+
+struct thread_master *master;
+
+/* The filters configured, so that the access-list's answer can be checked
+ * against a plain first-match walk. */
+enum rule_kind
+{
+  RULE_ZEBRA,
+  RULE_CISCO,
+  RULE_EXTENDED,
+};
+
+struct rule
+{
+  enum rule_kind kind;
+  int permit;
+  int deleted;
+
+  /* zebra */
+  struct prefix prefix;
+  int exact;
+
+  /* cisco, in host byte order */
+  u_int32_t addr, wild;
+  u_int32_t mask, maskwild;
+};
+
+#define RULES_MAX 5000
+
+static struct rule rules[RULES_MAX];
+static unsigned int nrules;
+
+static struct vty *vty;
+static struct prng *prng;
+
+static const char *
+ipstr (u_int32_t addr, char *buf)
+{
+  struct in_addr in;
+
+  in.s_addr = htonl (addr);
+  return inet_ntop (AF_INET, &in, buf, INET_ADDRSTRLEN);
+}
+
+static void
+rule_config (const char *name, struct rule *r, int set)
+{
+  const char *no = set ? "" : "no ";
+  const char *type = r->permit ? "permit" : "deny";
+  char b1[INET6_BUFSIZ], b2[INET_ADDRSTRLEN];
+  char b3[INET_ADDRSTRLEN], b4[INET_ADDRSTRLEN];
+
+  switch (r->kind)
+    {
+    case RULE_ZEBRA:
+      config_cmd (vty, "%s%saccess-list %s %s %s/%d%s", no,
+		  r->prefix.family == AF_INET6 ? "ipv6 " : "", name, type,
+		  inet_ntop (r->prefix.family, &r->prefix.u.prefix, b1,
+			     sizeof (b1)),
+		  r->prefix.prefixlen, r->exact ? " exact-match" : "");
+      break;
+    case RULE_CISCO:
+      config_cmd (vty, "%saccess-list %s %s %s %s", no, name, type,
+		  ipstr (r->addr, b1), ipstr (r->wild, b2));
+      break;
+    case RULE_EXTENDED:
+      config_cmd (vty, "%saccess-list %s %s ip %s %s %s %s", no, name, type,
+		  ipstr (r->addr, b1), ipstr (r->wild, b2),
+		  ipstr (r->mask, b3), ipstr (r->maskwild, b4));
+      break;
+    }
+}
+
+static int
+rule_same (struct rule *a, struct rule *b)
+{
+  if (a->kind != b->kind || a->permit != b->permit)
+    return 0;
+  if (a->kind == RULE_ZEBRA)
+    return a->exact == b->exact && prefix_same (&a->prefix, &b->prefix);
+  return a->addr == b->addr && a->wild == b->wild
+	 && a->mask == b->mask && a->maskwild == b->maskwild;
+}
+
+/* Mostly within 10.0.0.0/8 or 2001:db8::/32, so that filters overlap. */
+static void
+random_rule (struct rule *r, int family, enum rule_kind kind)
+{
+  static const u_int32_t wilds[] = {
+    0x00000000, 0x000000ff, 0x0000ffff, 0x00ffffff, 0x0000000f,
+    0x00000fff, 0x0007ffff, 0x00ff00ff, 0x000f00f0, 0xffffffff,
+  };
+  static const u_int32_t maskwilds[] = { 0, 0x000000ff, 0xffffffff };
+  struct in_addr mask;
+
+  memset (r, 0, sizeof (*r));
+  r->kind = kind;
+  r->permit = prng_rand (prng) & 1;
+
+  if (kind == RULE_ZEBRA)
+    {
+      r->prefix.family = family;
+      r->exact = (prng_rand (prng) % 4) == 0;
+      if (family == AF_INET)
+	{
+	  r->prefix.prefixlen = 8 + prng_rand (prng) % 21;
+	  r->prefix.u.prefix4.s_addr = htonl (0x0a000000
+					      | (prng_rand (prng) & 0xffffff));
+	}
+      else
+	{
+	  r->prefix.prefixlen = 32 + prng_rand (prng) % 33;
+	  r->prefix.u.prefix6.s6_addr32[0] = htonl (0x20010db8);
+	  r->prefix.u.prefix6.s6_addr32[1] = htonl (prng_rand (prng));
+	}
+      apply_mask (&r->prefix);
+      return;
+    }
+
+  r->wild = wilds[prng_rand (prng) % array_size (wilds)];
+  r->addr = (0x0a000000 | (prng_rand (prng) & 0xffffff)) & ~r->wild;
+  if (kind == RULE_EXTENDED)
+    {
+      masklen2ip (8 + prng_rand (prng) % 25, &mask);
+      r->maskwild = maskwilds[prng_rand (prng) % array_size (maskwilds)];
+      r->mask = ntohl (mask.s_addr) & ~r->maskwild;
+    }
+}
+
+static void
+add_rules (const char *name, int family, unsigned int count)
+{
+  struct rule *r;
+  enum rule_kind kind;
+  unsigned int i;
+
+  while (count-- && nrules < RULES_MAX)
+    {
+      r = &rules[nrules];
+      do
+	{
+	  if (family == AF_INET6)
+	    kind = RULE_ZEBRA;
+	  else if (isdigit ((int) name[0]))
+	    kind = atoi (name) < 100 ? RULE_CISCO : RULE_EXTENDED;
+	  else
+	    kind = RULE_ZEBRA;
+	  random_rule (r, family, kind);
+
+	  for (i = 0; i < nrules; i++)
+	    if (!rules[i].deleted && rule_same (&rules[i], r))
+	      break;
+	}
+      while (i < nrules);
+
+      rule_config (name, r, 1);
+      nrules++;
+    }
+}
+
+static int
+rule_match (struct rule *r, struct prefix *p)
+{
+  struct in_addr mask;
+  u_int32_t addr;
+
+  switch (r->kind)
+    {
+    case RULE_ZEBRA:
+      if (r->prefix.family != p->family)
+	return 0;
+      if (r->exact && r->prefix.prefixlen != p->prefixlen)
+	return 0;
+      return prefix_match (&r->prefix, p);
+    case RULE_CISCO:
+      addr = ntohl (p->u.prefix4.s_addr);
+      return (addr & ~r->wild) == r->addr;
+    case RULE_EXTENDED:
+      addr = ntohl (p->u.prefix4.s_addr);
+      masklen2ip (p->prefixlen, &mask);
+      return (addr & ~r->wild) == r->addr
+	     && (ntohl (mask.s_addr) & ~r->maskwild) == r->mask;
+    }
+  return 0;
+}
+
+static enum filter_type
+linear_apply (struct prefix *p)
+{
+  unsigned int i;
+
+  for (i = 0; i < nrules; i++)
+    if (!rules[i].deleted && rule_match (&rules[i], p))
+      return rules[i].permit ? FILTER_PERMIT : FILTER_DENY;
+  return FILTER_DENY;
+}
+
+/* A prefix within one of the filters, or anywhere at all. */
+static void
+random_lookup (struct prefix *p, int family)
+{
+  struct rule *r = &rules[prng_rand (prng) % nrules];
+  unsigned int maxlen = family == AF_INET ? 32 : 128;
+  unsigned int i;
+
+  memset (p, 0, sizeof (*p));
+  p->family = family;
+
+  if (prng_rand (prng) % 4 == 0)
+    {
+      for (i = 0; i < 4; i++)
+	p->u.prefix6.s6_addr32[i] = prng_rand (prng);
+      if (prng_rand (prng) & 1)
+	p->u.prefix6.s6_addr[0] = family == AF_INET ? 10 : 0x20;
+      p->prefixlen = prng_rand (prng) % (maxlen + 1);
+    }
+  else if (r->kind == RULE_ZEBRA)
+    {
+      for (i = 0; i < 4; i++)
+	p->u.prefix6.s6_addr32[i] = prng_rand (prng);
+      p->prefixlen = r->prefix.prefixlen;
+      /* take the filter's bits and random ones after */
+      for (i = 0; i < r->prefix.prefixlen; i++)
+	{
+	  u_char bit = 0x80 >> (i % 8);
+
+	  p->u.prefix6.s6_addr[i / 8] &= ~bit;
+	  p->u.prefix6.s6_addr[i / 8] |= r->prefix.u.prefix6.s6_addr[i / 8]
+					 & bit;
+	}
+      if (prng_rand (prng) & 1)
+	p->prefixlen += prng_rand (prng) % (maxlen - p->prefixlen + 1);
+    }
+  else
+    {
+      p->u.prefix4.s_addr = htonl (r->addr | (prng_rand (prng) & r->wild));
+      p->prefixlen = prng_rand (prng) % 33;
+    }
+  apply_mask (p);
+}
+
+static void
+verify (const char *name, int family, unsigned int lookups)
+{
+  struct access_list *access;
+  struct prefix p;
+  unsigned int i;
+
+  access = access_list_lookup (family == AF_INET ? AFI_IP : AFI_IP6, name);
+  assert (access);
+
+  for (i = 0; i < lookups; i++)
+    {
+      random_lookup (&p, family);
+      if (access_list_apply (access, &p) != linear_apply (&p))
+	{
+	  char buf[PREFIX2STR_BUFFER];
+
+	  fprintf (stderr, "%s: mismatch for %s\n", name,
+		   prefix2str (&p, buf, sizeof (buf)));
+	  abort ();
+	}
+    }
+}
+
+/* Fill a list, check it, then take out and put in filters, which makes
+ * the list rebuild its trie, and check again. */
+static void
+test_list (const char *name, int family, unsigned int count)
+{
+  unsigned int i;
+
+  nrules = 0;
+  add_rules (name, family, count);
+  verify (name, family, 20000);
+
+  for (i = 0; i < nrules; i += 3)
+    {
+      rule_config (name, &rules[i], 0);
+      rules[i].deleted = 1;
+    }
+  verify (name, family, 20000);
+
+  add_rules (name, family, count / 4);
+  verify (name, family, 20000);
+
+  for (i = 0; i < nrules; i++)
+    if (!rules[i].deleted)
+      rule_config (name, &rules[i], 0);
+  assert (access_list_lookup (family == AF_INET ? AFI_IP : AFI_IP6,
+			      name) == NULL);
+
+  printf ("Verified access-list %s\n", name);
+}
+
+int
+main (void)
+{
+  master = thread_master_create ();
+  cmd_init (1);
+  access_list_init ();
+
+  vty = vty_new ();
+  vty->type = VTY_TERM;
+  vty->node = CONFIG_NODE;
+  prng = prng_new (0);
+
+  test_list ("small", AF_INET, 6);
+  test_list ("zebra", AF_INET, 1000);
+  test_list ("zebra6", AF_INET6, 1000);
+  test_list ("10", AF_INET, 1000);
+  test_list ("110", AF_INET, 1000);
+
+  prng_free (prng);
+  return 0;
+}
@@ -0,0 +1,10 @@
+import frrtest
+
+class TestAccessList(frrtest.TestMultiOut):
+    program = './test_access_list'
+
+TestAccessList.onesimple('Verified access-list small')
+TestAccessList.onesimple('Verified access-list zebra')
+TestAccessList.onesimple('Verified access-list zebra6')
+TestAccessList.onesimple('Verified access-list 10')
+TestAccessList.onesimple('Verified access-list 110')
@@ -0,0 +1,146 @@
+/*
+ * Test how long it takes to run prefixes through a long zebra-style
+ * access-list, compared with walking its filters one by one in order.
+ *
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "command.h"
+#include "filter.h"
+#include "memory.h"
+#include "prefix.h"
+#include "thread.h"
+#include "vty.h"
+#include "prng.h"
+
+#include "config_cmd.h"
+
+#define FILTERS 5000
+#define LOOKUPS 50000
+
+struct thread_master *master;
+
+static struct prefix filters[FILTERS];
+static int permits[FILTERS];
+static struct prefix lookups[LOOKUPS];
+
+static unsigned long elapsed_usec(struct timeval *from, struct timeval *to)
+{
+  return 1000000 * (to->tv_sec - from->tv_sec) + to->tv_usec - from->tv_usec;
+}
+
+/* Within 10.0.0.0/8, so that filters overlap; duplicates only shadow
+ * each other, which the linear walk does just the same. */
+static void make_list(struct vty *vty, struct prng *prng, const char *name)
+{
+  char buf[PREFIX2STR_BUFFER];
+  unsigned int i;
+
+  for (i = 0; i < FILTERS; i++)
+    {
+      filters[i].family = AF_INET;
+      filters[i].prefixlen = 8 + prng_rand(prng) % 21;
+      filters[i].u.prefix4.s_addr = htonl(0x0a000000
+                                          | (prng_rand(prng) & 0xffffff));
+      apply_mask(&filters[i]);
+      permits[i] = prng_rand(prng) & 1;
+
+      config_cmd(vty, "access-list %s %s %s", name,
+                 permits[i] ? "permit" : "deny",
+                 prefix2str(&filters[i], buf, sizeof(buf)));
+    }
+}
+
+static enum filter_type linear_apply(struct prefix *p)
+{
+  unsigned int i;
+
+  for (i = 0; i < FILTERS; i++)
+    if (prefix_match(&filters[i], p))
+      return permits[i] ? FILTER_PERMIT : FILTER_DENY;
+  return FILTER_DENY;
+}
+
+int main(int argc, char **argv)
+{
+  struct access_list *access;
+  struct prng *prng;
+  struct vty *vty;
+  struct timeval tv_start, tv_lap, tv_stop;
+  unsigned long t_list, t_linear;
+  unsigned int i, count = 0;
+
+  master = thread_master_create();
+  cmd_init(1);
+  access_list_init();
+
+  vty = vty_new();
+  vty->type = VTY_TERM;
+  vty->node = CONFIG_NODE;
+  prng = prng_new(0);
+
+  make_list(vty, prng, "perf");
+  access = access_list_lookup(AFI_IP, "perf");
+
+  /* Mostly within 10.0.0.0/8 as well. */
+  for (i = 0; i < LOOKUPS; i++)
+    {
+      u_int32_t addr = prng_rand(prng);
+
+      if (prng_rand(prng) % 4)
+        addr = 0x0a000000 | (addr & 0xffffff);
+      lookups[i].family = AF_INET;
+      lookups[i].prefixlen = 16 + prng_rand(prng) % 17;
+      lookups[i].u.prefix4.s_addr = htonl(addr);
+      apply_mask(&lookups[i]);
+    }
+
+  monotime(&tv_start);
+
+  for (i = 0; i < LOOKUPS; i++)
+    count += access_list_apply(access, &lookups[i]) == FILTER_PERMIT;
+
+  monotime(&tv_lap);
+
+  for (i = 0; i < LOOKUPS; i++)
+    count -= linear_apply(&lookups[i]) == FILTER_PERMIT;
+
+  monotime(&tv_stop);
+
+  if (count != 0)
+    abort();
+
+  t_list = elapsed_usec(&tv_start, &tv_lap) / 1000;
+  t_linear = elapsed_usec(&tv_lap, &tv_stop) / 1000;
+
+  printf("access-list: Applying %d filters to %d prefixes took "
+         "%ld.%03ld seconds.\n", FILTERS, LOOKUPS,
+         t_list/1000, t_list%1000);
+  printf("linear     : Applying %d filters to %d prefixes took "
+         "%ld.%03ld seconds.\n", FILTERS, LOOKUPS,
+         t_linear/1000, t_linear%1000);
+  fflush(stdout);
+
+  prng_free(prng);
+  return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Test how long it takes to fill, search and empty chained and open
+ * addressing hash tables, and how long the slowest single insert took.
+ *
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "memory.h"
+#include "thread.h"
+#include "hash.h"
+#include "jhash.h"
+#include "prng.h"
+
+#define HASH_ENTRIES 2000000
+#define REMOVE_ENTRIES 1000000
+
+struct thread_master *master;
+
+static unsigned int item_key(void *arg)
+{
+  return jhash_1word(*(unsigned int *)arg, 0);
+}
+
+static int item_cmp(const void *a, const void *b)
+{
+  return *(const unsigned int *)a == *(const unsigned int *)b;
+}
+
+static void item_count(struct hash_backet *hb, void *arg)
+{
+  (*(unsigned long *)arg)++;
+}
+
+static unsigned long elapsed_usec(struct timeval *from, struct timeval *to)
+{
+  return 1000000 * (to->tv_sec - from->tv_sec) + to->tv_usec - from->tv_usec;
+}
+
+static void hash_benchmark(const char *backend, bool open)
+{
+  struct prng *prng;
+  struct hash *hash;
+  unsigned int *items;
+  struct timeval tv_start, tv_lap, tv_lap2, tv_stop, tv_op, tv_op2;
+  unsigned long t_insert, t_lookup, t_remove, t_op, t_worst = 0;
+  unsigned long n;
+  int i;
+
+  prng = prng_new(0);
+  items = calloc(HASH_ENTRIES, sizeof(*items));
+  for (i = 0; i < HASH_ENTRIES; i++)
+    items[i] = i * 2654435761U;
+
+  if (open)
+    hash = hash_create_open(item_key, item_cmp);
+  else
+    hash = hash_create(item_key, item_cmp);
+
+  monotime(&tv_start);
+
+  for (i = 0; i < HASH_ENTRIES; i++)
+    {
+      monotime(&tv_op);
+      hash_get(hash, &items[i], hash_alloc_intern);
+      monotime(&tv_op2);
+
+      t_op = elapsed_usec(&tv_op, &tv_op2);
+      if (t_op > t_worst)
+        t_worst = t_op;
+    }
+
+  monotime(&tv_lap);
+
+  for (i = 0; i < HASH_ENTRIES; i++)
+    {
+      unsigned int key = items[prng_rand(prng) % HASH_ENTRIES];
+
+      if (*(unsigned int *)hash_lookup(hash, &key) != key)
+        abort();
+    }
+
+  monotime(&tv_lap2);
+
+  for (i = 0; i < REMOVE_ENTRIES; i++)
+    if (hash_release(hash, &items[i]) != &items[i])
+      abort();
+
+  monotime(&tv_stop);
+
+  n = 0;
+  hash_iterate(hash, item_count, &n);
+  if (n != HASH_ENTRIES - REMOVE_ENTRIES || hash->count != n)
+    abort();
+  if (hash_lookup(hash, &items[0]))
+    abort();
+
+  t_insert = elapsed_usec(&tv_start, &tv_lap) / 1000;
+  t_lookup = elapsed_usec(&tv_lap, &tv_lap2) / 1000;
+  t_remove = elapsed_usec(&tv_lap2, &tv_stop) / 1000;
+
+  printf("%-7s: Inserting %d entries took %ld.%03ld seconds, "
+         "slowest insert %ld.%03ld ms.\n",
+         backend, HASH_ENTRIES, t_insert/1000, t_insert%1000,
+         t_worst/1000, t_worst%1000);
+  printf("%-7s: Looking up %d random entries took %ld.%03ld seconds.\n",
+         backend, HASH_ENTRIES, t_lookup/1000, t_lookup%1000);
+  printf("%-7s: Removing %d entries took %ld.%03ld seconds.\n",
+         backend, REMOVE_ENTRIES, t_remove/1000, t_remove%1000);
+  fflush(stdout);
+
+  hash_clean(hash, NULL);
+  hash_free(hash);
+  free(items);
+  prng_free(prng);
+}
+
+int main(int argc, char **argv)
+{
+  hash_benchmark("chained", false);
+  hash_benchmark("open", true);
+  return 0;
+}
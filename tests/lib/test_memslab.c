@@ -0,0 +1,161 @@
+/*
+ * Slab-backed memtype tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+#include <memory.h>
+
+struct thread_master *master;
+
+struct test_obj
+{
+  struct test_obj *self;
+  unsigned long seq;
+  char pad[40];
+};
+
+DEFINE_MGROUP(TEST_MEMSLAB, "slab test")
+DEFINE_MTYPE_STATIC_SLAB(TEST_MEMSLAB, TEST_SLAB, "slab test object",
+			 sizeof (struct test_obj))
+
+#define OBJECTS 20000
+#define THREADS 4
+
+static struct test_obj *objs[OBJECTS];
+
+static void
+fill (unsigned int from, unsigned int to)
+{
+  unsigned int i;
+
+  for (i = from; i < to; i++)
+    {
+      objs[i] = XCALLOC (MTYPE_TEST_SLAB, sizeof (struct test_obj));
+      assert (objs[i]->self == NULL && objs[i]->seq == 0);
+      objs[i]->self = objs[i];
+      objs[i]->seq = i;
+    }
+}
+
+static void
+check (unsigned int from, unsigned int to)
+{
+  unsigned int i;
+
+  for (i = from; i < to; i++)
+    assert (objs[i]->self == objs[i] && objs[i]->seq == i);
+}
+
+static void
+drain (unsigned int from, unsigned int to)
+{
+  unsigned int i;
+
+  for (i = from; i < to; i++)
+    XFREE (MTYPE_TEST_SLAB, objs[i]);
+}
+
+static void
+test_alloc_free (void)
+{
+  struct memslab_stats st;
+
+  /* Every object must be distinct, and stay put while others come and
+   * go. */
+  fill (0, OBJECTS);
+  check (0, OBJECTS);
+  drain (0, OBJECTS / 2);
+  fill (0, OBJECTS / 2);
+  check (0, OBJECTS);
+
+  if (!mtype_slab_stats (MTYPE_TEST_SLAB, &st))
+    {
+      /* built with ASan, which needs to see each object on its own */
+      drain (0, OBJECTS);
+      printf ("Verified slab allocation\n");
+      return;
+    }
+
+  assert (st.objsize >= sizeof (struct test_obj));
+  assert (st.total >= OBJECTS);
+  assert (st.total - st.free == OBJECTS);
+  assert (st.bytes >= st.total * st.objsize);
+
+  drain (0, OBJECTS);
+  assert (mtype_slab_stats (MTYPE_TEST_SLAB, &st));
+  assert (st.free == st.total);
+  assert (mtype_stats_alloc (MTYPE_TEST_SLAB) == 0);
+
+  printf ("Verified slab allocation\n");
+}
+
+/* Each pthread frees the objects the main thread allocated for it, then
+ * allocates and frees its own. */
+static void *
+thread_churn (void *arg)
+{
+  unsigned int n = (uintptr_t) arg;
+  unsigned int from = n * (OBJECTS / THREADS);
+  unsigned int to = from + OBJECTS / THREADS;
+  unsigned int round;
+
+  for (round = 0; round < 4; round++)
+    {
+      check (from, to);
+      drain (from, to);
+      fill (from, to);
+    }
+  return NULL;
+}
+
+static void
+test_pthreads (void)
+{
+  pthread_t threads[THREADS];
+  struct memslab_stats st;
+  unsigned int i;
+
+  fill (0, OBJECTS);
+  for (i = 0; i < THREADS; i++)
+    assert (pthread_create (&threads[i], NULL, thread_churn,
+			    (void *) (uintptr_t) i) == 0);
+  for (i = 0; i < THREADS; i++)
+    pthread_join (threads[i], NULL);
+
+  check (0, OBJECTS);
+  assert (mtype_stats_alloc (MTYPE_TEST_SLAB) == OBJECTS);
+
+  /* The pthreads are gone, so their caches must be back in the pool;
+   * only the main thread's can still be holding objects. */
+  if (mtype_slab_stats (MTYPE_TEST_SLAB, &st))
+    assert (st.cached <= 128);
+
+  drain (0, OBJECTS);
+  printf ("Verified slab allocation from pthreads\n");
+}
+
+int
+main (void)
+{
+  test_alloc_free ();
+  test_pthreads ();
+  return 0;
+}
@@ -0,0 +1,7 @@
+import frrtest
+
+class TestMemslab(frrtest.TestMultiOut):
+    program = './test_memslab'
+
+TestMemslab.onesimple('Verified slab allocation')
+TestMemslab.onesimple('Verified slab allocation from pthreads')
@@ -0,0 +1,342 @@
+/*
+ * Prefix-list tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "memory.h"
+#include "plist.h"
+#include "prefix.h"
+#include "table.h"
+#include "thread.h"
+#include "vty.h"
+#include "prng.h"
+
+#include "config_cmd.h"
+
+struct thread_master *master;
+
+/* The entries configured, so that the prefix-list's answer can be checked
+ * against a plain first-match walk. */
+struct rule
+{
+  int seq;
+  int permit;
+  int deleted;
+  struct prefix prefix;
+  int ge, le;
+};
+
+#define RULES_MAX 5000
+#define LOOKUPS 20000
+
+static struct rule rules[RULES_MAX];
+static unsigned int nrules;
+
+static struct vty *vty;
+static struct prng *prng;
+
+static void
+rule_config (const char *name, struct rule *r, int set)
+{
+  char buf[PREFIX2STR_BUFFER];
+  char ge[16] = "", le[16] = "";
+
+  if (r->ge)
+    snprintf (ge, sizeof (ge), " ge %d", r->ge);
+  if (r->le)
+    snprintf (le, sizeof (le), " le %d", r->le);
+  config_cmd (vty, "%s%s prefix-list %s seq %d %s %s%s%s", set ? "" : "no ",
+	      r->prefix.family == AF_INET ? "ip" : "ipv6", name, r->seq,
+	      r->permit ? "permit" : "deny",
+	      prefix2str (&r->prefix, buf, sizeof (buf)), ge, le);
+}
+
+/* Mostly within 10.0.0.0/8 or 2001:db8::/32, so that entries overlap. */
+static void
+random_rule (struct rule *r, int family)
+{
+  unsigned int maxlen = family == AF_INET ? 32 : 128;
+
+  memset (r, 0, sizeof (*r));
+  r->permit = prng_rand (prng) & 1;
+  r->prefix.family = family;
+  if (family == AF_INET)
+    {
+      r->prefix.prefixlen = 8 + prng_rand (prng) % 21;
+      r->prefix.u.prefix4.s_addr = htonl (0x0a000000
+					  | (prng_rand (prng) & 0xffffff));
+    }
+  else
+    {
+      r->prefix.prefixlen = 32 + prng_rand (prng) % 33;
+      r->prefix.u.prefix6.s6_addr32[0] = htonl (0x20010db8);
+      r->prefix.u.prefix6.s6_addr32[1] = htonl (prng_rand (prng));
+    }
+  apply_mask (&r->prefix);
+
+  switch (prng_rand (prng) % 4)
+    {
+    case 0:
+      break;
+    case 1:
+      r->le = r->prefix.prefixlen + 1
+	      + prng_rand (prng) % (maxlen - r->prefix.prefixlen);
+      break;
+    case 2:
+      r->ge = r->prefix.prefixlen + 1
+	      + prng_rand (prng) % (maxlen - r->prefix.prefixlen);
+      break;
+    case 3:
+      r->ge = r->prefix.prefixlen + 1
+	      + prng_rand (prng) % (maxlen - r->prefix.prefixlen);
+      r->le = r->ge + prng_rand (prng) % (maxlen - r->ge + 1);
+      break;
+    }
+  /* the CLI leaves out "le" when it is implied by "ge" */
+  if (r->ge && r->le == (int) maxlen)
+    r->le = 0;
+}
+
+static int
+rule_same (struct rule *a, struct rule *b)
+{
+  return a->permit == b->permit && a->ge == b->ge && a->le == b->le
+	 && prefix_same (&a->prefix, &b->prefix);
+}
+
+static void
+add_rules (const char *name, int family, unsigned int count)
+{
+  struct rule *r;
+  unsigned int i;
+
+  while (count-- && nrules < RULES_MAX)
+    {
+      r = &rules[nrules];
+      do
+	{
+	  random_rule (r, family);
+	  for (i = 0; i < nrules; i++)
+	    if (!rules[i].deleted && rule_same (&rules[i], r))
+	      break;
+	}
+      while (i < nrules);
+
+      /* in between the existing ones now and then */
+      r->seq = (nrules + 1) * 10;
+      if (nrules && prng_rand (prng) % 4 == 0)
+	r->seq = rules[prng_rand (prng) % nrules].seq + 1
+		 + prng_rand (prng) % 9;
+      for (i = 0; i < nrules; i++)
+	if (!rules[i].deleted && rules[i].seq == r->seq)
+	  break;
+      if (i < nrules)
+	r->seq = (nrules + 1) * 10;
+
+      rule_config (name, r, 1);
+      nrules++;
+    }
+}
+
+static int
+rule_match (struct rule *r, struct prefix *p)
+{
+  if (!prefix_match (&r->prefix, p))
+    return 0;
+  if (!r->ge && !r->le)
+    return r->prefix.prefixlen == p->prefixlen;
+  if (r->ge && p->prefixlen < r->ge)
+    return 0;
+  if (r->le && p->prefixlen > r->le)
+    return 0;
+  return 1;
+}
+
+static enum prefix_list_type
+linear_apply (struct prefix *p)
+{
+  struct rule *best = NULL;
+  unsigned int i;
+
+  for (i = 0; i < nrules; i++)
+    if (!rules[i].deleted && (!best || rules[i].seq < best->seq)
+	&& rule_match (&rules[i], p))
+      best = &rules[i];
+  if (!best)
+    return PREFIX_DENY;
+  return best->permit ? PREFIX_PERMIT : PREFIX_DENY;
+}
+
+/* A prefix within one of the entries, or anywhere at all. */
+static void
+random_lookup (struct prefix *p, int family)
+{
+  struct rule *r = &rules[prng_rand (prng) % nrules];
+  unsigned int maxlen = family == AF_INET ? 32 : 128;
+  unsigned int i;
+
+  memset (p, 0, sizeof (*p));
+  p->family = family;
+  for (i = 0; i < 4; i++)
+    p->u.prefix6.s6_addr32[i] = prng_rand (prng);
+
+  if (prng_rand (prng) % 4 == 0)
+    {
+      if (prng_rand (prng) & 1)
+	p->u.prefix6.s6_addr[0] = family == AF_INET ? 10 : 0x20;
+      p->prefixlen = prng_rand (prng) % (maxlen + 1);
+    }
+  else
+    {
+      p->prefixlen = r->prefix.prefixlen;
+      /* take the entry's bits and random ones after */
+      for (i = 0; i < r->prefix.prefixlen; i++)
+	{
+	  u_char bit = 0x80 >> (i % 8);
+
+	  p->u.prefix6.s6_addr[i / 8] &= ~bit;
+	  p->u.prefix6.s6_addr[i / 8] |= r->prefix.u.prefix6.s6_addr[i / 8]
+					 & bit;
+	}
+      if (prng_rand (prng) & 1)
+	p->prefixlen += prng_rand (prng) % (maxlen - p->prefixlen + 1);
+    }
+  apply_mask (p);
+}
+
+/* count prefixes, in the order a walk of a route table holding them finds
+ * them in.  Returns how many there are without duplicates. */
+static unsigned int
+table_order (struct prefix *prefixes, unsigned int count)
+{
+  struct route_table *table = route_table_init ();
+  struct route_node *rn;
+  unsigned int i;
+
+  for (i = 0; i < count; i++)
+    {
+      rn = route_node_get (table, &prefixes[i]);
+      rn->info = rn;
+    }
+  for (i = 0, rn = route_top (table); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	prefix_copy (&prefixes[i++], &rn->p);
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  route_table_finish (table);
+  return i;
+}
+
+static void
+verify (const char *name, int family)
+{
+  static struct prefix lookups[LOOKUPS];
+  static struct prefix *ptrs[LOOKUPS];
+  static enum prefix_list_type results[LOOKUPS];
+  struct prefix_list *plist;
+  unsigned int i, count;
+  int sorted;
+
+  plist = prefix_list_lookup (family == AF_INET ? AFI_IP : AFI_IP6, name);
+  assert (plist);
+
+  for (i = 0; i < LOOKUPS; i++)
+    {
+      random_lookup (&lookups[i], family);
+      ptrs[i] = &lookups[i];
+    }
+
+  /* in any order, then as a table walk has them */
+  for (sorted = 0, count = LOOKUPS; sorted < 2; sorted++)
+    {
+      if (sorted)
+	count = table_order (lookups, LOOKUPS);
+      prefix_list_apply_bulk (plist, ptrs, count, results);
+
+      for (i = 0; i < count; i++)
+	{
+	  enum prefix_list_type expect = linear_apply (&lookups[i]);
+
+	  if (prefix_list_apply (plist, &lookups[i]) != expect
+	      || results[i] != expect)
+	    {
+	      char buf[PREFIX2STR_BUFFER];
+
+	      fprintf (stderr, "%s: mismatch for %s\n", name,
+		       prefix2str (&lookups[i], buf, sizeof (buf)));
+	      abort ();
+	    }
+	}
+    }
+}
+
+/* Fill a list, check it, then take out and put in entries, which changes
+ * the trie under the list, and check again. */
+static void
+test_list (const char *name, int family, unsigned int count)
+{
+  unsigned int i;
+
+  nrules = 0;
+  add_rules (name, family, count);
+  verify (name, family);
+
+  for (i = 0; i < nrules; i += 3)
+    {
+      rule_config (name, &rules[i], 0);
+      rules[i].deleted = 1;
+    }
+  verify (name, family);
+
+  add_rules (name, family, count / 4);
+  verify (name, family);
+
+  for (i = 0; i < nrules; i++)
+    if (!rules[i].deleted)
+      rule_config (name, &rules[i], 0);
+  assert (prefix_list_lookup (family == AF_INET ? AFI_IP : AFI_IP6,
+			      name) == NULL);
+
+  printf ("Verified prefix-list %s\n", name);
+}
+
+int
+main (void)
+{
+  master = thread_master_create ();
+  cmd_init (1);
+  prefix_list_init ();
+
+  vty = vty_new ();
+  vty->type = VTY_TERM;
+  vty->node = CONFIG_NODE;
+  prng = prng_new (0);
+
+  test_list ("small", AF_INET, 6);
+  test_list ("v4", AF_INET, 1000);
+  test_list ("v6", AF_INET6, 1000);
+
+  prng_free (prng);
+  return 0;
+}
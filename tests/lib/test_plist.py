@@ -0,0 +1,8 @@
+import frrtest
+
+class TestPlist(frrtest.TestMultiOut):
+    program = './test_plist'
+
+TestPlist.onesimple('Verified prefix-list small')
+TestPlist.onesimple('Verified prefix-list v4')
+TestPlist.onesimple('Verified prefix-list v6')
@@ -0,0 +1,165 @@
+/*
+ * Test how long it takes to run a full table's worth of prefixes, in the
+ * order a table walk finds them in, through a long prefix-list one at a
+ * time and in one prefix_list_apply_bulk() call.
+ *
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "command.h"
+#include "memory.h"
+#include "plist.h"
+#include "prefix.h"
+#include "table.h"
+#include "thread.h"
+#include "vty.h"
+#include "prng.h"
+
+#include "config_cmd.h"
+
+#define ENTRIES 2000
+#define LOOKUPS 300000
+#define ROUNDS 10
+
+struct thread_master *master;
+
+static struct prefix lookups[LOOKUPS];
+static struct prefix *ptrs[LOOKUPS];
+static enum prefix_list_type results[LOOKUPS];
+
+static unsigned long elapsed_usec(struct timeval *from, struct timeval *to)
+{
+  return 1000000 * (to->tv_sec - from->tv_sec) + to->tv_usec - from->tv_usec;
+}
+
+/* Within 10.0.0.0/8: every tenth entry a /16 with a range of longer
+ * prefixes, the rest /24s, all different. */
+static void make_list(struct vty *vty, const char *name)
+{
+  unsigned int i;
+
+  for (i = 0; i < ENTRIES; i++)
+    if (i % 10 == 0)
+      config_cmd(vty, "ip prefix-list %s seq %u %s 10.%u.0.0/16 ge 17 le 24",
+                 name, (i + 1) * 5, i % 20 ? "permit" : "deny", i / 10);
+    else
+      config_cmd(vty, "ip prefix-list %s seq %u %s 10.%u.%u.0/24 le 28",
+                 name, (i + 1) * 5, i % 3 ? "permit" : "deny",
+                 i / 256, i % 256);
+}
+
+/* Mostly /24s, three quarters of them within 10.0.0.0/8, in the order a
+ * table walk finds them in.  Returns how many there are after dropping
+ * duplicates. */
+static unsigned int make_lookups(struct prng *prng)
+{
+  struct route_table *table = route_table_init();
+  struct route_node *rn;
+  unsigned int i;
+
+  for (i = 0; i < LOOKUPS; i++)
+    {
+      u_int32_t addr = prng_rand(prng);
+
+      if (prng_rand(prng) % 4)
+        addr = 0x0a000000 | (addr & 0xffffff);
+      lookups[i].family = AF_INET;
+      lookups[i].prefixlen = 24;
+      if (prng_rand(prng) % 8 == 0)
+        lookups[i].prefixlen = 16 + prng_rand(prng) % 8;
+      lookups[i].u.prefix4.s_addr = htonl(addr);
+      apply_mask(&lookups[i]);
+
+      rn = route_node_get(table, &lookups[i]);
+      rn->info = rn;
+    }
+
+  for (i = 0, rn = route_top(table); rn; rn = route_next(rn))
+    if (rn->info)
+      {
+        prefix_copy(&lookups[i], &rn->p);
+        ptrs[i] = &lookups[i];
+        i++;
+        rn->info = NULL;
+        route_unlock_node(rn);
+      }
+  route_table_finish(table);
+  return i;
+}
+
+int main(int argc, char **argv)
+{
+  struct prefix_list *plist;
+  struct prng *prng;
+  struct vty *vty;
+  struct timeval tv_start, tv_lap, tv_stop;
+  unsigned long t_single, t_bulk;
+  unsigned int i, n, count, permits = 0;
+
+  master = thread_master_create();
+  cmd_init(1);
+  prefix_list_init();
+
+  vty = vty_new();
+  vty->type = VTY_TERM;
+  vty->node = CONFIG_NODE;
+  prng = prng_new(0);
+
+  make_list(vty, "perf");
+  plist = prefix_list_lookup(AFI_IP, "perf");
+  count = make_lookups(prng);
+
+  monotime(&tv_start);
+
+  for (n = 0; n < ROUNDS; n++)
+    for (i = 0; i < count; i++)
+      permits += prefix_list_apply(plist, &lookups[i]) == PREFIX_PERMIT;
+
+  monotime(&tv_lap);
+
+  for (n = 0; n < ROUNDS; n++)
+    {
+      prefix_list_apply_bulk(plist, ptrs, count, results);
+      for (i = 0; i < count; i++)
+        permits -= results[i] == PREFIX_PERMIT;
+    }
+
+  monotime(&tv_stop);
+
+  if (permits != 0)
+    abort();
+
+  t_single = elapsed_usec(&tv_start, &tv_lap) / 1000;
+  t_bulk = elapsed_usec(&tv_lap, &tv_stop) / 1000;
+
+  printf("single: Applying %d entries to %u prefixes %d times took "
+         "%ld.%03ld seconds.\n", ENTRIES, count, ROUNDS,
+         t_single/1000, t_single%1000);
+  printf("bulk  : Applying %d entries to %u prefixes %d times took "
+         "%ld.%03ld seconds.\n", ENTRIES, count, ROUNDS,
+         t_bulk/1000, t_bulk%1000);
+  fflush(stdout);
+
+  prng_free(prng);
+  return 0;
+}
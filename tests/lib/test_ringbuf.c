@@ -0,0 +1,148 @@
+/*
+ * Ring buffer tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <ringbuf.h>
+#include <network.h>
+#include <thread.h>
+
+struct thread_master *master;
+
+#define BUFSIZE 64
+
+static void
+test_put_get (void)
+{
+  struct ringbuf *buf = ringbuf_new (BUFSIZE);
+  u_char in[BUFSIZE * 2], out[BUFSIZE * 2];
+  unsigned int i, round;
+
+  for (i = 0; i < sizeof (in); i++)
+    in[i] = i;
+
+  assert (ringbuf_remain (buf) == 0);
+  assert (ringbuf_space (buf) == BUFSIZE);
+
+  /* can't overfill */
+  assert (ringbuf_put (buf, in, sizeof (in)) == BUFSIZE);
+  assert (ringbuf_space (buf) == 0);
+  assert (ringbuf_put (buf, in, 1) == 0);
+  assert (ringbuf_get (buf, out, sizeof (out)) == BUFSIZE);
+  assert (!memcmp (in, out, BUFSIZE));
+  assert (ringbuf_remain (buf) == 0);
+  printf ("Verified filling and draining\n");
+
+  /* walk the start around the end of the buffer a few times */
+  for (round = 0; round < 3 * BUFSIZE; round++)
+    {
+      assert (ringbuf_put (buf, in, 3) == 3);
+      assert (ringbuf_put (buf, in + 3, 40) == 40);
+      assert (ringbuf_get (buf, out, 17) == 17);
+      assert (ringbuf_get (buf, out + 17, 26) == 26);
+      assert (!memcmp (in, out, 43));
+      /* leave one byte behind so start keeps moving */
+      assert (ringbuf_put (buf, in, 1) == 1);
+      assert (ringbuf_get (buf, out, 1) == 1);
+    }
+  printf ("Verified wrapping around\n");
+
+  ringbuf_reset (buf);
+  assert (ringbuf_remain (buf) == 0);
+  assert (ringbuf_get (buf, out, 1) == 0);
+  ringbuf_del (buf);
+}
+
+static void
+test_peek_copy (void)
+{
+  struct ringbuf *a = ringbuf_new (BUFSIZE), *b = ringbuf_new (BUFSIZE);
+  u_char in[BUFSIZE], out[BUFSIZE];
+  unsigned int i;
+
+  for (i = 0; i < sizeof (in); i++)
+    in[i] = 0xff - i;
+
+  /* push start past the middle so the data wraps */
+  ringbuf_put (a, in, 50);
+  ringbuf_get (a, out, 49);
+  ringbuf_put (a, in, 40);
+  assert (ringbuf_remain (a) == 41);
+
+  assert (ringbuf_peek (a, 1, out, sizeof (out)) == 40);
+  assert (!memcmp (in, out, 40));
+  assert (ringbuf_peek (a, 41, out, 1) == 0);
+  assert (ringbuf_remain (a) == 41);
+  printf ("Verified peeking\n");
+
+  ringbuf_put (b, in, 30);
+  assert (ringbuf_copy (b, a, BUFSIZE) == BUFSIZE - 30);
+  assert (ringbuf_remain (a) == 41 - (BUFSIZE - 30));
+  assert (ringbuf_get (b, out, 30) == 30);
+  assert (ringbuf_get (b, out, 1) == 1 && out[0] == in[49]);
+  assert (ringbuf_get (b, out, BUFSIZE) == BUFSIZE - 31);
+  assert (!memcmp (in, out, BUFSIZE - 31));
+  printf ("Verified copying\n");
+
+  ringbuf_del (a);
+  ringbuf_del (b);
+}
+
+static void
+test_read_try (void)
+{
+  struct ringbuf *buf = ringbuf_new (BUFSIZE);
+  u_char in[BUFSIZE], out[BUFSIZE];
+  int fds[2];
+  unsigned int i;
+
+  for (i = 0; i < sizeof (in); i++)
+    in[i] = i * 7;
+
+  assert (pipe (fds) == 0);
+  set_nonblocking (fds[0]);
+
+  assert (ringbuf_read_try (buf, fds[0]) == -2);
+
+  /* wrap the free space so it takes both iovecs */
+  ringbuf_put (buf, in, 40);
+  ringbuf_get (buf, out, 40);
+  assert (write (fds[1], in, BUFSIZE) == BUFSIZE);
+  assert (ringbuf_read_try (buf, fds[0]) == BUFSIZE);
+  assert (ringbuf_read_try (buf, fds[0]) == -1);
+  assert (ringbuf_get (buf, out, BUFSIZE) == BUFSIZE);
+  assert (!memcmp (in, out, BUFSIZE));
+
+  close (fds[1]);
+  assert (ringbuf_read_try (buf, fds[0]) == 0);
+  close (fds[0]);
+  printf ("Verified reading from a file descriptor\n");
+
+  ringbuf_del (buf);
+}
+
+int
+main (void)
+{
+  test_put_get ();
+  test_peek_copy ();
+  test_read_try ();
+  return 0;
+}
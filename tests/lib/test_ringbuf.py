@@ -0,0 +1,10 @@
+import frrtest
+
+class TestRingbuf(frrtest.TestMultiOut):
+    program = './test_ringbuf'
+
+TestRingbuf.onesimple('Verified filling and draining')
+TestRingbuf.onesimple('Verified wrapping around')
+TestRingbuf.onesimple('Verified peeking')
+TestRingbuf.onesimple('Verified copying')
+TestRingbuf.onesimple('Verified reading from a file descriptor')
@@ -0,0 +1,343 @@
+/*
+ * Route-map result cache tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "memory.h"
+#include "plist.h"
+#include "prefix.h"
+#include "routemap.h"
+#include "thread.h"
+#include "vty.h"
+
+#include "config_cmd.h"
+
+struct thread_master *master;
+
+static struct vty *vty;
+
+/* How often the match clause was evaluated, and how many references the
+ * caches hold on the keys. */
+static unsigned long matches;
+static long held[4];
+
+static int keys[4];
+
+static route_map_result_t
+test_match_prefix_list (void *rule, struct prefix *prefix,
+			route_map_object_t type, void *object)
+{
+  struct route_map_list_ref *ref = rule;
+
+  matches++;
+  if (ref->generation != route_map_generation ())
+    {
+      ref->list = prefix_list_lookup (AFI_IP, ref->name);
+      ref->generation = route_map_generation ();
+    }
+  if (ref->list == NULL)
+    return RMAP_NOMATCH;
+
+  return (prefix_list_apply (ref->list, prefix) == PREFIX_DENY ?
+	  RMAP_NOMATCH : RMAP_MATCH);
+}
+
+static struct route_map_rule_cmd test_match_prefix_list_cmd =
+{
+  "ip address prefix-list",
+  test_match_prefix_list,
+  route_map_list_ref_compile,
+  route_map_list_ref_free,
+  RMAP_RULE_CACHEABLE
+};
+
+static route_map_result_t
+test_set_metric (void *rule, struct prefix *prefix,
+		 route_map_object_t type, void *object)
+{
+  return RMAP_OKAY;
+}
+
+static struct route_map_rule_cmd test_set_metric_cmd =
+{
+  "metric",
+  test_set_metric,
+  NULL,
+  NULL
+};
+
+static void
+key_hold (void *key)
+{
+  held[(int *) key - keys]++;
+}
+
+static void
+key_release (void *key)
+{
+  held[(int *) key - keys]--;
+  assert (held[(int *) key - keys] >= 0);
+}
+
+static long
+held_total (void)
+{
+  return held[0] + held[1] + held[2] + held[3];
+}
+
+static void
+make_prefix (struct prefix *p, unsigned int net, unsigned int i)
+{
+  memset (p, 0, sizeof (*p));
+  p->family = AF_INET;
+  p->prefixlen = 24;
+  p->u.prefix4.s_addr = htonl (net << 24 | i << 8);
+}
+
+#define PREFIXES 1000
+
+/* Apply map to PREFIXES each out of 10/8 and 20/8, for each key, and
+ * check the results. */
+static void
+apply_all (struct route_map *map, route_map_result_t want10,
+	   route_map_result_t want20)
+{
+  struct prefix p;
+  unsigned int i, k;
+
+  for (k = 0; k < array_size (keys); k++)
+    for (i = 0; i < PREFIXES; i++)
+      {
+	make_prefix (&p, 10, i);
+	assert (route_map_apply_cached (map, &p, RMAP_BGP, NULL, &keys[k])
+		== want10);
+	make_prefix (&p, 20, i);
+	assert (route_map_apply_cached (map, &p, RMAP_BGP, NULL, &keys[k])
+		== want20);
+      }
+}
+
+static void
+test_cache (void)
+{
+  struct route_map *map;
+
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "ip prefix-list PL seq 5 permit 10.0.0.0/8 le 32");
+  config_cmd (vty, "route-map CACHE permit 10");
+  config_cmd (vty, "match ip address prefix-list PL");
+
+  map = route_map_lookup_by_name ("CACHE");
+  assert (map && route_map_cacheable (map));
+
+  /* Every (key, prefix) is evaluated once, and then comes from the
+   * cache, which keeps a reference on each key. */
+  matches = 0;
+  apply_all (map, RMAP_MATCH, RMAP_DENYMATCH);
+  assert (matches == 2 * PREFIXES * array_size (keys));
+  assert (held_total () == (long) matches);
+  apply_all (map, RMAP_MATCH, RMAP_DENYMATCH);
+  assert (matches == 2 * PREFIXES * array_size (keys));
+
+  /* Changing the prefix-list drops everything cached. */
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "ip prefix-list PL seq 10 permit 20.0.0.0/8 le 32");
+  matches = 0;
+  apply_all (map, RMAP_MATCH, RMAP_MATCH);
+  assert (matches == 2 * PREFIXES * array_size (keys));
+  assert (held_total () == (long) matches);
+
+  /* So does changing the map; with a set clause it can't be cached. */
+  config_cmd (vty, "route-map CACHE permit 10");
+  config_cmd (vty, "set metric 10");
+  assert (!route_map_cacheable (map));
+  assert (held_total () == 0);
+  matches = 0;
+  apply_all (map, RMAP_OKAY, RMAP_OKAY);
+  apply_all (map, RMAP_OKAY, RMAP_OKAY);
+  assert (matches == 4 * PREFIXES * array_size (keys));
+
+  config_cmd (vty, "no set metric");
+  assert (route_map_cacheable (map));
+
+  /* A later sequence that is reached with on-match next. */
+  config_cmd (vty, "on-match next");
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "route-map CACHE deny 20");
+  config_cmd (vty, "match ip address prefix-list PL");
+  matches = 0;
+  apply_all (map, RMAP_DENYMATCH, RMAP_DENYMATCH);
+  assert (matches == 4 * PREFIXES * array_size (keys));
+  apply_all (map, RMAP_DENYMATCH, RMAP_DENYMATCH);
+  assert (matches == 4 * PREFIXES * array_size (keys));
+
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "no route-map CACHE deny 20");
+  config_cmd (vty, "route-map CACHE permit 10");
+  config_cmd (vty, "no on-match next");
+  apply_all (map, RMAP_MATCH, RMAP_MATCH);
+
+  printf ("Verified route-map cache\n");
+}
+
+/* ROUTE_MAP_CACHE_MAX, and how many results are looked up again and
+ * again while ever more new ones push through the cache. */
+#define CACHE_MAX 65536
+#define HOT 1000
+#define ROUNDS 20
+#define COLD 10000
+
+static void
+test_eviction (void)
+{
+  struct route_map *map;
+  struct prefix p;
+  unsigned int i, n, c;
+  long before = held_total ();
+
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "ip prefix-list BIG seq 5 permit 10.0.0.0/8 le 32");
+  config_cmd (vty, "route-map BIG permit 10");
+  config_cmd (vty, "match ip address prefix-list BIG");
+
+  map = route_map_lookup_by_name ("BIG");
+  assert (map && route_map_cacheable (map));
+  assert (!route_map_prefix_independent (map));
+
+  /* The hot results stay cached, even though the cold ones go round the
+   * cache several times; only the cold ones are evaluated again. */
+  matches = 0;
+  for (n = 0; n < ROUNDS; n++)
+    {
+      for (i = 0; i < HOT; i++)
+	{
+	  make_prefix (&p, 10, i);
+	  assert (route_map_apply_cached (map, &p, RMAP_BGP, NULL, &keys[0])
+		  == RMAP_MATCH);
+	}
+      for (i = 0; i < COLD; i++)
+	{
+	  c = n * COLD + i;
+	  make_prefix (&p, 20 + 10 * (c / 3 % 2), c / 6);
+	  assert (route_map_apply_cached (map, &p, RMAP_BGP, NULL,
+					  &keys[1 + c % 3])
+		  == RMAP_DENYMATCH);
+	}
+    }
+  assert (matches == HOT + ROUNDS * COLD);
+
+  /* And the cache stops growing when it is full. */
+  assert (held_total () - before == CACHE_MAX);
+
+  config_cmd (vty, "no route-map BIG");
+  config_cmd (vty, "no ip prefix-list BIG");
+  assert (held_total () == before);
+
+  printf ("Verified route-map cache eviction\n");
+}
+
+/* A map that treats all prefixes alike keeps one result per key and
+ * address family. */
+static void
+test_prefix_independent (void)
+{
+  struct route_map *map;
+  long before = held_total ();
+
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "route-map ALL permit 10");
+
+  map = route_map_lookup_by_name ("ALL");
+  assert (map && route_map_cacheable (map));
+  assert (route_map_prefix_independent (map));
+
+  apply_all (map, RMAP_MATCH, RMAP_MATCH);
+  assert (held_total () - before == (long) array_size (keys));
+
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "no route-map ALL");
+  assert (held_total () == before);
+
+  printf ("Verified prefix-independent route-map cache\n");
+}
+
+static void
+test_references (void)
+{
+  struct route_map *map, *outer;
+  struct prefix p;
+
+  map = route_map_lookup_by_name ("CACHE");
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "route-map OUTER permit 10");
+  config_cmd (vty, "call CACHE");
+  outer = route_map_lookup_by_name ("OUTER");
+  assert (outer && !route_map_cacheable (outer));
+
+  make_prefix (&p, 30, 1);
+  assert (route_map_apply (outer, &p, RMAP_BGP, NULL) == RMAP_DENYMATCH);
+  make_prefix (&p, 20, 1);
+  assert (route_map_apply (outer, &p, RMAP_BGP, NULL) == RMAP_MATCH);
+
+  /* The prefix-list goes away under the map, and comes back anew. */
+  vty->node = CONFIG_NODE;
+  config_cmd (vty, "no ip prefix-list PL");
+  apply_all (map, RMAP_DENYMATCH, RMAP_DENYMATCH);
+  config_cmd (vty, "ip prefix-list PL seq 5 permit 20.0.0.0/8 le 32");
+  apply_all (map, RMAP_DENYMATCH, RMAP_MATCH);
+
+  /* As does the route-map that is called. */
+  config_cmd (vty, "no route-map CACHE");
+  assert (held_total () == 0);
+  assert (route_map_apply (outer, &p, RMAP_BGP, NULL) == RMAP_MATCH);
+  config_cmd (vty, "route-map CACHE deny 10");
+  assert (route_map_apply (outer, &p, RMAP_BGP, NULL) == RMAP_DENYMATCH);
+
+  printf ("Verified route-map list references\n");
+}
+
+int
+main (void)
+{
+  master = thread_master_create ();
+  cmd_init (1);
+  prefix_list_init ();
+  route_map_init ();
+  route_map_match_ip_address_prefix_list_hook (generic_match_add);
+  route_map_set_metric_hook (generic_set_add);
+  route_map_no_set_metric_hook (generic_set_delete);
+  route_map_install_match (&test_match_prefix_list_cmd);
+  route_map_install_set (&test_set_metric_cmd);
+  route_map_cache_key_hooks (key_hold, key_release);
+
+  vty = vty_new ();
+  vty->type = VTY_TERM;
+
+  test_cache ();
+  test_eviction ();
+  test_prefix_independent ();
+  test_references ();
+
+  route_map_finish ();
+  assert (held_total () == 0);
+  return 0;
+}
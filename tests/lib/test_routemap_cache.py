@@ -0,0 +1,9 @@
+import frrtest
+
+class TestRoutemapCache(frrtest.TestMultiOut):
+    program = './test_routemap_cache'
+
+TestRoutemapCache.onesimple('Verified route-map cache')
+TestRoutemapCache.onesimple('Verified route-map cache eviction')
+TestRoutemapCache.onesimple('Verified prefix-independent route-map cache')
+TestRoutemapCache.onesimple('Verified route-map list references')
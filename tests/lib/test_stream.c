@@ -48,6 +48,56 @@ print_stream (struct stream *s)
   stream_set_getp (s, getp);
 }
 
+static void
+test_ref (void)
+{
+  struct stream *s, *ref;
+
+  printf ("\nshared streams\n");
+
+  s = stream_new (1024);
+  stream_putl (s, 0xdeadbeef);
+  stream_putl (s, 0xcafef00d);
+
+  ref = stream_ref (s);
+  printf ("same data: %s\n", STREAM_DATA (ref) == STREAM_DATA (s) ? "yes" : "no");
+
+  /* each stream reads on its own */
+  printf ("ref l: 0x%x\n", stream_getl (ref));
+  printf ("s l: 0x%x\n", stream_getl (s));
+  printf ("s l: 0x%x\n", stream_getl (s));
+
+  /* and the data stays around until the last one goes */
+  stream_free (s);
+  print_stream (ref);
+  stream_free (ref);
+}
+
+static void
+test_pool (void)
+{
+  struct stream *s;
+  u_char *data;
+
+  printf ("\nstream pools\n");
+
+  s = stream_new (4096);
+  data = STREAM_DATA (s);
+  stream_free (s);
+
+  /* a freed buffer of the same size class gets reused */
+  s = stream_new (4000);
+  printf ("reused: %s\n", STREAM_DATA (s) == data ? "yes" : "no");
+  printf ("size: %zu\n", STREAM_SIZE (s));
+
+  /* growing within the size class keeps the buffer */
+  stream_putl (s, 0xdeadbeef);
+  stream_resize (s, 4096);
+  printf ("kept: %s\n", STREAM_DATA (s) == data ? "yes" : "no");
+  print_stream (s);
+  stream_free (s);
+}
+
 int
 main (void)
 {
@@ -70,6 +120,11 @@ main (void)
   printf ("w: 0x%hx\n", stream_getw (s));
   printf ("l: 0x%x\n", stream_getl (s));
   printf ("q: 0x%" PRIx64 "\n", stream_getq (s));
-  
+
+  stream_free (s);
+
+  test_ref ();
+  test_pool ();
+
   return 0;
 }
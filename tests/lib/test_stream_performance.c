@@ -0,0 +1,99 @@
+/*
+ * Test how long it takes to allocate and free streams from the buffer
+ * pools, and to hand one packet to many consumers with stream_dup()
+ * versus stream_ref().
+ *
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "stream.h"
+#include "thread.h"
+
+#define PACKETS 200000
+#define FANOUT 32
+
+struct thread_master *master;
+
+static unsigned long elapsed_usec(struct timeval *from, struct timeval *to)
+{
+  return 1000000 * (to->tv_sec - from->tv_sec) + to->tv_usec - from->tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+  struct timeval tv_start, tv_new, tv_dup, tv_ref;
+  struct stream *s, *copies[FANOUT];
+  unsigned long t_new, t_dup, t_ref;
+  unsigned int i, j;
+
+  monotime(&tv_start);
+
+  for (i = 0; i < PACKETS; i++)
+    {
+      s = stream_new(4096);
+      stream_putl(s, i);
+      stream_free(s);
+    }
+
+  monotime(&tv_new);
+
+  s = stream_new(4096);
+  stream_put(s, NULL, 1024);
+
+  for (i = 0; i < PACKETS / FANOUT; i++)
+    {
+      for (j = 0; j < FANOUT; j++)
+        copies[j] = stream_dup(s);
+      for (j = 0; j < FANOUT; j++)
+        stream_free(copies[j]);
+    }
+
+  monotime(&tv_dup);
+
+  for (i = 0; i < PACKETS / FANOUT; i++)
+    {
+      for (j = 0; j < FANOUT; j++)
+        copies[j] = stream_ref(s);
+      for (j = 0; j < FANOUT; j++)
+        stream_free(copies[j]);
+    }
+
+  monotime(&tv_ref);
+  stream_free(s);
+
+  t_new = elapsed_usec(&tv_start, &tv_new) / 1000;
+  t_dup = elapsed_usec(&tv_new, &tv_dup) / 1000;
+  t_ref = elapsed_usec(&tv_dup, &tv_ref) / 1000;
+
+  printf("new/free: Allocating %d streams took %ld.%03ld seconds.\n",
+         PACKETS, t_new/1000, t_new%1000);
+  printf("dup     : Sending %d 1k packets to %d consumers took "
+         "%ld.%03ld seconds.\n", PACKETS / FANOUT, FANOUT,
+         t_dup/1000, t_dup%1000);
+  printf("ref     : Sending %d 1k packets to %d consumers took "
+         "%ld.%03ld seconds.\n", PACKETS / FANOUT, FANOUT,
+         t_ref/1000, t_ref%1000);
+  fflush(stdout);
+
+  return 0;
+}
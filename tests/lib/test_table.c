@@ -23,6 +23,7 @@
 
 #include "prefix.h"
 #include "table.h"
+#include "prng.h"
 
 /*
  * test_node_t
@@ -532,6 +533,347 @@ test_iter_pause (void)
   route_table_finish (table);
 }
 
+/*
+ * random_prefix
+ *
+ * Make up an IPv4 prefix with a length somewhere between /8 and /32,
+ * favouring the lengths seen in a full table.
+ */
+static void
+random_prefix (struct prng *prng, struct prefix_ipv4 *p)
+{
+  static const u_char lens[] = { 8, 12, 16, 19, 20, 21, 22, 23, 24, 24, 24,
+				 24, 24, 24, 28, 32 };
+
+  memset (p, 0, sizeof (*p));
+  p->family = AF_INET;
+  p->prefixlen = lens[prng_rand (prng) % array_size (lens)];
+  p->prefix.s_addr = htonl (prng_rand (prng));
+  apply_mask_ipv4 (p);
+}
+
+/*
+ * random_host
+ */
+static void
+random_host (struct prng *prng, struct prefix_ipv4 *p)
+{
+  memset (p, 0, sizeof (*p));
+  p->family = AF_INET;
+  p->prefixlen = IPV4_MAX_BITLEN;
+  p->prefix.s_addr = htonl (prng_rand (prng));
+}
+
+/*
+ * verify_stride_lookups
+ *
+ * Check that a table with a stride index returns the same nodes as walking
+ * the tree from the top would, for exact and longest-prefix lookups.
+ */
+static void
+verify_stride_lookups (struct route_table *table, struct route_table *plain,
+		       struct prng *prng, unsigned int count)
+{
+  struct prefix_ipv4 p;
+  struct route_node *rn, *prn;
+  unsigned int i;
+
+  for (i = 0; i < count; i++)
+    {
+      if (i % 2)
+	random_prefix (prng, &p);
+      else
+	random_host (prng, &p);
+
+      rn = route_node_match (table, (struct prefix *) &p);
+      prn = route_node_match (plain, (struct prefix *) &p);
+      assert (!rn == !prn);
+      if (rn)
+	{
+	  assert (prefix_same (&rn->p, &prn->p));
+	  route_unlock_node (rn);
+	  route_unlock_node (prn);
+	}
+
+      rn = route_node_lookup (table, (struct prefix *) &p);
+      prn = route_node_lookup (plain, (struct prefix *) &p);
+      assert (!rn == !prn);
+      if (rn)
+	{
+	  route_unlock_node (rn);
+	  route_unlock_node (prn);
+	}
+    }
+}
+
+/*
+ * test_stride_index
+ *
+ * Fill a table using the stride delegate and an ordinary one with the same
+ * prefixes, delete half of them again, and compare lookups along the way.
+ */
+static void
+test_stride_index (void)
+{
+  struct route_table *table, *plain;
+  struct prng *prng, *lookups;
+  struct prefix_ipv4 p;
+  struct route_node *rn;
+  static int dummy;
+  unsigned int i;
+
+  printf ("\n\nTesting lookups through the stride index\n");
+
+  table = route_table_init_with_delegate (route_table_get_stride_delegate ());
+  plain = route_table_init ();
+  prng = prng_new (0);
+  lookups = prng_new (1);
+
+  for (i = 0; i < 20000; i++)
+    {
+      random_prefix (prng, &p);
+      rn = route_node_get (table, (struct prefix *) &p);
+      if (rn->info)
+	route_unlock_node (rn);
+      rn->info = &dummy;
+      rn = route_node_get (plain, (struct prefix *) &p);
+      if (rn->info)
+	route_unlock_node (rn);
+      rn->info = &dummy;
+    }
+  /* A default route, so that every lookup has a match above the index. */
+  memset (&p, 0, sizeof (p));
+  p.family = AF_INET;
+  rn = route_node_get (table, (struct prefix *) &p);
+  rn->info = &dummy;
+  rn = route_node_get (plain, (struct prefix *) &p);
+  rn->info = &dummy;
+
+  assert (table->stride_index);
+  assert (route_table_count (table) == route_table_count (plain));
+  verify_stride_lookups (table, plain, lookups, 100000);
+
+  /* Delete every other route, default included, in both tables. */
+  i = 0;
+  for (rn = route_top (plain); rn; rn = route_next (rn))
+    {
+      struct route_node *srn;
+
+      if (!rn->info || i++ % 2)
+	continue;
+
+      srn = route_node_lookup (table, &rn->p);
+      assert (srn);
+      srn->info = NULL;
+      route_unlock_node (srn);
+      route_unlock_node (srn);
+
+      rn->info = NULL;
+      route_unlock_node (rn);
+    }
+
+  assert (route_table_count (table) == route_table_count (plain));
+  verify_stride_lookups (table, plain, lookups, 100000);
+
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  for (rn = route_top (plain); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  assert (route_table_count (table) == 0);
+  assert (route_table_count (plain) == 0);
+
+  route_table_finish (table);
+  route_table_finish (plain);
+  prng_free (prng);
+  prng_free (lookups);
+
+  printf ("Verified stride index lookups\n");
+}
+
+/*
+ * test_get_batch
+ *
+ * Add runs of neighbouring prefixes, as an UPDATE would carry them, in
+ * batches to one table and one at a time to another, and check that both
+ * come out with the same tree.
+ */
+static void
+test_get_batch (void)
+{
+  struct route_table *table, *plain;
+  struct prng *prng;
+  struct prefix_ipv4 ps[32];
+  const struct prefix *pp[32];
+  struct route_node *nodes[32];
+  struct route_node *rn, *prn;
+  unsigned int i, j;
+
+  printf ("\n\nTesting adding nodes in batches\n");
+
+  table = route_table_init_with_delegate (route_table_get_stride_delegate ());
+  plain = route_table_init ();
+  prng = prng_new (0);
+
+  for (i = 0; i < 2000; i++)
+    {
+      random_prefix (prng, &ps[0]);
+      for (j = 1; j < array_size (ps); j++)
+	{
+	  ps[j] = ps[0];
+	  if (j % 8 == 0)
+	    random_prefix (prng, &ps[j]);
+	  else if (ps[0].prefixlen > 8)
+	    ps[j].prefix.s_addr =
+	      htonl (ntohl (ps[0].prefix.s_addr)
+		     + (j << (IPV4_MAX_BITLEN - ps[0].prefixlen)));
+	}
+
+      for (j = 0; j < array_size (ps); j++)
+	pp[j] = (struct prefix *) &ps[j];
+      route_node_get_batch (table, pp, nodes, array_size (ps));
+
+      for (j = 0; j < array_size (ps); j++)
+	{
+	  assert (prefix_same (&nodes[j]->p, pp[j]));
+	  if (nodes[j]->info)
+	    route_unlock_node (nodes[j]);
+	  nodes[j]->info = nodes[j];
+
+	  rn = route_node_get (plain, pp[j]);
+	  if (rn->info)
+	    route_unlock_node (rn);
+	  rn->info = rn;
+	}
+    }
+
+  assert (table->stride_index);
+  assert (route_table_count (table) == route_table_count (plain));
+  for (rn = route_top (table), prn = route_top (plain); rn || prn;
+       rn = route_next (rn), prn = route_next (prn))
+    {
+      assert (rn && prn);
+      assert (prefix_same (&rn->p, &prn->p));
+      assert (!rn->info == !prn->info);
+    }
+
+  for (rn = route_top (table); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  for (rn = route_top (plain); rn; rn = route_next (rn))
+    if (rn->info)
+      {
+	rn->info = NULL;
+	route_unlock_node (rn);
+      }
+  assert (route_table_count (table) == 0);
+
+  route_table_finish (table);
+  route_table_finish (plain);
+  prng_free (prng);
+
+  printf ("Verified adding nodes in batches\n");
+}
+
+/*
+ * test_match_batch
+ *
+ * Look up batches of prefixes and addresses of all sizes, across the
+ * batches route_node_match_batch() takes them in, and check that each
+ * comes out with the node route_node_match() finds for it alone.
+ */
+static void
+test_match_batch (void)
+{
+  static const unsigned int sizes[] = { 1, 2, 15, 16, 17, 31, 32, 33, 100 };
+  route_table_delegate_t *delegates[2];
+  struct route_table *table;
+  struct route_node *rn, *one;
+  struct prng *prng;
+  struct prefix_ipv4 p, ps[100];
+  const struct prefix *pp[100];
+  struct route_node *matched[100];
+  static int dummy;
+  unsigned int d, i, j, k, found = 0;
+
+  printf ("\n\nTesting batch lookups\n");
+
+  delegates[0] = route_table_get_default_delegate ();
+  delegates[1] = route_table_get_stride_delegate ();
+  prng = prng_new (0);
+
+  for (d = 0; d < array_size (delegates); d++)
+    {
+      table = route_table_init_with_delegate (delegates[d]);
+
+      /* No default route, so that some lookups find nothing. */
+      for (i = 0; i < 20000; i++)
+	{
+	  random_prefix (prng, &p);
+	  if (p.prefixlen < 12)
+	    continue;
+	  rn = route_node_get (table, (struct prefix *) &p);
+	  if (rn->info)
+	    route_unlock_node (rn);
+	  rn->info = &dummy;
+	}
+
+      for (i = 0; i < 200; i++)
+	{
+	  for (k = 0; k < array_size (sizes); k++)
+	    {
+	      for (j = 0; j < sizes[k]; j++)
+		{
+		  if (prng_rand (prng) % 4 == 0)
+		    random_prefix (prng, &ps[j]);
+		  else
+		    random_host (prng, &ps[j]);
+		  pp[j] = (struct prefix *) &ps[j];
+		}
+
+	      route_node_match_batch (table, pp, matched, sizes[k]);
+
+	      for (j = 0; j < sizes[k]; j++)
+		{
+		  one = route_node_match (table, pp[j]);
+		  assert (matched[j] == one);
+		  if (one)
+		    {
+		      found++;
+		      route_unlock_node (one);
+		      route_unlock_node (matched[j]);
+		    }
+		}
+	    }
+	}
+
+      for (rn = route_top (table); rn; rn = route_next (rn))
+	if (rn->info)
+	  {
+	    rn->info = NULL;
+	    route_unlock_node (rn);
+	  }
+      assert (route_table_count (table) == 0);
+      route_table_finish (table);
+    }
+
+  /* and not all of them missed */
+  assert (found > 0);
+  prng_free (prng);
+
+  printf ("Verified batch lookups\n");
+}
+
 /*
  * run_tests
  */
@@ -541,6 +883,9 @@ run_tests (void)
   test_prefix_iter_cmp ();
   test_get_next ();
   test_iter_pause ();
+  test_stride_index ();
+  test_get_batch ();
+  test_match_batch ();
 }
 
 /*
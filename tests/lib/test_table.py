@@ -8,3 +8,6 @@ for i in range(6):
 for i in range(11):
     TestTable.onesimple('Verifying successor')
 TestTable.onesimple('Verified pausing')
+TestTable.onesimple('Verified stride index lookups')
+TestTable.onesimple('Verified adding nodes in batches')
+TestTable.onesimple('Verified batch lookups')
@@ -0,0 +1,134 @@
+/*
+ * Test how long it takes to look up random addresses in a table of
+ * random IPv4 prefixes one at a time with route_node_match() and in
+ * batches with route_node_match_batch(), on a plain tree and with the
+ * stride index.
+ *
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+
+#include "memory.h"
+#include "prefix.h"
+#include "table.h"
+#include "thread.h"
+#include "prng.h"
+
+#define PREFIXES 250000
+#define LOOKUPS 500000
+#define BATCH 64
+
+struct thread_master *master;
+
+static struct prefix_ipv4 lookups[LOOKUPS];
+static const struct prefix *ptrs[LOOKUPS];
+
+static unsigned long elapsed_usec(struct timeval *from, struct timeval *to)
+{
+  return 1000000 * (to->tv_sec - from->tv_sec) + to->tv_usec - from->tv_usec;
+}
+
+static void run_test(const char *name, route_table_delegate_t *delegate)
+{
+  static int dummy;
+  struct route_table *table;
+  struct route_node *rn, *matched[BATCH];
+  struct prefix_ipv4 p;
+  struct prng *prng;
+  struct timeval tv_start, tv_lap, tv_stop;
+  unsigned long t_single, t_batch;
+  unsigned int i, j, found = 0;
+
+  prng = prng_new(0);
+  table = route_table_init_with_delegate(delegate);
+
+  for (i = 0; i < PREFIXES; i++)
+    {
+      memset(&p, 0, sizeof(p));
+      p.family = AF_INET;
+      p.prefixlen = 8 + prng_rand(prng) % 25;
+      p.prefix.s_addr = prng_rand(prng);
+      apply_mask_ipv4(&p);
+      rn = route_node_get(table, (struct prefix *)&p);
+      if (rn->info)
+        route_unlock_node(rn);
+      rn->info = &dummy;
+    }
+
+  for (i = 0; i < LOOKUPS; i++)
+    {
+      lookups[i].family = AF_INET;
+      lookups[i].prefixlen = IPV4_MAX_BITLEN;
+      lookups[i].prefix.s_addr = prng_rand(prng);
+      ptrs[i] = (struct prefix *)&lookups[i];
+    }
+
+  monotime(&tv_start);
+
+  for (i = 0; i < LOOKUPS; i++)
+    if ((rn = route_node_match(table, ptrs[i])))
+      {
+        found++;
+        route_unlock_node(rn);
+      }
+
+  monotime(&tv_lap);
+
+  for (i = 0; i < LOOKUPS; i += BATCH)
+    {
+      unsigned int n = MIN(BATCH, LOOKUPS - i);
+
+      route_node_match_batch(table, &ptrs[i], matched, n);
+      for (j = 0; j < n; j++)
+        if (matched[j])
+          {
+            found--;
+            route_unlock_node(matched[j]);
+          }
+    }
+
+  monotime(&tv_stop);
+
+  if (found != 0)
+    abort();
+
+  t_single = elapsed_usec(&tv_start, &tv_lap) / 1000;
+  t_batch = elapsed_usec(&tv_lap, &tv_stop) / 1000;
+
+  printf("%s single: Looking up %d addresses in %lu nodes took "
+         "%ld.%03ld seconds.\n", name, LOOKUPS, route_table_count(table),
+         t_single/1000, t_single%1000);
+  printf("%s batch : Looking up %d addresses in %lu nodes took "
+         "%ld.%03ld seconds.\n", name, LOOKUPS, route_table_count(table),
+         t_batch/1000, t_batch%1000);
+  fflush(stdout);
+
+  route_table_finish(table);
+  prng_free(prng);
+}
+
+int main(int argc, char **argv)
+{
+  run_test("Plain tree  ", route_table_get_default_delegate());
+  run_test("Stride index", route_table_get_stride_delegate());
+  return 0;
+}
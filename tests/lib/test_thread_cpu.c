@@ -0,0 +1,186 @@
+/*
+ * Per-thread_master task accounting tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "hash.h"
+#include "monotime.h"
+#include "thread.h"
+
+struct thread_master *master;
+
+#define THREADS 4
+#define EVENTS 10000
+
+static struct thread_master *masters[THREADS];
+
+static int
+dummy_task (struct thread *thread)
+{
+  return 0;
+}
+
+static int
+other_task (struct thread *thread)
+{
+  return 0;
+}
+
+/* Run EVENTS events on the pthread's own master; the last one runs a
+ * different function on every other master. */
+static void *
+run_events (void *arg)
+{
+  struct thread_master *m = arg;
+  struct thread fetch;
+  unsigned int i;
+
+  for (i = 0; i < EVENTS; i++)
+    {
+      thread_add_event (m, dummy_task, NULL, 0, NULL);
+      assert (thread_fetch (m, &fetch));
+      thread_call (&fetch);
+    }
+  if (m == masters[0] || m == masters[2])
+    {
+      thread_add_event (m, other_task, NULL, 0, NULL);
+      assert (thread_fetch (m, &fetch));
+      thread_call (&fetch);
+    }
+  return NULL;
+}
+
+/* Keeps the pthread busy for the given number of msec. */
+static int
+slow_task (struct thread *thread)
+{
+  struct timeval start;
+
+  monotime (&start);
+  while (monotime_since (&start, NULL) < THREAD_VAL (thread) * 1000)
+    ;
+  return 0;
+}
+
+static struct cpu_thread_history *
+lookup (struct thread_master *m, int (*func) (struct thread *))
+{
+  struct cpu_thread_history key;
+
+  key.func = func;
+  return hash_lookup (m->cpu_record, &key);
+}
+
+static void
+test_accounting (void)
+{
+  pthread_t threads[THREADS];
+  struct cpu_thread_history *hist;
+  unsigned long buckets;
+  unsigned int i, j;
+
+  for (i = 0; i < THREADS; i++)
+    masters[i] = thread_master_create ();
+  for (i = 0; i < THREADS; i++)
+    assert (pthread_create (&threads[i], NULL, run_events, masters[i]) == 0);
+  for (i = 0; i < THREADS; i++)
+    pthread_join (threads[i], NULL);
+
+  /* Every master has its own histories, none of them lost a run. */
+  for (i = 0; i < THREADS; i++)
+    {
+      hist = lookup (masters[i], dummy_task);
+      assert (hist && hist->total_calls == EVENTS);
+      assert (hist->total_active == 0);
+      assert (hist->types == (1 << THREAD_EVENT));
+      assert (hist->real.max <= hist->real.total);
+
+      buckets = 0;
+      for (j = 0; j < THREAD_HIST_BUCKETS; j++)
+	buckets += hist->buckets[j];
+      assert (buckets == EVENTS);
+
+      hist = lookup (masters[i], other_task);
+      if (i == 0 || i == 2)
+	assert (hist && hist->total_calls == 1);
+      else
+	assert (hist == NULL);
+    }
+
+  for (i = 0; i < THREADS; i++)
+    thread_master_free (masters[i]);
+
+  printf ("Verified per-master accounting\n");
+}
+
+/* Events and timers that run late are accounted for on both the function
+   and the master, and a task running late is caught while it is still at
+   it. */
+static void
+test_latency (void)
+{
+  struct thread_master *m = thread_master_create ();
+  struct cpu_thread_history *hist;
+  struct thread fetch;
+  struct timespec nap = { 0, 20 * 1000 * 1000 };
+  unsigned long runs = 0;
+  unsigned int i;
+
+  thread_add_event (m, dummy_task, NULL, 0, NULL);
+  nanosleep (&nap, NULL);
+  assert (thread_fetch (m, &fetch));
+  thread_call (&fetch);
+
+  hist = lookup (m, dummy_task);
+  assert (hist->lag_calls == 1 && hist->lag.max >= 20000);
+  assert (m->lag_count == 1 && m->lag.max == hist->lag.max);
+  for (i = 0; i < THREAD_HIST_BUCKETS; i++)
+    runs += m->lag_buckets[i];
+  assert (runs == 1);
+
+  /* Timers are late from when they expire, not when they were added. */
+  thread_add_timer_msec (m, other_task, NULL, 10, NULL);
+  assert (thread_fetch (m, &fetch));
+  thread_call (&fetch);
+  hist = lookup (m, other_task);
+  assert (hist->lag_calls == 1 && hist->lag.max < 10000);
+
+  walltime_warning = 20 * 1000;
+  walltime_backtrace = true;
+  thread_add_event (m, slow_task, NULL, 200, NULL);
+  assert (thread_fetch (m, &fetch));
+  thread_call (&fetch);
+  assert (m->watchdog_start != 0 && m->task_start == 0);
+  walltime_warning = WALLTIME_WARNING_DEFAULT;
+  walltime_backtrace = false;
+
+  thread_master_free (m);
+  printf ("Verified latency accounting\n");
+}
+
+int
+main (void)
+{
+  test_accounting ();
+  test_latency ();
+  return 0;
+}
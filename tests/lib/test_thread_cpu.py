@@ -0,0 +1,7 @@
+import frrtest
+
+class TestThreadCpu(frrtest.TestMultiOut):
+    program = './test_thread_cpu'
+
+TestThreadCpu.onesimple('Verified per-master accounting')
+TestThreadCpu.onesimple('Verified latency accounting')
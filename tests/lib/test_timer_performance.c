@@ -1,6 +1,8 @@
 /*
  * Test program which measures the time it takes to schedule and
- * remove timers.
+ * remove timers, both on the timer heap and on the timer wheel, and
+ * how the cost of a single I/O wakeup scales with the number of idle
+ * file descriptors the event loop watches.
  *
  * Copyright (C) 2013 by Open Source Routing.
  * Copyright (C) 2013 by Internet Systems Consortium, Inc. ("ISC")
@@ -26,7 +28,9 @@
 
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/resource.h>
 
+#include "memory.h"
 #include "thread.h"
 #include "pqueue.h"
 #include "prng.h"
@@ -34,6 +38,8 @@
 #define SCHEDULE_TIMERS 1000000
 #define REMOVE_TIMERS    500000
 
+#define FD_WAKEUPS        10000
+
 struct thread_master *master;
 
 static int dummy_func(struct thread *thread)
@@ -41,15 +47,101 @@ static int dummy_func(struct thread *thread)
   return 0;
 }
 
-int main(int argc, char **argv)
+static int fd_read_func(struct thread *thread)
+{
+  char byte;
+
+  if (read(THREAD_FD(thread), &byte, 1) != 1)
+    abort();
+  thread_add_read(thread->master, fd_read_func, NULL, THREAD_FD(thread), NULL);
+  return 0;
+}
+
+/* Watch npipes idle pipes for reading, then make one of them readable at a
+ * time and measure how long it takes the event loop to dispatch it. */
+static void fd_benchmark(const char *backend, int npipes, bool use_poll)
+{
+  struct thread_master *m;
+  struct thread thread;
+  struct timeval tv_start, tv_stop;
+  unsigned long t_wakeup;
+  int (*pipes)[2];
+  int i;
+
+  m = thread_master_create();
+  if (use_poll)
+    thread_master_use_poll(m);
+  pipes = calloc(npipes, sizeof(*pipes));
+
+  for (i = 0; i < npipes; i++)
+    {
+      if (pipe(pipes[i]) < 0)
+        abort();
+      thread_add_read(m, fd_read_func, NULL, pipes[i][0], NULL);
+    }
+
+  monotime(&tv_start);
+
+  for (i = 0; i < FD_WAKEUPS; i++)
+    {
+      if (write(pipes[i % npipes][1], "x", 1) != 1)
+        abort();
+      if (!thread_fetch(m, &thread))
+        abort();
+      thread_call(&thread);
+    }
+
+  monotime(&tv_stop);
+
+  t_wakeup = 1000000 * (tv_stop.tv_sec - tv_start.tv_sec);
+  t_wakeup += tv_stop.tv_usec - tv_start.tv_usec;
+
+  printf("%-6s: %5d fds, %d wakeups took %ld.%03ld seconds (%lu ns each).\n",
+         backend, npipes, FD_WAKEUPS, t_wakeup / 1000000,
+         (t_wakeup / 1000) % 1000, t_wakeup * 1000 / FD_WAKEUPS);
+  fflush(stdout);
+
+  for (i = 0; i < npipes; i++)
+    {
+      close(pipes[i][0]);
+      close(pipes[i][1]);
+    }
+  free(pipes);
+  thread_master_free(m);
+}
+
+static void fd_benchmarks(void)
+{
+  static const int npipes[] = { 8, 64, 512, 4096 };
+  struct rlimit limit;
+  unsigned i;
+
+  /* leave some room for stdio, the masters' wakeup pipes and the like */
+  getrlimit(RLIMIT_NOFILE, &limit);
+
+  for (i = 0; i < array_size(npipes); i++)
+    {
+      if ((rlim_t)2 * npipes[i] + 32 > limit.rlim_cur)
+        break;
+      fd_benchmark("poll", npipes[i], true);
+#ifdef HAVE_EPOLL
+      fd_benchmark("epoll", npipes[i], false);
+#endif
+    }
+}
+
+/* Schedule, reschedule (as done for holdtimers on every keepalive) and
+ * remove a large number of timers spread out over more than a day. */
+static void timer_benchmark(const char *backend, bool wheel)
 {
   struct prng *prng;
   int i;
   struct thread **timers;
-  struct timeval tv_start, tv_lap, tv_stop;
-  unsigned long t_schedule, t_remove;
+  struct timeval tv_start, tv_lap, tv_lap2, tv_stop;
+  unsigned long t_schedule, t_reschedule, t_remove;
 
   master = thread_master_create();
+  thread_master_set_timer_wheel(master, wheel);
   prng = prng_new(0);
   timers = calloc(SCHEDULE_TIMERS, sizeof(*timers));
 
@@ -76,6 +168,19 @@ int main(int argc, char **argv)
 
   monotime(&tv_lap);
 
+  for (i = 0; i < SCHEDULE_TIMERS; i++)
+    {
+      int index;
+
+      index = prng_rand(prng) % SCHEDULE_TIMERS;
+      if (timers[index])
+        thread_cancel(timers[index]);
+      timers[index] = NULL;
+      thread_add_timer(master, dummy_func, NULL, 90, &timers[index]);
+    }
+
+  monotime(&tv_lap2);
+
   for (i = 0; i < REMOVE_TIMERS; i++)
     {
       int index;
@@ -91,17 +196,30 @@ int main(int argc, char **argv)
   t_schedule = 1000 * (tv_lap.tv_sec - tv_start.tv_sec);
   t_schedule += (tv_lap.tv_usec - tv_start.tv_usec) / 1000;
 
-  t_remove = 1000 * (tv_stop.tv_sec - tv_lap.tv_sec);
-  t_remove += (tv_stop.tv_usec - tv_lap.tv_usec) / 1000;
+  t_reschedule = 1000 * (tv_lap2.tv_sec - tv_lap.tv_sec);
+  t_reschedule += (tv_lap2.tv_usec - tv_lap.tv_usec) / 1000;
 
-  printf("Scheduling %d random timers took %ld.%03ld seconds.\n",
-         SCHEDULE_TIMERS, t_schedule/1000, t_schedule%1000);
-  printf("Removing %d random timers took %ld.%03ld seconds.\n",
-         REMOVE_TIMERS, t_remove/1000, t_remove%1000);
+  t_remove = 1000 * (tv_stop.tv_sec - tv_lap2.tv_sec);
+  t_remove += (tv_stop.tv_usec - tv_lap2.tv_usec) / 1000;
+
+  printf("%-5s: Scheduling %d random timers took %ld.%03ld seconds.\n",
+         backend, SCHEDULE_TIMERS, t_schedule/1000, t_schedule%1000);
+  printf("%-5s: Rescheduling %d random timers took %ld.%03ld seconds.\n",
+         backend, SCHEDULE_TIMERS, t_reschedule/1000, t_reschedule%1000);
+  printf("%-5s: Removing %d random timers took %ld.%03ld seconds.\n",
+         backend, REMOVE_TIMERS, t_remove/1000, t_remove%1000);
   fflush(stdout);
 
   free(timers);
   thread_master_free(master);
   prng_free(prng);
+}
+
+int main(int argc, char **argv)
+{
+  timer_benchmark("heap", false);
+  timer_benchmark("wheel", true);
+
+  fd_benchmarks();
   return 0;
 }
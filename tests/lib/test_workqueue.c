@@ -0,0 +1,195 @@
+/*
+ * Work queue scheduler tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "linklist.h"
+#include "monotime.h"
+#include "thread.h"
+#include "workqueue.h"
+
+struct thread_master *master;
+
+#define ITEMS 20000
+
+static int item;
+static unsigned int completions;
+
+/* queues that are being run */
+static struct work_queue *queues[2];
+
+/* Each item keeps the pthread busy for 20 usec. */
+static wq_item_status
+busy_item (struct work_queue *wq, void *data)
+{
+  struct timeval start;
+
+  monotime (&start);
+  while (monotime_since (&start, NULL) < 20)
+    ;
+  return WQ_SUCCESS;
+}
+
+static wq_item_status
+quick_item (struct work_queue *wq, void *data)
+{
+  return WQ_SUCCESS;
+}
+
+static void
+count_completion (struct work_queue *wq)
+{
+  completions++;
+}
+
+static void
+free_completion (struct work_queue *wq)
+{
+  completions++;
+  if (queues[0] == wq)
+    queues[0] = NULL;
+  if (queues[1] == wq)
+    queues[1] = NULL;
+  work_queue_free (wq);
+}
+
+static struct work_queue *
+queue_new (struct thread_master *m, const char *name, unsigned int weight)
+{
+  struct work_queue *wq = work_queue_new (m, name);
+
+  wq->spec.workfunc = busy_item;
+  wq->spec.completion_func = count_completion;
+  wq->spec.hold = 0;
+  wq->spec.weight = weight;
+  return wq;
+}
+
+/* Run m until the scheduler has run runs times, or the queues have
+ * nothing left to do. */
+static void
+run (struct thread_master *m, unsigned int runs)
+{
+  struct thread fetch;
+
+  while (runs > 0
+         && ((queues[0] && work_queue_is_scheduled (queues[0]))
+             || (queues[1] && work_queue_is_scheduled (queues[1])))
+         && thread_fetch (m, &fetch))
+    {
+      if (fetch.func == work_queue_run)
+        runs--;
+      thread_call (&fetch);
+    }
+}
+
+/* Two queues busy at the same time share the scheduler by weight, and
+ * items are accounted for from being added to being done. */
+static void
+test_weights (void)
+{
+  struct thread_master *m = thread_master_create ();
+  struct work_queue *heavy, *light;
+  double ratio;
+  unsigned int i;
+
+  heavy = queue_new (m, "heavy", 3 * WORK_QUEUE_DEFAULT_WEIGHT);
+  light = queue_new (m, "light", WORK_QUEUE_DEFAULT_WEIGHT);
+  queues[0] = heavy;
+  queues[1] = light;
+  for (i = 0; i < ITEMS; i++)
+    {
+      work_queue_add (heavy, &item);
+      work_queue_add (light, &item);
+    }
+  assert (work_queue_is_scheduled (heavy) && work_queue_is_scheduled (light));
+
+  run (m, 10);
+  assert (heavy->latency.items > 0 && light->latency.items > 0);
+  ratio = (double) heavy->latency.items / light->latency.items;
+  assert (ratio > 1.8 && ratio < 5);
+
+  /* light gets all of the time once heavy is done */
+  run (m, ~0U);
+  assert (heavy->latency.items == ITEMS && light->latency.items == ITEMS);
+  assert (listcount (heavy->items) == 0 && listcount (light->items) == 0);
+  assert (!work_queue_is_scheduled (heavy) && !work_queue_is_scheduled (light));
+  assert (completions == 2);
+  assert (light->latency.max >= heavy->latency.max);
+  assert (light->latency.max >= ITEMS * 2 * 20 / 1000);
+
+  work_queue_free (heavy);
+  work_queue_free (light);
+  thread_master_free (m);
+  printf ("Verified work queue weights\n");
+}
+
+/* Queues can go away from within the scheduler, including the last one on
+ * a master. */
+static void
+test_lifetimes (void)
+{
+  struct thread_master *m = thread_master_create ();
+  struct work_queue *wq, *other;
+  unsigned int i;
+
+  completions = 0;
+  wq = queue_new (m, "self", WORK_QUEUE_DEFAULT_WEIGHT);
+  wq->spec.workfunc = quick_item;
+  wq->spec.completion_func = free_completion;
+  other = queue_new (m, "other", WORK_QUEUE_DEFAULT_WEIGHT);
+  other->spec.workfunc = quick_item;
+  other->spec.completion_func = free_completion;
+  queues[0] = wq;
+  queues[1] = other;
+  for (i = 0; i < 100; i++)
+    {
+      work_queue_add (wq, &item);
+      work_queue_add (other, &item);
+    }
+  run (m, ~0U);
+  assert (completions == 2);
+
+  /* a plugged queue stays put */
+  wq = queue_new (m, "plugged", WORK_QUEUE_DEFAULT_WEIGHT);
+  queues[0] = wq;
+  work_queue_plug (wq);
+  work_queue_add (wq, &item);
+  assert (!work_queue_is_scheduled (wq));
+  run (m, ~0U);
+  assert (listcount (wq->items) == 1);
+  work_queue_unplug (wq);
+  assert (work_queue_is_scheduled (wq));
+  run (m, ~0U);
+  assert (listcount (wq->items) == 0);
+  work_queue_free (wq);
+
+  thread_master_free (m);
+  printf ("Verified work queue lifetimes\n");
+}
+
+int
+main (void)
+{
+  test_weights ();
+  test_lifetimes ();
+  return 0;
+}
@@ -0,0 +1,7 @@
+import frrtest
+
+class TestWorkQueue(frrtest.TestMultiOut):
+    program = './test_workqueue'
+
+TestWorkQueue.onesimple('Verified work queue weights')
+TestWorkQueue.onesimple('Verified work queue lifetimes')
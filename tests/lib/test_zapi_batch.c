@@ -0,0 +1,357 @@
+/*
+ * zapi message framing and ZEBRA_ROUTE_BATCH tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "network.h"
+#include "stream.h"
+#include "zclient.h"
+
+struct thread_master *master;
+
+/* enough to fill a few batches */
+#define MESSAGES 200
+
+/* zebra's per-client budget, kept small so it runs out often */
+#define BUDGET 4
+
+/* Message i carries i, and between 0 and 99 bytes more. */
+static void
+make_message (struct stream *s, unsigned int i)
+{
+  unsigned int pad = i % 100;
+
+  stream_reset (s);
+  zclient_create_header (s, ZEBRA_IPV4_ROUTE_ADD, VRF_DEFAULT);
+  stream_putl (s, i);
+  while (pad--)
+    stream_putc (s, i);
+  stream_putw_at (s, 0, stream_get_endp (s));
+}
+
+/* Message i, length bytes of it, at pos in s. */
+static void
+check_message (struct stream *s, size_t pos, int length, unsigned int i)
+{
+  assert (length == ZEBRA_HEADER_SIZE + 4 + (int) (i % 100));
+  assert (stream_getw_from (s, pos) == length);
+  assert (stream_getw_from (s, pos + 6) == ZEBRA_IPV4_ROUTE_ADD);
+  assert (stream_getl_from (s, pos + ZEBRA_HEADER_SIZE) == i);
+}
+
+/* Take whatever is on the socket, and check it holds the messages from
+ * *next on, in batches.  Returns how many batches there were. */
+static unsigned int
+receive (int sock, struct stream *work, struct stream *msg,
+         unsigned int *next)
+{
+  unsigned int batches = 0;
+  int length;
+  size_t pos;
+
+  stream_reset (work);
+  while (stream_read_try (work, sock, STREAM_WRITEABLE (work)) > 0)
+    ;
+
+  while (zapi_read_next (work, msg) == 1)
+    {
+      assert (stream_getw_from (msg, 6) == ZEBRA_ROUTE_BATCH);
+      batches++;
+      for (pos = ZEBRA_HEADER_SIZE;
+           (length = zapi_batch_next (msg, pos, stream_get_endp (msg))) > 0;
+           pos += length)
+        check_message (msg, pos, length, (*next)++);
+      assert (length == 0);
+    }
+  assert (STREAM_READABLE (work) == 0);
+  return batches;
+}
+
+/* Run the event that sends the batch off. */
+static void
+run_batch (struct zclient *zclient)
+{
+  struct thread thread;
+
+  assert (zclient->t_batch != NULL);
+  assert (thread_fetch (master, &thread) != NULL);
+  thread_call (&thread);
+  assert (zclient->t_batch == NULL);
+}
+
+/* Route messages sent through zclient come out of the socket packed into
+ * ZEBRA_ROUTE_BATCH messages, in order and whole. */
+static void
+test_roundtrip (void)
+{
+  struct zclient *zclient;
+  struct stream *work, *msg;
+  unsigned int i, next = 0, batches;
+  int sv[2];
+  char byte;
+
+  assert (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  set_nonblocking (sv[1]);
+  zclient = zclient_new (master);
+  zclient->sock = sv[0];
+  work = stream_new (4 * ZEBRA_MAX_PACKET_SIZ);
+  msg = stream_new (ZEBRA_MAX_PACKET_SIZ);
+
+  /* Held back until the event, and then all in one. */
+  for (i = 0; i < 10; i++)
+    {
+      make_message (zclient->obuf, i);
+      assert (zclient_send_message (zclient) == 0);
+    }
+  assert (recv (sv[1], &byte, 1, MSG_PEEK) == -1 && errno == EAGAIN);
+  run_batch (zclient);
+  assert (receive (sv[1], work, msg, &next) == 1);
+  assert (next == 10);
+
+  /* Sent when full, and the rest from the event. */
+  for (; i < MESSAGES; i++)
+    {
+      make_message (zclient->obuf, i);
+      assert (zclient_send_message (zclient) == 0);
+    }
+  batches = receive (sv[1], work, msg, &next);
+  assert (batches > 1);
+  assert (next < MESSAGES);
+  run_batch (zclient);
+  assert (receive (sv[1], work, msg, &next) == 1);
+  assert (next == MESSAGES);
+
+  /* Anything else goes after what has been batched so far, right away. */
+  make_message (zclient->obuf, 0);
+  assert (zclient_send_message (zclient) == 0);
+  stream_reset (zclient->obuf);
+  zclient_create_header (zclient->obuf, ZEBRA_HELLO, VRF_DEFAULT);
+  stream_putc (zclient->obuf, ZEBRA_ROUTE_BGP);
+  stream_putw_at (zclient->obuf, 0, stream_get_endp (zclient->obuf));
+  assert (zclient_send_message (zclient) == 0);
+  assert (zclient->t_batch == NULL);
+
+  stream_reset (work);
+  while (stream_read_try (work, sv[1], STREAM_WRITEABLE (work)) > 0)
+    ;
+  assert (zapi_read_next (work, msg) == 1);
+  assert (stream_getw_from (msg, 6) == ZEBRA_ROUTE_BATCH);
+  next = 0;
+  assert (zapi_batch_next (msg, ZEBRA_HEADER_SIZE, stream_get_endp (msg))
+          == ZEBRA_HEADER_SIZE + 4);
+  check_message (msg, ZEBRA_HEADER_SIZE, ZEBRA_HEADER_SIZE + 4, 0);
+  assert (zapi_read_next (work, msg) == 1);
+  assert (stream_getw_from (msg, 6) == ZEBRA_HELLO);
+  assert (zapi_read_next (work, msg) == 0);
+
+  /* One too big for a batch goes out on its own. */
+  stream_reset (zclient->obuf);
+  zclient_create_header (zclient->obuf, ZEBRA_IPV4_ROUTE_ADD, VRF_DEFAULT);
+  while (stream_get_endp (zclient->obuf)
+         <= STREAM_SIZE (zclient->batch) - ZEBRA_HEADER_SIZE)
+    stream_putc (zclient->obuf, 0);
+  stream_putw_at (zclient->obuf, 0, stream_get_endp (zclient->obuf));
+  assert (zclient_send_message (zclient) == 0);
+  assert (zclient->t_batch == NULL);
+
+  stream_reset (work);
+  while (stream_read_try (work, sv[1], STREAM_WRITEABLE (work)) > 0)
+    ;
+  assert (zapi_read_next (work, msg) == 1);
+  assert (stream_getw_from (msg, 6) == ZEBRA_IPV4_ROUTE_ADD);
+  assert (stream_get_endp (msg)
+          == STREAM_SIZE (zclient->batch) - ZEBRA_HEADER_SIZE + 1);
+
+  zclient_free (zclient);
+  stream_free (work);
+  stream_free (msg);
+  close (sv[0]);
+  close (sv[1]);
+
+  printf ("Verified batch round trip\n");
+}
+
+/* A batch of messages 0 and 1, with room for more. */
+static size_t
+make_batch (struct stream *s)
+{
+  struct stream *m = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  unsigned int i;
+
+  stream_reset (s);
+  zclient_create_header (s, ZEBRA_ROUTE_BATCH, VRF_DEFAULT);
+  for (i = 0; i < 2; i++)
+    {
+      make_message (m, i);
+      stream_put (s, STREAM_DATA (m), stream_get_endp (m));
+    }
+  stream_putw_at (s, 0, stream_get_endp (s));
+  stream_free (m);
+  return stream_get_endp (s);
+}
+
+/* What zebra gets may not be what zclient sent: everything from the
+ * first bad message on is refused. */
+static void
+test_malformed (void)
+{
+  struct stream *s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  struct stream *work = stream_new (2 * ZEBRA_MAX_PACKET_SIZ);
+  struct stream *msg = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  size_t end, second = ZEBRA_HEADER_SIZE + ZEBRA_HEADER_SIZE + 4;
+
+  end = make_batch (s);
+  assert (zapi_batch_next (s, ZEBRA_HEADER_SIZE, end)
+          == ZEBRA_HEADER_SIZE + 4);
+  assert (zapi_batch_next (s, second, end) == ZEBRA_HEADER_SIZE + 5);
+  assert (zapi_batch_next (s, end, end) == 0);
+
+  /* Truncated, mid-message and mid-header. */
+  assert (zapi_batch_next (s, second, end - 1) == -1);
+  assert (zapi_batch_next (s, second, second + 3) == -1);
+  stream_put (s, STREAM_DATA (s) + second, 3);
+  assert (zapi_batch_next (s, end, end + 3) == -1);
+
+  /* Longer than what is left, or shorter than its own header. */
+  stream_putw_at (s, second, 0xffff);
+  assert (zapi_batch_next (s, second, end) == -1);
+  stream_putw_at (s, second, ZEBRA_HEADER_SIZE - 1);
+  assert (zapi_batch_next (s, second, end) == -1);
+
+  /* Not a zapi header at all. */
+  end = make_batch (s);
+  stream_putc_at (s, second + 2, 0);
+  assert (zapi_batch_next (s, second, end) == -1);
+  end = make_batch (s);
+  stream_putc_at (s, second + 3, ZSERV_VERSION + 1);
+  assert (zapi_batch_next (s, second, end) == -1);
+
+  /* Off the socket: bits of a good message are left for the next read,
+   * one too big for the buffer or with a bad header is refused. */
+  end = make_batch (s);
+  stream_reset (work);
+  stream_put (work, STREAM_DATA (s), ZEBRA_HEADER_SIZE - 1);
+  assert (zapi_read_next (work, msg) == 0);
+  stream_put (work, STREAM_DATA (s) + ZEBRA_HEADER_SIZE - 1, end - 1
+              - (ZEBRA_HEADER_SIZE - 1));
+  assert (zapi_read_next (work, msg) == 0);
+  assert (stream_get_getp (work) == 0);
+  assert (! zapi_read_ready (work));
+  stream_putc (work, STREAM_DATA (s)[end - 1]);
+  assert (zapi_read_ready (work));
+  assert (zapi_read_next (work, msg) == 1);
+  assert (stream_get_endp (msg) == end);
+  assert (memcmp (STREAM_DATA (msg), STREAM_DATA (s), end) == 0);
+
+  stream_reset (work);
+  zclient_create_header (work, ZEBRA_IPV4_ROUTE_ADD, VRF_DEFAULT);
+  stream_putw_at (work, 0, STREAM_SIZE (msg) + 1);
+  while (STREAM_WRITEABLE (work))
+    stream_putc (work, 0);
+  assert (zapi_read_next (work, msg) == -1);
+
+  stream_reset (work);
+  stream_put (work, STREAM_DATA (s), end);
+  stream_putc_at (work, 3, ZSERV_VERSION + 1);
+  assert (zapi_read_next (work, msg) == -1);
+
+  stream_free (s);
+  stream_free (work);
+  stream_free (msg);
+
+  printf ("Verified malformed batches\n");
+}
+
+/* zebra_client_read's loop: each go reads what it can, acts on up to
+ * BUDGET whole messages, and either comes straight back if whole ones are
+ * left over or waits for the socket to have more. */
+static void
+test_budget (void)
+{
+  struct stream *wire = stream_new (MESSAGES * (ZEBRA_HEADER_SIZE + 4 + 99));
+  struct stream *work = stream_new (2 * ZEBRA_MAX_PACKET_SIZ);
+  struct stream *msg = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  unsigned int i, next = 0, packets, reads = 0;
+  unsigned int resumed = 0, waited_partial = 0;
+  size_t chunk;
+  int ret;
+
+  for (i = 0; i < MESSAGES; i++)
+    {
+      make_message (msg, i);
+      stream_put (wire, STREAM_DATA (msg), stream_get_endp (msg));
+    }
+
+  while (next < MESSAGES)
+    {
+      /* The socket gives up anything from 1 to 500 bytes at a time,
+       * whatever the framing. */
+      chunk = 1 + (reads++ * 131) % 500;
+      chunk = MIN (chunk, STREAM_READABLE (wire));
+      chunk = MIN (chunk, STREAM_WRITEABLE (work));
+      stream_put (work, STREAM_PNT (wire), chunk);
+      stream_forward_getp (wire, chunk);
+
+      for (packets = 0; packets < BUDGET; packets++)
+        {
+          ret = zapi_read_next (work, msg);
+          if (ret == 0)
+            break;
+          assert (ret == 1);
+          check_message (msg, 0, stream_get_endp (msg), next++);
+        }
+
+      stream_pulldown (work);
+
+      if (packets == BUDGET && zapi_read_ready (work))
+        resumed++;
+      else
+        {
+          /* Waiting on the socket, so nothing whole may be left behind. */
+          assert (! zapi_read_ready (work));
+          if (STREAM_READABLE (work))
+            waited_partial++;
+        }
+    }
+
+  assert (STREAM_READABLE (wire) == 0);
+  assert (STREAM_READABLE (work) == 0);
+  assert (resumed > 0);
+  assert (waited_partial > 0);
+
+  stream_free (wire);
+  stream_free (work);
+  stream_free (msg);
+
+  printf ("Verified read budget\n");
+}
+
+int
+main (void)
+{
+  master = thread_master_create ();
+
+  test_roundtrip ();
+  test_malformed ();
+  test_budget ();
+  return 0;
+}
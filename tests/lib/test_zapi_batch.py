@@ -0,0 +1,8 @@
+import frrtest
+
+class TestZapiBatch(frrtest.TestMultiOut):
+    program = './test_zapi_batch'
+
+TestZapiBatch.onesimple('Verified batch round trip')
+TestZapiBatch.onesimple('Verified malformed batches')
+TestZapiBatch.onesimple('Verified read budget')
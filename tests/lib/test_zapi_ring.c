@@ -0,0 +1,190 @@
+/*
+ * zapi shared memory ring tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+#include <poll.h>
+
+#include "network.h"
+#include "stream.h"
+#include "zclient.h"
+#include "zapi_ring.h"
+
+struct thread_master *master;
+
+/* enough to go round the ring a few times */
+#define MESSAGES 50000
+
+static struct zapi_ring *producer, *consumer;
+
+/* Message i carries i, and between 0 and 99 bytes more. */
+static void
+make_message (struct stream *s, unsigned int i)
+{
+  unsigned int pad = i % 100;
+
+  stream_reset (s);
+  zclient_create_header (s, ZEBRA_IPV4_ROUTE_ADD, VRF_DEFAULT);
+  stream_putl (s, i);
+  while (pad--)
+    stream_putc (s, i);
+  stream_putw_at (s, 0, stream_get_endp (s));
+}
+
+static void
+check_message (struct stream *s, unsigned int i)
+{
+  assert (stream_get_endp (s) == ZEBRA_HEADER_SIZE + 4 + i % 100);
+  assert (stream_getw_from (s, 6) == ZEBRA_IPV4_ROUTE_ADD);
+  assert (stream_getl_from (s, ZEBRA_HEADER_SIZE) == i);
+}
+
+/* The producer hands the ring to the consumer over a socket, as zclient
+ * does to zebra. */
+static void
+test_handover (void)
+{
+  struct stream *s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  int sv[2], fds[2] = { -1, -1 };
+
+  assert (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+  producer = zapi_ring_create (ZAPI_RING_SIZE);
+  if (!producer)
+    {
+      /* No memfd or eventfd here; nothing else to test. */
+      printf ("Verified ring handover\n");
+      printf ("Verified ring transfer\n");
+      printf ("Verified ring checks\n");
+      exit (0);
+    }
+
+  make_message (s, 1);
+  assert (zapi_ring_send_fds (sv[0], STREAM_DATA (s), stream_get_endp (s),
+                              producer) == (ssize_t) stream_get_endp (s));
+
+  stream_reset (s);
+  assert (zapi_ring_read_try (s, sv[1], STREAM_WRITEABLE (s), fds)
+          == ZEBRA_HEADER_SIZE + 4 + 1);
+  check_message (s, 1);
+  assert (fds[0] >= 0 && fds[1] >= 0);
+
+  consumer = zapi_ring_attach (fds[0], fds[1]);
+  assert (consumer);
+
+  close (sv[0]);
+  close (sv[1]);
+  stream_free (s);
+  printf ("Verified ring handover\n");
+}
+
+static void *
+produce (void *arg)
+{
+  struct stream *s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  unsigned int i;
+
+  for (i = 0; i < MESSAGES; i++)
+    {
+      make_message (s, i);
+      while (zapi_ring_put (producer, STREAM_DATA (s), stream_get_endp (s)) < 0)
+        sched_yield ();
+    }
+  stream_free (s);
+  return NULL;
+}
+
+/* Messages come out as they went in, with the consumer going to sleep on
+ * the eventfd whenever it catches up with the producer. */
+static void
+test_transfer (void)
+{
+  struct stream *s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  struct pollfd pfd;
+  pthread_t thread;
+  unsigned int i = 0;
+  int ret;
+
+  assert (pthread_create (&thread, NULL, produce, NULL) == 0);
+
+  pfd.fd = zapi_ring_eventfd (consumer);
+  pfd.events = POLLIN;
+  while (i < MESSAGES)
+    {
+      ret = zapi_ring_get (consumer, s);
+      assert (ret >= 0);
+      if (ret == 1)
+        {
+          check_message (s, i++);
+          continue;
+        }
+      /* A lost wakeup would hang here; don't wait forever. */
+      if (zapi_ring_sleep (consumer))
+        assert (poll (&pfd, 1, 10000) == 1);
+    }
+  assert (zapi_ring_get (consumer, s) == 0);
+
+  pthread_join (thread, NULL);
+  stream_free (s);
+  printf ("Verified ring transfer\n");
+}
+
+/* The consumer doesn't trust what it finds in the ring.  This leaves
+ * garbage in it, so comes last. */
+static void
+test_checks (void)
+{
+  struct stream *s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  struct stream *small = stream_new (16);
+  u_char junk[ZEBRA_HEADER_SIZE] = { 0, 3 };
+  int fds[2];
+
+  /* A message that is longer than the room for it. */
+  make_message (s, 99);
+  assert (zapi_ring_put (producer, STREAM_DATA (s), stream_get_endp (s)) == 0);
+  assert (zapi_ring_get (consumer, small) == -1);
+  assert (zapi_ring_get (consumer, s) == 1);
+  check_message (s, 99);
+
+  /* A message shorter than its header. */
+  assert (zapi_ring_put (producer, junk, sizeof (junk)) == 0);
+  assert (zapi_ring_get (consumer, s) == -1);
+
+  /* A memfd that isn't a ring. */
+  assert (pipe (fds) == 0);
+  assert (zapi_ring_attach (fds[0], fds[1]) == NULL);
+
+  stream_free (s);
+  stream_free (small);
+  printf ("Verified ring checks\n");
+}
+
+int
+main (void)
+{
+  test_handover ();
+  test_transfer ();
+  test_checks ();
+
+  zapi_ring_free (producer);
+  zapi_ring_free (consumer);
+  return 0;
+}
@@ -0,0 +1,8 @@
+import frrtest
+
+class TestZapiRing(frrtest.TestMultiOut):
+    program = './test_zapi_ring'
+
+TestZapiRing.onesimple('Verified ring handover')
+TestZapiRing.onesimple('Verified ring transfer')
+TestZapiRing.onesimple('Verified ring checks')
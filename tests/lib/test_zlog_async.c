@@ -0,0 +1,129 @@
+/*
+ * Asynchronous logging tests.
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+#include <log.h>
+
+struct thread_master *master;
+
+#define THREADS 4
+#define MESSAGES 20000
+
+static char logfile[] = "/tmp/test_zlog_async.XXXXXX";
+
+static void *
+thread_log (void *arg)
+{
+  unsigned int n = (uintptr_t) arg;
+  unsigned int i;
+
+  for (i = 0; i < MESSAGES; i++)
+    zlog_debug ("thread %u message %u", n, i);
+  return NULL;
+}
+
+/* Every message that wasn't dropped must be in the file, and the ones from
+ * each pthread in the order they were logged in. */
+static void
+check_file (unsigned long *lines, unsigned long *notices)
+{
+  unsigned int last[THREADS];
+  unsigned int n, i, t;
+  unsigned long dropped;
+  char buf[256], *p;
+  FILE *fp;
+
+  for (t = 0; t < THREADS; t++)
+    last[t] = UINT_MAX;
+  *lines = *notices = 0;
+
+  fp = fopen (logfile, "r");
+  assert (fp);
+  while (fgets (buf, sizeof (buf), fp))
+    {
+      assert (strchr (buf, '\n'));
+      if ((p = strstr (buf, "TEST: thread ")))
+	{
+	  assert (sscanf (p, "TEST: thread %u message %u", &n, &i) == 2);
+	  assert (n < THREADS);
+	  assert (last[n] == UINT_MAX || i > last[n]);
+	  last[n] = i;
+	  (*lines)++;
+	}
+      else
+	{
+	  p = strstr (buf, "TEST: ");
+	  assert (p);
+	  assert (sscanf (p, "TEST: %lu log messages dropped", &dropped) == 1);
+	  *notices += dropped;
+	}
+    }
+  fclose (fp);
+}
+
+static void
+test_async (void)
+{
+  pthread_t threads[THREADS];
+  struct zlog_async_stats stats;
+  unsigned long lines, notices;
+  unsigned int i;
+  int fd;
+
+  fd = mkstemp (logfile);
+  assert (fd >= 0);
+  close (fd);
+
+  openzlog ("test_zlog_async", "TEST", 0, LOG_CONS | LOG_NDELAY | LOG_PID,
+	    LOG_DAEMON);
+  zlog_set_file (logfile, LOG_DEBUG);
+  zlog_set_level (ZLOG_DEST_MONITOR, ZLOG_DISABLED);
+  zlog_set_async (1);
+
+  for (i = 0; i < THREADS; i++)
+    assert (pthread_create (&threads[i], NULL, thread_log,
+			    (void *) (uintptr_t) i) == 0);
+  for (i = 0; i < THREADS; i++)
+    pthread_join (threads[i], NULL);
+
+  /* turning it off writes out the rest */
+  zlog_set_async (0);
+  zlog_async_get_stats (&stats);
+  closezlog ();
+
+  assert (stats.queued + stats.dropped == THREADS * MESSAGES);
+  assert (stats.written == stats.queued);
+
+  check_file (&lines, &notices);
+  assert (lines == stats.queued);
+  assert (notices == stats.dropped);
+  unlink (logfile);
+
+  printf ("Verified asynchronous logging\n");
+}
+
+int
+main (void)
+{
+  test_async ();
+  return 0;
+}
@@ -377,7 +377,7 @@ zebra_vrf_table_create (struct zebra_vrf *zvrf, afi_t afi, safi_t safi)
   if (afi == AFI_IP6)
     table = srcdest_table_init();
   else
-    table = route_table_init();
+    table = route_table_init_with_delegate (route_table_get_stride_delegate ());
   table->cleanup = zebra_rtable_node_cleanup;
   zvrf->table[afi][safi] = table;
 
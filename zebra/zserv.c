@@ -38,6 +38,7 @@
 #include "buffer.h"
 #include "nexthop.h"
 #include "vrf.h"
+#include "zapi_ring.h"
 
 #include "zebra/zserv.h"
 #include "zebra/zebra_ns.h"
@@ -2140,6 +2141,8 @@ zebra_client_close (struct zserv *client)
   /* Free stream buffers. */
   if (client->ibuf)
     stream_free (client->ibuf);
+  if (client->ibuf_work)
+    stream_free (client->ibuf_work);
   if (client->obuf)
     stream_free (client->obuf);
   if (client->wb)
@@ -2152,6 +2155,16 @@ zebra_client_close (struct zserv *client)
     thread_cancel (client->t_write);
   if (client->t_suicide)
     thread_cancel (client->t_suicide);
+  if (client->t_ring)
+    thread_cancel (client->t_ring);
+
+  /* Release the shared memory ring. */
+  if (client->ring)
+    zapi_ring_free (client->ring);
+  if (client->ring_fds[0] >= 0)
+    close (client->ring_fds[0]);
+  if (client->ring_fds[1] >= 0)
+    close (client->ring_fds[1]);
 
   /* Free client structure. */
   listnode_delete (zebrad.client_list, client);
@@ -2171,6 +2184,8 @@ zebra_client_create (int sock)
   /* Make client input/output buffer. */
   client->sock = sock;
   client->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  client->ibuf_work = stream_new (ZEBRA_IBUF_WORK_SIZE);
+  client->ring_fds[0] = client->ring_fds[1] = -1;
   client->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   client->wb = buffer_new(0);
 
@@ -2198,104 +2213,138 @@ zebra_client_create (int sock)
   zebra_vrf_update_all (client);
 }
 
-/* Handler of zebra service request. */
-static int
-zebra_client_read (struct thread *thread)
+static int zebra_client_ring_read (struct thread *);
+
+/* The client offers a shared memory ring for its messages; its fds came
+   along with the message. */
+static void
+zread_zapi_ring (struct zserv *client)
 {
-  int sock;
-  struct zserv *client;
-  size_t already;
-  uint16_t length, command;
-  uint8_t marker, version;
+  struct stream *s;
+  int accept = 0;
+
+  if (client->ring_fds[0] >= 0)
+    {
+      if (!client->ring)
+        client->ring = zapi_ring_attach (client->ring_fds[0],
+                                         client->ring_fds[1]);
+      else
+        {
+          close (client->ring_fds[0]);
+          close (client->ring_fds[1]);
+        }
+      client->ring_fds[0] = client->ring_fds[1] = -1;
+      accept = (client->ring != NULL && !client->ring_active);
+    }
+
+  if (!accept)
+    zlog_warn ("%s: declining shared memory ring from %s client",
+               __func__, zebra_route_string (client->proto));
+
+  s = client->obuf;
+  stream_reset (s);
+  zserv_create_header (s, ZEBRA_ZAPI_RING, VRF_DEFAULT);
+  stream_putc (s, accept);
+  stream_putw_at (s, 0, stream_get_endp (s));
+  zebra_server_send_message (client);
+}
+
+/* The client's messages come through the ring from here on. */
+static void
+zread_zapi_ring_start (struct zserv *client)
+{
+  if (!client->ring || client->ring_active)
+    return;
+
+  client->ring_active = 1;
+  thread_add_event (zebrad.master, zebra_client_ring_read, client, 0,
+                    &client->t_ring);
+}
+
+/* Handle a ZEBRA_ROUTE_BATCH message: any number of route add/delete
+   messages, each complete with its own header, packed back to back. */
+static void
+zread_route_batch (struct zserv *client, u_short length)
+{
+  struct stream *s = client->ibuf;
+  size_t pos = stream_get_getp (s);
+  size_t end = pos + length;
+  uint16_t command;
+  int sublen;
   vrf_id_t vrf_id;
   struct zebra_vrf *zvrf;
 
-  /* Get thread data.  Reset reading thread because I'm running. */
-  sock = THREAD_FD (thread);
-  client = THREAD_ARG (thread);
-  client->t_read = NULL;
+  client->batch_cnt++;
 
-  if (client->t_suicide)
+  while ((sublen = zapi_batch_next (s, pos, end)) > 0)
     {
-      zebra_client_close(client);
-      return -1;
-    }
+      vrf_id = stream_getw_from (s, pos + 4);
+      command = stream_getw_from (s, pos + 6);
 
-  /* Read length and command (if we don't have it already). */
-  if ((already = stream_get_endp(client->ibuf)) < ZEBRA_HEADER_SIZE)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     ZEBRA_HEADER_SIZE-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed socket [%d]", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(ZEBRA_HEADER_SIZE-already))
-	{
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-      already = ZEBRA_HEADER_SIZE;
+      if (IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV)
+        zlog_debug ("zebra batched message received [%s] %d in VRF %u",
+                    zserv_command_string (command),
+                    sublen - ZEBRA_HEADER_SIZE, vrf_id);
+
+      stream_set_getp (s, pos + ZEBRA_HEADER_SIZE);
+      zvrf = zebra_vrf_lookup_by_id (vrf_id);
+      if (!zvrf)
+        {
+          if (IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV)
+            zlog_debug ("zebra received unknown VRF[%u]", vrf_id);
+        }
+      else
+        switch (command)
+          {
+          case ZEBRA_IPV4_ROUTE_ADD:
+          case ZEBRA_IPV4_NEXTHOP_ADD:
+            zread_ipv4_add (client, sublen - ZEBRA_HEADER_SIZE, zvrf);
+            break;
+          case ZEBRA_IPV4_ROUTE_DELETE:
+          case ZEBRA_IPV4_NEXTHOP_DELETE:
+            zread_ipv4_delete (client, sublen - ZEBRA_HEADER_SIZE, zvrf);
+            break;
+          case ZEBRA_IPV4_ROUTE_IPV6_NEXTHOP_ADD:
+            zread_ipv4_route_ipv6_nexthop_add (client,
+                                               sublen - ZEBRA_HEADER_SIZE,
+                                               zvrf);
+            break;
+          case ZEBRA_IPV6_ROUTE_ADD:
+            zread_ipv6_add (client, sublen - ZEBRA_HEADER_SIZE, zvrf);
+            break;
+          case ZEBRA_IPV6_ROUTE_DELETE:
+            zread_ipv6_delete (client, sublen - ZEBRA_HEADER_SIZE, zvrf);
+            break;
+          default:
+            zlog_info ("Zebra received command %s in a batch, ignoring it",
+                       zserv_command_string (command));
+            break;
+          }
+
+      pos += sublen;
     }
 
-  /* Reset to read from the beginning of the incoming packet. */
-  stream_set_getp(client->ibuf, 0);
+  if (sublen < 0)
+    zlog_warn ("%s: socket %d sent a malformed batch, dropping the rest",
+               __func__, client->sock);
+}
 
-  /* Fetch header values */
+/* Act on the message in client->ibuf.  Returns -1 if the client is gone
+   afterwards. */
+static int
+zebra_client_dispatch (struct zserv *client, int sock)
+{
+  uint16_t length, command;
+  vrf_id_t vrf_id;
+  struct zebra_vrf *zvrf;
+
+  /* Fetch header values; they have been checked already. */
+  stream_set_getp (client->ibuf, 0);
   length = stream_getw (client->ibuf);
-  marker = stream_getc (client->ibuf);
-  version = stream_getc (client->ibuf);
+  stream_forward_getp (client->ibuf, 2);
   vrf_id = stream_getw (client->ibuf);
   command = stream_getw (client->ibuf);
 
-  if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
-    {
-      zlog_err("%s: socket %d version mismatch, marker %d, version %d",
-               __func__, sock, marker, version);
-      zebra_client_close (client);
-      return -1;
-    }
-  if (length < ZEBRA_HEADER_SIZE) 
-    {
-      zlog_warn("%s: socket %d message length %u is less than header size %d",
-	        __func__, sock, length, ZEBRA_HEADER_SIZE);
-      zebra_client_close (client);
-      return -1;
-    }
-  if (length > STREAM_SIZE(client->ibuf))
-    {
-      zlog_warn("%s: socket %d message length %u exceeds buffer size %lu",
-	        __func__, sock, length, (u_long)STREAM_SIZE(client->ibuf));
-      zebra_client_close (client);
-      return -1;
-    }
-
-  /* Read rest of data. */
-  if (already < length)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     length-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed [%d] when reading zebra data", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(length-already))
-        {
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-    }
-
   length -= ZEBRA_HEADER_SIZE;
 
   /* Debug packet information. */
@@ -2314,7 +2363,7 @@ zebra_client_read (struct thread *thread)
     {
       if (IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV)
         zlog_debug ("zebra received unknown VRF[%u]", vrf_id);
-      goto zclient_read_out;
+      return 0;
     }
 
   switch (command) 
@@ -2352,6 +2401,15 @@ zebra_client_read (struct thread *thread)
     case ZEBRA_IPV6_ROUTE_DELETE:
       zread_ipv6_delete (client, length, zvrf);
       break;
+    case ZEBRA_ROUTE_BATCH:
+      zread_route_batch (client, length);
+      break;
+    case ZEBRA_ZAPI_RING:
+      zread_zapi_ring (client);
+      break;
+    case ZEBRA_ZAPI_RING_START:
+      zread_zapi_ring_start (client);
+      break;
     case ZEBRA_REDISTRIBUTE_ADD:
       zebra_redistribute_add (command, client, length, zvrf);
       break;
@@ -2431,9 +2489,124 @@ zebra_client_read (struct thread *thread)
       return -1;
     }
 
- zclient_read_out:
-  stream_reset (client->ibuf);
-  zebra_event (ZEBRA_READ, sock, client);
+  return 0;
+}
+
+/* Handler of zebra service request.  Everything the socket has is read
+   into client->ibuf_work, and up to zebrad.packets_to_process complete
+   messages out of it are acted on before we go back to the event loop. */
+static int
+zebra_client_read (struct thread *thread)
+{
+  int sock;
+  struct zserv *client;
+  struct stream *work;
+  u_int32_t packets;
+  int ret;
+
+  /* Get thread data.  Reset reading thread because I'm running. */
+  sock = THREAD_FD (thread);
+  client = THREAD_ARG (thread);
+  client->t_read = NULL;
+  work = client->ibuf_work;
+
+  if (client->t_suicide)
+    {
+      zebra_client_close(client);
+      return -1;
+    }
+
+  /* Take in as much as there is room for.  There always is room for at
+     least one more message, see the pulldown below. */
+  if (STREAM_WRITEABLE (work) > 0)
+    {
+      ssize_t nbyte;
+
+      nbyte = zapi_ring_read_try (work, sock, STREAM_WRITEABLE (work),
+				  client->ring_fds);
+      if (nbyte == 0 || nbyte == -1)
+	{
+	  if (IS_ZEBRA_DEBUG_EVENT)
+	    zlog_debug ("connection closed socket [%d]", sock);
+	  zebra_client_close (client);
+	  return -1;
+	}
+    }
+
+  for (packets = 0; packets < zebrad.packets_to_process; packets++)
+    {
+      /* Stop at a message whose rest is still to come. */
+      ret = zapi_read_next (work, client->ibuf);
+      if (ret == 0)
+	break;
+      if (ret < 0)
+	{
+	  zlog_warn ("%s: socket %d sent a bad message header, closing",
+		     __func__, sock);
+	  zebra_client_close (client);
+	  return -1;
+	}
+
+      if (zebra_client_dispatch (client, sock) < 0)
+	return -1;
+    }
+
+  stream_pulldown (work);
+
+  /* Out of budget with messages left over: let the other clients and
+     events have a go, and come straight back to these. */
+  if (packets == zebrad.packets_to_process && zapi_read_ready (work))
+    thread_add_event (zebrad.master, zebra_client_read, client, sock,
+		      &client->t_read);
+  else
+    zebra_event (ZEBRA_READ, sock, client);
+
+  return 0;
+}
+
+/* Act on the messages in the client's shared memory ring, up to
+   zebrad.packets_to_process of them per go, and wait on the ring's
+   eventfd once it's empty. */
+static int
+zebra_client_ring_read (struct thread *thread)
+{
+  struct zserv *client;
+  u_int32_t packets;
+  int ret;
+
+  client = THREAD_ARG (thread);
+  client->t_ring = NULL;
+
+  if (client->t_suicide)
+    {
+      zebra_client_close(client);
+      return -1;
+    }
+
+  for (packets = 0; packets < zebrad.packets_to_process; packets++)
+    {
+      ret = zapi_ring_get (client->ring, client->ibuf);
+      if (ret == 0)
+	break;
+      if (ret < 0 || zapi_check_header (client->ibuf, 0,
+					   STREAM_SIZE (client->ibuf)) == 0)
+	{
+	  zlog_warn ("%s: garbage in shared memory ring of socket %d, closing",
+		     __func__, client->sock);
+	  zebra_client_close (client);
+	  return -1;
+	}
+
+      if (zebra_client_dispatch (client, client->sock) < 0)
+	return -1;
+    }
+
+  if (packets < zebrad.packets_to_process && zapi_ring_sleep (client->ring))
+    thread_add_read (zebrad.master, zebra_client_ring_read, client,
+		     zapi_ring_eventfd (client->ring), &client->t_ring);
+  else
+    thread_add_event (zebrad.master, zebra_client_ring_read, client, 0,
+		      &client->t_ring);
   return 0;
 }
 
@@ -2717,6 +2890,9 @@ zebra_show_client_detail (struct vty *vty, struct zserv *client)
 	   VTY_NEWLINE);
   vty_out (vty, "Interface Down Notifications: %d%s", client->ifdown_cnt,
 	   VTY_NEWLINE);
+  vty_out (vty, "Route Batches: %d%s", client->batch_cnt, VTY_NEWLINE);
+  vty_out (vty, "Transport: %s%s",
+	   client->ring_active ? "shared memory ring" : "socket", VTY_NEWLINE);
 
   vty_out (vty, "%s", VTY_NEWLINE);
   return;
@@ -2790,6 +2966,29 @@ DEFUN (no_config_table,
 }
 #endif
 
+DEFUN (zebra_zapi_packets,
+       zebra_zapi_packets_cmd,
+       "zebra zapi-packets (1-10000)",
+       "Zebra configuration\n"
+       "Messages to process per client wakeup\n"
+       "Number of messages\n")
+{
+  zebrad.packets_to_process = strtoul (argv[2]->arg, NULL, 10);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_zebra_zapi_packets,
+       no_zebra_zapi_packets_cmd,
+       "no zebra zapi-packets [(1-10000)]",
+       NO_STR
+       "Zebra configuration\n"
+       "Messages to process per client wakeup\n"
+       "Number of messages\n")
+{
+  zebrad.packets_to_process = ZEBRA_ZAPI_PACKETS_TO_PROCESS;
+  return CMD_SUCCESS;
+}
+
 DEFUN (ip_forwarding,
        ip_forwarding_cmd,
        "ip forwarding",
@@ -2903,6 +3102,9 @@ config_write_table (struct vty *vty)
   if (zebrad.rtm_table_default)
     vty_out (vty, "table %d%s", zebrad.rtm_table_default,
 	     VTY_NEWLINE);
+  if (zebrad.packets_to_process != ZEBRA_ZAPI_PACKETS_TO_PROCESS)
+    vty_out (vty, "zebra zapi-packets %u%s", zebrad.packets_to_process,
+	     VTY_NEWLINE);
   return 0;
 }
 
@@ -3046,6 +3248,8 @@ zebra_init (void)
   install_element (ENABLE_NODE, &show_zebra_cmd);
   install_element (ENABLE_NODE, &show_zebra_client_cmd);
   install_element (ENABLE_NODE, &show_zebra_client_summary_cmd);
+  install_element (CONFIG_NODE, &zebra_zapi_packets_cmd);
+  install_element (CONFIG_NODE, &no_zebra_zapi_packets_cmd);
 
 #ifdef HAVE_NETLINK
   install_element (VIEW_NODE, &show_table_cmd);
@@ -38,6 +38,12 @@
 
 #define ZEBRA_RMAP_DEFAULT_UPDATE_TIMER 5 /* disabled by default */
 
+/* Room for this many full-sized messages from a client per read(). */
+#define ZEBRA_IBUF_WORK_SIZE (ZEBRA_MAX_PACKET_SIZ * 16)
+
+/* Most messages acted on per client per wakeup, by default. */
+#define ZEBRA_ZAPI_PACKETS_TO_PROCESS 1000
+
 /* Client structure. */
 struct zserv
 {
@@ -48,6 +54,17 @@ struct zserv
   struct stream *ibuf;
   struct stream *obuf;
 
+  /* Data read from the client but not acted on yet. */
+  struct stream *ibuf_work;
+
+  /* Shared memory ring the client sends its messages through once it has
+     sent ZEBRA_ZAPI_RING_START, and the fds for it that came along with
+     the socket data, until the ZEBRA_ZAPI_RING message is acted on. */
+  struct zapi_ring *ring;
+  int ring_active;
+  int ring_fds[2];
+  struct thread *t_ring;
+
   /* Buffer of data waiting to be written to client. */
   struct buffer *wb;
 
@@ -105,6 +122,7 @@ struct zserv
   u_int32_t vrfdel_cnt;
   u_int32_t if_vrfchg_cnt;
   u_int32_t bfd_client_reg_cnt;
+  u_int32_t batch_cnt;
 
   time_t connect_time;
   time_t last_read_time;
@@ -127,6 +145,9 @@ struct zebra_t
   /* default table */
   u_int32_t rtm_table_default;
 
+  /* messages to act on per client per wakeup */
+  u_int32_t packets_to_process;
+
   /* rib work queue */
   struct work_queue *ribq;
   struct meta_queue *mq;